@@ -0,0 +1,336 @@
+// fyzenor-bench: drives the engines behind the file manager's hot paths
+// headlessly against synthetic trees and prints a latency histogram for every
+// timed scope (see trace.h). They call the code those FileManager paths run,
+// such as the preview workers' buildTextPreview() and buildDirectoryPreview(),
+// under the same scope names, so their numbers line up with the stats overlay
+// (S) and with `fyzenor --trace`.
+
+#include "utils.h" // first: it defines _XOPEN_SOURCE_EXTENDED
+#include "copy_engine.h"
+#include "content_search.h"
+#include "dir_loader.h"
+#include "file_entry.h"
+#include "fuzzy_finder.h"
+#include "preview_render.h"
+#include "size_engine.h"
+#include "trace.h"
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <set>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+  fs::path root;
+  size_t files = 1000000;
+  int depth = 5;
+  int fanout = 4;
+  int filesPerDir = 16;
+  size_t bigMB = 64;
+  int iterations = 5;
+  std::string trace;
+  std::set<std::string> only;
+  bool keep = false;
+};
+
+void usage() {
+  std::cout << "Usage: fyzenor-bench [options]\n"
+            << "  --root DIR        where the synthetic trees are made (default: $TMPDIR)\n"
+            << "  --files N         entries in the flat directory (default 1000000)\n"
+            << "  --depth N         levels of the deep tree (default 5)\n"
+            << "  --fanout N        subdirectories per level of the deep tree (default 4)\n"
+            << "  --files-per-dir N files in every deep tree directory (default 16)\n"
+            << "  --big-mb N        size of the huge single file in MiB (default 64)\n"
+            << "  --iterations N    runs of every benchmark (default 5)\n"
+            << "  --only LIST       comma-separated subset of: list,sort,size,preview,search,copy\n"
+            << "  --trace FILE      write a Chrome trace (chrome://tracing, ui.perfetto.dev)\n"
+            << "  --keep            leave the synthetic trees behind\n";
+}
+
+bool parseOptions(int argc, char* argv[], Options& o) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&]() -> std::string {
+      if (i + 1 >= argc) throw std::invalid_argument(arg + " needs a value");
+      return argv[++i];
+    };
+    try {
+      if (arg == "--root") o.root = value();
+      else if (arg == "--files") o.files = std::stoul(value());
+      else if (arg == "--depth") o.depth = std::stoi(value());
+      else if (arg == "--fanout") o.fanout = std::stoi(value());
+      else if (arg == "--files-per-dir") o.filesPerDir = std::stoi(value());
+      else if (arg == "--big-mb") o.bigMB = std::stoul(value());
+      else if (arg == "--iterations") o.iterations = std::max(1, std::stoi(value()));
+      else if (arg == "--trace") o.trace = value();
+      else if (arg == "--keep") o.keep = true;
+      else if (arg == "--only") {
+        std::stringstream ss(value());
+        std::string name;
+        while (std::getline(ss, name, ','))
+          o.only.insert(name);
+      } else {
+        usage();
+        return false;
+      }
+    } catch (const std::exception& e) {
+      std::cerr << "fyzenor-bench: bad option " << arg << ": " << e.what() << "\n";
+      return false;
+    }
+  }
+  if (o.root.empty()) o.root = fs::temp_directory_path();
+  o.root /= "fyzenor-bench-" + std::to_string(getpid());
+  return true;
+}
+
+void writeFile(const fs::path& p, const std::string& data) {
+  int fd = open(p.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return;
+  if (!data.empty() && write(fd, data.data(), data.size()) < 0) perror(p.c_str());
+  close(fd);
+}
+
+// --- Synthetic trees ---
+
+// One directory of n small files with mixed-case, numbered names. They are
+// sparse, so a million of them cost inodes but no data blocks.
+void makeFlat(const fs::path& dir, size_t n) {
+  fs::create_directories(dir);
+  std::mt19937 rng(7);
+  const char* stems[] = {"Report", "image", "notes", "IMG_", "data", "build", "Track "};
+  const char* exts[] = {".txt", ".png", ".md", ".jpg", ".json", ".o", ".flac"};
+  for (size_t i = 0; i < n; ++i) {
+    size_t k = rng() % 7;
+    std::string name = std::string(stems[k]) + std::to_string(rng() % (n * 4)) + "_" +
+                       std::to_string(i) + exts[(k + rng() % 2) % 7];
+    int fd = open((dir / name).c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) continue;
+    if (ftruncate(fd, rng() % 512) < 0) perror(name.c_str());
+    close(fd);
+  }
+}
+
+// depth levels of fanout subdirectories, filesPerDir text files in each;
+// every 97th file mentions the search needle.
+void makeDeep(const fs::path& dir, int depth, int fanout, int filesPerDir, size_t& counter) {
+  fs::create_directories(dir);
+  for (int f = 0; f < filesPerDir; ++f) {
+    std::string text = "int main() {\n  return " + std::to_string(counter) + ";\n}\n";
+    if (++counter % 97 == 0) text += "// needle " + std::to_string(counter) + "\n";
+    writeFile(dir / ("src" + std::to_string(f) + ".cpp"), text);
+  }
+  if (depth == 0) return;
+  for (int d = 0; d < fanout; ++d)
+    makeDeep(dir / ("dir" + std::to_string(d)), depth - 1, fanout, filesPerDir, counter);
+}
+
+// A highlighted-preview-sized source file repeated up to mb MiB.
+void makeBig(const fs::path& file, size_t mb) {
+  std::string chunk;
+  for (int i = 0; chunk.size() < (1 << 20); ++i)
+    chunk += "static int value" + std::to_string(i) + " = compute(\"text\", " + std::to_string(i) +
+             "); // comment\n";
+  chunk.resize(1 << 20);
+  int fd = open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) return;
+  for (size_t i = 0; i < mb; ++i) {
+    if (write(fd, chunk.data(), chunk.size()) < 0) break;
+  }
+  close(fd);
+}
+
+// --- Benchmarks ---
+
+void benchList(const fs::path& flat, const Options& o) {
+  for (int i = 0; i < o.iterations; ++i) {
+    FileListing listing;
+    TRACE_SCOPE("loadDirectory");
+    readDirectoryEntries(flat, false, false, listing);
+  }
+  for (int i = 0; i < o.iterations; ++i) {
+    FileListing listing;
+    TRACE_SCOPE("loadDirectory.stat");
+    readDirectoryEntries(flat, false, true, listing);
+  }
+}
+
+void benchSort(const fs::path& flat, const Options& o) {
+  FileListing base;
+  readDirectoryEntries(flat, false, true, base);
+  base.resolveAllStats();
+  for (SortMode mode : {SortMode::NAME, SortMode::SIZE, SortMode::DATE}) {
+    for (int i = 0; i < o.iterations; ++i) {
+      FileListing listing = base;
+      TRACE_SCOPE("sortList");
+      listing.sort(mode);
+    }
+  }
+  // Directory sizes arriving one by one while sorted by size.
+  FileListing listing = base;
+  listing.sort(SortMode::SIZE);
+  std::mt19937 rng(3);
+  for (int i = 0; i < 1000 && !listing.empty(); ++i) {
+    size_t idx = rng() % listing.size();
+    listing.setSize(idx, rng() % 4096);
+    TRACE_SCOPE("sortList.reposition");
+    listing.reposition(idx, SortMode::SIZE);
+  }
+}
+
+void benchSize(const fs::path& deep, const Options& o) {
+  for (int i = 0; i < o.iterations; ++i) {
+    std::mutex m;
+    std::condition_variable cv;
+    bool done = false;
+    SizeEngine engine(0, false, nullptr,
+                      [&](const fs::path&, uintmax_t, int, bool final) {
+                        if (!final) return;
+                        std::lock_guard<std::mutex> lock(m);
+                        done = true;
+                        cv.notify_all();
+                      },
+                      [](int) { return true; });
+    TRACE_SCOPE("processSizeQueue");
+    engine.submit(deep, 1);
+    std::unique_lock<std::mutex> lock(m);
+    cv.wait(lock, [&] { return done; });
+  }
+}
+
+void benchPreview(const fs::path& flat, const fs::path& big, const Options& o) {
+  auto never = [] { return false; };
+  for (int i = 0; i < o.iterations * 20; ++i) {
+    TRACE_SCOPE("preview.text");
+    StyledText text;
+    buildTextPreview(big.string(), 60, 200, never, text);
+  }
+  for (int i = 0; i < o.iterations; ++i) {
+    TRACE_SCOPE("preview.directory");
+    PreviewData data;
+    buildDirectoryPreview(flat.string(), false, 50, never, nullptr, data);
+  }
+}
+
+void benchSearch(const fs::path& deep, const Options& o) {
+  for (int i = 0; i < o.iterations; ++i) {
+    std::string error;
+    size_t hits = 0;
+    std::mutex m;
+    searchContents(deep.string(), "needle [0-9]+", 0,
+                   [&](const std::string&, const std::string&, uintmax_t, int64_t) {
+                     std::lock_guard<std::mutex> lock(m);
+                     ++hits;
+                   },
+                   [] { return false; }, error);
+  }
+  auto index = std::make_shared<PathIndex>(deep.string());
+  {
+    TRACE_SCOPE("search.fuzzy.index");
+    index->build([] { return false; });
+  }
+  FuzzyMatcher matcher(index);
+  for (int i = 0; i < o.iterations; ++i) {
+    size_t total = 0;
+    // Typed one character at a time, as the finder sees it.
+    for (const char* q : {"d", "di", "dir", "dir3", "dir3/s", "dir3/src", "dir3/src1"})
+      matcher.search(q, 200, total);
+  }
+}
+
+void benchCopy(const fs::path& big, const fs::path& dir, const Options& o) {
+  fs::path dest = dir / "copy.bin";
+  for (int i = 0; i < o.iterations; ++i) {
+    fs::remove(dest);
+    int in = open(big.c_str(), O_RDONLY | O_CLOEXEC);
+    int out = open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (in < 0 || out < 0) {
+      if (in >= 0) close(in);
+      if (out >= 0) close(out);
+      return;
+    }
+    {
+      TRACE_SCOPE("copyFileWithProgress");
+      copyFileData(in, out, 0, [](uint64_t) { return true; });
+      fsync(out);
+    }
+    close(in);
+    close(out);
+  }
+  fs::remove(dest);
+}
+
+// --- Report ---
+
+std::string formatNs(uint64_t ns) {
+  char buf[32];
+  if (ns < 10000) snprintf(buf, sizeof(buf), "%.2f us", ns / 1e3);
+  else if (ns < 10000000000ULL) snprintf(buf, sizeof(buf), "%.2f ms", ns / 1e6);
+  else snprintf(buf, sizeof(buf), "%.2f s", ns / 1e9);
+  return buf;
+}
+
+void report() {
+  for (const TraceStats& st : traceStats()) {
+    printf("\n%s  n=%llu  mean=%s  p50<=%s  p90<=%s  p99<=%s  max=%s\n", st.name.c_str(),
+           (unsigned long long)st.count, formatNs(st.totalNs / st.count).c_str(),
+           formatNs(st.p50Ns).c_str(), formatNs(st.p90Ns).c_str(), formatNs(st.p99Ns).c_str(),
+           formatNs(st.maxNs).c_str());
+    int first = TraceSite::BUCKETS, last = -1;
+    uint64_t peak = 0;
+    for (int b = 0; b < TraceSite::BUCKETS; ++b) {
+      if (!st.buckets[b]) continue;
+      first = std::min(first, b);
+      last = b;
+      peak = std::max(peak, st.buckets[b]);
+    }
+    for (int b = first; b <= last; ++b) {
+      int bar = static_cast<int>(st.buckets[b] * 40 / peak);
+      printf("  < %10s | %-40s %llu\n", formatNs(1000ULL << (b + 1)).c_str(),
+             std::string(bar, '#').c_str(), (unsigned long long)st.buckets[b]);
+    }
+  }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+  Options o;
+  if (!parseOptions(argc, argv, o)) return 2;
+  auto wanted = [&](const char* name) { return o.only.empty() || o.only.count(name); };
+
+  fs::path flat = o.root / "flat";
+  fs::path deep = o.root / "deep";
+  fs::path big = o.root / "big.cpp";
+  std::cout << "Building synthetic trees in " << o.root.string() << "..." << std::endl;
+  if (wanted("list") || wanted("sort") || wanted("preview")) makeFlat(flat, o.files);
+  size_t counter = 0;
+  if (wanted("size") || wanted("search")) makeDeep(deep, o.depth, o.fanout, o.filesPerDir, counter);
+  if (wanted("preview") || wanted("copy")) makeBig(big, o.bigMB);
+
+  if (!o.trace.empty()) traceStart(o.trace);
+  if (wanted("list")) benchList(flat, o);
+  if (wanted("sort")) benchSort(flat, o);
+  if (wanted("size")) benchSize(deep, o);
+  if (wanted("preview")) benchPreview(flat, big, o);
+  if (wanted("search")) benchSearch(deep, o);
+  if (wanted("copy")) benchCopy(big, o.root, o);
+  bool traced = o.trace.empty() || traceStop();
+
+  report();
+  if (!o.keep) {
+    std::error_code ec;
+    fs::remove_all(o.root, ec);
+  }
+  if (!traced) {
+    std::cerr << "fyzenor-bench: could not write " << o.trace << "\n";
+    return 1;
+  }
+  return 0;
+}
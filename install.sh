@@ -128,7 +128,7 @@ fi
 echo -e "${BLUE}Compiling Fyzenor...${NC}"
 mkdir -p build
 cd build || exit 1
-if cmake .. && make; then
+if cmake .. && make fyzenor; then
     echo -e "${GREEN}Compilation successful!${NC}"
     cd ..
 else
@@ -0,0 +1,534 @@
+#include "archive_list.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef FYZENOR_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef FYZENOR_HAVE_BZIP2
+#include <bzlib.h>
+#endif
+#ifdef FYZENOR_HAVE_LZMA
+#include <lzma.h>
+#endif
+
+namespace {
+
+using CancelFn = std::function<bool()>;
+
+constexpr size_t IO_CHUNK = 64 * 1024;
+// Skip loops check for cancellation after this much member data.
+constexpr uint64_t CANCEL_CHECK_BYTES = 1024 * 1024;
+// GNU long names and pax headers bigger than this are skipped, not parsed.
+constexpr uint64_t MAX_META_BYTES = 1024 * 1024;
+#ifdef FYZENOR_HAVE_LZMA
+constexpr uint64_t XZ_MEMLIMIT = 256ull * 1024 * 1024;
+#endif
+
+struct Fd {
+  int fd;
+  explicit Fd(int fd) : fd(fd) {}
+  ~Fd() {
+    if (fd >= 0) close(fd);
+  }
+};
+
+uint16_t le16(const unsigned char* p) { return static_cast<uint16_t>(p[0] | p[1] << 8); }
+uint32_t le32(const unsigned char* p) {
+  return static_cast<uint32_t>(p[0]) | static_cast<uint32_t>(p[1]) << 8 |
+         static_cast<uint32_t>(p[2]) << 16 | static_cast<uint32_t>(p[3]) << 24;
+}
+uint64_t le64(const unsigned char* p) {
+  return static_cast<uint64_t>(le32(p)) | static_cast<uint64_t>(le32(p + 4)) << 32;
+}
+
+bool preadFull(int fd, unsigned char* buf, size_t n, uint64_t off) {
+  while (n > 0) {
+    ssize_t r = pread(fd, buf, n, static_cast<off_t>(off));
+    if (r < 0 && errno == EINTR) continue;
+    if (r <= 0) return false;
+    buf += r;
+    n -= static_cast<size_t>(r);
+    off += static_cast<uint64_t>(r);
+  }
+  return true;
+}
+
+// --- zip -------------------------------------------------------------------
+
+constexpr uint32_t ZIP_EOCD_SIG = 0x06054b50;
+constexpr uint32_t ZIP64_LOCATOR_SIG = 0x07064b50;
+constexpr uint32_t ZIP64_EOCD_SIG = 0x06064b50;
+constexpr uint32_t ZIP_CENTRAL_SIG = 0x02014b50;
+constexpr size_t ZIP_EOCD_LEN = 22;
+constexpr size_t ZIP_CENTRAL_LEN = 46;
+
+// Reads the central directory front to back through a window that is
+// refilled on demand, so a listing touches about maxEntries records.
+class Window {
+public:
+  Window(int fd, uint64_t end) : fd(fd), end(end) {}
+
+  const unsigned char* at(uint64_t off, size_t n) {
+    if (off < base || off + n > base + buf.size()) {
+      if (off + n > end) return nullptr;
+      size_t len = static_cast<size_t>(std::min<uint64_t>(std::max(n, IO_CHUNK), end - off));
+      buf.resize(len);
+      if (!preadFull(fd, buf.data(), len, off)) return nullptr;
+      base = off;
+    }
+    return buf.data() + (off - base);
+  }
+
+private:
+  int fd;
+  uint64_t end;
+  uint64_t base = 0;
+  std::vector<unsigned char> buf;
+};
+
+// Finds the end-of-central-directory record in the last 64 KiB (its comment
+// is at most that long) and returns the directory's offset, size and count.
+bool findZipDirectory(int fd, uint64_t fileSize, uint64_t& cdOffset, uint64_t& cdSize,
+                      uint64_t& count) {
+  if (fileSize < ZIP_EOCD_LEN) return false;
+  size_t tailLen = static_cast<size_t>(std::min<uint64_t>(fileSize, 0xFFFF + ZIP_EOCD_LEN));
+  uint64_t tailStart = fileSize - tailLen;
+  std::vector<unsigned char> tail(tailLen);
+  if (!preadFull(fd, tail.data(), tailLen, tailStart)) return false;
+
+  for (size_t i = tailLen - ZIP_EOCD_LEN + 1; i-- > 0;) {
+    const unsigned char* e = tail.data() + i;
+    if (le32(e) != ZIP_EOCD_SIG) continue;
+    count = le16(e + 10);
+    cdSize = le32(e + 12);
+    cdOffset = le32(e + 16);
+    uint64_t eocdPos = tailStart + i;
+
+    if ((count == 0xFFFF || cdSize == 0xFFFFFFFF || cdOffset == 0xFFFFFFFF) && eocdPos >= 20) {
+      unsigned char loc[20];
+      unsigned char rec[56];
+      if (preadFull(fd, loc, sizeof(loc), eocdPos - 20) && le32(loc) == ZIP64_LOCATOR_SIG &&
+          preadFull(fd, rec, sizeof(rec), le64(loc + 8)) && le32(rec) == ZIP64_EOCD_SIG) {
+        count = le64(rec + 32);
+        cdSize = le64(rec + 40);
+        cdOffset = le64(rec + 48);
+      }
+    }
+    if (cdSize > eocdPos) return false;
+    // Self-extracting archives have data prepended that the offsets ignore;
+    // the directory still ends where the EOCD record starts.
+    unsigned char sig[4];
+    if (cdOffset + cdSize > eocdPos || !preadFull(fd, sig, 4, cdOffset) ||
+        le32(sig) != ZIP_CENTRAL_SIG)
+      cdOffset = eocdPos - cdSize;
+    return true;
+  }
+  return false;
+}
+
+bool listZip(int fd, uint64_t fileSize, size_t maxEntries, ArchiveListing& out) {
+  uint64_t cdOffset = 0, cdSize = 0, count = 0;
+  if (!findZipDirectory(fd, fileSize, cdOffset, cdSize, count)) return false;
+
+  Window win(fd, cdOffset + cdSize);
+  uint64_t off = cdOffset;
+  for (uint64_t i = 0; i < count && out.entries.size() < maxEntries; ++i) {
+    const unsigned char* h = win.at(off, ZIP_CENTRAL_LEN);
+    if (!h || le32(h) != ZIP_CENTRAL_SIG) return !out.entries.empty();
+    uint64_t size = le32(h + 24);
+    size_t nameLen = le16(h + 28), extraLen = le16(h + 30), commentLen = le16(h + 32);
+    const unsigned char* rest = win.at(off + ZIP_CENTRAL_LEN, nameLen + extraLen);
+    if (!rest) return !out.entries.empty();
+
+    ArchiveEntry entry;
+    entry.name.assign(reinterpret_cast<const char*>(rest), nameLen);
+    if (size == 0xFFFFFFFF) {
+      // The zip64 extra field leads with the real uncompressed size.
+      const unsigned char* x = rest + nameLen;
+      for (size_t p = 0; p + 4 <= extraLen;) {
+        uint16_t id = le16(x + p), len = le16(x + p + 2);
+        if (id == 0x0001 && len >= 8 && p + 4 + 8 <= extraLen) {
+          size = le64(x + p + 4);
+          break;
+        }
+        p += 4 + len;
+      }
+    }
+    entry.size = size;
+    entry.isDir = !entry.name.empty() && entry.name.back() == '/';
+    out.entries.push_back(std::move(entry));
+    off += ZIP_CENTRAL_LEN + nameLen + extraLen + commentLen;
+  }
+  out.total = count;
+  out.more = out.entries.size() < count;
+  return true;
+}
+
+// --- tar -------------------------------------------------------------------
+
+enum class Codec { NONE, GZIP, BZIP2, XZ };
+
+// Sequential reader over a plain or compressed file. Input and output are
+// both bounded by IO_CHUNK buffers, whatever the archive's size.
+class TarStream {
+public:
+  TarStream(int fd, Codec codec) : fd(fd), codec(codec) {}
+
+  ~TarStream() {
+#ifdef FYZENOR_HAVE_ZLIB
+    if (codec == Codec::GZIP && started) inflateEnd(&zs);
+#endif
+#ifdef FYZENOR_HAVE_BZIP2
+    if (codec == Codec::BZIP2 && started) BZ2_bzDecompressEnd(&bs);
+#endif
+#ifdef FYZENOR_HAVE_LZMA
+    if (codec == Codec::XZ && started) lzma_end(&ls);
+#endif
+  }
+
+  TarStream(const TarStream&) = delete;
+  TarStream& operator=(const TarStream&) = delete;
+
+  bool init() {
+    switch (codec) {
+    case Codec::NONE:
+      started = true;
+      break;
+#ifdef FYZENOR_HAVE_ZLIB
+    case Codec::GZIP:
+      // 15 + 32: full window, gzip or zlib header detected automatically.
+      started = inflateInit2(&zs, 15 + 32) == Z_OK;
+      break;
+#endif
+#ifdef FYZENOR_HAVE_BZIP2
+    case Codec::BZIP2:
+      started = BZ2_bzDecompressInit(&bs, 0, 0) == BZ_OK;
+      break;
+#endif
+#ifdef FYZENOR_HAVE_LZMA
+    case Codec::XZ:
+      started = lzma_stream_decoder(&ls, XZ_MEMLIMIT, LZMA_CONCATENATED) == LZMA_OK;
+      break;
+#endif
+    default:
+      return false;
+    }
+    if (started && codec != Codec::NONE) in.resize(IO_CHUNK);
+    return started;
+  }
+
+  // Reads exactly n bytes; false at end of input or on a decode error.
+  bool read(unsigned char* dst, size_t n) {
+    if (codec == Codec::NONE) {
+      while (n > 0) {
+        ssize_t r = ::read(fd, dst, n);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        dst += r;
+        n -= static_cast<size_t>(r);
+      }
+      return true;
+    }
+    return decode(dst, n);
+  }
+
+  bool skip(uint64_t n, const CancelFn& cancelled) {
+    if (codec == Codec::NONE) return lseek(fd, static_cast<off_t>(n), SEEK_CUR) >= 0;
+    if (scratch.empty()) scratch.resize(IO_CHUNK);
+    uint64_t sinceCheck = 0;
+    while (n > 0) {
+      size_t len = static_cast<size_t>(std::min<uint64_t>(n, scratch.size()));
+      if (!decode(scratch.data(), len)) return false;
+      n -= len;
+      sinceCheck += len;
+      if (sinceCheck >= CANCEL_CHECK_BYTES) {
+        sinceCheck = 0;
+        if (cancelled && cancelled()) return false;
+      }
+    }
+    return true;
+  }
+
+  bool seekable() const { return codec == Codec::NONE; }
+
+private:
+  // Refills the input buffer; returns the bytes now available (0 at EOF).
+  size_t fill(size_t pending, const unsigned char*& next) {
+    if (pending > 0) return pending;
+    if (eof) return 0;
+    ssize_t r;
+    do {
+      r = ::read(fd, in.data(), in.size());
+    } while (r < 0 && errno == EINTR);
+    if (r <= 0) {
+      eof = true;
+      return 0;
+    }
+    next = in.data();
+    return static_cast<size_t>(r);
+  }
+
+  bool decode(unsigned char* dst, size_t n) {
+    switch (codec) {
+#ifdef FYZENOR_HAVE_ZLIB
+    case Codec::GZIP: {
+      zs.next_out = dst;
+      zs.avail_out = static_cast<uInt>(n);
+      while (zs.avail_out > 0) {
+        const unsigned char* next = zs.next_in;
+        zs.avail_in = static_cast<uInt>(fill(zs.avail_in, next));
+        zs.next_in = const_cast<Bytef*>(next);
+        if (zs.avail_in == 0) return false;
+        int ret = inflate(&zs, Z_NO_FLUSH);
+        if (ret == Z_STREAM_END) {
+          // Concatenated members (pigz, appended archives) continue the tar.
+          if (inflateReset(&zs) != Z_OK) return false;
+        } else if (ret != Z_OK) {
+          return false;
+        }
+      }
+      return true;
+    }
+#endif
+#ifdef FYZENOR_HAVE_BZIP2
+    case Codec::BZIP2: {
+      bs.next_out = reinterpret_cast<char*>(dst);
+      bs.avail_out = static_cast<unsigned>(n);
+      while (bs.avail_out > 0) {
+        const unsigned char* next = reinterpret_cast<const unsigned char*>(bs.next_in);
+        bs.avail_in = static_cast<unsigned>(fill(bs.avail_in, next));
+        bs.next_in = reinterpret_cast<char*>(const_cast<unsigned char*>(next));
+        if (bs.avail_in == 0) return false;
+        int ret = BZ2_bzDecompress(&bs);
+        if (ret == BZ_STREAM_END) {
+          // pbzip2 writes one stream per block.
+          char* keepIn = bs.next_in;
+          unsigned keepAvail = bs.avail_in;
+          char* keepOut = bs.next_out;
+          unsigned keepOutAvail = bs.avail_out;
+          BZ2_bzDecompressEnd(&bs);
+          bs = bz_stream{};
+          if (BZ2_bzDecompressInit(&bs, 0, 0) != BZ_OK) {
+            started = false;
+            return false;
+          }
+          bs.next_in = keepIn;
+          bs.avail_in = keepAvail;
+          bs.next_out = keepOut;
+          bs.avail_out = keepOutAvail;
+        } else if (ret != BZ_OK) {
+          return false;
+        }
+      }
+      return true;
+    }
+#endif
+#ifdef FYZENOR_HAVE_LZMA
+    case Codec::XZ: {
+      ls.next_out = dst;
+      ls.avail_out = n;
+      while (ls.avail_out > 0) {
+        const unsigned char* next = ls.next_in;
+        ls.avail_in = fill(ls.avail_in, next);
+        ls.next_in = next;
+        lzma_ret ret = lzma_code(&ls, ls.avail_in == 0 ? LZMA_FINISH : LZMA_RUN);
+        if (ret == LZMA_STREAM_END) return ls.avail_out == 0;
+        if (ret != LZMA_OK) return false;
+      }
+      return true;
+    }
+#endif
+    default:
+      return false;
+    }
+  }
+
+  int fd;
+  Codec codec;
+  bool started = false;
+  bool eof = false;
+  std::vector<unsigned char> in;
+  std::vector<unsigned char> scratch;
+#ifdef FYZENOR_HAVE_ZLIB
+  z_stream zs{};
+#endif
+#ifdef FYZENOR_HAVE_BZIP2
+  bz_stream bs{};
+#endif
+#ifdef FYZENOR_HAVE_LZMA
+  lzma_stream ls = LZMA_STREAM_INIT;
+#endif
+};
+
+constexpr size_t TAR_BLOCK = 512;
+
+// Octal, or GNU base-256 when the high bit of the first byte is set.
+uint64_t tarNumber(const unsigned char* p, size_t len) {
+  uint64_t v = 0;
+  if (p[0] & 0x80) {
+    v = p[0] & 0x7F;
+    for (size_t i = 1; i < len; ++i) v = v << 8 | p[i];
+    return v;
+  }
+  size_t i = 0;
+  while (i < len && (p[i] == ' ' || p[i] == '\0')) ++i;
+  for (; i < len && p[i] >= '0' && p[i] <= '7'; ++i) v = v * 8 + (p[i] - '0');
+  return v;
+}
+
+bool tarChecksumOk(const unsigned char* h) {
+  uint64_t sum = 0;
+  for (size_t i = 0; i < TAR_BLOCK; ++i) sum += (i >= 148 && i < 156) ? ' ' : h[i];
+  return sum == tarNumber(h + 148, 8);
+}
+
+std::string tarField(const unsigned char* p, size_t len) {
+  return std::string(reinterpret_cast<const char*>(p),
+                     strnlen(reinterpret_cast<const char*>(p), len));
+}
+
+uint64_t padded(uint64_t n) { return (n + TAR_BLOCK - 1) & ~static_cast<uint64_t>(TAR_BLOCK - 1); }
+
+// Picks "path" and "size" out of pax extended header records
+// ("<len> <key>=<value>\n").
+void parsePax(const std::string& data, std::string& path, uint64_t& size, bool& haveSize) {
+  size_t pos = 0;
+  while (pos < data.size()) {
+    size_t sp = data.find(' ', pos);
+    if (sp == std::string::npos) break;
+    size_t len = strtoull(data.c_str() + pos, nullptr, 10);
+    if (len == 0 || pos + len > data.size()) break;
+    std::string rec = data.substr(sp + 1, pos + len - sp - 2); // drop '\n'
+    size_t eq = rec.find('=');
+    if (eq != std::string::npos) {
+      std::string key = rec.substr(0, eq);
+      if (key == "path") {
+        path = rec.substr(eq + 1);
+      } else if (key == "size") {
+        size = strtoull(rec.c_str() + eq + 1, nullptr, 10);
+        haveSize = true;
+      }
+    }
+    pos += len;
+  }
+}
+
+bool listTar(int fd, Codec codec, size_t maxEntries, ArchiveListing& out,
+             const CancelFn& cancelled) {
+  TarStream stream(fd, codec);
+  if (!stream.init()) return false;
+
+  unsigned char h[TAR_BLOCK];
+  std::string longName, paxPath;
+  uint64_t paxSize = 0;
+  bool havePaxSize = false;
+  bool sawHeader = false;
+
+  while (true) {
+    if (!stream.read(h, TAR_BLOCK)) return sawHeader;
+    if (std::all_of(h, h + TAR_BLOCK, [](unsigned char c) { return c == 0; }))
+      return sawHeader || out.entries.empty();
+    if (!tarChecksumOk(h)) return sawHeader;
+    sawHeader = true;
+
+    // Only peeking to see whether anything follows the last listed entry.
+    if (out.entries.size() >= maxEntries) {
+      out.more = true;
+      return true;
+    }
+
+    uint64_t size = tarNumber(h + 124, 12);
+    char type = static_cast<char>(h[156]);
+
+    if (type == 'L' || type == 'x') {
+      if (size > MAX_META_BYTES) {
+        if (!stream.skip(padded(size), cancelled)) return false;
+        continue;
+      }
+      std::string data(padded(size), '\0');
+      if (!stream.read(reinterpret_cast<unsigned char*>(&data[0]), data.size())) return false;
+      data.resize(size);
+      if (type == 'L')
+        longName = data.c_str();
+      else
+        parsePax(data, paxPath, paxSize, havePaxSize);
+      continue;
+    }
+    if (type == 'K' || type == 'g') {
+      if (!stream.skip(padded(size), cancelled)) return false;
+      continue;
+    }
+
+    ArchiveEntry entry;
+    if (!paxPath.empty()) {
+      entry.name = paxPath;
+    } else if (!longName.empty()) {
+      entry.name = longName;
+    } else {
+      entry.name = tarField(h, 100);
+      if (memcmp(h + 257, "ustar", 5) == 0) {
+        std::string prefix = tarField(h + 345, 155);
+        if (!prefix.empty()) entry.name = prefix + "/" + entry.name;
+      }
+    }
+    if (havePaxSize) size = paxSize;
+    entry.size = size;
+    entry.isDir = type == '5' || (!entry.name.empty() && entry.name.back() == '/');
+    out.entries.push_back(std::move(entry));
+    longName.clear();
+    paxPath.clear();
+    havePaxSize = false;
+
+    // Links, devices, FIFOs and directories carry no data whatever size says.
+    bool hasData = !(type == '1' || type == '2' || type == '3' || type == '4' || type == '5' ||
+                     type == '6');
+    bool lastWanted = out.entries.size() >= maxEntries;
+    if (lastWanted && !stream.seekable()) {
+      // Checking for a next header would mean inflating this member's data.
+      out.more = true;
+      return true;
+    }
+    // A truncated archive still lists what came before the damage.
+    if (hasData && size > 0 && !stream.skip(padded(size), cancelled)) return true;
+  }
+}
+
+} // namespace
+
+bool listArchive(const std::string& path, size_t maxEntries, ArchiveListing& out,
+                 const CancelFn& cancelled) {
+  out = ArchiveListing{};
+  Fd f(open(path.c_str(), O_RDONLY | O_CLOEXEC));
+  if (f.fd < 0) return false;
+  struct stat st;
+  if (fstat(f.fd, &st) != 0 || !S_ISREG(st.st_mode)) return false;
+  uint64_t fileSize = static_cast<uint64_t>(st.st_size);
+
+  unsigned char magic[263] = {};
+  size_t magicLen = static_cast<size_t>(std::min<uint64_t>(fileSize, sizeof(magic)));
+  if (!preadFull(f.fd, magic, magicLen, 0)) return false;
+
+  Codec codec = Codec::NONE;
+  if (magic[0] == 0x1F && magic[1] == 0x8B)
+    codec = Codec::GZIP;
+  else if (memcmp(magic, "BZh", 3) == 0)
+    codec = Codec::BZIP2;
+  else if (memcmp(magic, "\xFD" "7zXZ\0", 6) == 0)
+    codec = Codec::XZ;
+
+  // A tar can end with a zip member, so only look for a zip trailer when
+  // the first header doesn't say ustar.
+  bool ustar = memcmp(magic + 257, "ustar", 5) == 0;
+  if (codec == Codec::NONE && !ustar) {
+    // Zip first: it is identified by its trailer, which also covers
+    // self-extracting archives with an executable in front.
+    if (listZip(f.fd, fileSize, maxEntries, out)) return true;
+    out = ArchiveListing{};
+  }
+  return listTar(f.fd, codec, maxEntries, out, cancelled);
+}
@@ -0,0 +1,37 @@
+#ifndef ARCHIVE_LIST_H
+#define ARCHIVE_LIST_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct ArchiveEntry {
+  std::string name; // path inside the archive
+  uint64_t size = 0; // uncompressed
+  bool isDir = false;
+};
+
+struct ArchiveListing {
+  std::vector<ArchiveEntry> entries;
+  // Members in the whole archive, when the format records it (zip); else 0.
+  uint64_t total = 0;
+  // Listing stopped at maxEntries and more members may follow.
+  bool more = false;
+};
+
+// Lists the first maxEntries members of a zip, or of a tar that is plain or
+// gzip, bzip2 or xz compressed (each codec only when built with its library).
+// The format is detected from the file contents, not the extension.
+//
+// Zip reads only the central directory at the end of the file. Tar reads
+// member headers in order, seeking past data when uncompressed and
+// decompressing through a fixed-size buffer otherwise, and stops as soon as
+// maxEntries are listed. cancelled is polled while skipping member data.
+//
+// Returns false for other formats, damaged archives or when cancelled, so the
+// caller can fall back to an external tool.
+bool listArchive(const std::string& path, size_t maxEntries, ArchiveListing& out,
+                 const std::function<bool()>& cancelled);
+
+#endif // ARCHIVE_LIST_H
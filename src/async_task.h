@@ -26,7 +26,10 @@ struct AsyncTask {
   std::condition_variable pauseCv;
 
   // Throughput & timing metrics
-  uint64_t totalBytes = 0;
+  // totalBytes may still grow while totalBytesFinal is false (the paste task
+  // measures uncached trees alongside the copy).
+  std::atomic<uint64_t> totalBytes{0};
+  std::atomic<bool> totalBytesFinal{true};
   std::atomic<uint64_t> bytesProcessed{0};
   std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
 
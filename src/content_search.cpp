@@ -0,0 +1,763 @@
+#include "content_search.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <regex>
+#include <thread>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+using CancelFn = std::function<bool()>;
+
+constexpr size_t READ_CHUNK = 1024 * 1024;
+// Files with a NUL byte this early are treated as binary, like rg and grep.
+constexpr size_t BINARY_PROBE = 8192;
+// libstdc++'s regex executor recurses per character, so very long lines are
+// matched in windows of this size instead of whole.
+constexpr size_t MAX_REGEX_WINDOW = 8192;
+
+char asciiLower(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c; }
+
+// --- matcher ---------------------------------------------------------------
+
+// Longest run of characters that every match of pat must contain, or "" if
+// none can be proven (alternation, or only classes and groups). pure is set
+// when the pattern is nothing but that run.
+std::string requiredLiteral(const std::string& pat, bool& pure) {
+  pure = true;
+  std::string best, cur;
+  auto endRun = [&] {
+    if (cur.size() > best.size()) best = cur;
+    cur.clear();
+  };
+  // Skips from an opening bracket or paren at i to its closing partner.
+  auto skipClass = [&](size_t i) {
+    size_t j = i + 1;
+    if (j < pat.size() && pat[j] == '^') ++j;
+    if (j < pat.size() && pat[j] == ']') ++j;
+    for (; j < pat.size() && pat[j] != ']'; ++j)
+      if (pat[j] == '\\') ++j;
+    return j;
+  };
+  auto skipGroup = [&](size_t i) {
+    int depth = 0;
+    size_t j = i;
+    for (; j < pat.size(); ++j) {
+      if (pat[j] == '\\') {
+        ++j;
+      } else if (pat[j] == '[') {
+        j = skipClass(j);
+      } else if (pat[j] == '(') {
+        ++depth;
+      } else if (pat[j] == ')' && --depth == 0) {
+        break;
+      }
+    }
+    return j;
+  };
+
+  for (size_t i = 0; i < pat.size(); ++i) {
+    char c = pat[i];
+    switch (c) {
+    case '|':
+      pure = false;
+      return "";
+    case '*':
+    case '?':
+    case '{':
+      // The preceding atom may be absent.
+      pure = false;
+      if (!cur.empty()) cur.pop_back();
+      endRun();
+      if (c == '{')
+        while (i < pat.size() && pat[i] != '}') ++i;
+      break;
+    case '+':
+      pure = false;
+      endRun();
+      break;
+    case '(':
+      // Contents of a group may be quantified as a whole; don't trust them.
+      pure = false;
+      endRun();
+      i = skipGroup(i);
+      break;
+    case '[':
+      pure = false;
+      endRun();
+      i = skipClass(i);
+      break;
+    case '.':
+    case '^':
+    case '$':
+    case ')':
+      pure = false;
+      endRun();
+      break;
+    case '\\':
+      if (i + 1 >= pat.size()) break;
+      c = pat[++i];
+      if (isalnum(static_cast<unsigned char>(c))) {
+        // \d, \b, \n, \x41 ...: not a literal character.
+        pure = false;
+        endRun();
+        if (c == 'x') i += 2;
+        else if (c == 'u') i += 4;
+        else if (c == 'c') i += 1;
+      } else {
+        cur += c;
+      }
+      break;
+    default:
+      cur += c;
+    }
+  }
+  endRun();
+  return best;
+}
+
+// Splits pat at its top-level '|' (not inside groups, classes or escapes).
+std::vector<std::string> splitAlternation(const std::string& pat) {
+  std::vector<std::string> branches(1);
+  int depth = 0;
+  bool inClass = false;
+  for (size_t i = 0; i < pat.size(); ++i) {
+    char c = pat[i];
+    if (c == '\\' && i + 1 < pat.size()) {
+      branches.back() += c;
+      branches.back() += pat[++i];
+      continue;
+    }
+    if (inClass) {
+      if (c == ']') inClass = false;
+    } else if (c == '[') {
+      inClass = true;
+    } else if (c == '(') {
+      ++depth;
+    } else if (c == ')') {
+      --depth;
+    } else if (c == '|' && depth == 0) {
+      branches.emplace_back();
+      continue;
+    }
+    branches.back() += c;
+  }
+  return branches;
+}
+
+// Whether pat uses ^ or $ as anchors, which only mean line edges when the
+// regex is run on one line at a time.
+bool hasLineAnchors(const std::string& pat) {
+  bool inClass = false;
+  for (size_t i = 0; i < pat.size(); ++i) {
+    char c = pat[i];
+    if (c == '\\') {
+      ++i;
+    } else if (inClass) {
+      inClass = c != ']';
+    } else if (c == '[') {
+      inClass = true;
+    } else if (c == '^' || c == '$') {
+      return true;
+    }
+  }
+  return false;
+}
+
+class Matcher {
+public:
+  bool compile(const std::string& pattern, std::string& error) {
+    icase = std::none_of(pattern.begin(), pattern.end(),
+                         [](char c) { return c >= 'A' && c <= 'Z'; });
+    lineAnchors = hasLineAnchors(pattern);
+    // Every branch of an alternation needs a literal of its own, or no line
+    // can be ruled out without the regex.
+    pure = true;
+    for (const std::string& branch : splitAlternation(pattern)) {
+      bool branchPure = false;
+      std::string lit = requiredLiteral(branch, branchPure);
+      if (lit.empty()) {
+        literals.clear();
+        pure = false;
+        break;
+      }
+      if (icase) std::transform(lit.begin(), lit.end(), lit.begin(), asciiLower);
+      literals.push_back(std::move(lit));
+      pure = pure && branchPure;
+    }
+    if (pure) return true;
+    try {
+      auto flags = std::regex::ECMAScript | std::regex::optimize;
+      if (icase) flags |= std::regex::icase;
+      re = std::regex(pattern, flags);
+    } catch (const std::regex_error& e) {
+      error = e.what();
+      return false;
+    }
+    return true;
+  }
+
+  // Whether any complete line of data[0, len) matches.
+  bool matches(const char* data, size_t len) const {
+    const char* end = data + len;
+    if (literals.empty()) return scanRegex(data, end);
+
+    // Next occurrence of each literal at or after from; null once exhausted.
+    std::vector<const char*> next(literals.size());
+    for (size_t i = 0; i < literals.size(); ++i)
+      next[i] = find(literals[i], data, end);
+    for (const char* from = data; from < end;) {
+      const char* hit = nullptr;
+      size_t hitLen = 0;
+      for (size_t i = 0; i < literals.size(); ++i) {
+        if (next[i] && next[i] < from) next[i] = find(literals[i], from, end);
+        if (next[i] && (!hit || next[i] < hit)) {
+          hit = next[i];
+          hitLen = literals[i].size();
+        }
+      }
+      if (!hit) return false;
+      if (pure) return true;
+      const char* lineStart = hit;
+      while (lineStart > data && lineStart[-1] != '\n') --lineStart;
+      const char* nl = static_cast<const char*>(memchr(hit, '\n', end - hit));
+      const char* lineEnd = nl ? nl : end;
+      if (lineMatches(lineStart, lineEnd, hit, hit + hitLen)) return true;
+      from = lineEnd + 1;
+    }
+    return false;
+  }
+
+private:
+  // No literal to look for: run the regex over runs of whole lines at once,
+  // which costs far less than one regex_search per line.
+  bool scanRegex(const char* data, const char* end) const {
+    if (lineAnchors) {
+      for (const char* line = data; line < end;) {
+        const char* nl = static_cast<const char*>(memchr(line, '\n', end - line));
+        const char* lineEnd = nl ? nl : end;
+        if (lineMatches(line, lineEnd, line, lineEnd)) return true;
+        line = lineEnd + 1;
+      }
+      return false;
+    }
+    for (const char* ws = data; ws < end;) {
+      const char* we = end;
+      if (static_cast<size_t>(end - ws) > MAX_REGEX_WINDOW) {
+        we = ws + MAX_REGEX_WINDOW;
+        while (we > ws && we[-1] != '\n') --we;
+        if (we == ws) {
+          const char* nl = static_cast<const char*>(memchr(ws, '\n', end - ws));
+          const char* lineEnd = nl ? nl : end;
+          if (lineMatches(ws, lineEnd, ws, lineEnd)) return true;
+          ws = lineEnd + 1;
+          continue;
+        }
+      }
+      for (const char* from = ws; from < we;) {
+        std::cmatch m;
+        if (!std::regex_search(from, we, m, re)) break;
+        const char* ms = m[0].first;
+        const char* me = m[0].second;
+        if (!memchr(ms, '\n', me - ms)) return true;
+        // The match ran into the next line (\s, [^x] ...); the line it
+        // started on may still match on its own. Nothing earlier can.
+        const char* ls = ms;
+        while (ls > ws && ls[-1] != '\n') --ls;
+        const char* le = static_cast<const char*>(memchr(ms, '\n', we - ms));
+        if (lineMatches(ls, le, ls, le)) return true;
+        from = le + 1;
+      }
+      ws = we;
+    }
+    return false;
+  }
+
+  const char* find(const std::string& literal, const char* p, const char* end) const {
+    size_t n = literal.size();
+    if (static_cast<size_t>(end - p) < n) return nullptr;
+    if (!icase) return static_cast<const char*>(memmem(p, end - p, literal.data(), n));
+
+    // Candidates are positions holding the first byte in either case.
+    const char* last = end - n;
+    char lo = literal[0];
+    char up = (lo >= 'a' && lo <= 'z') ? static_cast<char>(lo - 32) : lo;
+    const char* s = p;
+#ifdef __SSE2__
+    __m128i vlo = _mm_set1_epi8(lo), vup = _mm_set1_epi8(up);
+    for (; s + 16 <= last + 1; s += 16) {
+      __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s));
+      unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(
+          _mm_or_si128(_mm_cmpeq_epi8(chunk, vlo), _mm_cmpeq_epi8(chunk, vup))));
+      for (; mask; mask &= mask - 1) {
+        const char* cand = s + __builtin_ctz(mask);
+        if (equalsCaseless(literal, cand)) return cand;
+      }
+    }
+#endif
+    for (; s <= last; ++s)
+      if ((*s == lo || *s == up) && equalsCaseless(literal, s)) return s;
+    return nullptr;
+  }
+
+  static bool equalsCaseless(const std::string& literal, const char* s) {
+    for (size_t i = 1; i < literal.size(); ++i)
+      if (asciiLower(s[i]) != literal[i]) return false;
+    return true;
+  }
+
+  // Runs the regex over the line [ls, le), or over a window of it around
+  // [hs, he) when the line is very long.
+  bool lineMatches(const char* ls, const char* le, const char* hs, const char* he) const {
+    if (static_cast<size_t>(le - ls) <= MAX_REGEX_WINDOW)
+      return std::regex_search(ls, le, re);
+    if (literals.empty()) {
+      for (const char* w = ls; w < le; w += MAX_REGEX_WINDOW) {
+        const char* we = std::min(le, w + MAX_REGEX_WINDOW);
+        if (windowMatches(ls, le, w, we)) return true;
+      }
+      return false;
+    }
+    size_t margin = MAX_REGEX_WINDOW / 2;
+    const char* w = (static_cast<size_t>(hs - ls) > margin) ? hs - margin : ls;
+    const char* we = (static_cast<size_t>(le - he) > margin) ? he + margin : le;
+    return windowMatches(ls, le, w, we);
+  }
+
+  bool windowMatches(const char* ls, const char* le, const char* w, const char* we) const {
+    auto flags = std::regex_constants::match_default;
+    // Anchors and \b must not fire at a window edge that isn't a line edge.
+    if (w > ls) flags |= std::regex_constants::match_prev_avail;
+    if (we < le) flags |= std::regex_constants::match_not_eol;
+    return std::regex_search(w, we, re, flags);
+  }
+
+  bool icase = false;
+  bool pure = false;
+  bool lineAnchors = false;
+  std::vector<std::string> literals;
+  std::regex re;
+};
+
+// --- ignore files ----------------------------------------------------------
+
+// Shell glob where '*' and '?' stop at '/', "**" crosses directories and
+// "[...]" is a bracket expression.
+bool globMatch(const char* p, const char* s) {
+  while (*p) {
+    if (p[0] == '*' && p[1] == '*') {
+      p += 2;
+      if (*p == '/') {
+        ++p;
+        for (const char* t = s;;) {
+          if (globMatch(p, t)) return true;
+          t = strchr(t, '/');
+          if (!t) return false;
+          ++t;
+        }
+      }
+      for (const char* t = s;; ++t) {
+        if (globMatch(p, t)) return true;
+        if (!*t) return false;
+      }
+    }
+    if (*p == '*') {
+      ++p;
+      for (const char* t = s;; ++t) {
+        if (globMatch(p, t)) return true;
+        if (!*t || *t == '/') return false;
+      }
+    }
+    if (!*s) return false;
+    if (*p == '?') {
+      if (*s == '/') return false;
+      ++p;
+      ++s;
+      continue;
+    }
+    if (*p == '[') {
+      const char* q = p + 1;
+      bool negate = (*q == '!' || *q == '^');
+      if (negate) ++q;
+      bool hit = false;
+      const char* start = q;
+      while (*q && (*q != ']' || q == start)) {
+        char lo = *q, hi = *q;
+        if (q[1] == '-' && q[2] && q[2] != ']') {
+          hi = q[2];
+          q += 2;
+        }
+        if (*s >= lo && *s <= hi) hit = true;
+        ++q;
+      }
+      if (*q == ']') {
+        if (hit == negate || *s == '/') return false;
+        p = q + 1;
+        ++s;
+        continue;
+      }
+      // No closing bracket: a literal '['.
+    }
+    if (*p == '\\' && p[1]) ++p;
+    if (*p != *s) return false;
+    ++p;
+    ++s;
+  }
+  return !*s;
+}
+
+struct IgnoreRule {
+  std::string glob;
+  bool negate = false;
+  bool dirOnly = false;
+  // Contains a slash, so it is matched against the path from the ignore
+  // file's directory instead of just the name.
+  bool anchored = false;
+};
+
+// Rules from the ignore files of one directory, chained to its ancestors'.
+struct IgnoreNode {
+  std::shared_ptr<const IgnoreNode> parent;
+  std::string base; // directory, with trailing '/'
+  std::vector<IgnoreRule> rules;
+};
+using IgnorePtr = std::shared_ptr<const IgnoreNode>;
+
+void parseIgnoreFile(int dirfd, const char* name, std::vector<IgnoreRule>& rules) {
+  int fd = openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return;
+  std::string text;
+  char buf[4096];
+  ssize_t n;
+  while ((n = read(fd, buf, sizeof(buf))) > 0) text.append(buf, static_cast<size_t>(n));
+  close(fd);
+
+  size_t pos = 0;
+  while (pos < text.size()) {
+    size_t nl = text.find('\n', pos);
+    if (nl == std::string::npos) nl = text.size();
+    std::string line = text.substr(pos, nl - pos);
+    pos = nl + 1;
+    if (!line.empty() && line.back() == '\r') line.pop_back();
+    while (!line.empty() && line.back() == ' ' && !(line.size() > 1 && line[line.size() - 2] == '\\'))
+      line.pop_back();
+    if (line.empty() || line[0] == '#') continue;
+
+    IgnoreRule rule;
+    if (line[0] == '!') {
+      rule.negate = true;
+      line.erase(0, 1);
+    } else if (line[0] == '\\' && line.size() > 1 && (line[1] == '#' || line[1] == '!')) {
+      line.erase(0, 1);
+    }
+    if (!line.empty() && line.back() == '/') {
+      rule.dirOnly = true;
+      line.pop_back();
+    }
+    if (line.empty()) continue;
+    rule.anchored = line.find('/') != std::string::npos;
+    if (line[0] == '/') line.erase(0, 1);
+    rule.glob = std::move(line);
+    rules.push_back(std::move(rule));
+  }
+}
+
+// Later rules and deeper files win, so walk both backwards.
+bool isIgnored(const IgnoreNode* node, const std::string& path, const char* name, bool isDir) {
+  for (; node; node = node->parent.get()) {
+    if (node->rules.empty() || path.compare(0, node->base.size(), node->base) != 0) continue;
+    const char* rel = path.c_str() + node->base.size();
+    for (auto it = node->rules.rbegin(); it != node->rules.rend(); ++it) {
+      if (it->dirOnly && !isDir) continue;
+      if (globMatch(it->glob.c_str(), it->anchored ? rel : name)) return !it->negate;
+    }
+  }
+  return false;
+}
+
+IgnorePtr loadIgnores(int dirfd, const std::string& base, bool inRepo, IgnorePtr parent) {
+  std::vector<IgnoreRule> rules;
+  if (inRepo) parseIgnoreFile(dirfd, ".gitignore", rules);
+  parseIgnoreFile(dirfd, ".ignore", rules);
+  parseIgnoreFile(dirfd, ".rgignore", rules);
+  if (rules.empty()) return parent;
+  auto node = std::make_shared<IgnoreNode>();
+  node->parent = std::move(parent);
+  node->base = base;
+  node->rules = std::move(rules);
+  return node;
+}
+
+bool hasGitDir(const std::string& dir) {
+  struct stat st;
+  return stat((dir + "/.git").c_str(), &st) == 0;
+}
+
+// Ignore rules that apply to root from the enclosing repository: its
+// .git/info/exclude and the .gitignore files above root, outermost first
+// (root's own are read by the walk). Sets inRepo when root is inside one.
+IgnorePtr ancestorIgnores(const std::string& root, bool& inRepo) {
+  std::vector<std::string> chain;
+  std::string top = root;
+  inRepo = hasGitDir(top);
+  while (!inRepo && top != "/") {
+    size_t slash = top.rfind('/');
+    if (slash == std::string::npos) break;
+    top = slash == 0 ? "/" : top.substr(0, slash);
+    chain.push_back(top);
+    inRepo = hasGitDir(top);
+  }
+  if (!inRepo) return nullptr;
+
+  IgnorePtr node;
+  std::string topBase = top == "/" ? "/" : top + "/";
+  int gitfd = open((top + "/.git/info").c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (gitfd >= 0) {
+    std::vector<IgnoreRule> rules;
+    parseIgnoreFile(gitfd, "exclude", rules);
+    close(gitfd);
+    if (!rules.empty()) {
+      auto n = std::make_shared<IgnoreNode>();
+      n->base = topBase;
+      n->rules = std::move(rules);
+      node = n;
+    }
+  }
+  for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+    int fd = open(it->c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) continue;
+    node = loadIgnores(fd, *it == "/" ? "/" : *it + "/", true, node);
+    close(fd);
+  }
+  return node;
+}
+
+// --- walker ----------------------------------------------------------------
+
+struct DirItem {
+  std::string path; // no trailing slash
+  IgnorePtr ignore;
+  bool inRepo;
+};
+
+class Walker {
+public:
+  Walker(const Matcher& matcher, unsigned n, const SearchHitFn& onHit, const CancelFn& cancelled)
+      : matcher(matcher), onHit(onHit), cancelled(cancelled) {
+    for (unsigned i = 0; i < n; ++i)
+      workers.push_back(std::make_unique<Worker>());
+  }
+
+  void run(DirItem root) {
+    push(0, std::move(root));
+    for (size_t i = 0; i < workers.size(); ++i)
+      workers[i]->t = std::thread(&Walker::workerLoop, this, i);
+    for (auto& w : workers)
+      w->t.join();
+  }
+
+private:
+  struct Worker {
+    std::mutex m;
+    std::deque<DirItem> q;
+    std::thread t;
+    std::vector<char> buf;
+  };
+
+  void push(size_t self, DirItem item) {
+    {
+      std::lock_guard<std::mutex> lock(workers[self]->m);
+      workers[self]->q.push_back(std::move(item));
+    }
+    {
+      std::lock_guard<std::mutex> lock(idleMutex);
+      queued++;
+      outstanding++;
+    }
+    idleCv.notify_one();
+  }
+
+  // Own newest directory first (depth first keeps the deques short), then
+  // the oldest, largest-subtree directory of another worker.
+  bool nextItem(size_t self, DirItem& out) {
+    {
+      Worker& w = *workers[self];
+      std::lock_guard<std::mutex> lock(w.m);
+      if (!w.q.empty()) {
+        out = std::move(w.q.back());
+        w.q.pop_back();
+        queued--;
+        return true;
+      }
+    }
+    for (size_t k = 1; k < workers.size(); ++k) {
+      Worker& victim = *workers[(self + k) % workers.size()];
+      std::lock_guard<std::mutex> lock(victim.m);
+      if (!victim.q.empty()) {
+        out = std::move(victim.q.front());
+        victim.q.pop_front();
+        queued--;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void workerLoop(size_t self) {
+    while (true) {
+      DirItem item;
+      if (!nextItem(self, item)) {
+        std::unique_lock<std::mutex> lock(idleMutex);
+        // outstanding counts queued and in-progress directories, so zero
+        // means nobody can produce more work.
+        idleCv.wait(lock, [this] { return queued > 0 || outstanding == 0; });
+        if (outstanding == 0) return;
+        continue;
+      }
+      if (!stop && cancelled && cancelled()) stop = true;
+      if (!stop) processDir(self, item);
+      std::lock_guard<std::mutex> lock(idleMutex);
+      if (--outstanding == 0) idleCv.notify_all();
+    }
+  }
+
+  void processDir(size_t self, const DirItem& item) {
+    int dirfd = open(item.path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0) return;
+    DIR* dp = fdopendir(dirfd);
+    if (!dp) {
+      close(dirfd);
+      return;
+    }
+    struct Entry {
+      std::string name;
+      unsigned char type;
+    };
+    std::vector<Entry> entries;
+    bool repoHere = false;
+    while (struct dirent* e = readdir(dp)) {
+      const char* n = e->d_name;
+      if (n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0'))) continue;
+      if (strcmp(n, ".git") == 0) {
+        repoHere = true;
+        continue;
+      }
+      entries.push_back({n, e->d_type});
+    }
+
+    bool inRepo = item.inRepo || repoHere;
+    std::string base = item.path == "/" ? "/" : item.path + "/";
+    IgnorePtr ignore = loadIgnores(dirfd, base, inRepo, item.ignore);
+
+    for (const Entry& e : entries) {
+      if (stop) break;
+      unsigned char type = e.type;
+      if (type == DT_UNKNOWN) {
+        struct stat st;
+        if (fstatat(dirfd, e.name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0) continue;
+        type = S_ISDIR(st.st_mode) ? DT_DIR : S_ISREG(st.st_mode) ? DT_REG : DT_LNK;
+      }
+      if (type != DT_DIR && type != DT_REG) continue;
+      std::string path = base + e.name;
+      if (ignore && isIgnored(ignore.get(), path, e.name.c_str(), type == DT_DIR)) continue;
+      if (type == DT_DIR) {
+        push(self, {std::move(path), ignore, inRepo});
+      } else {
+        searchFile(*workers[self], dirfd, item.path, e.name);
+        if (cancelled && cancelled()) stop = true;
+      }
+    }
+    closedir(dp);
+  }
+
+  void searchFile(Worker& w, int dirfd, const std::string& dir, const std::string& name) {
+    int fd = openat(dirfd, name.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) return;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+      close(fd);
+      return;
+    }
+    uintmax_t fileSize = static_cast<uintmax_t>(st.st_size);
+    if (w.buf.size() < READ_CHUNK) w.buf.resize(READ_CHUNK);
+
+    // Scan whole lines; a partial last line is carried into the next read.
+    bool matched = false, first = true;
+    size_t carry = 0;
+    while (!matched) {
+      if (carry == w.buf.size()) w.buf.resize(w.buf.size() * 2);
+      ssize_t n = read(fd, w.buf.data() + carry, w.buf.size() - carry);
+      if (n < 0 && errno == EINTR) continue;
+      bool eof = n <= 0;
+      size_t len = carry + (eof ? 0 : static_cast<size_t>(n));
+      if (first) {
+        first = false;
+        if (memchr(w.buf.data(), '\0', std::min(len, BINARY_PROBE))) break;
+      }
+      size_t scan = len;
+      if (!eof) {
+        while (scan > 0 && w.buf[scan - 1] != '\n') --scan;
+      }
+      if (scan > 0 && matcher.matches(w.buf.data(), scan)) matched = true;
+      if (eof) break;
+      carry = len - scan;
+      if (carry > 0 && scan > 0) memmove(w.buf.data(), w.buf.data() + scan, carry);
+      if (cancelled && cancelled()) {
+        stop = true;
+        break;
+      }
+    }
+    close(fd);
+    if (!matched) return;
+#ifdef __linux__
+    int64_t mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+    int64_t mtime = static_cast<int64_t>(st.st_mtime) * 1000000000LL;
+#endif
+    onHit(dir, name, fileSize, mtime);
+  }
+
+  const Matcher& matcher;
+  const SearchHitFn& onHit;
+  const CancelFn& cancelled;
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::mutex idleMutex;
+  std::condition_variable idleCv;
+  std::atomic<size_t> queued{0};
+  size_t outstanding = 0;
+  std::atomic<bool> stop{false};
+};
+
+} // namespace
+
+bool searchContents(const std::string& rootPath, const std::string& pattern, unsigned workers,
+                    const SearchHitFn& onHit, const CancelFn& cancelled, std::string& error) {
+  TRACE_SCOPE("search.content");
+  Matcher matcher;
+  if (!matcher.compile(pattern, error)) return false;
+
+  std::string root = rootPath;
+  while (root.size() > 1 && root.back() == '/') root.pop_back();
+  bool inRepo = false;
+  DirItem start{root, ancestorIgnores(root, inRepo), false};
+  start.inRepo = inRepo;
+
+  if (workers == 0) workers = std::max(1u, std::thread::hardware_concurrency());
+  Walker walker(matcher, workers, onHit, cancelled);
+  walker.run(std::move(start));
+  return true;
+}
@@ -0,0 +1,33 @@
+#ifndef CONTENT_SEARCH_H
+#define CONTENT_SEARCH_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// In-process equivalent of `rg --files-with-matches --smart-case --hidden
+// --glob '!.git'`. The pattern is an ECMAScript regex matched line by line,
+// case-insensitively unless it contains an uppercase letter.
+//
+// Directories are walked by a pool of work-stealing threads. .gitignore is
+// honoured inside git repositories (including the ones above root, up to the
+// repository top, and .git/info/exclude), .ignore and .rgignore everywhere.
+// Symlinks, special files and files with a NUL byte in their first block are
+// skipped. Files are read in large chunks and only lines containing the
+// pattern's longest required literal (found with memmem, or an SSE2 scan when
+// caseless) are handed to the regex engine.
+
+// Called for every file with at least one matching line, possibly from
+// several threads at once. size and mtime (ns since the epoch) come from the
+// fstat the scan already made.
+using SearchHitFn = std::function<void(const std::string& dir, const std::string& name,
+                                       uintmax_t size, int64_t mtime)>;
+
+// Blocks until root has been searched or cancelled() returns true (polled
+// between files and chunks). workers == 0 means one per core. Returns false
+// with a message in error if pattern does not compile.
+bool searchContents(const std::string& root, const std::string& pattern, unsigned workers,
+                    const SearchHitFn& onHit, const std::function<bool()>& cancelled,
+                    std::string& error);
+
+#endif // CONTENT_SEARCH_H
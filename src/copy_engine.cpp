@@ -0,0 +1,217 @@
+#include "copy_engine.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <fcntl.h>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+// Large enough to keep the kernel busy, small enough that pause and cancel
+// still react within a fraction of a second on slow disks.
+constexpr size_t KERNEL_CHUNK = 16 * 1024 * 1024;
+constexpr size_t BUFFER_SIZE = 1024 * 1024;
+
+enum class Result { DONE, UNSUPPORTED, FAILED, STOPPED };
+
+// errno values meaning "this backend can't do it here", not a real I/O error.
+bool isUnsupported(int err) {
+  return err == ENOSYS || err == EXDEV || err == EINVAL || err == EOPNOTSUPP ||
+         err == ENOTSUP || err == EBADF || err == ETXTBSY || err == EPERM;
+}
+
+#ifdef __linux__
+Result tryClone(int inFd, int outFd, uint64_t offset, const CopyProgressFn& onProgress) {
+#ifdef FICLONE
+  struct stat in, out;
+  if (offset != 0 || fstat(inFd, &in) != 0 || fstat(outFd, &out) != 0 || out.st_size != 0)
+    return Result::UNSUPPORTED;
+  if (ioctl(outFd, FICLONE, inFd) != 0) return Result::UNSUPPORTED;
+  if (in.st_size > 0 && !onProgress(static_cast<uint64_t>(in.st_size))) return Result::STOPPED;
+  return Result::DONE;
+#else
+  (void)inFd;
+  (void)outFd;
+  (void)offset;
+  (void)onProgress;
+  return Result::UNSUPPORTED;
+#endif
+}
+
+Result tryCopyFileRange(int inFd, int outFd, uint64_t& offset, const CopyProgressFn& onProgress) {
+  bool first = true;
+  while (true) {
+    off64_t inOff = static_cast<off64_t>(offset);
+    off64_t outOff = static_cast<off64_t>(offset);
+    ssize_t n = copy_file_range(inFd, &inOff, outFd, &outOff, KERNEL_CHUNK, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      // Some filesystems only refuse on the first call; after data has moved,
+      // an error is an error.
+      return (first && isUnsupported(errno)) ? Result::UNSUPPORTED : Result::FAILED;
+    }
+    if (n == 0) {
+      // Pseudo files report EOF here even when they have data to read.
+      return (first && offset == 0) ? Result::UNSUPPORTED : Result::DONE;
+    }
+    first = false;
+    offset += static_cast<uint64_t>(n);
+    if (!onProgress(static_cast<uint64_t>(n))) return Result::STOPPED;
+  }
+}
+
+Result trySendfile(int inFd, int outFd, uint64_t& offset, const CopyProgressFn& onProgress) {
+  if (lseek(outFd, static_cast<off_t>(offset), SEEK_SET) < 0) return Result::UNSUPPORTED;
+  bool first = true;
+  while (true) {
+    off_t inOff = static_cast<off_t>(offset);
+    ssize_t n = sendfile(outFd, inFd, &inOff, KERNEL_CHUNK);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return (first && isUnsupported(errno)) ? Result::UNSUPPORTED : Result::FAILED;
+    }
+    if (n == 0) return (first && offset == 0) ? Result::UNSUPPORTED : Result::DONE;
+    first = false;
+    offset += static_cast<uint64_t>(n);
+    if (!onProgress(static_cast<uint64_t>(n))) return Result::STOPPED;
+  }
+}
+#endif
+
+Result copyBuffered(int inFd, int outFd, uint64_t& offset, const CopyProgressFn& onProgress) {
+  std::vector<char> buf(BUFFER_SIZE);
+  while (true) {
+    ssize_t n = pread(inFd, buf.data(), buf.size(), static_cast<off_t>(offset));
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return Result::FAILED;
+    }
+    if (n == 0) return Result::DONE;
+    ssize_t written = 0;
+    while (written < n) {
+      ssize_t w = pwrite(outFd, buf.data() + written, static_cast<size_t>(n - written),
+                         static_cast<off_t>(offset + written));
+      if (w < 0) {
+        if (errno == EINTR) continue;
+        return Result::FAILED;
+      }
+      written += w;
+    }
+    offset += static_cast<uint64_t>(n);
+    if (!onProgress(static_cast<uint64_t>(n))) return Result::STOPPED;
+  }
+}
+
+#ifdef __linux__
+// /sys/dev/block/M:m is the disk itself or one of its partitions, whose queue
+// settings live on the parent disk.
+bool isRotational(dev_t dev) {
+  if (major(dev) == 0) return false; // tmpfs, overlayfs, FUSE, ...
+  char path[96];
+  const char* layouts[] = {"/sys/dev/block/%u:%u/queue/rotational",
+                           "/sys/dev/block/%u:%u/../queue/rotational"};
+  for (const char* layout : layouts) {
+    snprintf(path, sizeof(path), layout, major(dev), minor(dev));
+    if (FILE* f = fopen(path, "r")) {
+      int c = fgetc(f);
+      fclose(f);
+      return c == '1';
+    }
+  }
+  return false;
+}
+#endif
+
+std::mutex slotMutex;
+std::condition_variable slotCv;
+std::unordered_map<dev_t, unsigned> slotsInUse;
+std::unordered_map<dev_t, unsigned> slotLimits;
+
+bool slotFree(dev_t dev) {
+  auto lim = slotLimits.find(dev);
+  if (lim == slotLimits.end()) lim = slotLimits.emplace(dev, deviceCopyConcurrency(dev)).first;
+  auto it = slotsInUse.find(dev);
+  return it == slotsInUse.end() || it->second < lim->second;
+}
+
+} // namespace
+
+unsigned deviceCopyConcurrency(dev_t dev) {
+#ifdef __linux__
+  if (isRotational(dev)) return 2;
+#else
+  (void)dev;
+#endif
+  return std::clamp(std::thread::hardware_concurrency(), 4u, 16u);
+}
+
+RenameResult renameNoReplace(const char* src, const char* dest) {
+  struct stat srcSt, parentSt;
+  std::string parent(dest);
+  size_t slash = parent.rfind('/');
+  parent = (slash == std::string::npos) ? "." : (slash == 0 ? "/" : parent.substr(0, slash));
+  if (lstat(src, &srcSt) != 0 || stat(parent.c_str(), &parentSt) != 0) return RenameResult::FAILED;
+  if (srcSt.st_dev != parentSt.st_dev) return RenameResult::CROSS_DEVICE;
+#ifdef __linux__
+  if (renameat2(AT_FDCWD, src, AT_FDCWD, dest, RENAME_NOREPLACE) == 0) return RenameResult::MOVED;
+  if (errno == EXDEV) return RenameResult::CROSS_DEVICE;
+  if (errno == EEXIST) return RenameResult::EXISTS;
+  if (errno != ENOSYS && errno != EINVAL) return RenameResult::FAILED;
+  // Filesystem without RENAME_NOREPLACE support: check, then plain rename.
+#endif
+  struct stat st;
+  if (lstat(dest, &st) == 0) return RenameResult::EXISTS;
+  if (rename(src, dest) == 0) return RenameResult::MOVED;
+  return errno == EXDEV ? RenameResult::CROSS_DEVICE : RenameResult::FAILED;
+}
+
+DeviceCopySlot::DeviceCopySlot(dev_t s, dev_t d) : src(s), dest(d) {
+  std::unique_lock<std::mutex> lock(slotMutex);
+  slotCv.wait(lock, [this] { return slotFree(src) && (dest == src || slotFree(dest)); });
+  slotsInUse[src]++;
+  if (dest != src) slotsInUse[dest]++;
+}
+
+DeviceCopySlot::~DeviceCopySlot() {
+  {
+    std::lock_guard<std::mutex> lock(slotMutex);
+    if (--slotsInUse[src] == 0) slotsInUse.erase(src);
+    if (dest != src && --slotsInUse[dest] == 0) slotsInUse.erase(dest);
+  }
+  slotCv.notify_all();
+}
+
+bool copyFileData(int inFd, int outFd, uint64_t offset, const CopyProgressFn& onProgress,
+                  CopyMethod* used) {
+  Result r = Result::UNSUPPORTED;
+#ifdef __linux__
+  r = tryClone(inFd, outFd, offset, onProgress);
+  if (r != Result::UNSUPPORTED) {
+    if (used) *used = CopyMethod::CLONE;
+    return r == Result::DONE;
+  }
+  r = tryCopyFileRange(inFd, outFd, offset, onProgress);
+  if (r != Result::UNSUPPORTED) {
+    if (used) *used = CopyMethod::COPY_FILE_RANGE;
+    return r == Result::DONE;
+  }
+  r = trySendfile(inFd, outFd, offset, onProgress);
+  if (r != Result::UNSUPPORTED) {
+    if (used) *used = CopyMethod::SENDFILE;
+    return r == Result::DONE;
+  }
+#endif
+  if (used) *used = CopyMethod::BUFFERED;
+  r = copyBuffered(inFd, outFd, offset, onProgress);
+  return r == Result::DONE;
+}
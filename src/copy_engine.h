@@ -0,0 +1,53 @@
+#ifndef COPY_ENGINE_H
+#define COPY_ENGINE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <sys/types.h>
+
+enum class CopyMethod { CLONE, COPY_FILE_RANGE, SENDFILE, BUFFERED };
+
+// Called after every chunk with the number of bytes just written. Returning
+// false stops the copy (pause waits happen inside the callback).
+using CopyProgressFn = std::function<bool(uint64_t bytes)>;
+
+// Copies inFd to outFd from offset to the end of the input, writing at the
+// same offset in outFd. Tries, in order: a reflink clone (FICLONE, only for
+// whole-file copies into an empty destination), copy_file_range() in large
+// chunks, sendfile(), and a buffered read/write loop. A backend that refuses
+// the pair of files before moving any data hands over to the next one.
+// Returns false on I/O error or when onProgress asked to stop.
+bool copyFileData(int inFd, int outFd, uint64_t offset, const CopyProgressFn& onProgress,
+                  CopyMethod* used = nullptr);
+
+enum class RenameResult { MOVED, CROSS_DEVICE, EXISTS, FAILED };
+
+// Moves src to dest with one rename when both are on the same filesystem,
+// never replacing an existing dest (renameat2 RENAME_NOREPLACE). CROSS_DEVICE
+// and EXISTS tell the caller to fall back to copy + delete.
+RenameResult renameNoReplace(const char* src, const char* dest);
+
+// How many files may be copied at once on dev: two for rotational disks (more
+// streams only add seeks), more for SSD, NVMe and RAM-backed filesystems.
+unsigned deviceCopyConcurrency(dev_t dev);
+
+// Process-wide copy slots per device, so paste tasks running side by side on
+// the same hard disk take turns instead of thrashing it. A slot covers both
+// the source and destination device.
+class DeviceCopySlot {
+public:
+  DeviceCopySlot(dev_t src, dev_t dest);
+  ~DeviceCopySlot();
+
+  DeviceCopySlot(const DeviceCopySlot&) = delete;
+  DeviceCopySlot& operator=(const DeviceCopySlot&) = delete;
+
+private:
+  dev_t src;
+  dev_t dest;
+};
+
+#endif // COPY_ENGINE_H
@@ -0,0 +1,247 @@
+#include "dir_loader.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <system_error>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+#endif
+
+constexpr size_t DIRENT_BUF_SIZE = 128 * 1024;
+
+int64_t toNanos(int64_t sec, uint32_t nsec) {
+  return sec * 1000000000LL + static_cast<int64_t>(nsec);
+}
+
+bool statAt(int dirfd, const char* name, bool follow, bool& isDir, bool& isLink,
+            uintmax_t& size, int64_t& mtime) {
+#ifdef __linux__
+  struct statx stx;
+  int flags = AT_STATX_DONT_SYNC | (follow ? 0 : AT_SYMLINK_NOFOLLOW);
+  if (statx(dirfd, name, flags, STATX_TYPE | STATX_SIZE | STATX_MTIME, &stx) != 0)
+    return false;
+  isDir = S_ISDIR(stx.stx_mode);
+  isLink = S_ISLNK(stx.stx_mode);
+  size = stx.stx_size;
+  mtime = toNanos(stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec);
+#else
+  struct stat st;
+  if (fstatat(dirfd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+    return false;
+  isDir = S_ISDIR(st.st_mode);
+  isLink = S_ISLNK(st.st_mode);
+  size = st.st_size;
+  mtime = toNanos(st.st_mtime, 0);
+#endif
+  return true;
+}
+
+bool isDotOrDotDot(const char* n) {
+  return n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0'));
+}
+
+} // namespace
+
+bool statEntry(const char* path, bool follow, bool& isDir, uintmax_t& size, int64_t& mtime) {
+  bool isLink = false;
+  return statAt(AT_FDCWD, path, follow, isDir, isLink, size, mtime);
+}
+
+uint8_t classifyEntry(int dirfd, const char* name, unsigned char dtype, bool eagerStat,
+                      bool isGvfs, uintmax_t& size, int64_t& mtime) {
+  uint8_t flags = 0;
+  bool isLink = (dtype == DT_LNK);
+  bool isDir = (dtype == DT_DIR);
+  bool d = false, l = false;
+  uintmax_t sz = 0;
+  int64_t mt = FileListing::MTIME_UNKNOWN;
+  size = 0;
+  mtime = FileListing::MTIME_UNKNOWN;
+
+  if (dtype == DT_UNKNOWN) {
+    if (statAt(dirfd, name, false, d, l, sz, mt)) {
+      isLink = l;
+      isDir = d;
+      if (!isLink) {
+        size = sz;
+        mtime = mt;
+      }
+    }
+  } else if (!isLink && !isGvfs) {
+    if (eagerStat) {
+      if (statAt(dirfd, name, false, d, l, sz, mt)) {
+        size = sz;
+        mtime = mt;
+      }
+    } else {
+      flags |= FileListing::STAT_PENDING;
+    }
+  } else if (!isLink && isGvfs && !isDir) {
+    if (statAt(dirfd, name, false, d, l, sz, mt)) size = sz;
+  }
+
+  // Symlinks are classified by their target so they sort with dirs/files.
+  if (isLink) {
+    flags |= FileListing::IS_SYMLINK;
+    if (statAt(dirfd, name, true, d, l, sz, mt)) {
+      flags |= FileListing::TARGET_EXISTS;
+      if (d) flags |= FileListing::SYMLINK_DIR;
+      isDir = d;
+      size = sz;
+      mtime = mt;
+    } else {
+      isDir = false;
+      size = 0;
+    }
+  }
+
+  if (isDir) {
+    flags |= FileListing::IS_DIR;
+    size = isGvfs ? 0 : SIZE_CALCULATING;
+  }
+
+  if (isGvfs) {
+    flags |= FileListing::IS_GVFS;
+    mtime = FileListing::MTIME_UNKNOWN;
+    if (isLink) flags |= FileListing::DETAILS_PENDING;
+  } else {
+    flags |= FileListing::DETAILS_PENDING;
+  }
+  return flags;
+}
+
+bool isDirectoryEmpty(const char* path) {
+#ifdef __linux__
+  int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) return false;
+  alignas(linux_dirent64) char buf[1024];
+  bool empty = true;
+  bool done = false;
+  while (!done) {
+    long n = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+    if (n <= 0) {
+      if (n < 0) empty = false;
+      break;
+    }
+    for (long pos = 0; pos < n;) {
+      auto* d = reinterpret_cast<linux_dirent64*>(buf + pos);
+      pos += d->d_reclen;
+      if (!isDotOrDotDot(d->d_name)) {
+        empty = false;
+        done = true;
+        break;
+      }
+    }
+  }
+  close(fd);
+  return empty;
+#else
+  try {
+    return fs::directory_iterator(path) == fs::directory_iterator();
+  } catch (...) {
+    return false;
+  }
+#endif
+}
+
+std::string formatCompactTime(int64_t mtime) {
+  if (mtime == FileListing::MTIME_UNKNOWN) return "Unknown";
+  std::time_t ctime = static_cast<std::time_t>(mtime / 1000000000LL);
+  if (mtime < 0 && mtime % 1000000000LL != 0) ctime -= 1;
+  std::tm ltime;
+  if (!localtime_r(&ctime, &ltime)) return "Unknown";
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", &ltime);
+  return std::string(buf);
+}
+
+DirReader::DirReader(const fs::path& d, bool hidden, bool eager)
+    : dir(d), showHidden(hidden), eagerStat(eager) {
+  dirPrefix = dir.string();
+  if (dirPrefix.empty() || dirPrefix.back() != '/') dirPrefix += '/';
+  isGvfs = dirPrefix.find("/gvfs/") != std::string::npos;
+
+  fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (fd < 0) {
+    err = errno;
+    eof = true;
+    return;
+  }
+  buf.resize(DIRENT_BUF_SIZE);
+}
+
+DirReader::~DirReader() {
+  if (fd >= 0) close(fd);
+}
+
+bool DirReader::readChunk(FileListing& out, size_t maxEntries) {
+  if (fd < 0) return false;
+
+  size_t added = 0;
+  while (added < maxEntries) {
+#ifdef __linux__
+    if (bufPos >= bufLen) {
+      if (eof) return false;
+      long n = syscall(SYS_getdents64, fd, buf.data(), buf.size());
+      if (n <= 0) {
+        if (n < 0) err = errno;
+        eof = true;
+        return false;
+      }
+      bufLen = static_cast<size_t>(n);
+      bufPos = 0;
+    }
+    auto* d = reinterpret_cast<linux_dirent64*>(buf.data() + bufPos);
+    bufPos += d->d_reclen;
+    const char* nm = d->d_name;
+    unsigned char type = d->d_type;
+#else
+    // Portable fallback: no raw dirents, so every entry gets a full stat.
+    if (!dirIt) dirIt = std::make_unique<fs::directory_iterator>(dir);
+    if (*dirIt == fs::directory_iterator()) {
+      eof = true;
+      return false;
+    }
+    std::string nameStr = (*dirIt)->path().filename().string();
+    ++*dirIt;
+    const char* nm = nameStr.c_str();
+    unsigned char type = DT_UNKNOWN;
+#endif
+    if (isDotOrDotDot(nm)) continue;
+    if (!showHidden && nm[0] == '.') continue;
+
+    uintmax_t size = 0;
+    int64_t mtime = FileListing::MTIME_UNKNOWN;
+    uint8_t flags = classifyEntry(fd, nm, type, eagerStat, isGvfs, size, mtime);
+    out.append(std::string_view(dirPrefix.data(), dirPrefix.size() - 1), nm, flags, size, mtime);
+    added++;
+  }
+  return true;
+}
+
+void readDirectoryEntries(const fs::path& dir, bool showHidden, bool eagerStat,
+                          FileListing& out) {
+  DirReader reader(dir, showHidden, eagerStat);
+  if (!reader.isOpen()) {
+    throw fs::filesystem_error("directory_iterator::directory_iterator", dir,
+                               std::error_code(reader.error(), std::generic_category()));
+  }
+  while (reader.readChunk(out)) {
+  }
+}
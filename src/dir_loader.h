@@ -0,0 +1,61 @@
+#ifndef DIR_LOADER_H
+#define DIR_LOADER_H
+
+#include "file_entry.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// Batched directory reader. On Linux it pulls raw dirents with getdents64 and
+// fills type/size/mtime with one AT_STATX_DONT_SYNC statx per name, skipping
+// the statx entirely when d_type is enough for the current listing. Symlink
+// targets and empty-directory probes are always deferred to
+// FileListing::resolveDetails(), which the panes call only for visible rows.
+class DirReader {
+public:
+  DirReader(const fs::path& dir, bool showHidden, bool eagerStat);
+  ~DirReader();
+
+  DirReader(const DirReader&) = delete;
+  DirReader& operator=(const DirReader&) = delete;
+
+  bool isOpen() const { return fd >= 0; }
+  int error() const { return err; }
+
+  // Appends at most maxEntries entries to out. Returns false once the
+  // directory is exhausted (or a read error occurred).
+  bool readChunk(FileListing& out, size_t maxEntries = SIZE_MAX);
+
+private:
+  fs::path dir;
+  std::string dirPrefix;
+  bool showHidden;
+  bool eagerStat;
+  bool isGvfs;
+  int fd = -1;
+  int err = 0;
+  bool eof = false;
+  std::vector<char> buf;
+  size_t bufLen = 0;
+  size_t bufPos = 0;
+#ifndef __linux__
+  std::unique_ptr<fs::directory_iterator> dirIt;
+#endif
+};
+
+// Reads a whole directory through DirReader. Throws fs::filesystem_error when
+// the directory cannot be opened, mirroring fs::directory_iterator.
+void readDirectoryEntries(const fs::path& dir, bool showHidden, bool eagerStat,
+                          FileListing& out);
+
+// Low-level helpers shared with FileListing's lazy resolution. Times are
+// nanoseconds since the Unix epoch, FileListing::MTIME_UNKNOWN if unavailable.
+bool statEntry(const char* path, bool follow, bool& isDir, uintmax_t& size, int64_t& mtime);
+// Derives FileListing flags, size and mtime for name (relative to dirfd) from
+// its d_type, statting only when needed.
+uint8_t classifyEntry(int dirfd, const char* name, unsigned char dtype, bool eagerStat,
+                      bool isGvfs, uintmax_t& size, int64_t& mtime);
+bool isDirectoryEmpty(const char* path);
+std::string formatCompactTime(int64_t mtime);
+
+#endif // DIR_LOADER_H
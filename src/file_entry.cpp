@@ -1,181 +1,621 @@
 #include "file_entry.h"
-#include <algorithm>
-#include <chrono>
-
-FileEntry::FileEntry(const fs::path& p) : path(p) {
-  name = p.filename().string();
-  is_directory = false;
-  is_symlink = false;
-  symlink_target = "";
-  symlink_target_exists = false;
-  is_symlink_directory = false;
-  extension = p.extension().string();
-  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-
-  bool isGvfs = (p.string().find("/gvfs/") != std::string::npos);
-
-  try {
-    if (isGvfs) {
-      modified_time = fs::file_time_type::min();
-    } else {
-      modified_time = fs::last_write_time(p);
+#include "dir_loader.h"
+#include <climits>
+#include <dirent.h>
+#include <fcntl.h>
+#include <thread>
+#include <unordered_map>
+#include <unistd.h>
+
+namespace {
+
+// A name in natural order, one byte at a time: ASCII letters in lower case,
+// and each run of digits, without leading zeros, as its length and then its
+// digits two to a byte. The length is '0' + length below 9 and '9' followed
+// by the length (at most 255) from there, so it sorts where a digit would.
+// Comparing two such streams byte by byte is the natural order, and the
+// first 16 bytes are the cached sort prefix.
+class NaturalBytes {
+public:
+  explicit NaturalBytes(std::string_view s) : s(s) {}
+
+  // The next byte, or -1 at the end.
+  int next() {
+    if (lengthPending) {
+      lengthPending = false;
+      return static_cast<int>(std::min<size_t>(digitsLeft, 255));
+    }
+    if (digitsLeft > 1) {
+      digitsLeft -= 2;
+      int pair = (s[pos] - '0') * 10 + (s[pos + 1] - '0');
+      pos += 2;
+      return pair;
     }
-  } catch (...) {
-    modified_time = fs::file_time_type::min();
-  }
-
-  try {
-    is_symlink = fs::is_symlink(fs::symlink_status(p));
-    if (is_symlink) {
-      try {
-        fs::path target_path = fs::read_symlink(p);
-        symlink_target = target_path.string();
-        fs::path resolved = target_path;
-        if (target_path.is_relative()) {
-          resolved = p.parent_path() / target_path;
-        }
-        if (fs::exists(resolved)) {
-          symlink_target_exists = true;
-          if (fs::is_directory(resolved)) {
-            is_symlink_directory = true;
-          }
-        }
-      } catch (...) {}
+    if (digitsLeft == 1) {
+      digitsLeft = 0;
+      return s[pos++] - '0';
     }
-  } catch (...) {}
+    if (pos >= s.size()) return -1;
+    unsigned char c = static_cast<unsigned char>(s[pos]);
+    if (!isDigit(c)) {
+      ++pos;
+      return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+    }
+    while (pos + 1 < s.size() && s[pos] == '0' && isDigit(s[pos + 1]))
+      ++pos;
+    size_t end = pos;
+    while (end < s.size() && isDigit(s[end]))
+      ++end;
+    digitsLeft = end - pos;
+    if (digitsLeft < 9) return '0' + static_cast<int>(digitsLeft);
+    lengthPending = true;
+    return '9';
+  }
+
+private:
+  static bool isDigit(unsigned char c) { return c >= '0' && c <= '9'; }
 
-  try {
-    if (is_symlink) {
-      is_directory = is_symlink_directory;
-    } else {
-      is_directory = fs::is_directory(p);
+  std::string_view s;
+  size_t pos = 0;
+  size_t digitsLeft = 0;
+  bool lengthPending = false;
+};
+
+FileListing::NameKey namePrefix(std::string_view name) {
+  uint64_t half[2] = {0, 0};
+  if (configNaturalSort) {
+    NaturalBytes bytes(name);
+    for (int i = 0; i < 16; ++i) {
+      int b = bytes.next();
+      half[i / 8] = (half[i / 8] << 8) | static_cast<uint64_t>(b < 0 ? 0 : b);
     }
-  } catch (...) {
-    is_directory = false;
+  } else {
+    for (size_t i = 0; i < 16; ++i)
+      half[i / 8] = (half[i / 8] << 8) |
+                    (i < name.size() ? static_cast<unsigned char>(name[i]) : 0);
   }
+  return {half[0], half[1]};
+}
 
-  try {
-    if (is_directory) {
-      size = isGvfs ? 0 : SIZE_CALCULATING;
-    } else {
-      size = fs::file_size(p);
+// Sorts chunks of keys on their own threads, then merges them.
+template <typename T, typename Less>
+void parallelSort(std::vector<T>& keys, unsigned workers, Less less) {
+  std::vector<size_t> bounds;
+  for (unsigned w = 0; w <= workers; ++w)
+    bounds.push_back(keys.size() * w / workers);
+  std::vector<std::thread> threads;
+  for (unsigned w = 0; w < workers; ++w) {
+    threads.emplace_back([&, w] {
+      std::sort(keys.begin() + bounds[w], keys.begin() + bounds[w + 1], less);
+    });
+  }
+  for (auto& t : threads)
+    t.join();
+  for (size_t step = 1; step < workers; step *= 2) {
+    for (size_t w = 0; w + step < workers; w += 2 * step) {
+      size_t end = bounds[std::min<size_t>(w + 2 * step, workers)];
+      std::inplace_merge(keys.begin() + bounds[w], keys.begin() + bounds[w + step],
+                         keys.begin() + end, less);
     }
-  } catch (...) {
-    size = 0;
   }
+}
 
-  is_empty_directory = false;
-  if (is_directory) {
-    try {
-      if (!isGvfs) {
-        is_empty_directory = (fs::directory_iterator(p) == fs::directory_iterator());
-      }
-    } catch (...) {}
+} // namespace
+
+// --- FileEntry ---
+
+fs::path FileEntry::path() const { return fs::path(listing->rowPath(row)); }
+
+std::string_view FileEntry::nameView() const { return listing->view(listing->rows->names[row]); }
+
+std::string_view FileEntry::extensionView() const {
+  return listing->view(listing->rows->exts[row]);
+}
+
+bool FileEntry::is_directory() const { return listing->rows->flags[row] & FileListing::IS_DIR; }
+
+bool FileEntry::is_symlink() const { return listing->rows->flags[row] & FileListing::IS_SYMLINK; }
+
+bool FileEntry::symlink_target_exists() const {
+  return listing->rows->flags[row] & FileListing::TARGET_EXISTS;
+}
+
+bool FileEntry::is_symlink_directory() const {
+  return listing->rows->flags[row] & FileListing::SYMLINK_DIR;
+}
+
+bool FileEntry::is_empty_directory() const {
+  return listing->rows->flags[row] & FileListing::EMPTY_DIR;
+}
+
+uintmax_t FileEntry::size() const { return listing->rows->sizes[row]; }
+
+int64_t FileEntry::modified_time() const { return listing->rows->mtimes[row]; }
+
+std::string FileEntry::modified_time_str() const {
+  if (listing->rows->flags[row] & FileListing::IS_GVFS) return "Unknown";
+  return formatCompactTime(listing->rows->mtimes[row]);
+}
+
+std::string FileEntry::symlink_target() const {
+  const auto& targets = listing->rows->symlinkTargets;
+  auto it = targets.find(row);
+  return it != targets.end() ? it->second : std::string();
+}
+
+// --- FileListing ---
+
+FileListing::FileListing(const FileListing& other)
+    : rows(other.rows ? std::make_shared<Rows>(*other.rows) : nullptr),
+      order(other.order ? std::make_shared<std::vector<uint32_t>>(*other.order) : nullptr) {}
+
+FileListing& FileListing::operator=(const FileListing& other) {
+  if (this != &other) {
+    FileListing copy(other);
+    *this = std::move(copy);
   }
+  return *this;
+}
 
-  // Pre-format the compact modified time
-  if (isGvfs || modified_time == fs::file_time_type::min()) {
-    modified_time_str = "Unknown";
-  } else {
-    try {
-      auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-          modified_time - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
-      std::time_t ctime = std::chrono::system_clock::to_time_t(sctp);
-      std::tm* ltime = std::localtime(&ctime);
-      char buf[32];
-      std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", ltime);
-      modified_time_str = std::string(buf);
-    } catch (...) {
-      modified_time_str = "Unknown";
-    }
+FileListing FileListing::share() const {
+  FileListing view;
+  view.rows = rows;
+  view.order = order;
+  return view;
+}
+
+FileListing::Rows& FileListing::ownRows() {
+  if (!rows)
+    rows = std::make_shared<Rows>();
+  else if (rows.use_count() > 1)
+    rows = std::make_shared<Rows>(*rows);
+  return *rows;
+}
+
+std::vector<uint32_t>& FileListing::ownOrder() {
+  if (!order)
+    order = std::make_shared<std::vector<uint32_t>>();
+  else if (order.use_count() > 1)
+    order = std::make_shared<std::vector<uint32_t>>(*order);
+  return *order;
+}
+
+void FileListing::clear() {
+  // Other views keep what they share; an unshared listing keeps its capacity.
+  if (rows && rows.use_count() == 1)
+    *rows = Rows{};
+  else
+    rows.reset();
+  if (order && order.use_count() == 1)
+    order->clear();
+  else
+    order.reset();
+}
+
+void FileListing::reserve(size_t n) {
+  Rows& d = ownRows();
+  d.arena.reserve(n * 16);
+  d.names.reserve(n);
+  d.exts.reserve(n);
+  d.parentIds.reserve(n);
+  d.flags.reserve(n);
+  d.sizes.reserve(n);
+  d.mtimes.reserve(n);
+  ownOrder().reserve(n);
+}
+
+FileListing::Span FileListing::store(std::string_view s) {
+  Rows& d = ownRows();
+  Span span{static_cast<uint32_t>(d.arena.size()), static_cast<uint16_t>(s.size())};
+  d.arena.append(s.data(), s.size());
+  return span;
+}
+
+FileListing::Span FileListing::internExtension(std::string_view name) {
+  size_t dot = name.rfind('.');
+  if (dot == std::string_view::npos || dot == 0) return Span{0, 0};
+  std::string ext(name.substr(dot));
+  for (auto& c : ext)
+    c = static_cast<char>(::tolower(static_cast<unsigned char>(c)));
+  Rows& d = ownRows();
+  auto it = d.extIntern.find(ext);
+  if (it != d.extIntern.end()) return it->second;
+  Span span = store(ext);
+  d.extIntern.emplace(std::move(ext), span);
+  return span;
+}
+
+uint32_t FileListing::internParent(std::string_view dir) {
+  Rows& d = ownRows();
+  if (!d.parents.empty() && d.parents.back() == dir)
+    return static_cast<uint32_t>(d.parents.size() - 1);
+  std::string key(dir);
+  auto it = d.parentIndex.find(key);
+  if (it != d.parentIndex.end()) return it->second;
+  uint32_t id = static_cast<uint32_t>(d.parents.size());
+  d.parents.push_back(key);
+  d.parentIndex.emplace(std::move(key), id);
+  return id;
+}
+
+std::string_view FileListing::rowDiskName(uint32_t r) const {
+  auto it = rows->diskNames.find(r);
+  return view(it != rows->diskNames.end() ? it->second : rows->names[r]);
+}
+
+std::string FileListing::rowPath(uint32_t r) const {
+  const std::string& dir = rows->parents[rows->parentIds[r]];
+  std::string_view name = rowDiskName(r);
+  std::string full;
+  full.reserve(dir.size() + 1 + name.size());
+  full.append(dir);
+  full.push_back('/');
+  full.append(name.data(), name.size());
+  return full;
+}
+
+size_t FileListing::append(std::string_view dir, std::string_view name, uint8_t f,
+                           uintmax_t size, int64_t mtime) {
+  Rows& d = ownRows();
+  auto& o = ownOrder();
+  uint32_t r = static_cast<uint32_t>(d.names.size());
+  d.parentIds.push_back(internParent(dir));
+  d.names.push_back(store(name));
+  d.exts.push_back(internExtension(name));
+  d.flags.push_back(f);
+  d.sizes.push_back(size);
+  d.mtimes.push_back(mtime);
+  o.push_back(r);
+  return o.size() - 1;
+}
+
+void FileListing::appendPath(const fs::path& p) {
+  std::string full = p.is_absolute() ? p.string() : fs::absolute(p).string();
+  while (full.size() > 1 && full.back() == '/')
+    full.pop_back();
+  size_t slash = full.rfind('/');
+  if (slash == std::string::npos) return;
+
+  bool isGvfs = full.find("/gvfs/") != std::string::npos;
+  uintmax_t size = 0;
+  int64_t mtime = MTIME_UNKNOWN;
+  uint8_t f = classifyEntry(AT_FDCWD, full.c_str(), DT_UNKNOWN, true, isGvfs, size, mtime);
+  std::string_view sv(full);
+  append(sv.substr(0, slash), sv.substr(slash + 1), f, size, mtime);
+}
+
+void FileListing::appendListing(const FileListing& other) {
+  if (other.empty()) return;
+  // Copy what is read from other first: appending may be to a view that
+  // shares other's rows, and ownRows() would then swap them out.
+  FileListing src = other.share();
+  const Rows& o = *src.rows;
+  for (uint32_t r : *src.order) {
+    size_t pos = append(o.parents[o.parentIds[r]], src.rowDiskName(r), o.flags[r], o.sizes[r],
+                        o.mtimes[r]);
+    if (o.diskNames.count(r)) setDisplayName(pos, src.view(o.names[r]));
+    auto it = o.symlinkTargets.find(r);
+    if (it != o.symlinkTargets.end()) rows->symlinkTargets[(*order)[pos]] = it->second;
   }
 }
 
-FileEntry::FileEntry(const fs::directory_entry& entry) : path(entry.path()) {
-  name = path.filename().string();
-  is_directory = false;
-  is_symlink = false;
-  symlink_target = "";
-  symlink_target_exists = false;
-  is_symlink_directory = false;
-  extension = path.extension().string();
-  std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
-
-  bool isGvfs = (path.string().find("/gvfs/") != std::string::npos);
-
-  try {
-    is_symlink = entry.is_symlink();
-    if (is_symlink) {
-      try {
-        fs::path target_path = fs::read_symlink(path);
-        symlink_target = target_path.string();
-        fs::path resolved = target_path;
-        if (target_path.is_relative()) {
-          resolved = path.parent_path() / target_path;
-        }
-        if (fs::exists(resolved)) {
-          symlink_target_exists = true;
-          if (fs::is_directory(resolved)) {
-            is_symlink_directory = true;
-          }
-        }
-      } catch (...) {}
-    }
-  } catch (...) {}
+void FileListing::setDisplayName(size_t i, std::string_view name) {
+  Rows& d = ownRows();
+  uint32_t r = (*order)[i];
+  if (!d.diskNames.count(r)) d.diskNames[r] = d.names[r];
+  Span stored = store(name);
+  d.names[r] = stored;
+  d.exts[r] = internExtension(name);
+  if (r < d.nameKeys.size()) d.nameKeys[r] = namePrefix(name);
+}
 
-  try {
-    if (is_symlink) {
-      is_directory = is_symlink_directory;
-    } else {
-      is_directory = entry.is_directory();
-    }
-  } catch (...) {
-    is_directory = false;
+void FileListing::restat(size_t i) {
+  uint32_t r = (*order)[i];
+  std::string full = rowPath(r);
+  bool isGvfs = full.find("/gvfs/") != std::string::npos;
+  uintmax_t size = 0;
+  int64_t mtime = MTIME_UNKNOWN;
+  uint8_t f = classifyEntry(AT_FDCWD, full.c_str(), DT_UNKNOWN, true, isGvfs, size, mtime);
+  Rows& d = *rows;
+  if ((f & IS_DIR) && (d.flags[r] & IS_DIR)) size = d.sizes[r];
+  d.flags[r] = f;
+  d.sizes[r] = size;
+  d.mtimes[r] = mtime;
+  d.symlinkTargets.erase(r);
+}
+
+size_t FileListing::indexOf(const fs::path& p, size_t from) const {
+  if (empty()) return npos;
+  const std::string& full = p.native();
+  size_t slash = full.rfind('/');
+  if (slash == std::string::npos) return npos;
+  auto it = rows->parentIndex.find(full.substr(0, slash));
+  if (it == rows->parentIndex.end()) return npos;
+  uint32_t pid = it->second;
+  std::string_view name = std::string_view(full).substr(slash + 1);
+  const auto& o = *order;
+  for (size_t i = from; i < o.size(); ++i) {
+    uint32_t r = o[i];
+    if (rows->parentIds[r] == pid && rowDiskName(r) == name) return i;
   }
+  return npos;
+}
 
-  try {
-    if (isGvfs) {
-      modified_time = fs::file_time_type::min();
-    } else {
-      modified_time = entry.last_write_time();
+int FileListing::compareNames(std::string_view a, std::string_view b) {
+  if (configNaturalSort) {
+    NaturalBytes x(a), y(b);
+    for (;;) {
+      int p = x.next(), q = y.next();
+      if (p != q) return p < q ? -1 : 1;
+      if (p < 0) break;
     }
-  } catch (...) {
-    modified_time = fs::file_time_type::min();
   }
+  int c = a.compare(b);
+  return (c > 0) - (c < 0);
+}
 
-  try {
-    if (is_directory) {
-      size = isGvfs ? 0 : SIZE_CALCULATING;
-    } else {
-      size = entry.file_size();
-    }
-  } catch (...) {
-    size = 0;
+void FileListing::fillNameKeys() const {
+  Rows& d = *rows;
+  d.nameKeys.reserve(d.names.size());
+  for (size_t r = d.nameKeys.size(); r < d.names.size(); ++r)
+    d.nameKeys.push_back(namePrefix(view(d.names[r])));
+}
+
+FileListing::SortKey FileListing::sortKey(uint32_t r, SortMode mode) const {
+  const Rows& d = *rows;
+  SortKey key{0, d.nameKeys[r], r, static_cast<uint8_t>(d.flags[r] & IS_DIR ? 0 : 1)};
+  // Both fields descending; the flipped sign bit orders int64 as unsigned.
+  if (mode == SortMode::SIZE)
+    key.field = ~static_cast<uint64_t>(d.sizes[r]);
+  else if (mode == SortMode::DATE)
+    key.field = ~(static_cast<uint64_t>(d.mtimes[r]) ^ (1ULL << 63));
+  return key;
+}
+
+bool FileListing::keyLess(const SortKey& a, const SortKey& b) const {
+  if (a.group != b.group) return a.group < b.group;
+  if (a.field != b.field) return a.field < b.field;
+  if (a.name.hi != b.name.hi) return a.name.hi < b.name.hi;
+  if (a.name.lo != b.name.lo) return a.name.lo < b.name.lo;
+  return compareNames(view(rows->names[a.row]), view(rows->names[b.row])) < 0;
+}
+
+void FileListing::sort(SortMode mode) {
+  if (empty()) return;
+  fillNameKeys();
+  auto& o = ownOrder();
+  std::vector<SortKey> keys;
+  keys.reserve(o.size());
+  for (uint32_t r : o)
+    keys.push_back(sortKey(r, mode));
+  auto less = [this](const SortKey& a, const SortKey& b) { return keyLess(a, b); };
+  unsigned workers = std::min(std::thread::hardware_concurrency(), 8u);
+  if (keys.size() >= PARALLEL_SORT_MIN && workers > 1)
+    parallelSort(keys, workers, less);
+  else
+    std::sort(keys.begin(), keys.end(), less);
+  for (size_t i = 0; i < keys.size(); ++i)
+    o[i] = keys[i].row;
+}
+
+void FileListing::partialSort(size_t k, SortMode mode) {
+  if (empty()) return;
+  fillNameKeys();
+  auto& o = ownOrder();
+  std::vector<SortKey> keys;
+  keys.reserve(o.size());
+  for (uint32_t r : o)
+    keys.push_back(sortKey(r, mode));
+  std::partial_sort(keys.begin(), keys.begin() + std::min(k, keys.size()), keys.end(),
+                    [this](const SortKey& a, const SortKey& b) { return keyLess(a, b); });
+  for (size_t i = 0; i < keys.size(); ++i)
+    o[i] = keys[i].row;
+}
+
+size_t FileListing::mergeSortedPrefix(size_t sorted, size_t from, size_t k, SortMode mode,
+                                      size_t& tracked) {
+  if (empty()) return 0;
+  size_t n = size();
+  from = std::min(from, n);
+  sorted = std::min(sorted, from);
+  k = std::min(std::max(k, sorted), n);
+  if (k > sorted && sorted < from) {
+    uint32_t row = tracked < n ? (*order)[tracked] : 0;
+    partialSort(k, mode);
+    if (tracked < n) tracked = positionOfRow(row);
+    return k;
   }
+  fillNameKeys();
+  auto& o = ownOrder();
+  auto less = [this](const SortKey& a, const SortKey& b) { return keyLess(a, b); };
 
-  is_empty_directory = false;
-  if (is_directory) {
-    try {
-      if (!isGvfs) {
-        is_empty_directory = (fs::directory_iterator(path) == fs::directory_iterator());
+  // Only the best k new rows can join the prefix.
+  std::vector<SortKey> fresh;
+  fresh.reserve(n - from);
+  for (size_t i = from; i < n; ++i)
+    fresh.push_back(sortKey(o[i], mode));
+  size_t take = std::min(k, fresh.size());
+  if (take < fresh.size()) std::nth_element(fresh.begin(), fresh.begin() + take, fresh.end(), less);
+  std::sort(fresh.begin(), fresh.begin() + take, less);
+  std::vector<SortKey> prefix;
+  prefix.reserve(sorted);
+  for (size_t i = 0; i < sorted; ++i)
+    prefix.push_back(sortKey(o[i], mode));
+
+  // The winners, then the rest, go back into the slots [0, sorted) and
+  // [from, n) the rows came from; the rows in between stay put.
+  uint32_t trackedRow = tracked < n ? o[tracked] : 0;
+  bool tracking = tracked < n && (tracked < sorted || tracked >= from);
+  size_t slot = 0;
+  auto put = [&](uint32_t row) {
+    size_t at = slot < sorted ? slot : from + (slot - sorted);
+    o[at] = row;
+    if (tracking && row == trackedRow) tracked = at;
+    ++slot;
+  };
+  size_t a = 0, b = 0;
+  for (size_t w = 0; w < k; ++w) {
+    if (b == take || (a < sorted && !less(fresh[b], prefix[a]))) put(prefix[a++].row);
+    else put(fresh[b++].row);
+  }
+  while (a < sorted)
+    put(prefix[a++].row);
+  for (; b < fresh.size(); ++b)
+    put(fresh[b].row);
+  return k;
+}
+
+size_t FileListing::positionOfRow(uint32_t r) const {
+  const auto& o = *order;
+  for (size_t i = 0; i < o.size(); ++i)
+    if (o[i] == r) return i;
+  return npos;
+}
+
+size_t FileListing::reposition(size_t i, SortMode mode) {
+  fillNameKeys();
+  auto& o = ownOrder();
+  SortKey key = sortKey(o[i], mode);
+  auto less = [&](const SortKey& k, uint32_t row) { return keyLess(k, sortKey(row, mode)); };
+  // Rotate the row into place so that only the rows it passes move.
+  auto at = o.begin() + i;
+  if (i > 0 && less(key, o[i - 1])) {
+    auto it = std::upper_bound(o.begin(), at, key, less);
+    std::rotate(it, at, at + 1);
+    return static_cast<size_t>(it - o.begin());
+  }
+  auto it = std::upper_bound(at + 1, o.end(), key, less);
+  std::rotate(at, at + 1, it);
+  return static_cast<size_t>(it - o.begin()) - 1;
+}
+
+bool FileListing::applyChanges(const std::string& dir, const std::vector<std::string>& gone,
+                               const std::vector<std::string>& present, SortMode mode,
+                               const std::function<void(size_t, bool)>& prepare) {
+  if (gone.empty() && present.empty()) return false;
+
+  // Positions of dir's rows by name, in one pass.
+  std::unordered_map<std::string_view, size_t> byName;
+  if (!empty()) {
+    auto it = rows->parentIndex.find(dir);
+    if (it != rows->parentIndex.end()) {
+      const auto& o = *order;
+      for (size_t i = 0; i < o.size(); ++i) {
+        if (rows->parentIds[o[i]] == it->second) byName.emplace(rowDiskName(o[i]), i);
       }
-    } catch (...) {}
+    }
   }
 
-  // Pre-format the compact modified time
-  if (isGvfs || modified_time == fs::file_time_type::min()) {
-    modified_time_str = "Unknown";
-  } else {
-    try {
-      auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-          modified_time - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
-      std::time_t ctime = std::chrono::system_clock::to_time_t(sctp);
-      std::tm* ltime = std::localtime(&ctime);
-      char buf[32];
-      std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M", ltime);
-      modified_time_str = std::string(buf);
-    } catch (...) {
-      modified_time_str = "Unknown";
+  constexpr uint8_t KEEP = 0, ERASE = 1, MOVE = 2;
+  size_t before = size();
+  std::vector<uint8_t> marks(before, KEEP);
+  bool changed = false;
+  for (const std::string& name : gone) {
+    auto it = byName.find(name);
+    if (it == byName.end()) continue;
+    marks[it->second] = ERASE;
+    changed = true;
+  }
+  std::vector<std::string> added;
+  for (const std::string& name : present) {
+    auto it = byName.find(name);
+    if (it == byName.end()) {
+      added.push_back(name);
+      continue;
     }
+    if (marks[it->second] == MOVE) continue;
+    restat(it->second);
+    marks[it->second] = MOVE;
+    changed = true;
+    if (prepare) prepare(it->second, false);
+  }
+  byName.clear(); // appending may move the arena
+  for (const std::string& name : added) {
+    size_t was = size();
+    appendPath(fs::path(dir) / name);
+    if (size() == was) continue;
+    changed = true;
+    if (prepare) prepare(size() - 1, true);
+  }
+  if (!changed) return false;
+
+  // The untouched rows are still in order; sort the touched ones and merge.
+  fillNameKeys();
+  auto& o = ownOrder();
+  std::vector<uint32_t> kept;
+  std::vector<SortKey> moved;
+  kept.reserve(o.size());
+  for (size_t i = 0; i < o.size(); ++i) {
+    uint8_t m = i < before ? marks[i] : MOVE;
+    if (m == KEEP) kept.push_back(o[i]);
+    else if (m == MOVE) moved.push_back(sortKey(o[i], mode));
+  }
+  auto less = [this](const SortKey& a, const SortKey& b) { return keyLess(a, b); };
+  std::sort(moved.begin(), moved.end(), less);
+  o.clear();
+  size_t k = 0;
+  for (uint32_t r : kept) {
+    SortKey key = sortKey(r, mode);
+    while (k < moved.size() && less(moved[k], key))
+      o.push_back(moved[k++].row);
+    o.push_back(r);
   }
+  for (; k < moved.size(); ++k)
+    o.push_back(moved[k].row);
+  return true;
+}
+
+void FileListing::resolveRowStat(uint32_t r) const {
+  Rows& d = *rows;
+  if (!(d.flags[r] & STAT_PENDING)) return;
+  d.flags[r] &= ~STAT_PENDING;
+
+  bool isDir = false;
+  uintmax_t sz = 0;
+  int64_t mt = MTIME_UNKNOWN;
+  if (statEntry(rowPath(r).c_str(), d.flags[r] & IS_SYMLINK, isDir, sz, mt)) {
+    d.mtimes[r] = mt;
+    if (!(d.flags[r] & IS_DIR)) d.sizes[r] = sz;
+  }
+}
+
+void FileListing::resolveRowDetails(uint32_t r) const {
+  resolveRowStat(r);
+  Rows& d = *rows;
+  if (!(d.flags[r] & DETAILS_PENDING)) return;
+  d.flags[r] &= ~DETAILS_PENDING;
+
+  std::string full = rowPath(r);
+  if (d.flags[r] & IS_SYMLINK) {
+    char buf[PATH_MAX];
+    ssize_t n = readlink(full.c_str(), buf, sizeof(buf));
+    if (n >= 0) d.symlinkTargets[r] = std::string(buf, static_cast<size_t>(n));
+  }
+  if ((d.flags[r] & IS_DIR) && !(d.flags[r] & IS_GVFS) && isDirectoryEmpty(full.c_str())) {
+    d.flags[r] |= EMPTY_DIR;
+  }
+}
+
+void FileListing::resolveAllStats() const {
+  if (empty()) return;
+  for (uint32_t r : *order)
+    resolveRowStat(r);
+}
+
+size_t FileListing::memoryUsage() const {
+  size_t bytes = order ? order->capacity() * sizeof(uint32_t) : 0;
+  if (!rows) return bytes;
+  const Rows& d = *rows;
+  bytes += d.arena.capacity();
+  for (const auto& p : d.parents)
+    bytes += p.capacity() + sizeof(p);
+  bytes += d.names.capacity() * sizeof(Span) + d.exts.capacity() * sizeof(Span);
+  bytes += d.parentIds.capacity() * sizeof(uint32_t);
+  bytes += d.flags.capacity() + d.sizes.capacity() * sizeof(uintmax_t);
+  bytes += d.mtimes.capacity() * sizeof(int64_t);
+  bytes += d.nameKeys.capacity() * sizeof(NameKey);
+  bytes += d.diskNames.size() * (sizeof(uint32_t) + sizeof(Span)) * 2;
+  for (const auto& kv : d.symlinkTargets)
+    bytes += kv.second.capacity() + sizeof(kv);
+  return bytes;
 }
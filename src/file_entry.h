@@ -2,23 +2,252 @@
 #define FILE_ENTRY_H
 
 #include "utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string_view>
 
-struct FileEntry {
-  fs::path path;
-  std::string name;
-  bool is_directory;
-  uintmax_t size;
-  std::string extension;
-  bool is_symlink;
-  std::string symlink_target;
-  bool symlink_target_exists;
-  bool is_symlink_directory;
-  bool is_empty_directory;
-  fs::file_time_type modified_time;
-  std::string modified_time_str;
-
-  FileEntry(const fs::path& p);
-  FileEntry(const fs::directory_entry& entry);
+class FileListing;
+
+// Read-only view of one row of a FileListing. Cheap to copy; valid while the
+// listing it came from is alive. Accessors keep the old field names.
+class FileEntry {
+public:
+  FileEntry(const FileListing* listing, uint32_t row) : listing(listing), row(row) {}
+
+  fs::path path() const;
+  std::string name() const { return std::string(nameView()); }
+  std::string_view nameView() const;
+  std::string extension() const { return std::string(extensionView()); }
+  std::string_view extensionView() const;
+
+  bool is_directory() const;
+  bool is_symlink() const;
+  bool symlink_target_exists() const;
+  bool is_symlink_directory() const;
+  bool is_empty_directory() const;
+  uintmax_t size() const;
+  int64_t modified_time() const;
+  std::string modified_time_str() const;
+  std::string symlink_target() const;
+
+private:
+  const FileListing* listing;
+  uint32_t row;
+};
+
+// Struct-of-arrays directory listing. Names and interned extensions live in
+// one string arena addressed by uint32_t offsets, the bools are packed into a
+// flag byte, mtime is kept as nanoseconds since the epoch and full paths are
+// rebuilt from a parent-directory table on demand. Rows are only ever
+// appended; sorting and erasing permute the `order` index instead.
+//
+// Rows and order are held through shared pointers so that share() hands out
+// more views of one listing without copying it (copy-on-write). Changing the
+// set of rows or their names copies the rows first, and resorting or erasing
+// copies the order. Facts filled in or refreshed later (lazy stats and
+// details, directory sizes, restat()) are written in place, so every view
+// sees them. Views that share must stay on one thread. Copying a FileListing
+// makes an independent deep copy that is safe to hand to another thread.
+class FileListing {
+public:
+  enum Flag : uint8_t {
+    IS_DIR = 1 << 0,
+    IS_SYMLINK = 1 << 1,
+    TARGET_EXISTS = 1 << 2,
+    SYMLINK_DIR = 1 << 3,
+    EMPTY_DIR = 1 << 4,
+    STAT_PENDING = 1 << 5,
+    DETAILS_PENDING = 1 << 6,
+    IS_GVFS = 1 << 7,
+  };
+
+  static constexpr int64_t MTIME_UNKNOWN = INT64_MIN;
+
+  class const_iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = FileEntry;
+    using difference_type = std::ptrdiff_t;
+    using pointer = void;
+    using reference = FileEntry;
+
+    const_iterator(const FileListing* l, size_t i) : l(l), i(i) {}
+    FileEntry operator*() const { return (*l)[i]; }
+    const_iterator& operator++() {
+      ++i;
+      return *this;
+    }
+    bool operator==(const const_iterator& o) const { return i == o.i; }
+    bool operator!=(const const_iterator& o) const { return i != o.i; }
+
+  private:
+    const FileListing* l;
+    size_t i;
+  };
+
+  FileListing() = default;
+  FileListing(const FileListing& other);
+  FileListing& operator=(const FileListing& other);
+  FileListing(FileListing&&) noexcept = default;
+  FileListing& operator=(FileListing&&) noexcept = default;
+
+  // Another view of this listing, sharing its rows and order (see above).
+  FileListing share() const;
+
+  size_t size() const { return order ? order->size() : 0; }
+  bool empty() const { return size() == 0; }
+  void clear();
+  void reserve(size_t n);
+
+  FileEntry operator[](size_t i) const { return FileEntry(this, (*order)[i]); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size()); }
+
+  // Appends a row in directory dir (same string for every row of a plain
+  // listing). Returns the new position.
+  size_t append(std::string_view dir, std::string_view name, uint8_t flags, uintmax_t size,
+                int64_t mtime);
+  // Appends and stats an arbitrary path (search results).
+  void appendPath(const fs::path& p);
+  // Copies all rows of other (in its current order) to the end of this one.
+  void appendListing(const FileListing& other);
+
+  // Trash rows show the original name while path() still points at the
+  // trashed file.
+  void setDisplayName(size_t i, std::string_view name);
+  void setSize(size_t i, uintmax_t size) { rows->sizes[(*order)[i]] = size; }
+  // Re-stats row i after an inotify change. A directory keeps its size.
+  void restat(size_t i);
+  void erase(size_t i) {
+    auto& o = ownOrder();
+    o.erase(o.begin() + i);
+  }
+
+  // Applies one batch of changes to the rows of dir in a listing sorted for
+  // mode: rows named in gone are erased, those named in present re-statted
+  // (or appended when missing). prepare, if set, sees every re-statted or
+  // appended row's position (added tells which) before the touched rows are
+  // sorted on their own and merged back, so a batch costs one pass over the
+  // listing instead of a lookup and a move per name. Returns true if the
+  // listing changed.
+  bool applyChanges(const std::string& dir, const std::vector<std::string>& gone,
+                    const std::vector<std::string>& present, SortMode mode,
+                    const std::function<void(size_t i, bool added)>& prepare = nullptr);
+
+  // Position of the row whose path() equals p, or npos. Positions before
+  // from are not searched.
+  size_t indexOf(const fs::path& p, size_t from = 0) const;
+  static constexpr size_t npos = static_cast<size_t>(-1);
+
+  // Lazy columns: size/mtime when the bulk read skipped the stat, and the
+  // symlink target / empty-dir probe which only visible rows need.
+  void resolveStat(size_t i) const { resolveRowStat((*order)[i]); }
+  void resolveDetails(size_t i) const { resolveRowDetails((*order)[i]); }
+  void resolveAllStats() const;
+  bool detailsResolved(size_t i) const {
+    return !(rows->flags[(*order)[i]] & (STAT_PENDING | DETAILS_PENDING));
+  }
+
+  // Orders the rows for mode: directories first, then largest (SIZE) or
+  // newest (DATE) first, then by compareNames(). Each row is reduced to a
+  // small key holding its group, the mode's field and a cached 16-byte prefix
+  // of its name order, so comparisons only reach the names on a tied prefix.
+  // Listings of PARALLEL_SORT_MIN rows and up are sorted on several threads.
+  // SIZE and DATE want resolveAllStats() first.
+  void sort(SortMode mode);
+  // Only the first k positions end up in final order.
+  void partialSort(size_t k, SortMode mode);
+  // partialSort(k) for a listing whose first sorted positions already hold,
+  // in order, the first rows of [0, from) and whose rows from `from` on were
+  // just appended. Only the sorted prefix and the new rows are looked at, so
+  // it costs O(size() - from + k log k), unless k reaches past a prefix that
+  // is shorter than from, which takes a full partialSort. The row at
+  // position tracked, if it is not npos, is followed to its new position.
+  // Returns the length of the sorted prefix, at least k when that many rows
+  // exist.
+  size_t mergeSortedPrefix(size_t sorted, size_t from, size_t k, SortMode mode,
+                           size_t& tracked);
+  // Moves row i to its place in a listing otherwise sorted for mode, by
+  // binary search; the other rows keep their order. Returns the new position.
+  size_t reposition(size_t i, SortMode mode);
+
+  // Name order: with configNaturalSort, ASCII case is ignored and runs of
+  // digits compare as numbers (file2 before file10); byte order breaks ties
+  // and is the whole order otherwise.
+  static int compareNames(std::string_view a, std::string_view b);
+  static constexpr size_t PARALLEL_SORT_MIN = 1 << 17;
+  // The first 16 bytes of a name's order, big end first.
+  struct NameKey {
+    uint64_t hi;
+    uint64_t lo;
+  };
+
+  size_t memoryUsage() const;
+
+private:
+  friend class FileEntry;
+
+  struct Span {
+    uint32_t off;
+    uint16_t len;
+  };
+
+  // Everything but the order. The lazy resolvers write facts into it through
+  // const methods, which is what lets views share it.
+  struct Rows {
+    std::string arena;
+    std::vector<std::string> parents;
+    std::unordered_map<std::string, uint32_t> parentIndex;
+    std::unordered_map<std::string, Span> extIntern;
+
+    std::vector<Span> names;
+    std::vector<Span> exts;
+    std::vector<uint32_t> parentIds;
+    std::vector<uint8_t> flags;
+    std::vector<uintmax_t> sizes;
+    std::vector<int64_t> mtimes;
+    // Name order prefixes for sorting, filled up to the last row by
+    // fillNameKeys().
+    std::vector<NameKey> nameKeys;
+
+    // Sparse columns.
+    std::unordered_map<uint32_t, Span> diskNames;
+    std::unordered_map<uint32_t, std::string> symlinkTargets;
+  };
+
+  struct SortKey {
+    uint64_t field;
+    NameKey name;
+    uint32_t row;
+    uint8_t group;
+  };
+  void fillNameKeys() const;
+  SortKey sortKey(uint32_t r, SortMode mode) const;
+  bool keyLess(const SortKey& a, const SortKey& b) const;
+  size_t positionOfRow(uint32_t r) const;
+
+  // Unshared, writable rows and order, copied first if another view holds
+  // them.
+  Rows& ownRows();
+  std::vector<uint32_t>& ownOrder();
+
+  std::string_view view(Span s) const {
+    return std::string_view(rows->arena.data() + s.off, s.len);
+  }
+  Span store(std::string_view s);
+  Span internExtension(std::string_view name);
+  uint32_t internParent(std::string_view dir);
+  std::string_view rowDiskName(uint32_t r) const;
+  std::string rowPath(uint32_t r) const;
+  void resolveRowStat(uint32_t r) const;
+  void resolveRowDetails(uint32_t r) const;
+
+  // Null while empty.
+  std::shared_ptr<Rows> rows;
+  std::shared_ptr<std::vector<uint32_t>> order;
 };
 
 #endif // FILE_ENTRY_H
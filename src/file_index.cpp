@@ -0,0 +1,546 @@
+#include "file_index.h"
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char INDEX_MAGIC[8] = {'F', 'Y', 'Z', 'F', 'I', 'D', 'X', '1'};
+constexpr uint32_t INDEX_VERSION = 1;
+
+// Paths per segment handed to the PathIndex while loading.
+constexpr size_t LOAD_SEGMENT_PATHS = 65536;
+// A full recrawl is due once the last one is this old.
+constexpr std::time_t MAX_AGE_SECONDS = 24 * 60 * 60;
+// Changes are written back at most this often.
+constexpr auto SAVE_INTERVAL = std::chrono::minutes(5);
+// Upper bound on the directories watched; at most half the user's inotify
+// allowance is taken.
+constexpr size_t MAX_WATCHES = 8192;
+// Queued changes beyond this are dropped in favour of a recrawl.
+constexpr size_t MAX_PENDING_CHANGES = 65536;
+constexpr uint32_t WATCH_MASK =
+    IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF | IN_ONLYDIR;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t rootLen;
+  int64_t crawledAt;
+  uint64_t count;
+  uint64_t dataSize;
+};
+
+void putVarint(std::string& out, uint64_t v) {
+  while (v >= 0x80) {
+    out += static_cast<char>((v & 0x7F) | 0x80);
+    v >>= 7;
+  }
+  out += static_cast<char>(v);
+}
+
+bool getVarint(const unsigned char*& p, const unsigned char* end, uint64_t& v) {
+  v = 0;
+  for (int shift = 0; p < end && shift < 64; shift += 7) {
+    unsigned char b = *p++;
+    v |= static_cast<uint64_t>(b & 0x7F) << shift;
+    if (!(b & 0x80)) return true;
+  }
+  return false;
+}
+
+bool ignoredComponent(const std::string& rel) {
+  return rel == ".git" || rel.rfind(".git/", 0) == 0 || rel.find("/.git/") != std::string::npos ||
+         (rel.size() >= 5 && rel.compare(rel.size() - 5, 5, "/.git") == 0);
+}
+
+void lowerThreadPriority() {
+#ifdef __linux__
+  setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), 19);
+  // IOPRIO_WHO_PROCESS with id 0 is the calling thread; class 3 is idle.
+  syscall(SYS_ioprio_set, 1, 0, 3 << 13);
+#endif
+}
+
+size_t inotifyAllowance() {
+  size_t limit = MAX_WATCHES * 2;
+  if (FILE* f = fopen("/proc/sys/fs/inotify/max_user_watches", "r")) {
+    unsigned long v = 0;
+    if (fscanf(f, "%lu", &v) == 1) limit = v;
+    fclose(f);
+  }
+  return std::min(MAX_WATCHES, limit / 2);
+}
+
+} // namespace
+
+FileIndex::~FileIndex() { stop(); }
+
+void FileIndex::start(const std::string& root, const std::string& file) {
+  stop();
+  rootPath = root;
+  while (rootPath.size() > 1 && rootPath.back() == '/')
+    rootPath.pop_back();
+  filePath = file;
+  stopping = false;
+  running = true;
+  worker = std::thread(&FileIndex::run, this);
+}
+
+void FileIndex::stop() {
+  stopping = true;
+  wake.notify();
+  if (worker.joinable()) worker.join();
+  running = false;
+}
+
+bool FileIndex::ready() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return index && index->complete();
+}
+
+size_t FileIndex::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return index ? index->size() : 0;
+}
+
+bool FileIndex::relative(const std::string& path, std::string& rel) const {
+  if (path == rootPath) {
+    rel.clear();
+    return true;
+  }
+  std::string prefix = rootPath == "/" ? "/" : rootPath + "/";
+  if (path.size() <= prefix.size() || path.compare(0, prefix.size(), prefix) != 0) return false;
+  rel = path.substr(prefix.size());
+  return true;
+}
+
+bool FileIndex::removed(const std::string& rel, uint32_t entry) const {
+  if (tombstones.empty()) return false;
+  auto dead = [&](const std::string& p) {
+    auto it = tombstones.find(p);
+    return it != tombstones.end() && entry < it->second;
+  };
+  if (dead(rel)) return true;
+  for (size_t slash = rel.find('/'); slash != std::string::npos; slash = rel.find('/', slash + 1)) {
+    if (dead(rel.substr(0, slash))) return true;
+  }
+  return false;
+}
+
+// Queued creations of paths idx already holds must not add them again:
+// marks those paths live-added. Called with the mutex held.
+void FileIndex::seedLiveAdded(const PathIndex& idx) {
+  std::unordered_set<std::string> wanted;
+  for (const Change& c : pendingChanges) {
+    if (!c.gone) wanted.insert(c.rel);
+  }
+  if (wanted.empty()) return;
+  PathIndex::Snapshot snap = idx.snapshot();
+  std::string p;
+  for (const auto& seg : snap.segments) {
+    for (size_t i = 0; i < seg->size(); ++i) {
+      p.assign(seg->path(i));
+      if (wanted.count(p)) liveAdded.insert(p);
+    }
+  }
+}
+
+std::vector<FileIndex::Hit> FileIndex::query(const std::string& q, size_t limit, size_t& total) {
+  TRACE_SCOPE("search.jump");
+  std::vector<Hit> out;
+  total = 0;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!matcher) return out;
+  // Ask for extra so tombstoned and duplicate paths can be dropped.
+  std::vector<FuzzyHit> hits = matcher->search(q, limit * 2, total);
+  std::unordered_set<std::string> seen;
+  std::string prefix = rootPath == "/" ? "/" : rootPath + "/";
+  for (const FuzzyHit& h : hits) {
+    if (out.size() >= limit) break;
+    std::string rel = matcher->path(h.index);
+    if (removed(rel, h.index) || !seen.insert(rel).second) continue;
+    out.push_back({prefix + rel, matcher->isDir(h.index)});
+  }
+  return out;
+}
+
+void FileIndex::noteEvent(const std::string& dir, const std::string& name, uint32_t mask) {
+  if (!running || name.empty()) return;
+  std::string rel;
+  if (!relative(dir, rel)) return;
+  rel = rel.empty() ? name : rel + "/" + name;
+  if (ignoredComponent(rel)) return;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!(mask & (IN_CREATE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM))) return;
+  if (pendingChanges.size() >= MAX_PENDING_CHANGES) {
+    crawledAt = 0;
+    return;
+  }
+  pendingChanges.push_back(
+      {rel, (mask & IN_ISDIR) != 0, (mask & (IN_DELETE | IN_MOVED_FROM)) != 0});
+  wake.notify();
+}
+
+void FileIndex::run() {
+  lowerThreadPriority();
+  watchBudget = inotifyAllowance();
+  bool loaded = load();
+  if (stopping) return;
+  if (!loaded || std::time(nullptr) - crawledAt > MAX_AGE_SECONDS) crawl();
+
+  inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  addWatches();
+  auto lastSave = std::chrono::steady_clock::now();
+
+  while (!stopping) {
+    // Sleep until an event, a forwarded change, the next save or the next
+    // recrawl, whichever comes first.
+    int waitMs;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto untilStale = std::chrono::seconds(std::max<std::time_t>(
+          0, crawledAt + MAX_AGE_SECONDS - std::time(nullptr) + 1));
+      auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(untilStale);
+      if (dirty) {
+        auto untilSave = std::chrono::duration_cast<std::chrono::milliseconds>(
+            lastSave + SAVE_INTERVAL - std::chrono::steady_clock::now());
+        wait = std::min(wait, std::max(untilSave, std::chrono::milliseconds(0)) +
+                                  std::chrono::milliseconds(1));
+      }
+      waitMs = static_cast<int>(std::min<long long>(wait.count(), 60 * 60 * 1000));
+    }
+    struct pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {wake.fd(), POLLIN, 0}};
+    int n = poll(fds, 2, waitMs);
+    wake.drain();
+    if (n > 0 && (fds[0].revents & POLLIN)) readEvents();
+    applyChanges();
+
+    bool stale, needSave;
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stale = std::time(nullptr) - crawledAt > MAX_AGE_SECONDS;
+      needSave = dirty && std::chrono::steady_clock::now() - lastSave > SAVE_INTERVAL;
+    }
+    if (stale) {
+      crawl();
+      addWatches();
+    }
+    if (needSave) {
+      save();
+      lastSave = std::chrono::steady_clock::now();
+    }
+  }
+
+  if (inotifyFd >= 0) close(inotifyFd);
+  inotifyFd = -1;
+  watches.clear();
+  bool needSave;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    needSave = dirty;
+  }
+  if (needSave) save();
+}
+
+// A fresh crawl replaces the index once it completes; until then queries
+// keep using the loaded one, or see the crawl's progress if there was none.
+void FileIndex::crawl() {
+  auto fresh = std::make_shared<PathIndex>(rootPath);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (!index) {
+      index = fresh;
+      matcher = std::make_unique<FuzzyMatcher>(fresh);
+    }
+  }
+  fresh->build([this]() { return stopping.load(); });
+  if (!fresh->complete()) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (index != fresh) {
+      index = fresh;
+      matcher = std::make_unique<FuzzyMatcher>(fresh);
+    }
+    tombstones.clear();
+    liveAdded.clear();
+    // Changes seen while crawling may already be in the fresh index.
+    seedLiveAdded(*fresh);
+    crawledAt = std::time(nullptr);
+    dirty = true;
+  }
+  save();
+}
+
+void FileIndex::applyChanges() {
+  std::vector<Change> changes;
+  std::shared_ptr<PathIndex> idx;
+  auto seg = std::make_unique<PathIndex::Segment>();
+  std::vector<std::string> newDirs;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    changes.swap(pendingChanges);
+    idx = index;
+    if (!idx || changes.empty()) return;
+    dirty = true;
+    // Entries added here are numbered from the index's current size on.
+    uint32_t next = idx->size();
+    for (Change& c : changes) {
+      if (c.gone) {
+        // Hides every entry so far for the path and, for a directory, all
+        // below it; whatever comes back is added as new entries.
+        liveAdded.erase(c.rel);
+        liveAdded.erase(liveAdded.lower_bound(c.rel + '/'), liveAdded.lower_bound(c.rel + '0'));
+        tombstones[c.rel] = next + static_cast<uint32_t>(seg->size());
+        continue;
+      }
+      if (!liveAdded.insert(c.rel).second) continue;
+      seg->add(c.rel, c.isDir);
+      if (c.isDir) newDirs.push_back(c.rel);
+    }
+  }
+  idx->append(std::move(seg));
+  // Directories moved in arrive with their contents. Paths already added
+  // (created events that raced the walk) are skipped, and the walked ones
+  // are marked so later events for them are too.
+  auto known = [this](const std::string& rel) {
+    std::lock_guard<std::mutex> lock(mutex);
+    return !liveAdded.insert(rel).second;
+  };
+  for (const std::string& rel : newDirs) {
+    if (stopping) break;
+    idx->addSubtree(rel, [this]() { return stopping.load(); }, known);
+    addWatch(rel);
+  }
+}
+
+void FileIndex::addWatches() {
+  if (inotifyFd < 0) return;
+  std::shared_ptr<PathIndex> idx;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    idx = index;
+  }
+  if (!idx) return;
+  addWatch("");
+  // Shallowest directories first; they see the most activity per watch.
+  PathIndex::Snapshot snap = idx->snapshot();
+  std::vector<std::pair<uint32_t, std::string_view>> dirs;
+  for (const auto& seg : snap.segments) {
+    for (size_t i = 0; i < seg->size(); ++i) {
+      if (!seg->dirs[i]) continue;
+      std::string_view p = seg->path(i);
+      dirs.emplace_back(static_cast<uint32_t>(std::count(p.begin(), p.end(), '/')), p);
+    }
+  }
+  size_t want = std::min(dirs.size(), watchBudget);
+  std::partial_sort(dirs.begin(), dirs.begin() + want, dirs.end(),
+                    [](const auto& a, const auto& b) { return a.first < b.first; });
+  for (size_t i = 0; i < want && watches.size() < watchBudget && !stopping; ++i) {
+    addWatch(std::string(dirs[i].second));
+  }
+}
+
+void FileIndex::addWatch(const std::string& rel) {
+  if (inotifyFd < 0 || watches.size() >= watchBudget) return;
+  std::string full = rel.empty() ? rootPath : (rootPath == "/" ? "/" : rootPath + "/") + rel;
+  int wd = inotify_add_watch(inotifyFd, full.c_str(), WATCH_MASK);
+  if (wd >= 0) watches[wd] = rel;
+}
+
+void FileIndex::readEvents() {
+  char buffer[16384] __attribute__((aligned(__alignof__(struct inotify_event))));
+  while (true) {
+    ssize_t len = read(inotifyFd, buffer, sizeof(buffer));
+    if (len <= 0) return;
+    const struct inotify_event* event;
+    for (char* ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + event->len) {
+      event = reinterpret_cast<const struct inotify_event*>(ptr);
+      if (event->mask & IN_Q_OVERFLOW) {
+        std::lock_guard<std::mutex> lock(mutex);
+        crawledAt = 0;
+        continue;
+      }
+      auto it = watches.find(event->wd);
+      if (it == watches.end()) continue;
+      if (event->mask & (IN_IGNORED | IN_MOVE_SELF)) {
+        // A moved directory's watch would report under its old path.
+        if (event->mask & IN_MOVE_SELF) inotify_rm_watch(inotifyFd, event->wd);
+        watches.erase(it);
+        continue;
+      }
+      if (event->len == 0) continue;
+      std::string dir = it->second.empty()
+                            ? rootPath
+                            : (rootPath == "/" ? "/" : rootPath + "/") + it->second;
+      noteEvent(dir, event->name, event->mask);
+    }
+  }
+}
+
+// Layout: Header, root path, then per path (sorted) a varint count of bytes
+// shared with the previous path, a varint (suffix length << 1 | isDir) and
+// the suffix.
+bool FileIndex::save() {
+  std::shared_ptr<PathIndex> idx;
+  std::map<std::string, uint32_t> dead;
+  std::time_t stamp;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    idx = index;
+    dead = tombstones;
+    stamp = crawledAt;
+    dirty = false;
+  }
+  if (!idx || filePath.empty()) return false;
+
+  PathIndex::Snapshot snap = idx->snapshot();
+  std::vector<std::pair<std::string_view, bool>> paths;
+  paths.reserve(snap.total);
+  auto isDead = [&dead](std::string_view p, uint32_t entry) {
+    if (dead.empty()) return false;
+    for (size_t slash = p.find('/');; slash = p.find('/', slash + 1)) {
+      auto it = dead.find(std::string(p.substr(0, slash)));
+      if (it != dead.end() && entry < it->second) return true;
+      if (slash == std::string_view::npos) return false;
+    }
+  };
+  for (size_t s = 0; s < snap.segments.size(); ++s) {
+    const auto& seg = snap.segments[s];
+    for (size_t i = 0; i < seg->size(); ++i) {
+      std::string_view p = seg->path(i);
+      if (!isDead(p, snap.starts[s] + static_cast<uint32_t>(i)))
+        paths.emplace_back(p, seg->dirs[i] != 0);
+    }
+  }
+  std::sort(paths.begin(), paths.end());
+  paths.erase(std::unique(paths.begin(), paths.end(),
+                          [](const auto& a, const auto& b) { return a.first == b.first; }),
+              paths.end());
+
+  std::string data;
+  data.reserve(paths.size() * 16);
+  std::string_view prev;
+  for (const auto& [p, isDir] : paths) {
+    size_t shared = 0;
+    size_t limit = std::min(prev.size(), p.size());
+    while (shared < limit && prev[shared] == p[shared]) ++shared;
+    putVarint(data, shared);
+    putVarint(data, (static_cast<uint64_t>(p.size() - shared) << 1) | (isDir ? 1 : 0));
+    data.append(p.data() + shared, p.size() - shared);
+    prev = p;
+  }
+
+  Header h{};
+  std::memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  h.version = INDEX_VERSION;
+  h.rootLen = static_cast<uint32_t>(rootPath.size());
+  h.crawledAt = stamp;
+  h.count = paths.size();
+  h.dataSize = data.size();
+
+  std::string tmp = filePath + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (!f) return false;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+            fwrite(rootPath.data(), 1, rootPath.size(), f) == rootPath.size() &&
+            fwrite(data.data(), 1, data.size(), f) == data.size();
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp.c_str(), filePath.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+
+  // Drop the dead entries from memory too, so sizes and match counts are
+  // exact again; the compacted index is what load() would read back.
+  if (paths.size() == snap.total || stopping) return true;
+  auto compacted = std::make_shared<PathIndex>(rootPath);
+  auto seg = std::make_unique<PathIndex::Segment>();
+  for (const auto& [p, isDir] : paths) {
+    seg->add(p, isDir);
+    if (seg->size() >= LOAD_SEGMENT_PATHS) {
+      compacted->append(std::move(seg));
+      seg = std::make_unique<PathIndex::Segment>();
+    }
+  }
+  compacted->append(std::move(seg));
+  compacted->markComplete();
+  std::lock_guard<std::mutex> lock(mutex);
+  // Only this thread changes the index, but a crawl may have replaced it.
+  if (index == idx && tombstones.size() == dead.size()) {
+    index = compacted;
+    matcher = std::make_unique<FuzzyMatcher>(compacted);
+    tombstones.clear();
+  }
+  return true;
+}
+
+bool FileIndex::load() {
+  int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+  size_t len = static_cast<size_t>(st.st_size);
+  void* m = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) return false;
+
+  const Header* h = static_cast<const Header*>(m);
+  const unsigned char* base = static_cast<const unsigned char*>(m) + sizeof(Header);
+  bool valid = std::memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0 &&
+               h->version == INDEX_VERSION && h->rootLen <= len - sizeof(Header) &&
+               h->dataSize == len - sizeof(Header) - h->rootLen &&
+               std::string_view(reinterpret_cast<const char*>(base), h->rootLen) == rootPath;
+  if (!valid) {
+    munmap(m, len);
+    return false;
+  }
+
+  auto loaded = std::make_shared<PathIndex>(rootPath);
+  const unsigned char* p = base + h->rootLen;
+  const unsigned char* end = p + h->dataSize;
+  std::string path;
+  auto seg = std::make_unique<PathIndex::Segment>();
+  bool ok = true;
+  for (uint64_t i = 0; i < h->count && ok; ++i) {
+    uint64_t shared, tail;
+    ok = getVarint(p, end, shared) && getVarint(p, end, tail) && shared <= path.size() &&
+         (tail >> 1) <= static_cast<uint64_t>(end - p);
+    if (!ok) break;
+    path.resize(shared);
+    path.append(reinterpret_cast<const char*>(p), tail >> 1);
+    p += tail >> 1;
+    seg->add(path, tail & 1);
+    if (seg->size() >= LOAD_SEGMENT_PATHS) {
+      loaded->append(std::move(seg));
+      seg = std::make_unique<PathIndex::Segment>();
+    }
+    if (stopping) ok = false;
+  }
+  std::time_t stamp = static_cast<std::time_t>(h->crawledAt);
+  ok = ok && p == end;
+  munmap(m, len);
+  if (!ok) return false;
+  loaded->append(std::move(seg));
+  loaded->markComplete();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  index = loaded;
+  matcher = std::make_unique<FuzzyMatcher>(loaded);
+  crawledAt = stamp;
+  seedLiveAdded(*loaded);
+  return true;
+}
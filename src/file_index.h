@@ -0,0 +1,103 @@
+#ifndef FILE_INDEX_H
+#define FILE_INDEX_H
+
+#include "fuzzy_finder.h"
+#include "wakeup.h"
+#include <atomic>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Persistent index of every path under one root, for jumping to a file from
+// anywhere. A low-priority background thread loads the index file (sorted,
+// front-coded paths) or crawls the tree when there is none or it is stale,
+// then keeps it current from inotify: it watches the shallowest directories
+// it can afford, and FileManager forwards the events of the directories it
+// watches itself through noteEvent(). Deleted paths are tombstoned until the
+// next save rewrites the file and compacts the in-memory index to match it.
+// A tombstone only hides the entries that existed when it was set, so a path
+// that comes back is added afresh while its old entries (and, for a
+// directory, its old children) stay hidden.
+//
+// Queries run the fuzzy matcher over the in-memory PathIndex, so they work
+// (on what has been loaded so far) while the index is still coming in.
+class FileIndex {
+public:
+  struct Hit {
+    std::string path; // absolute
+    bool isDir;
+  };
+
+  FileIndex() = default;
+  ~FileIndex();
+
+  FileIndex(const FileIndex&) = delete;
+  FileIndex& operator=(const FileIndex&) = delete;
+
+  // Starts the background thread for root, persisting to file.
+  void start(const std::string& root, const std::string& file);
+  // Stops the thread and saves what changed.
+  void stop();
+
+  bool enabled() const { return running; }
+  // True once the index has been fully loaded or crawled.
+  bool ready() const;
+  size_t size() const;
+  const std::string& root() const { return rootPath; }
+
+  // Best `limit` paths for query, best first; total receives the number of
+  // matching paths.
+  std::vector<Hit> query(const std::string& query, size_t limit, size_t& total);
+
+  // An inotify event for name in dir (absolute); ignored outside root.
+  void noteEvent(const std::string& dir, const std::string& name, uint32_t mask);
+
+private:
+  void run();
+  bool load();
+  bool save();
+  void crawl();
+  void addWatches();
+  void addWatch(const std::string& rel);
+  void readEvents();
+  void applyChanges();
+  bool removed(const std::string& rel, uint32_t entry) const;
+  void seedLiveAdded(const PathIndex& idx);
+  bool relative(const std::string& path, std::string& rel) const;
+
+  std::string rootPath;
+  std::string filePath;
+  std::thread worker;
+  std::atomic<bool> running{false};
+  std::atomic<bool> stopping{false};
+
+  mutable std::mutex mutex;
+  std::shared_ptr<PathIndex> index;
+  std::unique_ptr<FuzzyMatcher> matcher;
+  // Removed paths and directories, each with the index size when it was
+  // removed: entries numbered below that are dead.
+  std::map<std::string, uint32_t> tombstones;
+  std::set<std::string> liveAdded; // live paths added since load or crawl
+  struct Change {
+    std::string rel;
+    bool isDir;
+    bool gone;
+  };
+  std::vector<Change> pendingChanges; // in event order
+  std::time_t crawledAt = 0;
+  bool dirty = false;
+
+  Wakeup wake; // queued changes or stop()
+  int inotifyFd = -1;
+  std::unordered_map<int, std::string> watches; // wd -> relative directory
+  size_t watchBudget = 0;
+};
+
+#endif // FILE_INDEX_H
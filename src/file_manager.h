@@ -3,6 +3,26 @@
 
 #include "utils.h"
 #include "file_entry.h"
+#include "dir_loader.h"
+#include "size_engine.h"
+#include "size_index.h"
+#include "styled_text.h"
+#include "syntax_highlight.h"
+#include "text_reader.h"
+#include "copy_engine.h"
+#include "image_decode.h"
+#include "preview_cache.h"
+#include "preview_render.h"
+#include "archive_list.h"
+#include "content_search.h"
+#include "file_index.h"
+#include "listing_cache.h"
+#include "fuzzy_finder.h"
+#include "subprocess.h"
+#include "thumb_cache.h"
+#include "trace.h"
+#include "trash.h"
+#include "wakeup.h"
 #include "async_task.h"
 
 #include <algorithm>
@@ -10,6 +30,7 @@
 #include <atomic>
 #include <clocale>
 #include <cctype>
+#include <climits>
 #include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
@@ -22,6 +43,7 @@
 #include <mutex>
 #include <ncurses.h>
 #include <map>
+#include <queue>
 #include <set>
 #include <sstream>
 #include <string>
@@ -35,6 +57,7 @@
 #include <sys/ioctl.h>
 #include <unistd.h>
 #include <sys/stat.h>
+#include <fcntl.h>
 #include <pwd.h>
 #include <grp.h>
 #include <sys/inotify.h>
@@ -52,6 +75,14 @@ struct SizeResult {
   int viewId;
 };
 
+// One inotify event on a watched directory; name is empty for events on the
+// directory itself.
+struct FsEvent {
+  fs::path dir;
+  std::string name;
+  uint32_t mask;
+};
+
 class FileManager {
 private:
   struct Tab {
@@ -61,7 +92,7 @@ private:
     bool isSearching = false;
     bool isTrashMode = false;
     std::set<fs::path> multiSelection;
-    std::vector<FileEntry> currentFiles;
+    FileListing currentFiles;
     std::vector<fs::path> backHistory;
     std::vector<fs::path> forwardHistory;
   };
@@ -82,8 +113,8 @@ private:
   // Background worker threads (e.g. size/preview workers) must NEVER access these fields
   // directly. They must instead receive deep copies of paths inside their job structs.
   fs::path currentPath;
-  std::vector<FileEntry> currentFiles;
-  std::vector<FileEntry> parentFiles;
+  FileListing currentFiles;
+  FileListing parentFiles;
   std::set<fs::path> multiSelection;
   std::vector<fs::path> pinnedPaths;
   size_t pinnedIndex = 0;
@@ -95,33 +126,118 @@ private:
   WINDOW *winPinned, *winParent, *winCurrent, *winPreview;
   int width, height;
 
+  // Damage tracking. The list windows keep their cells between frames and
+  // remember what their frame and each visible row were drawn from, so a
+  // redraw only formats the rows whose inputs changed: a cursor move repaints
+  // two rows, an async size result one. ncurses then only sends the cells
+  // that differ. updateLayout() and invalidateDrawCache() start over.
+  enum RowMark : uint16_t {
+    ROW_DIR = 1 << 0,
+    ROW_SYMLINK = 1 << 1,
+    ROW_EMPTY_DIR = 1 << 2,
+    ROW_SELECTED = 1 << 3,
+    ROW_MULTI = 1 << 4,
+    ROW_CLIPBOARD = 1 << 5,
+    ROW_CUT = 1 << 6,
+    ROW_STALE = 1 << 15, // never drawn from, forces a repaint
+  };
+  struct RowKey {
+    std::string name; // empty for a blank row
+    std::string symlinkTarget;
+    uintmax_t size = 0;
+    int64_t mtime = 0;
+    uint16_t marks = 0;
+    bool operator==(const RowKey& o) const {
+      return size == o.size && mtime == o.mtime && marks == o.marks && name == o.name &&
+             symlinkTarget == o.symlinkTarget;
+    }
+    bool operator!=(const RowKey& o) const { return !(*this == o); }
+  };
+  struct FrameKey {
+    std::string path;
+    size_t marked = 0;
+    int rows = 0, cols = 0;
+    SortMode sort = SortMode::NAME;
+    uint8_t flags = 0; // FRAME_* bits
+    bool operator==(const FrameKey& o) const {
+      return rows == o.rows && cols == o.cols && marked == o.marked && sort == o.sort &&
+             flags == o.flags && path == o.path;
+    }
+    bool operator!=(const FrameKey& o) const { return !(*this == o); }
+  };
+  enum FrameFlag : uint8_t {
+    FRAME_FOCUS = 1 << 0,
+    FRAME_SEARCHING = 1 << 1,
+    FRAME_TRASH = 1 << 2,
+    FRAME_EMPTY = 1 << 3,
+  };
+  struct PaneCache {
+    bool valid = false;
+    FrameKey frame;
+    std::vector<RowKey> rows; // one per line inside the border
+  };
+  std::unordered_map<WINDOW*, PaneCache> paneCaches;
+  // The single-pane preview is redrawn as a whole, when the selected entry or
+  // the preview generated for it changes.
+  struct PreviewKey {
+    std::string path;
+    uintmax_t size = 0;
+    int64_t mtime = 0;
+    uintmax_t dirSize = 0;
+    int rows = 0, cols = 0;
+    uint8_t flags = 0; // PREVIEW_* bits
+    bool operator==(const PreviewKey& o) const {
+      return size == o.size && mtime == o.mtime && dirSize == o.dirSize && rows == o.rows &&
+             cols == o.cols && flags == o.flags && path == o.path;
+    }
+  };
+  enum PreviewFlag : uint8_t {
+    PREVIEW_READY = 1 << 0,
+    PREVIEW_DIR_SIZE = 1 << 1,
+    PREVIEW_TRASH = 1 << 2,
+    PREVIEW_HIDDEN = 1 << 3,
+    PREVIEW_PARTIAL = 1 << 4, // a directory preview still being read
+  };
+  PreviewKey drawnPreview;
+  bool previewDrawn = false;
+
   Clipboard clipboard;
   std::string statusMessage;
   std::chrono::steady_clock::time_point statusTime;
+  static constexpr long STATUS_TOAST_MS = 1800;
   bool showHidden = false;
   SortMode sortMode = SortMode::NAME;
   bool isSearching = false;
   bool isTrashMode = false;
   fs::path preTrashPath;
+  Trash trash;
   std::vector<fs::path> lastTrashedFiles;
 
   // Async Preview State
   std::mutex previewMutex;
   std::atomic<bool> imageReady{false};
+  // Signalled by every worker that publishes something for run() to pick up;
+  // run() and the overlays sleep in poll() on it and the terminal.
+  Wakeup uiWakeup;
   std::string cachedBase64;
+  std::string cachedImageKey;
   int cachedImgW = 0, cachedImgH = 0;
-  std::vector<std::string> cachedTextLines;
+  std::shared_ptr<const StyledText> cachedText;
+  std::shared_ptr<const FileListing> cachedListing;
+  bool cachedListingPartial = false;
   PreviewType pendingDirectRenderType = PreviewType::NONE;
-  struct ImageCacheEntry {
-    std::string b64;
-    int w, h;
-  };
-  std::unordered_map<std::string, ImageCacheEntry> sessionImageCache;
-  std::vector<std::string> sessionImageCacheKeys;
+  // Generated previews by path, mtime, size and box; guarded by previewMutex.
+  PreviewCache previewCache{static_cast<size_t>(configPreviewCacheMB) * 1024 * 1024};
   std::string cachedPath;
   std::string requestedPath;
-  long long requestID = 0;
+  std::atomic<long long> requestID{0};
   bool lastWasDirectRender = false;
+  // Images uploaded to the terminal this session, by preview cache key, so
+  // a redraw only sends a placement. Oldest first in kittyUploadOrder.
+  std::unordered_map<std::string, uint32_t> kittyImageIds;
+  std::deque<std::string> kittyUploadOrder;
+  uint32_t nextKittyImageId = 0;
+  static constexpr size_t KITTY_MAX_IMAGES = 32;
 
   struct PreviewJob {
     std::string path;
@@ -129,26 +245,70 @@ private:
     int previewHeight;
     int previewWidth;
     long long reqId;
+    // 0 for the entry under the cursor, otherwise the prefetch distance.
+    int priority;
+    unsigned seq;
+    std::string cacheKey;
+    bool showHidden = false; // DIRECTORY jobs
+  };
+  // Lowest priority first; FIFO among equals.
+  struct PreviewJobLater {
+    bool operator()(const PreviewJob& a, const PreviewJob& b) const {
+      return a.priority != b.priority ? a.priority > b.priority : a.seq > b.seq;
+    }
   };
-  std::unique_ptr<PreviewJob> nextPreviewJob;
+  std::priority_queue<PreviewJob, std::vector<PreviewJob>, PreviewJobLater> previewQueue;
+  unsigned previewSeq = 0;
+  std::atomic<unsigned> previewTempSeq{0};
+  ThumbCacheGC thumbCacheGC;
   std::condition_variable previewCv;
-  std::thread previewWorker;
+  std::vector<std::thread> previewWorkers;
 
   std::thread searchThread;
-  FILE* searchPipe = nullptr;
   std::mutex searchMutex;
   long long searchRequestID = 0;
   std::atomic<bool> searchReady{false};
 
-  std::vector<FileEntry> pendingSearchResults;
+  FileListing pendingSearchResults;
   std::string pendingSearchStatus;
   bool hasPendingSearchResults = false;
+  bool pendingSearchRanked = false; // keep the result order instead of sorting
   std::mutex searchResultMutex;
 
+  // Path index behind the fuzzy finder, kept for reuse in the same directory.
+  static constexpr auto FUZZY_INDEX_TTL = std::chrono::minutes(2);
+  static constexpr size_t FUZZY_MAX_RESULTS = 200;
+  std::shared_ptr<PathIndex> fuzzyIndex;
+  std::thread fuzzyIndexThread;
+  std::atomic<bool> fuzzyIndexCancel{false};
+
+  // Streaming Directory Listing State
+  std::thread listingThread;
+  std::atomic<long long> listingRequestID{0};
+  std::mutex listingMutex;
+  FileListing pendingListingChunk;
+  bool hasPendingListingChunk = false;
+  bool pendingListingDone = false;
+  bool isStreamingListing = false;
+  size_t listingSortedPrefix = 0;
+  fs::path pendingCursorPath;
+  // Directory being streamed and its mtime before the read, for listingCache.
+  fs::path streamingPath;
+  int64_t streamingMtime = FileListing::MTIME_UNKNOWN;
+
+  // Listings shared by the panes, tabs and directory previews.
+  static constexpr size_t LISTING_CACHE_ENTRIES = 48;
+  static constexpr auto LISTING_CACHE_MAX_AGE = std::chrono::seconds(30);
+  ListingCache listingCache{LISTING_CACHE_ENTRIES, LISTING_CACHE_MAX_AGE};
+
   // Async Size Calculation State
   std::unordered_map<std::string, uintmax_t> dirSizeCache;
   std::mutex cacheMutex;
   std::thread sizeWorker;
+  SizeIndex sizeIndex;
+  FileIndex fileIndex;
+  static constexpr size_t FILE_JUMP_MAX_RESULTS = 500;
+  std::unique_ptr<SizeEngine> sizeEngine;
   std::atomic<bool> stopWorker{false};
   std::atomic<int> currentViewId{0};
   std::deque<SizeJob> sizeQueue;
@@ -163,8 +323,11 @@ private:
   std::mutex inotifyMutex;
   std::thread inotifyThread;
   std::atomic<bool> stopInotify{false};
+  Wakeup inotifyStop;
   std::atomic<bool> inotifyTriggered{false};
   std::atomic<bool> devicesTriggered{false};
+  std::vector<FsEvent> pendingFsEvents;
+  bool fsEventsOverflowed = false;
 
   // Async Background Tasks State
   std::vector<std::shared_ptr<AsyncTask>> activeTasks;
@@ -172,18 +335,45 @@ private:
   std::mutex taskMutex;
   int nextTaskId = 1;
 
-  uint64_t getDirectorySize(const fs::path& dir) {
-    uint64_t size = 0;
+  // Adds the size of every regular file under dir to task.totalBytes as it
+  // goes, so a running copy's total converges instead of waiting for a
+  // separate full walk.
+  void measureTree(const fs::path& dir, AsyncTask& task, const std::atomic<bool>& stop) {
+    uint64_t pending = 0;
+    size_t seen = 0;
     try {
       for (const auto& entry : fs::recursive_directory_iterator(dir, fs::directory_options::skip_permission_denied)) {
-        if (fs::is_regular_file(entry.status())) {
-          size += fs::file_size(entry);
+        if (stop)
+          break;
+        std::error_code ec;
+        if (entry.is_regular_file(ec)) {
+          uintmax_t size = entry.file_size(ec);
+          if (!ec)
+            pending += size;
+        }
+        if (++seen % 256 == 0) {
+          task.totalBytes += pending;
+          pending = 0;
         }
       }
     } catch (...) {}
-    return size;
+    task.totalBytes += pending;
+  }
+
+  // Size of dir if the session cache or the persistent index knows it.
+  bool knownDirectorySize(const fs::path& dir, uintmax_t& size) {
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      auto it = dirSizeCache.find(dir.string());
+      if (it != dirSizeCache.end()) {
+        size = it->second;
+        return true;
+      }
+    }
+    return sizeIndex.estimate(dir, size);
   }
 
+
   void changeDirectory(const fs::path& target, bool recordHistory = true) {
     if (currentPath == target) return;
     if (recordHistory) {
@@ -266,7 +456,6 @@ private:
     WINDOW* histWin = newwin(h, w, startY, startX);
     if (!histWin) return;
     keypad(histWin, TRUE);
-    wtimeout(histWin, 200);
 
     size_t selectedHistoryIndex = 0;
 
@@ -316,7 +505,7 @@ private:
 
       wrefresh(histWin);
 
-      int ch = wgetch(histWin);
+      int ch = waitKey(histWin, -1);
       if (ch == ERR) continue;
       if (ch == 'q' || ch == 27) {
         break;
@@ -351,7 +540,7 @@ private:
   void drawPermissionsOverlay() {
     clearDirectRender();
     if (currentFiles.empty() || selectedIndex >= currentFiles.size()) return;
-    fs::path filePath = currentFiles[selectedIndex].path;
+    fs::path filePath = currentFiles[selectedIndex].path();
 
     fs::perms perms;
     try {
@@ -397,7 +586,6 @@ private:
     WINDOW* permWin = newwin(h, w, startY, startX);
     if (!permWin) return;
     keypad(permWin, TRUE);
-    wtimeout(permWin, 200);
 
     int activeRow = 0; 
     int activeCol = 0; 
@@ -481,7 +669,7 @@ private:
 
       wrefresh(permWin);
 
-      int ch = wgetch(permWin);
+      int ch = waitKey(permWin, -1);
       if (ch == ERR) continue;
       if (ch == 'q' || ch == 27) {
         break;
@@ -606,15 +794,31 @@ private:
     return false;
   }
 
-  bool copyFileWithProgress(const fs::path& src, const fs::path& dest, std::shared_ptr<AsyncTask> task, uint64_t& bytesCopied, uint64_t totalBytes) {
+  // Adds n copied bytes to the task's shared counter and progress.
+  // Stays below 100% while the total is still being measured.
+  void addCopiedBytes(AsyncTask& task, std::atomic<uint64_t>& bytesCopied, uint64_t n) {
+    uint64_t done = (bytesCopied += n);
+    task.bytesProcessed = done;
+    uint64_t totalBytes = task.totalBytes;
+    int cap = task.totalBytesFinal ? 100 : 99;
+    if (totalBytes > 0) {
+      int prog = (int)((done * 100) / totalBytes);
+      task.progress = prog > cap ? cap : prog;
+    } else if (task.totalBytesFinal) {
+      task.progress = 100;
+    }
+  }
+
+  bool copyFileWithProgress(const fs::path& src, const fs::path& dest, std::shared_ptr<AsyncTask> task, std::atomic<uint64_t>& bytesCopied) {
+    TRACE_SCOPE("copyFileWithProgress");
     try {
       if (fs::is_symlink(fs::symlink_status(dest))) {
         fs::remove(dest);
       }
     } catch (...) {}
 
-    std::ifstream in(src, std::ios::binary);
-    if (!in) return false;
+    int inFd = open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (inFd < 0) return false;
 
     uintmax_t destSize = 0;
     bool appendMode = false;
@@ -623,12 +827,8 @@ private:
         destSize = fs::file_size(dest);
         uintmax_t srcSize = fs::file_size(src);
         if (destSize == srcSize) {
-          bytesCopied += srcSize;
-          task->bytesProcessed = bytesCopied;
-          if (totalBytes > 0) {
-            int prog = (int)((bytesCopied * 100) / totalBytes);
-            task->progress = prog > 100 ? 100 : prog;
-          }
+          close(inFd);
+          addCopiedBytes(*task, bytesCopied, srcSize);
           return true; // already copied completely!
         } else if (destSize < srcSize && destSize > 0) {
           appendMode = true;
@@ -636,64 +836,163 @@ private:
       }
     } catch (...) {}
 
-    std::ofstream out;
+    int outFd = -1;
     if (appendMode) {
-      in.seekg(destSize);
-      if (in.good()) {
-        out.open(dest, std::ios::binary | std::ios::in | std::ios::out);
-        if (out) {
-          out.seekp(destSize);
-          if (out.good()) {
-            bytesCopied += destSize;
-            task->bytesProcessed = bytesCopied;
-            if (totalBytes > 0) {
-              int prog = (int)((bytesCopied * 100) / totalBytes);
-              task->progress = prog > 100 ? 100 : prog;
-            }
-          } else {
-            out.close();
-            appendMode = false;
-          }
-        } else {
-          appendMode = false;
-        }
+      outFd = open(dest.c_str(), O_WRONLY | O_CLOEXEC);
+      if (outFd >= 0) {
+        addCopiedBytes(*task, bytesCopied, destSize);
       } else {
         appendMode = false;
       }
     }
 
     if (!appendMode) {
-      in.seekg(0);
-      out.close();
-      out.clear();
-      out.open(dest, std::ios::binary);
+      destSize = 0;
+      outFd = open(dest.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
     }
 
-    if (!out) return false;
+    if (outFd < 0) {
+      close(inFd);
+      return false;
+    }
 
-    char buffer[65536];
-    while (in.read(buffer, sizeof(buffer)) || in.gcount() > 0) {
+    // Reflink, copy_file_range or sendfile where the kernel can do it; each
+    // chunk reports back here for pause/cancel and progress.
+    bool ok = copyFileData(inFd, outFd, destSize, [&](uint64_t n) {
+      addCopiedBytes(*task, bytesCopied, n);
       task->checkPause();
-      if (task->isCancelled.load()) {
-        return false;
-      }
-      out.write(buffer, in.gcount());
-      if (out.fail()) {
-        return false;
-      }
-      bytesCopied += in.gcount();
-      task->bytesProcessed = bytesCopied;
-      if (totalBytes > 0) {
-        int prog = (int)((bytesCopied * 100) / totalBytes);
-        task->progress = prog > 100 ? 100 : prog;
-      } else {
-        task->progress = 100;
+      return !task->isCancelled.load();
+    });
+
+    if (close(outFd) != 0) ok = false;
+    close(inFd);
+    return ok;
+  }
+
+  // Files below SMALL_FILE_BYTES are grouped into batches of up to
+  // BATCH_MAX_FILES / BATCH_MAX_BYTES for the copy workers.
+  static constexpr uintmax_t SMALL_FILE_BYTES = 256 * 1024;
+  static constexpr size_t BATCH_MAX_FILES = 64;
+  static constexpr uintmax_t BATCH_MAX_BYTES = 4 * 1024 * 1024;
+
+  // Copies the tree under src into dest (which must exist). This thread
+  // enumerates and creates directories while a pool of workers copies the
+  // files; small files travel in batches so per-file latency overlaps. The
+  // pool size follows the slower of the two devices, and every batch holds a
+  // DeviceCopySlot so concurrent tasks share a hard disk politely. Sources
+  // copied successfully are appended to copied when it is non-null.
+  bool copyTreeParallel(const fs::path& src, const fs::path& dest,
+                        std::shared_ptr<AsyncTask> task, std::atomic<uint64_t>& bytesCopied,
+                        std::vector<fs::path>* copied) {
+    struct stat srcSt, destSt;
+    if (stat(src.c_str(), &srcSt) != 0 || stat(dest.c_str(), &destSt) != 0)
+      return false;
+    unsigned workerCount = configCopyWorkers;
+    if (workerCount == 0) {
+      workerCount = std::min(deviceCopyConcurrency(srcSt.st_dev),
+                             deviceCopyConcurrency(destSt.st_dev));
+    }
+    const size_t maxQueued = workerCount * 4;
+
+    using Batch = std::vector<std::pair<fs::path, fs::path>>;
+    std::mutex qMutex;
+    std::condition_variable notEmpty, notFull;
+    std::deque<Batch> queue;
+    bool enumerationDone = false;
+    std::atomic<bool> allOk{true};
+    std::mutex copiedMutex;
+
+    std::vector<std::thread> workers;
+    for (unsigned w = 0; w < workerCount; ++w) {
+      workers.emplace_back([&]() {
+        while (true) {
+          Batch batch;
+          {
+            std::unique_lock<std::mutex> lock(qMutex);
+            notEmpty.wait(lock, [&] { return !queue.empty() || enumerationDone; });
+            if (queue.empty())
+              return;
+            batch = std::move(queue.front());
+            queue.pop_front();
+          }
+          notFull.notify_one();
+
+          DeviceCopySlot slot(srcSt.st_dev, destSt.st_dev);
+          for (const auto& [from, to] : batch) {
+            task->checkPause();
+            if (task->isCancelled.load()) {
+              allOk = false;
+              break;
+            }
+            if (copyFileWithProgress(from, to, task, bytesCopied)) {
+              if (copied) {
+                std::lock_guard<std::mutex> lock(copiedMutex);
+                copied->push_back(from);
+              }
+            } else {
+              allOk = false;
+            }
+          }
+        }
+      });
+    }
+
+    auto enqueue = [&](Batch&& batch) {
+      std::unique_lock<std::mutex> lock(qMutex);
+      notFull.wait(lock, [&] { return queue.size() < maxQueued || task->isCancelled.load(); });
+      queue.push_back(std::move(batch));
+      lock.unlock();
+      notEmpty.notify_one();
+    };
+
+    // Paths are built by stripping src's prefix; fs::relative canonicalises
+    // both sides on every call.
+    const std::string& base = src.native();
+    size_t baseLen = base.size() + ((!base.empty() && base.back() == '/') ? 0 : 1);
+    Batch small;
+    uintmax_t smallBytes = 0;
+    try {
+      for (const auto& entry : fs::recursive_directory_iterator(src, fs::directory_options::skip_permission_denied)) {
+        task->checkPause();
+        if (task->isCancelled.load()) {
+          allOk = false;
+          break;
+        }
+        fs::path d = dest / entry.path().native().substr(baseLen);
+        std::error_code ec;
+        if (entry.is_directory(ec)) {
+          fs::create_directories(d, ec);
+          if (ec)
+            allOk = false;
+        } else if (entry.is_regular_file(ec)) {
+          uintmax_t size = entry.file_size(ec);
+          if (ec || size >= SMALL_FILE_BYTES) {
+            enqueue(Batch{{entry.path(), d}});
+            continue;
+          }
+          small.emplace_back(entry.path(), d);
+          smallBytes += size;
+          if (small.size() >= BATCH_MAX_FILES || smallBytes >= BATCH_MAX_BYTES) {
+            enqueue(std::move(small));
+            small.clear();
+            smallBytes = 0;
+          }
+        }
       }
+    } catch (...) {
+      allOk = false;
     }
-    if (in.bad() || (in.fail() && !in.eof())) {
-      return false;
+    if (!small.empty())
+      enqueue(std::move(small));
+
+    {
+      std::lock_guard<std::mutex> lock(qMutex);
+      enumerationDone = true;
     }
-    return true;
+    notEmpty.notify_all();
+    for (auto& t : workers)
+      t.join();
+    return allOk;
   }
 
   void startPasteTask(const std::vector<std::pair<fs::path, fs::path>>& jobs, bool isCut) {
@@ -716,23 +1015,61 @@ private:
       auto task = weakTask.lock();
       if (!task) return;
 
-      uint64_t totalBytes = 0;
+      int successCount = 0;
+      int failCount = 0;
+
+      // A move within one filesystem is a single rename. Only what is left
+      // (other devices, existing destinations) goes through the copy path.
+      std::vector<std::pair<fs::path, fs::path>> copyJobs;
       for (const auto& job : jobs) {
+        if (isCut && renameNoReplace(job.first.c_str(), job.second.c_str()) == RenameResult::MOVED) {
+          successCount++;
+          continue;
+        }
+        copyJobs.push_back(job);
+      }
+      if (copyJobs.empty()) {
+        task->bytesProcessed = 0;
+        task->progress = 100;
+      }
+
+      // Sizes the session cache or the size index already know count at
+      // once; other trees are measured next to the copy, refining the total
+      // while data is already moving.
+      uint64_t knownBytes = 0;
+      std::vector<fs::path> unmeasured;
+      for (const auto& job : copyJobs) {
         try {
+          uintmax_t size = 0;
           if (fs::is_directory(job.first)) {
-            totalBytes += getDirectorySize(job.first);
+            if (knownDirectorySize(job.first, size))
+              knownBytes += size;
+            else
+              unmeasured.push_back(job.first);
           } else if (fs::is_regular_file(job.first)) {
-            totalBytes += fs::file_size(job.first);
+            knownBytes += fs::file_size(job.first);
           }
         } catch (...) {}
       }
-      task->totalBytes = totalBytes;
+      task->totalBytes = knownBytes;
+      task->totalBytesFinal = unmeasured.empty();
 
-      uint64_t bytesCopied = 0;
-      int successCount = 0;
-      int failCount = 0;
+      std::atomic<bool> stopMeasuring{false};
+      std::thread measurer;
+      if (!unmeasured.empty()) {
+        measurer = std::thread([this, task, unmeasured, &stopMeasuring]() {
+          for (const auto& dir : unmeasured) {
+            if (stopMeasuring)
+              break;
+            measureTree(dir, *task, stopMeasuring);
+          }
+          task->totalBytesFinal = true;
+        });
+      }
 
-      for (const auto& job : jobs) {
+      std::atomic<uint64_t> bytesCopied{0};
+
+      for (const auto& job : copyJobs) {
         task->checkPause();
         if (task->isCancelled.load()) {
           failCount = jobs.size() - successCount;
@@ -744,31 +1081,9 @@ private:
         try {
           if (fs::is_directory(src)) {
             fs::create_directories(dest);
-            bool dirCopiedFully = true;
             std::vector<fs::path> filesToKeep;
-            try {
-              for (const auto& entry : fs::recursive_directory_iterator(src, fs::directory_options::skip_permission_denied)) {
-                task->checkPause();
-                if (task->isCancelled.load()) {
-                  dirCopiedFully = false;
-                  break;
-                }
-                fs::path rel = fs::relative(entry.path(), src);
-                fs::path d = dest / rel;
-                if (fs::is_directory(entry.status())) {
-                  fs::create_directories(d);
-                } else if (fs::is_regular_file(entry.status())) {
-                  bool ok = copyFileWithProgress(entry.path(), d, task, bytesCopied, totalBytes);
-                  if (ok) {
-                    if (isCut) filesToKeep.push_back(entry.path());
-                  } else {
-                    dirCopiedFully = false;
-                  }
-                }
-              }
-            } catch (...) {
-              dirCopiedFully = false;
-            }
+            bool dirCopiedFully =
+                copyTreeParallel(src, dest, task, bytesCopied, isCut ? &filesToKeep : nullptr);
             if (isCut) {
               if (dirCopiedFully) {
                 fs::remove_all(src);
@@ -784,7 +1099,7 @@ private:
               }
             }
           } else {
-            bool ok = copyFileWithProgress(src, dest, task, bytesCopied, totalBytes);
+            bool ok = copyFileWithProgress(src, dest, task, bytesCopied);
             if (ok) {
               if (isCut) {
                 try { fs::remove(src); } catch(...) {}
@@ -802,6 +1117,10 @@ private:
         }
       }
 
+      stopMeasuring = true;
+      if (measurer.joinable())
+        measurer.join();
+
       task->progress = 100;
       if (task->isCancelled.load()) {
         task->statusMessage = "Cancelled";
@@ -816,6 +1135,7 @@ private:
         taskHistoryLogs.push_back(logMsg);
       }
       task->isFinished = true;
+      uiWakeup.notify();
     });
   }
 
@@ -864,6 +1184,7 @@ private:
         taskHistoryLogs.push_back(logMsg);
       }
       task->isFinished = true;
+      uiWakeup.notify();
     });
   }
 
@@ -887,29 +1208,18 @@ private:
       auto task = weakTask.lock();
       if (!task) return;
 
-      int totalItems = targets.size();
-      int processed = 0;
-      int successCount = 0;
+      size_t totalItems = targets.size();
       std::vector<fs::path> failedTargets;
       std::vector<fs::path> trashedFilesTemp;
-
-      for (const auto& p : targets) {
-        task->checkPause();
-        if (task->isCancelled.load()) break;
-
-        if (moveToTrash(p)) {
-          successCount++;
-          fs::path trashed = findTrashedFile(p);
-          if (!trashed.empty()) {
-            trashedFilesTemp.push_back(trashed);
-          }
-        } else {
-          failedTargets.push_back(p);
-        }
-
-        processed++;
-        task->progress = (processed * 100) / totalItems;
+      task->checkPause();
+      if (!task->isCancelled.load()) {
+        trash.trash(targets, trashedFilesTemp, failedTargets, [&](size_t done) {
+          task->progress = static_cast<int>(done * 100 / totalItems);
+          task->checkPause();
+          return !task->isCancelled.load();
+        });
       }
+      size_t successCount = trashedFilesTemp.size();
 
       {
         std::lock_guard<std::mutex> lock(taskMutex);
@@ -930,6 +1240,7 @@ private:
         taskHistoryLogs.push_back(logMsg);
       }
       task->isFinished = true;
+      uiWakeup.notify();
     });
   }
 
@@ -972,6 +1283,7 @@ private:
         taskHistoryLogs.push_back(logMsg);
       }
       task->isFinished = true;
+      uiWakeup.notify();
     });
   }
 
@@ -1014,6 +1326,7 @@ private:
         taskHistoryLogs.push_back(logMsg);
       }
       task->isFinished = true;
+      uiWakeup.notify();
     });
   }
 
@@ -1111,189 +1424,67 @@ private:
     ::initColors();
   }
 
+  // Pairs for the colours of ANSI previews, created on first use. Indexed
+  // by (fg + 1) * 257 + (bg + 1) so a lookup is one load; -1 = not yet made.
   int get_or_create_color_pair(short fg, short bg) {
-    static std::map<std::pair<short, short>, int> pairCache;
+    static std::vector<short> pairTable(257 * 257, -1);
     static int nextPairId = 110;
 
-    auto key = std::make_pair(fg, bg);
-    auto it = pairCache.find(key);
-    if (it != pairCache.end()) {
-      return it->second;
+    if (fg < -1 || fg > 255 || bg < -1 || bg > 255) return 0;
+    short& slot = pairTable[(fg + 1) * 257 + (bg + 1)];
+    if (slot >= 0) {
+      return slot;
     }
-    if (nextPairId < COLOR_PAIRS) {
+    if (nextPairId < COLOR_PAIRS && nextPairId <= SHRT_MAX) {
       init_pair(nextPairId, fg, bg);
-      pairCache[key] = nextPairId;
+      slot = static_cast<short>(nextPairId);
       return nextPairId++;
     }
     return 0;
   }
 
-  void wprintw_ansi(WINDOW* win, int y, int x, const std::string& line, int maxW) {
+  // Draws line of text at (y, x), clipped and padded to maxW columns.
+  void drawStyledLine(WINDOW* win, int y, int x, const StyledText& text, size_t line, int maxW) {
+    static const attr_t styleAttrs[16] = {
+        A_NORMAL,
+        A_BOLD,
+        A_DIM,
+        A_BOLD | A_DIM,
+        A_ITALIC,
+        A_ITALIC | A_BOLD,
+        A_ITALIC | A_DIM,
+        A_ITALIC | A_BOLD | A_DIM,
+        A_UNDERLINE,
+        A_UNDERLINE | A_BOLD,
+        A_UNDERLINE | A_DIM,
+        A_UNDERLINE | A_BOLD | A_DIM,
+        A_UNDERLINE | A_ITALIC,
+        A_UNDERLINE | A_ITALIC | A_BOLD,
+        A_UNDERLINE | A_ITALIC | A_DIM,
+        A_UNDERLINE | A_ITALIC | A_BOLD | A_DIM,
+    };
     wmove(win, y, x);
-    int startX = x;
-
-    attr_t currentAttrs = A_NORMAL;
-    short fg = -1;
-    short bg = -1;
-
-    size_t i = 0;
-    while (i < line.size()) {
-      int cy, cx;
-      getyx(win, cy, cx);
-      if (cx >= startX + maxW) {
-        break;
-      }
-
-      if (line[i] == '\033' && i + 1 < line.size() && line[i + 1] == '[') {
-        i += 2;
-        std::string seq;
-        while (i < line.size() && !isalpha(line[i])) {
-          seq += line[i];
-          i++;
-        }
-        if (i >= line.size()) break;
-        char cmd = line[i];
-        i++;
-
-        if (cmd == 'm') {
-          std::vector<int> params;
-          int val = 0;
-          bool hasVal = false;
-          for (char c : seq) {
-            if (c == ';') {
-              params.push_back(hasVal ? val : 0);
-              val = 0;
-              hasVal = false;
-            } else if (c >= '0' && c <= '9') {
-              val = val * 10 + (c - '0');
-              hasVal = true;
-            }
-          }
-          if (hasVal) {
-            params.push_back(val);
-          }
-          if (params.empty()) {
-            params.push_back(0);
-          }
-
-          for (size_t p = 0; p < params.size(); ++p) {
-            int valParam = params[p];
-            if (valParam == 0) {
-              currentAttrs = A_NORMAL;
-              fg = -1;
-              bg = -1;
-            } else if (valParam == 1) {
-              currentAttrs |= A_BOLD;
-            } else if (valParam == 2) {
-              currentAttrs |= A_DIM;
-            } else if (valParam == 3) {
-              currentAttrs |= A_ITALIC;
-            } else if (valParam == 4) {
-              currentAttrs |= A_UNDERLINE;
-            } else if (valParam == 22) {
-              currentAttrs &= ~A_BOLD;
-              currentAttrs &= ~A_DIM;
-            } else if (valParam == 23) {
-              currentAttrs &= ~A_ITALIC;
-            } else if (valParam == 24) {
-              currentAttrs &= ~A_UNDERLINE;
-            } else if (valParam >= 30 && valParam <= 37) {
-              fg = valParam - 30;
-            } else if (valParam == 39) {
-              fg = -1;
-            } else if (valParam >= 40 && valParam <= 47) {
-              bg = valParam - 40;
-            } else if (valParam == 49) {
-              bg = -1;
-            } else if (valParam >= 90 && valParam <= 97) {
-              fg = valParam - 90 + 8;
-            } else if (valParam >= 100 && valParam <= 107) {
-              bg = valParam - 100 + 8;
-            } else if (valParam == 38) {
-              if (p + 2 < params.size() && params[p + 1] == 5) {
-                fg = params[p + 2];
-                p += 2;
-              } else if (p + 4 < params.size() && params[p + 1] == 2) {
-                int r = params[p + 2];
-                int g = params[p + 3];
-                int b = params[p + 4];
-                if (r == g && g == b) {
-                  if (r < 8) fg = 16;
-                  else if (r > 248) fg = 231;
-                  else fg = 232 + (r - 8) * 24 / 240;
-                } else {
-                  int qr = (r * 5 + 127) / 255;
-                  int qg = (g * 5 + 127) / 255;
-                  int qb = (b * 5 + 127) / 255;
-                  fg = 16 + 36 * qr + 6 * qg + qb;
-                }
-                p += 4;
-              }
-            } else if (valParam == 48) {
-              if (p + 2 < params.size() && params[p + 1] == 5) {
-                bg = params[p + 2];
-                p += 2;
-              } else if (p + 4 < params.size() && params[p + 1] == 2) {
-                int r = params[p + 2];
-                int g = params[p + 3];
-                int b = params[p + 4];
-                if (r == g && g == b) {
-                  if (r < 8) bg = 16;
-                  else if (r > 248) bg = 231;
-                  else bg = 232 + (r - 8) * 24 / 240;
-                } else {
-                  int qr = (r * 5 + 127) / 255;
-                  int qg = (g * 5 + 127) / 255;
-                  int qb = (b * 5 + 127) / 255;
-                  bg = 16 + 36 * qr + 6 * qg + qb;
-                }
-                p += 4;
-              }
-            }
-          }
-
-          wattrset(win, currentAttrs);
-          if (fg != -1 || bg != -1) {
-            int pair = get_or_create_color_pair(fg, bg);
-            wattron(win, COLOR_PAIR(pair));
-          } else {
-            wattron(win, COLOR_PAIR(2));
-          }
-        }
+    uint32_t width = maxW > 0 ? static_cast<uint32_t>(maxW) : 0;
+    uint32_t col = 0;
+    for (const StyledText::Span* s = text.lineBegin(line); s != text.lineEnd(line); ++s) {
+      if (col >= width) break;
+      int pair = (s->fg != -1 || s->bg != -1) ? get_or_create_color_pair(s->fg, s->bg) : 2;
+      wattrset(win, styleAttrs[s->style & 15] | COLOR_PAIR(pair));
+      std::string_view t = text.text(*s);
+      if (col + s->columns <= width) {
+        waddnstr(win, t.data(), static_cast<int>(t.size()));
+        col += s->columns;
       } else {
-        char c = line[i];
-        if (c == '\r' || c == '\n') {
-          i++;
-          continue;
-        }
-        if (c == '\t') {
-          int spacesToPrint = 4 - ((cx - startX) % 4);
-          for (int s = 0; s < spacesToPrint; ++s) {
-            getyx(win, cy, cx);
-            if (cx >= startX + maxW) break;
-            waddch(win, ' ');
-          }
-          i++;
-        } else {
-          waddch(win, (unsigned char)c);
-          i++;
-        }
+        waddnstr(win, t.data(), static_cast<int>(text.fit(*s, width - col)));
+        col = width;
       }
     }
 
     wattrset(win, A_NORMAL);
     wattron(win, COLOR_PAIR(2));
-    int cy, cx;
-    getyx(win, cy, cx);
-    int prevCx = cx;
-    while (cx < startX + maxW) {
+    int cx = getcurx(win);
+    for (int end = x + maxW; cx < end; ++cx)
       waddch(win, ' ');
-      getyx(win, cy, cx);
-      if (cx <= prevCx) {
-        break;
-      }
-      prevCx = cx;
-    }
   }
 
 public:
@@ -1312,8 +1503,26 @@ public:
     loadPins();
     loadCustomMacros();
 
+    sizeIndex.open((fs::path(getCacheRoot()) / "dirsizes.idx").string());
+    if (!configFileIndexRoot.empty()) {
+      std::string indexRoot = configFileIndexRoot;
+      const char* home = getenv("HOME");
+      if (home && indexRoot[0] == '~') indexRoot = home + indexRoot.substr(1);
+      fileIndex.start(indexRoot, (fs::path(getCacheRoot()) / "files.idx").string());
+    }
+    sizeEngine = std::make_unique<SizeEngine>(
+        configSizeWorkers, configSizeCrossFilesystems, &sizeIndex,
+        [this](const fs::path& root, uintmax_t size, int viewId, bool final) {
+          onSizeResult(root, size, viewId, final);
+        },
+        [this](int viewId) { return !stopWorker && viewId == currentViewId; });
     sizeWorker = std::thread(&FileManager::processSizeQueue, this);
-    previewWorker = std::thread(&FileManager::processPreviewWorker, this);
+    unsigned previewWorkerCount = configPreviewWorkers;
+    if (previewWorkerCount == 0)
+      previewWorkerCount = std::clamp(std::thread::hardware_concurrency() / 2, 2u, 4u);
+    for (unsigned i = 0; i < previewWorkerCount; ++i)
+      previewWorkers.emplace_back(&FileManager::processPreviewWorker, this);
+    thumbCacheGC.start(getCacheDir(), (uint64_t)configPreviewDiskCacheMB * 1024 * 1024);
     initInotify();
 
     try {
@@ -1338,14 +1547,16 @@ public:
 
     loadDirectory(currentPath, currentFiles);
     loadParent();
-    tabs[activeTabIndex].currentFiles = currentFiles;
+    updateInotifyWatches();
 
     initscr();
     cbreak();
     noecho();
     keypad(stdscr, TRUE);
     curs_set(0);
-    timeout(50);
+    // getch() never blocks; run() sleeps in poll() on the terminal and
+    // uiWakeup instead (see waitForInput).
+    timeout(0);
     std::cout << "\033[?2004h" << std::flush;
 
     // Enable mouse tracking to prevent terminal text selection override and handle mouse scroll
@@ -1362,29 +1573,67 @@ public:
     setStatus(startupBuf);
   }
 
+  // Lowercase d=a deletes the visible placements only; uploaded images
+  // stay in the terminal for the next placement.
   void clearDirectRender() {
-    std::cout << "\033_Ga=d,q=2\033\\" << std::flush;
+    std::cout << "\033_Ga=d,d=a,q=2\033\\" << std::flush;
     lastWasDirectRender = false;
+    previewDrawn = false;
+  }
+
+  // Makes the next frame repaint every pane from scratch.
+  void invalidateDrawCache() {
+    paneCaches.clear();
+    previewDrawn = false;
+  }
+
+  std::string kittyTransferPath(uint32_t id) {
+    return (fs::temp_directory_path() / ("fyzenor-tty-graphics-protocol-" +
+                                         std::to_string(getpid()) + "-" + std::to_string(id) +
+                                         ".png"))
+        .string();
+  }
+
+  // Frees the image data of everything this session uploaded, and any
+  // transfer files a terminal left behind.
+  void releaseKittyImages() {
+    bool files = kittyUsesFileTransfer();
+    for (const auto& entry : kittyImageIds) {
+      std::cout << "\033_Ga=d,d=I,i=" << entry.second << ",q=2\033\\";
+      if (files) {
+        std::error_code ec;
+        fs::remove(kittyTransferPath(entry.second), ec);
+      }
+    }
+    std::cout << std::flush;
+    kittyImageIds.clear();
+    kittyUploadOrder.clear();
   }
 
   void cancelSearch() {
-    FILE* pipeToClose = nullptr;
     {
       std::lock_guard<std::mutex> lock(searchMutex);
       searchRequestID++;
-      if (searchPipe) {
-        pipeToClose = searchPipe;
-        searchPipe = nullptr;
-      }
-    }
-    if (pipeToClose) {
-      fclose(pipeToClose);
     }
     if (searchThread.joinable()) {
       searchThread.join();
     }
   }
 
+  void cancelListing() {
+    listingRequestID++;
+    if (listingThread.joinable()) {
+      listingThread.join();
+    }
+    std::lock_guard<std::mutex> lock(listingMutex);
+    pendingListingChunk.clear();
+    hasPendingListingChunk = false;
+    pendingListingDone = false;
+    isStreamingListing = false;
+    listingSortedPrefix = 0;
+    pendingCursorPath.clear();
+  }
+
   ~FileManager() {
     // 1. Signal cancellation to all active background tasks
     {
@@ -1411,18 +1660,28 @@ public:
     previewCv.notify_all();
 
     cancelSearch();
+    cancelListing();
+    stopFuzzyIndex();
+    fileIndex.stop();
 
     if (sizeWorker.joinable())
       sizeWorker.join();
-    if (previewWorker.joinable())
-      previewWorker.join();
+    if (sizeEngine)
+      sizeEngine->stop();
+    sizeIndex.save();
+    for (auto& worker : previewWorkers) {
+      if (worker.joinable())
+        worker.join();
+    }
+    thumbCacheGC.stop();
 
     stopInotify = true;
+    inotifyStop.notify();
+    if (inotifyThread.joinable())
+      inotifyThread.join();
     if (inotifyFd >= 0) {
       close(inotifyFd);
     }
-    if (inotifyThread.joinable())
-      inotifyThread.join();
 
     if (winPinned)
       delwin(winPinned);
@@ -1433,6 +1692,7 @@ public:
     if (winPreview)
       delwin(winPreview);
     clearDirectRender();
+    releaseKittyImages();
     std::cout << "\033[?2004l" << std::flush;
     endwin();
   }
@@ -1449,22 +1709,35 @@ public:
     }
   }
 
+  // Events are collected for FS_EVENT_COALESCE_MS after the first one and
+  // then handed to run() in one batch (see applyFsEvents).
+  static constexpr int FS_EVENT_COALESCE_MS = 40;
+  static constexpr size_t FS_EVENT_MAX_PENDING = 4096;
+  static constexpr uint32_t WATCH_MASK = IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_TO |
+                                         IN_MOVED_FROM | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF;
+
   void inotifyWorker() {
-    struct pollfd pfd;
-    pfd.fd = inotifyFd;
-    pfd.events = POLLIN;
+    struct pollfd fds[2] = {{inotifyFd, POLLIN, 0}, {inotifyStop.fd(), POLLIN, 0}};
+    struct pollfd& pfd = fds[0];
 
     char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+    bool batchOpen = false;
+    auto flushAt = std::chrono::steady_clock::now();
 
     while (!stopInotify) {
-      int numEvents = poll(&pfd, 1, 200);
+      int waitMs = -1;
+      if (batchOpen) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(
+            flushAt - std::chrono::steady_clock::now());
+        waitMs = std::max(0, static_cast<int>(left.count()));
+      }
+      int numEvents = poll(fds, 2, waitMs);
       if (numEvents < 0) {
         if (errno == EINTR) continue;
         break;
       }
-      if (numEvents == 0) continue;
 
-      if (pfd.revents & POLLIN) {
+      if (numEvents > 0 && (pfd.revents & POLLIN)) {
         ssize_t len = read(inotifyFd, buffer, sizeof(buffer));
         if (len < 0 && errno != EAGAIN) {
           break;
@@ -1472,36 +1745,67 @@ public:
 
         bool gotFsChange = false;
         bool gotDeviceChange = false;
+        std::set<fs::path> changedDirs;
         const struct inotify_event* event;
         for (char* ptr = buffer; ptr < buffer + len; ptr += sizeof(struct inotify_event) + event->len) {
           event = reinterpret_cast<const struct inotify_event*>(ptr);
-          if (event->mask & (IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | IN_ATTRIB)) {
-            bool isDevicePath = false;
-            {
-              std::lock_guard<std::mutex> lock(inotifyMutex);
-              auto it = watchDescriptors.find(event->wd);
-              if (it != watchDescriptors.end()) {
-                const std::string& pathStr = it->second.string();
-                if (pathStr.rfind("/media", 0) == 0 || pathStr.find("/gvfs") != std::string::npos) {
-                  isDevicePath = true;
-                }
-              }
-            }
-            if (isDevicePath) {
-              gotDeviceChange = true;
+          if (event->mask & IN_Q_OVERFLOW) {
+            std::lock_guard<std::mutex> lock(inotifyMutex);
+            fsEventsOverflowed = true;
+            gotFsChange = true;
+            continue;
+          }
+          if (!(event->mask & WATCH_MASK))
+            continue;
+
+          bool isDevicePath = false;
+          fs::path watchedPath;
+          {
+            std::lock_guard<std::mutex> lock(inotifyMutex);
+            auto it = watchDescriptors.find(event->wd);
+            if (it == watchDescriptors.end())
+              continue;
+            watchedPath = it->second;
+            const std::string& pathStr = it->second.string();
+            if (pathStr.rfind("/media", 0) == 0 || pathStr.find("/gvfs") != std::string::npos) {
+              isDevicePath = true;
+            } else if (pendingFsEvents.size() >= FS_EVENT_MAX_PENDING) {
+              fsEventsOverflowed = true;
             } else {
-              gotFsChange = true;
+              pendingFsEvents.push_back(
+                  {watchedPath, event->len ? std::string(event->name) : std::string(), event->mask});
             }
           }
+          if (isDevicePath) {
+            gotDeviceChange = true;
+          } else {
+            gotFsChange = true;
+            changedDirs.insert(watchedPath);
+            if (event->len)
+              fileIndex.noteEvent(watchedPath.string(), event->name, event->mask);
+          }
         }
 
-        if (gotFsChange) {
-          inotifyTriggered = true;
+        for (const auto& dir : changedDirs) {
+          invalidateDirectorySizes(dir);
+        }
+        if (gotFsChange && !batchOpen) {
+          batchOpen = true;
+          flushAt = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(FS_EVENT_COALESCE_MS);
         }
         if (gotDeviceChange) {
+          trash.rescan();
           devicesTriggered = true;
+          uiWakeup.notify();
         }
       }
+
+      if (batchOpen && std::chrono::steady_clock::now() >= flushAt) {
+        batchOpen = false;
+        inotifyTriggered = true;
+        uiWakeup.notify();
+      }
     }
   }
 
@@ -1554,8 +1858,7 @@ public:
     for (const auto& path : pathsToWatch) {
       try {
         if (fs::exists(path) && fs::is_directory(path)) {
-          int wd = inotify_add_watch(inotifyFd, path.string().c_str(),
-                                     IN_CREATE | IN_DELETE | IN_MODIFY | IN_MOVED_TO | IN_MOVED_FROM | IN_ATTRIB);
+          int wd = inotify_add_watch(inotifyFd, path.string().c_str(), WATCH_MASK);
           if (wd >= 0) {
             watchDescriptors[wd] = path;
           }
@@ -1564,7 +1867,23 @@ public:
     }
   }
 
+  // A change inside dir alters the size of dir and of every ancestor. Their
+  // index records are only marked dirty, so they still sort by the old total
+  // while the rescan (of just the dirty directories) runs.
+  void invalidateDirectorySizes(const fs::path& dir) {
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      for (fs::path p = dir;; p = p.parent_path()) {
+        dirSizeCache.erase(p.string());
+        if (!p.has_parent_path() || p == p.parent_path())
+          break;
+      }
+    }
+    sizeIndex.markDirty(dir);
+  }
+
   // --- Async Size Worker Function ---
+  // Hands queued size jobs to the SizeEngine pool.
   void processSizeQueue() {
     while (!stopWorker) {
       SizeJob job;
@@ -1579,6 +1898,7 @@ public:
 
       if (job.viewId != currentViewId)
         continue;
+      TRACE_SCOPE("processSizeQueue");
 
       if (job.path.string().find("/gvfs/") != std::string::npos) {
         {
@@ -1588,34 +1908,20 @@ public:
         continue;
       }
 
-      uintmax_t size = 0;
-      try {
-        if (fs::exists(job.path) && fs::is_directory(job.path)) {
-          for (const auto& entry : fs::recursive_directory_iterator(
-                   job.path, fs::directory_options::skip_permission_denied)) {
-            if (job.viewId != currentViewId || stopWorker)
-              break;
-            try {
-              if (!fs::is_directory(entry.status())) {
-                size += fs::file_size(entry);
-              }
-            } catch (...) {
-            }
-          }
-        }
-      } catch (...) {
-      }
-
-      if (job.viewId == currentViewId) {
-        std::lock_guard<std::mutex> lock(resultMutex);
-        resultQueue.push_back({job.path, size, job.viewId});
-      }
+      sizeEngine->submit(job.path, job.viewId);
+    }
+  }
 
-      // Always update the cache
-      {
-        std::lock_guard<std::mutex> lock(cacheMutex);
-        dirSizeCache[job.path.string()] = size;
-      }
+  // Called from SizeEngine workers with running and final totals.
+  void onSizeResult(const fs::path& root, uintmax_t size, int viewId, bool final) {
+    if (viewId == currentViewId) {
+      std::lock_guard<std::mutex> lock(resultMutex);
+      resultQueue.push_back({root, size, viewId});
+      uiWakeup.notify();
+    }
+    if (final) {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      dirSizeCache[root.string()] = size;
     }
   }
 
@@ -1720,7 +2026,7 @@ public:
     std::string cmd = rawCmd;
     std::string currentFile = "";
     if (!currentFiles.empty() && selectedIndex < currentFiles.size()) {
-      currentFile = currentFiles[selectedIndex].path.string();
+      currentFile = currentFiles[selectedIndex].path().string();
     }
 
     size_t pos;
@@ -1821,55 +2127,223 @@ public:
   }
 
   const char* getIcon(const FileEntry& f) {
-    if (f.is_directory)
+    if (f.is_directory())
       return ICON_DIR;
-    if (VIDEO_EXTS.count(f.extension))
+    std::string ext = f.extension();
+    if (VIDEO_EXTS.count(ext))
       return ICON_VIDEO;
-    if (IMAGE_EXTS.count(f.extension))
+    if (IMAGE_EXTS.count(ext))
       return ICON_IMAGE;
-    if (AUDIO_EXTS.count(f.extension))
+    if (AUDIO_EXTS.count(ext))
       return ICON_MUSIC;
-    if (FRONTEND_EXTS.count(f.extension))
+    if (FRONTEND_EXTS.count(ext))
       return ICON_FRONTEND;
-    if (CONFIG_EXTS.count(f.extension))
+    if (CONFIG_EXTS.count(ext))
       return ICON_CONFIG;
-    if (SCRIPTS_EXTS.count(f.extension))
+    if (SCRIPTS_EXTS.count(ext))
       return ICON_SCRIPT;
-    if (DOCUMENTATION_EXTS.count(f.extension))
+    if (DOCUMENTATION_EXTS.count(ext))
       return ICON_DOCS;
-    if (FONT_EXTS.count(f.extension))
+    if (FONT_EXTS.count(ext))
       return ICON_FONT;
-    if (CORE_EXTS.count(f.extension))
+    if (CORE_EXTS.count(ext))
       return ICON_CORE;
-    if (ARCHIVE_EXTS.count(f.extension))
+    if (ARCHIVE_EXTS.count(ext))
       return ICON_ZIP;
     return ICON_FILE;
   }
 
-  // Unified Sorting Logic: Folders Top -> Size/Date/Name
-  void sortList(std::vector<FileEntry>& list) {
-    std::sort(list.begin(), list.end(), [this](const FileEntry& a, const FileEntry& b) {
-      // 1. Always keep directories on top
-      if (a.is_directory != b.is_directory) {
-        return a.is_directory > b.is_directory;
+  // Folders on top, then by size, date or name (FileListing::sort()). The
+  // parent pane and directory previews always use SortMode::NAME.
+  void sortList(FileListing& list) {
+    TRACE_SCOPE("sortList");
+    // Name-sorted loads skip the per-entry stat; other modes need it first.
+    if (sortMode != SortMode::NAME) {
+      list.resolveAllStats();
+    }
+    list.sort(sortMode);
+  }
+
+  // While a listing is still streaming in, only the rows up to the bottom of
+  // the visible window need to be in final order.
+  size_t visibleWindowEnd() const {
+    size_t rows = static_cast<size_t>(std::max(winCurrent ? getmaxy(winCurrent) : height, 1));
+    return std::min(currentFiles.size(), std::max(scrollOffset + rows, selectedIndex + 1));
+  }
+
+  void sortVisibleWindow() {
+    size_t k = visibleWindowEnd();
+    if (sortMode != SortMode::NAME) {
+      currentFiles.resolveAllStats();
+    }
+    currentFiles.partialSort(k, sortMode);
+    listingSortedPrefix = k;
+  }
+
+  // Fills directory sizes from the cache and queues the missing ones.
+  void applyCachedSizes(FileListing& list, size_t from, size_t to = FileListing::npos) {
+    std::lock_guard<std::mutex> qLock(queueMutex);
+    std::lock_guard<std::mutex> cLock(cacheMutex);
+    for (size_t i = from; i < std::min(to, list.size()); ++i) {
+      FileEntry entry = list[i];
+      if (entry.is_directory()) {
+        std::string entryPath = entry.path().string();
+        if (entryPath.find("/gvfs/") != std::string::npos) {
+          list.setSize(i, 0);
+          continue;
+        }
+        auto it = dirSizeCache.find(entryPath);
+        if (it != dirSizeCache.end()) {
+          list.setSize(i, it->second);
+        } else {
+          list.setSize(i, 0);
+          if (sortMode == SortMode::SIZE) {
+            // Sort by the indexed size right away; the queued job only
+            // rescans what changed since.
+            uintmax_t indexed = 0;
+            if (sizeIndex.estimate(entryPath, indexed))
+              list.setSize(i, indexed);
+            sizeQueue.push_back({entryPath, currentViewId.load()});
+          }
+        }
+      }
+    }
+  }
+
+  // Moves the cursor onto path, or remembers it until the streamed listing
+  // delivers that entry.
+  void selectPathWhenLoaded(const fs::path& path) {
+    size_t idx = currentFiles.indexOf(path);
+    if (idx != FileListing::npos) {
+      selectedIndex = idx;
+      scrollOffset = (selectedIndex > 10) ? selectedIndex - 10 : 0;
+      return;
+    }
+    if (isStreamingListing) {
+      pendingCursorPath = path;
+    }
+  }
+
+  // Pulls entries streamed in by the listing thread into currentFiles.
+  // Returns true when the view changed.
+  bool mergeListingChunks() {
+    FileListing chunk;
+    bool done = false;
+    {
+      std::lock_guard<std::mutex> lock(listingMutex);
+      if (!hasPendingListingChunk) return false;
+      std::swap(chunk, pendingListingChunk);
+      done = pendingListingDone;
+      hasPendingListingChunk = false;
+    }
+    if (!isStreamingListing) return false;
+
+    // A cursor still on the first row stays there; otherwise follow its row,
+    // unless it waits for an entry that has not arrived yet, which can only
+    // be among the new rows.
+    size_t tracked = FileListing::npos;
+    if (pendingCursorPath.empty() && selectedIndex > 0 && selectedIndex < currentFiles.size())
+      tracked = selectedIndex;
+
+    size_t first = currentFiles.size();
+    currentFiles.appendListing(chunk);
+    applyCachedSizes(currentFiles, first);
+    bool arrived = false;
+    if (!pendingCursorPath.empty()) {
+      tracked = currentFiles.indexOf(pendingCursorPath, first);
+      arrived = tracked != FileListing::npos;
+    }
+
+    if (done) {
+      fs::path trackedPath = tracked != FileListing::npos ? currentFiles[tracked].path() : "";
+      sortList(currentFiles);
+      if (!trackedPath.empty()) tracked = currentFiles.indexOf(trackedPath);
+      isStreamingListing = false;
+      listingSortedPrefix = currentFiles.size();
+      if (listingThread.joinable()) listingThread.join();
+      listingCache.store(streamingPath, showHidden, currentFiles, sortMode == SortMode::NAME,
+                         streamingMtime);
+    } else {
+      // Only the new rows are looked at: they are merged into the sorted
+      // window rather than the whole listing re-sorted per chunk.
+      if (sortMode != SortMode::NAME) {
+        for (size_t i = first; i < currentFiles.size(); ++i)
+          currentFiles.resolveStat(i);
       }
+      listingSortedPrefix = currentFiles.mergeSortedPrefix(listingSortedPrefix, first,
+                                                           visibleWindowEnd(), sortMode, tracked);
+    }
 
-      // 2. Sort by Mode
-      if (sortMode == SortMode::SIZE) {
-        if (a.size != b.size)
-          return a.size > b.size; // Descending
-      } else if (sortMode == SortMode::DATE) {
-        if (a.modified_time != b.modified_time)
-          return a.modified_time > b.modified_time; // Descending (newest first)
+    if (tracked != FileListing::npos) {
+      selectedIndex = tracked;
+      if (arrived) {
+        scrollOffset = (selectedIndex > 10) ? selectedIndex - 10 : 0;
+        pendingCursorPath.clear();
       }
+    }
+    if (done) pendingCursorPath.clear();
+
+    queueCv.notify_one();
+    return true;
+  }
 
-      // 3. Default: Sort by Name (Ascending)
-      return a.name < b.name;
+  // Reads the first screenful synchronously, then hands the rest of the
+  // directory to a background thread that streams it in chunks.
+  void streamDirectory(const fs::path& path, FileListing& target) {
+    auto reader = std::make_unique<DirReader>(path, showHidden, sortMode != SortMode::NAME);
+    if (!reader->isOpen()) {
+      throw fs::filesystem_error("directory_iterator::directory_iterator", path,
+                                 std::error_code(reader->error(), std::generic_category()));
+    }
+
+    const size_t firstScreen = static_cast<size_t>(std::max(height, 50));
+    auto start = std::chrono::steady_clock::now();
+    bool more = true;
+    while (more) {
+      more = reader->readChunk(target, 256);
+      auto elapsed = std::chrono::steady_clock::now() - start;
+      if (target.size() >= firstScreen && elapsed > std::chrono::milliseconds(15)) break;
+    }
+    if (!more) return;
+
+    isStreamingListing = true;
+    listingSortedPrefix = 0;
+    long long reqId = ++listingRequestID;
+    listingThread = std::thread([this, reqId, r = std::move(reader)]() {
+      bool hasMore = true;
+      while (hasMore && reqId == listingRequestID) {
+        FileListing chunk;
+        hasMore = r->readChunk(chunk, 4096);
+        std::lock_guard<std::mutex> lock(listingMutex);
+        if (reqId != listingRequestID) return;
+        if (pendingListingChunk.empty()) {
+          std::swap(pendingListingChunk, chunk);
+        } else {
+          pendingListingChunk.appendListing(chunk);
+        }
+        pendingListingDone = !hasMore;
+        hasPendingListingChunk = true;
+        uiWakeup.notify();
+      }
     });
   }
 
-  void loadDirectory(const fs::path& path, std::vector<FileEntry>& target) {
+  // Hands the listing a directory preview read for path to listingCache, so
+  // that stepping into the directory reuses it. Once published, the worker
+  // never touches it again, so the UI thread may share it.
+  void importDirectoryPreview(const fs::path& path) {
+    std::string key = directoryListingKey(path.string());
+    std::lock_guard<std::mutex> lock(previewMutex);
+    const PreviewData* data = previewCache.get(key);
+    if (data && data->listing)
+      listingCache.store(path, showHidden, *data->listing, true, data->listedMtime,
+                         data->listedAt);
+  }
+
+  void loadDirectory(const fs::path& path, FileListing& target) {
+    TRACE_SCOPE("loadDirectory");
     cancelSearch();
+    cancelListing();
     isSearching = false;
     target.clear();
     multiSelection.clear();
@@ -1883,60 +2357,51 @@ public:
       std::lock_guard<std::mutex> lock(resultMutex);
       resultQueue.clear();
     }
+    bool cached = false;
+    bool nameOrdered = false;
+    int64_t mtime = FileListing::MTIME_UNKNOWN;
     try {
       if (isTrashMode) {
-        std::vector<fs::path> trashDirs = getAllTrashFilesPaths();
-        for (const auto& trashDir : trashDirs) {
-          if (fs::exists(trashDir) && fs::is_directory(trashDir)) {
-            for (const auto& entry : fs::directory_iterator(trashDir)) {
-              if (!showHidden && entry.path().filename().string().front() == '.')
-                continue;
-              FileEntry fe(entry);
-              TrashInfo ti = getTrashInfo(entry.path());
-              if (!ti.originalPath.empty()) {
-                fe.name = fs::path(ti.originalPath).filename().string();
-                fe.extension = fs::path(ti.originalPath).extension().string();
-              }
-              target.push_back(fe);
+        for (const auto& trashDir : trash.filesDirs()) {
+          size_t first = target.size();
+          readDirectoryEntries(trashDir, showHidden, true, target);
+          TrashInfo ti;
+          for (size_t i = first; i < target.size(); ++i) {
+            if (trash.info(target[i].path(), ti)) {
+              target.setDisplayName(i, fs::path(ti.originalPath).filename().string());
             }
           }
         }
       } else {
-        for (const auto& entry : fs::directory_iterator(path)) {
-          if (!showHidden && entry.path().filename().string().front() == '.')
-            continue;
-          target.emplace_back(entry);
+        importDirectoryPreview(path);
+        cached = listingCache.lookup(path, showHidden, target, nameOrdered);
+        if (!cached) {
+          mtime = ListingCache::directoryMtime(path);
+          if (&target == &currentFiles)
+            streamDirectory(path, target);
+          else
+            readDirectoryEntries(path, showHidden, sortMode != SortMode::NAME, target);
         }
       }
     } catch (const std::exception& e) {
       setStatus("Error: " + std::string(e.what()));
+      mtime = FileListing::MTIME_UNKNOWN;
     }
 
     // Check cache and only queue what's missing
-    {
-      std::lock_guard<std::mutex> qLock(queueMutex);
-      std::lock_guard<std::mutex> cLock(cacheMutex);
-      for (auto& entry : target) {
-        if (entry.is_directory) {
-          if (entry.path.string().find("/gvfs/") != std::string::npos) {
-            entry.size = 0;
-            continue;
-          }
-          auto it = dirSizeCache.find(entry.path.string());
-          if (it != dirSizeCache.end()) {
-            entry.size = it->second;
-          } else {
-            entry.size = 0;
-            if (sortMode == SortMode::SIZE) {
-              sizeQueue.push_back({entry.path, currentViewId.load()});
-            }
-          }
-        }
-      }
-    }
+    applyCachedSizes(target, 0);
 
     // Initial Sort
-    sortList(target);
+    if (isStreamingListing) {
+      streamingPath = path;
+      streamingMtime = mtime;
+      sortVisibleWindow();
+    } else {
+      if (!cached || !nameOrdered || sortMode != SortMode::NAME)
+        sortList(target);
+      if (!cached && !isTrashMode)
+        listingCache.store(path, showHidden, target, sortMode == SortMode::NAME, mtime);
+    }
 
     queueCv.notify_one();
   }
@@ -1990,21 +2455,23 @@ public:
       return;
     }
     if (currentPath.has_parent_path() && currentPath != currentPath.parent_path()) {
+      fs::path parent = currentPath.parent_path();
       parentFiles.clear();
-      try {
-        for (const auto& entry : fs::directory_iterator(currentPath.parent_path())) {
-          if (!showHidden && entry.path().filename().string().front() == '.')
-            continue;
-          parentFiles.emplace_back(entry);
+      bool nameOrdered = false;
+      if (listingCache.lookup(parent, showHidden, parentFiles, nameOrdered)) {
+        if (!nameOrdered)
+          parentFiles.sort(SortMode::NAME);
+      } else {
+        int64_t mtime = ListingCache::directoryMtime(parent);
+        try {
+          readDirectoryEntries(parent, showHidden, false, parentFiles);
+        } catch (...) {
+          mtime = FileListing::MTIME_UNKNOWN;
         }
-      } catch (...) {
+        // Standard sort for parent to keep it stable
+        parentFiles.sort(SortMode::NAME);
+        listingCache.store(parent, showHidden, parentFiles, true, mtime);
       }
-      // Standard sort for parent to keep it stable
-      std::sort(parentFiles.begin(), parentFiles.end(), [](const FileEntry& a, const FileEntry& b) {
-        if (a.is_directory != b.is_directory)
-          return a.is_directory > b.is_directory;
-        return a.name < b.name;
-      });
     } else {
       parentFiles.clear();
     }
@@ -2023,13 +2490,14 @@ public:
     updateLayout();
     refresh();
     std::cout << "\033[?2004h" << std::flush;
-    timeout(50);
+    timeout(0);
   }
 
   void updateLayout() {
     endwin();
     refresh();
     clear();
+    invalidateDrawCache();
     getmaxyx(stdscr, height, width);
 
     if (isDualPaneMode) {
@@ -2111,327 +2579,251 @@ public:
     requestID++;
     requestedPath = path;
     imageReady = false;
+    std::vector<PreviewJob> neighbours = prefetchJobs(previewHeight, previewWidth);
 
-    if (type == PreviewType::IMAGE) {
+    {
       std::lock_guard<std::mutex> lock(previewMutex);
-      auto it = sessionImageCache.find(path);
-      if (it != sessionImageCache.end()) {
-        auto kit = std::find(sessionImageCacheKeys.begin(), sessionImageCacheKeys.end(), path);
-        if (kit != sessionImageCacheKeys.end()) {
-          sessionImageCacheKeys.erase(kit);
+      // Everything still queued belongs to an older requestID.
+      previewQueue = {};
+
+      std::string key = type == PreviewType::DIRECTORY
+                            ? directoryListingKey(path)
+                            : PreviewCache::makeKey(path, (int)type, previewHeight, previewWidth);
+      bool hit = false;
+      if (const PreviewData* cached = previewCache.get(key)) {
+        if (type == PreviewType::IMAGE) {
+          cachedBase64 = cached->b64;
+          cachedImageKey = key;
+          cachedImgW = cached->w;
+          cachedImgH = cached->h;
+        } else {
+          cachedText = cached->text;
+          cachedListing = cached->listing;
+          cachedListingPartial = false;
         }
-        sessionImageCacheKeys.push_back(path);
-
-        cachedBase64 = it->second.b64;
-        cachedImgW = it->second.w;
-        cachedImgH = it->second.h;
+        hit = true;
+      }
+      if (hit) {
         cachedPath = path;
         imageReady = true;
-        return;
+      } else {
+        PreviewJob job{path, type, previewHeight, previewWidth, requestID, 0, previewSeq++, key};
+        job.showHidden = showHidden;
+        previewQueue.push(std::move(job));
+      }
+
+      for (auto& job : neighbours) {
+        if (!previewCache.contains(job.cacheKey)) {
+          job.seq = previewSeq++;
+          previewQueue.push(std::move(job));
+        }
       }
     }
+    previewCv.notify_all();
+  }
 
-    {
-      std::lock_guard<std::mutex> lock(previewMutex);
-      nextPreviewJob = std::make_unique<PreviewJob>(PreviewJob{path, type, previewHeight, previewWidth, requestID});
+  // Preview cache key of a directory's listing. Unlike other previews it does
+  // not depend on the box, so loadDirectory() can look it up as well.
+  std::string directoryListingKey(const std::string& path) const {
+    return PreviewCache::makeKey(path, (int)PreviewType::DIRECTORY + (showHidden ? 0x100 : 0),
+                                 0, 0);
+  }
+
+  // What drawPreview would generate asynchronously for entry, if anything.
+  PreviewType asyncPreviewType(const FileEntry& entry) {
+    if (entry.is_directory())
+      return PreviewType::NONE;
+    std::string ext = entry.extension();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    bool isArchive = (ext == ".zip" || ext == ".tar" || ext == ".gz" || ext == ".tgz" ||
+                      ext == ".rar" || ext == ".bz2" || ext == ".xz" || ext == ".7z");
+    bool isAudio = (ext == ".mp3" || ext == ".wav" || ext == ".flac" || ext == ".ogg" ||
+                    ext == ".m4a" || ext == ".aac" || ext == ".opus" || ext == ".wma");
+    if (isCodeFile(entry.extension()) || isArchive || isAudio || ext == ".pdf")
+      return PreviewType::TEXT;
+    bool isVid = VIDEO_EXTS.count(entry.extension());
+    bool isImg = IMAGE_EXTS.count(entry.extension());
+    if (!isVid && !isImg)
+      return PreviewType::NONE;
+    if (entry.path().string().find("/gvfs/") != std::string::npos)
+      return PreviewType::NONE;
+    if ((isVid || !nativeImageFormat(ext)) && !isCommandAvailable("ffmpeg"))
+      return PreviewType::NONE;
+    return PreviewType::IMAGE;
+  }
+
+  // Preview jobs for the configPreviewPrefetch entries after and before the
+  // cursor, alternating outwards. They run under the current requestID, so
+  // moving the cursor drops them.
+  std::vector<PreviewJob> prefetchJobs(int previewHeight, int previewWidth) {
+    std::vector<PreviewJob> jobs;
+    int k = (int)configPreviewPrefetch;
+    if (isTrashMode || selectedIndex >= currentFiles.size())
+      k = 0;
+    for (int d = 1; d <= k; ++d) {
+      for (int sign : {1, -1}) {
+        long idx = (long)selectedIndex + sign * d;
+        if (idx < 0 || idx >= (long)currentFiles.size())
+          continue;
+        const auto& entry = currentFiles[idx];
+        PreviewType type = asyncPreviewType(entry);
+        if (type != PreviewType::NONE)
+          jobs.push_back({entry.path().string(), type, previewHeight, previewWidth, requestID, d, 0,
+                          PreviewCache::makeKey(entry.path().string(), (int)type, previewHeight,
+                                                previewWidth)});
+      }
     }
-    previewCv.notify_one();
+    return jobs;
   }
 
+  // Workers take the highest-priority job: the entry under the cursor first,
+  // then prefetches nearest first. Every job carries the requestID it was
+  // queued under; once the cursor moves on it is dropped, and a running one
+  // kills its subprocess.
   void processPreviewWorker() {
     while (!stopWorker) {
-      std::unique_ptr<PreviewJob> job;
+      PreviewJob job;
       {
         std::unique_lock<std::mutex> lock(previewMutex);
-        previewCv.wait(lock, [this] { return nextPreviewJob != nullptr || stopWorker; });
+        previewCv.wait(lock, [this] { return !previewQueue.empty() || stopWorker; });
         if (stopWorker)
           break;
-        job = std::move(nextPreviewJob);
+        job = previewQueue.top();
+        previewQueue.pop();
       }
 
-      if (!job)
+      if (job.reqId != requestID)
         continue;
+      bool prefetch = job.priority > 0;
 
-      if (job->reqId != requestID)
-        continue;
-
-      std::string b64;
-      std::vector<std::string> lines;
-
-      if (job->type == PreviewType::IMAGE) {
-        int targetW = (int)((job->previewWidth - 4) * 10);
-        int targetH = (int)((job->previewHeight - 4) * 20);
-        if (targetW < 10)
-          targetW = 10;
-        if (targetH < 10)
-          targetH = 10;
-
-        std::string cachePath = getCachePath(job->path, targetW, targetH);
-
-        std::string ext = fs::path(job->path).extension().string();
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-        bool isVid = VIDEO_EXTS.count(ext);
-
-        if (job->reqId != requestID)
+      PreviewData data;
+      if (job.type == PreviewType::IMAGE) {
+        TRACE_SCOPE("preview.image");
+        if (!renderImagePreview(job, data))
           continue;
-
-        if (cachePath == "/tmp/fm_preview_thumb.png") {
-          try {
-            fs::remove(cachePath);
-          } catch (...) {}
-        }
-
-        if (!fs::exists(cachePath)) {
-          std::string fileCmd = "\"" + job->path + "\"";
-          std::string scaleFilter = "scale=" + std::to_string(targetW) + ":" +
-                                    std::to_string(targetH) +
-                                    ":force_original_aspect_ratio=decrease";
-
-          std::string cmd;
-          if (isVid) {
-            cmd = "ffmpeg -y -v error -i " + fileCmd + " -vf \"" + scaleFilter +
-                  "\" -frames:v 1 -f image2 \"" + cachePath + "\" > /dev/null 2>&1";
-          } else {
-            cmd = "ffmpeg -y -v error -i " + fileCmd + " -vf \"" + scaleFilter + "\" -f image2 \"" +
-                  cachePath + "\" > /dev/null 2>&1";
-          }
-          int res = system(cmd.c_str());
-          (void)res;
-        }
-
-        if (job->reqId != requestID)
+      } else if (job.type == PreviewType::TEXT) {
+        TRACE_SCOPE("preview.text");
+        auto text = std::make_shared<StyledText>();
+        if (!buildTextPreview(job.path, job.previewHeight, job.previewWidth,
+                              [&] { return previewSuperseded(job); }, *text))
           continue;
-
-        if (!fs::exists(cachePath)) {
-          continue;
-        }
-
-        int finalW = 0, finalH = 0;
-        std::string probeCmd = "ffprobe -v error -select_streams v:0 -show_entries "
-                               "stream=width,height -of csv=s=x:p=0 \"" +
-                               cachePath + "\" 2>/dev/null";
-        FILE* p = popen(probeCmd.c_str(), "r");
-        if (p) {
-          char buf[64];
-          if (fgets(buf, sizeof(buf), p)) {
-            sscanf(buf, "%dx%d", &finalW, &finalH);
-          }
-          pclose(p);
-        }
-
-        if (job->reqId != requestID)
+        data.text = std::move(text);
+      } else if (job.type == PreviewType::DIRECTORY) {
+        TRACE_SCOPE("preview.directory");
+        if (!renderDirectoryPreview(job, data))
           continue;
+      } else {
+        continue;
+      }
 
-        std::ifstream file(cachePath, std::ios::binary);
-        if (file) {
-          std::vector<unsigned char> buffer(std::istreambuf_iterator<char>(file), {});
-          b64 = base64_encode(buffer.data(), buffer.size());
+      std::lock_guard<std::mutex> lock(previewMutex);
+      if (!prefetch && job.reqId == requestID) {
+        if (job.type == PreviewType::IMAGE) {
+          cachedImgW = data.w;
+          cachedImgH = data.h;
+          cachedBase64 = data.b64;
+          cachedImageKey = job.cacheKey;
+        } else {
+          cachedText = data.text;
+          cachedListing = data.listing;
+          cachedListingPartial = false;
         }
+        cachedPath = job.path;
+        imageReady = true;
+        uiWakeup.notify();
+      }
+      previewCache.put(job.cacheKey, std::move(data));
+    }
+  }
 
-        {
+  // Reads the directory of job (see buildDirectoryPreview), publishing its
+  // first previewHeight entries for drawing when it does not fit in one read.
+  bool renderDirectoryPreview(const PreviewJob& job, PreviewData& out) {
+    return buildDirectoryPreview(
+        job.path, job.showHidden, job.previewHeight, [&] { return previewSuperseded(job); },
+        [&](std::shared_ptr<FileListing> head) {
           std::lock_guard<std::mutex> lock(previewMutex);
-          if (job->reqId == requestID) {
-            cachedImgW = finalW;
-            cachedImgH = finalH;
-            cachedBase64 = b64;
-            if (sessionImageCache.size() >= 100) {
-              if (!sessionImageCacheKeys.empty()) {
-                std::string lruKey = sessionImageCacheKeys.front();
-                sessionImageCacheKeys.erase(sessionImageCacheKeys.begin());
-                sessionImageCache.erase(lruKey);
-              }
-            }
-            sessionImageCache[job->path] = {b64, cachedImgW, cachedImgH};
-            sessionImageCacheKeys.push_back(job->path);
-            cachedPath = job->path;
-            imageReady = true;
-          }
-        }
-      } else if (job->type == PreviewType::TEXT) {
-        std::string ext = fs::path(job->path).extension().string();
-        for (auto& c : ext) c = tolower(c);
+          if (job.reqId != requestID)
+            return false;
+          cachedText.reset();
+          cachedListing = std::move(head);
+          cachedListingPartial = true;
+          cachedPath = job.path;
+          imageReady = true;
+          uiWakeup.notify();
+          return true;
+        },
+        out);
+  }
 
-        bool isArchive = (ext == ".zip" || ext == ".tar" || ext == ".gz" || ext == ".tgz" || 
-                          ext == ".rar" || ext == ".bz2" || ext == ".xz" || ext == ".7z");
-        
-        bool isAudio = (ext == ".mp3" || ext == ".wav" || ext == ".flac" || ext == ".ogg" || 
-                        ext == ".m4a" || ext == ".aac" || ext == ".opus" || ext == ".wma");
-
-        if (isArchive) {
-          std::string archiveCmd;
-          if (ext == ".zip") {
-            archiveCmd = "unzip -l \"" + job->path + "\" 2>/dev/null | head -n 40";
-          } else if (ext == ".7z") {
-            archiveCmd = "7z l \"" + job->path + "\" 2>/dev/null | head -n 40";
-          } else if (ext == ".rar") {
-            archiveCmd = "unrar l \"" + job->path + "\" 2>/dev/null | head -n 40";
-          } else if (ext == ".tar") {
-            archiveCmd = "tar -tf \"" + job->path + "\" 2>/dev/null | head -n 40";
-          } else if (ext == ".gz" || ext == ".tgz") {
-            archiveCmd = "tar -ztf \"" + job->path + "\" 2>/dev/null | head -n 40";
-          } else if (ext == ".bz2") {
-            archiveCmd = "tar -jtf \"" + job->path + "\" 2>/dev/null | head -n 40";
-          } else if (ext == ".xz") {
-            archiveCmd = "tar -Jtf \"" + job->path + "\" 2>/dev/null | head -n 40";
-          }
+  // Scales the image (or a video's first frame) described by job into a
+  // Kitty PNG payload. Returns false if it failed or was superseded.
+  bool renderImagePreview(const PreviewJob& job, PreviewData& out) {
+    int targetW = (int)((job.previewWidth - 4) * 10);
+    int targetH = (int)((job.previewHeight - 4) * 20);
+    if (targetW < 10)
+      targetW = 10;
+    if (targetH < 10)
+      targetH = 10;
+
+    std::string cachePath = getCachePath(job.path, targetW, targetH);
+    if (!cachePath.empty() && loadThumb(cachePath, out.b64, out.w, out.h))
+      return true;
 
-          lines.push_back("\033[1;36mArchive Contents:\033[0m");
-          lines.push_back("--------------------------------");
-          if (!archiveCmd.empty()) {
-            FILE* pipe = popen(archiveCmd.c_str(), "r");
-            if (pipe) {
-              char buf[4096];
-              bool hasData = false;
-              while (fgets(buf, sizeof(buf), pipe) != nullptr) {
-                if (job->reqId != requestID || stopWorker)
-                  break;
-                std::string ln(buf);
-                if (!ln.empty() && ln.back() == '\n') ln.pop_back();
-                lines.push_back(ln);
-                hasData = true;
-              }
-              pclose(pipe);
-              if (!hasData) {
-                lines.push_back("(No list tool available or empty archive)");
-              }
-            } else {
-              lines.push_back("(Failed to run preview command)");
-            }
-          }
-        } else if (isAudio) {
-          std::string mediaCmd;
-          if (isCommandAvailable("mediainfo")) {
-            mediaCmd = "mediainfo \"" + job->path + "\" 2>/dev/null | head -n 40";
-          } else if (isCommandAvailable("ffprobe")) {
-            mediaCmd = "ffprobe -v error -show_format -show_streams \"" + job->path + "\" 2>/dev/null | grep -E \"codec_name|duration|bit_rate|width|height|sample_rate|channels|title|artist\" | head -n 40";
-          }
+    std::string ext = fs::path(job.path).extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    bool isVid = VIDEO_EXTS.count(ext);
 
-          lines.push_back("\033[1;35mMedia Info Metadata:\033[0m");
-          lines.push_back("--------------------------------");
-          if (!mediaCmd.empty()) {
-            FILE* pipe = popen(mediaCmd.c_str(), "r");
-            if (pipe) {
-              char buf[4096];
-              bool hasData = false;
-              while (fgets(buf, sizeof(buf), pipe) != nullptr) {
-                if (job->reqId != requestID || stopWorker)
-                  break;
-                std::string ln(buf);
-                if (!ln.empty() && ln.back() == '\n') ln.pop_back();
-                lines.push_back(ln);
-                hasData = true;
-              }
-              pclose(pipe);
-              if (!hasData) {
-                lines.push_back("(Failed to read stream metadata)");
-              }
-            } else {
-              lines.push_back("(Failed to run media probe)");
-            }
-          } else {
-            lines.push_back("(Install 'mediainfo' or 'ffmpeg' for full metadata previews)");
-          }
-        } else if (ext == ".pdf") {
-          if (isCommandAvailable("pdftotext")) {
-            std::string pdfCmd = "pdftotext -layout -l 3 \"" + job->path + "\" - 2>/dev/null | head -n 40";
-            lines.push_back("\033[1;32mPDF Document Preview (First 3 Pages):\033[0m");
-            lines.push_back("--------------------------------");
-            FILE* pipe = popen(pdfCmd.c_str(), "r");
-            if (pipe) {
-              char buf[4096];
-              bool hasData = false;
-              while (fgets(buf, sizeof(buf), pipe) != nullptr) {
-                if (job->reqId != requestID || stopWorker)
-                  break;
-                std::string ln(buf);
-                if (!ln.empty() && ln.back() == '\n') ln.pop_back();
-                lines.push_back(ln);
-                hasData = true;
-              }
-              pclose(pipe);
-              if (!hasData) {
-                lines.push_back("(Empty or encrypted PDF document)");
-              }
-            } else {
-              lines.push_back("(Failed to read PDF document)");
-            }
-          } else {
-            lines.push_back(" \033[1;31m[PDF File - No Preview]\033[0m ");
-            lines.push_back(" (Install 'poppler-utils' / 'pdftotext' to view text preview) ");
-          }
-        } else if (is_binary_file(job->path)) {
-          lines.push_back("\033[1;31m[Binary File]\033[0m");
-        } else {
-          if (job->reqId != requestID)
-            continue;
-
-          bool gotOutput = false;
-          std::string cmd;
-          if (isCommandAvailable("bat")) {
-            cmd = "bat --color=always --style=plain --paging=never "
-                  "--wrap=character --line-range=:" +
-                  std::to_string(job->previewHeight * 2) + " \"" + job->path + "\" 2>/dev/null";
-          } else if (isCommandAvailable("batcat")) {
-            cmd = "batcat --color=always --style=plain --paging=never "
-                  "--wrap=character --line-range=:" +
-                  std::to_string(job->previewHeight * 2) + " \"" + job->path + "\" 2>/dev/null";
-          }
+    if (job.reqId != requestID)
+      return false;
 
-          if (!cmd.empty()) {
-            FILE* pipe = popen(cmd.c_str(), "r");
-            if (pipe) {
-              char buffer[4096];
-              while (fgets(buffer, sizeof(buffer), pipe) != nullptr) {
-                if (job->reqId != requestID || stopWorker)
-                  break;
-                std::string line(buffer);
-                if (!line.empty() && line.back() == '\n')
-                  line.pop_back();
-                lines.push_back(line);
-                gotOutput = true;
-              }
-              pclose(pipe);
-            }
-          }
+    // Still images are decoded and scaled in-process; ffmpeg is only
+    // needed for video frames and formats without a native decoder.
+    std::vector<unsigned char> png;
+    if (isVid || !decodeImagePreview(job.path, targetW, targetH, png)) {
+      std::string framePath = (fs::path(getCacheDir()) /
+                               ("frame.part" + std::to_string(getpid()) + "-" +
+                                std::to_string(++previewTempSeq) + ".png"))
+                                  .string();
+      std::string fileCmd = "\"" + job.path + "\"";
+      std::string scaleFilter = "scale=" + std::to_string(targetW) + ":" +
+                                std::to_string(targetH) +
+                                ":force_original_aspect_ratio=decrease";
+
+      std::string cmd;
+      if (isVid) {
+        cmd = "ffmpeg -y -v error -i " + fileCmd + " -vf \"" + scaleFilter +
+              "\" -frames:v 1 -f image2 \"" + framePath + "\" > /dev/null 2>&1";
+      } else {
+        cmd = "ffmpeg -y -v error -i " + fileCmd + " -vf \"" + scaleFilter + "\" -f image2 \"" +
+              framePath + "\" > /dev/null 2>&1";
+      }
+      if (runShell(cmd, [&] { return previewSuperseded(job); }) == 0) {
+        std::ifstream file(framePath, std::ios::binary);
+        if (file)
+          png.assign(std::istreambuf_iterator<char>(file), {});
+      }
+      std::error_code ec;
+      fs::remove(framePath, ec);
+    }
 
-          if (job->reqId != requestID)
-            continue;
+    if (job.reqId != requestID)
+      return false;
 
-          if (!gotOutput) {
-            lines.clear();
-            std::ifstream f(job->path);
-            if (f.is_open()) {
-              std::string lineStr;
-              int count = 0;
-              while (std::getline(f, lineStr) && count < job->previewHeight) {
-                if (job->reqId != requestID || stopWorker)
-                  break;
-                std::string clean;
-                for (char c : lineStr) {
-                  if (c == '\t')
-                    clean += "    ";
-                  else
-                    clean += c;
-                }
-                if (clean.length() > (size_t)job->previewWidth)
-                  clean = clean.substr(0, job->previewWidth);
-                lines.push_back(clean);
-                count++;
-              }
-            }
-          }
-        }
+    // Native thumbnails are never upscaled, so size the placement from
+    // the preview box rather than the pixel count.
+    int pixW = 0, pixH = 0;
+    if (!pngDimensions(png.data(), png.size(), pixW, pixH))
+      return false;
+    fitWithin(pixW, pixH, targetW, targetH, out.w, out.h);
+    out.b64 = base64_encode(png.data(), png.size());
+    if (!cachePath.empty() && storeThumb(cachePath, out.b64, out.w, out.h))
+      thumbCacheGC.noteStore();
+    return true;
+  }
 
-        {
-          std::lock_guard<std::mutex> lock(previewMutex);
-          if (job->reqId == requestID) {
-            cachedTextLines = lines;
-            cachedPath = job->path;
-            imageReady = true;
-          }
-        }
-      }
-    }
+  bool previewSuperseded(const PreviewJob& job) const {
+    return job.reqId != requestID || stopWorker;
   }
 
   int getPreviewContentStartLine() {
@@ -2441,32 +2833,104 @@ public:
     if (isTrashMode) {
       return 8;
     }
-    return currentFiles[selectedIndex].is_symlink ? 7 : 6;
+    return currentFiles[selectedIndex].is_symlink() ? 7 : 6;
   }
 
-  void sendKittyGraphics(const std::string& b64Data, int pY, int pX, int cols, int rows,
-                         int offX = 0, int offY = 0, int startRow = 8) {
+  // Temp-file transfer saves the pty the base64 traffic but needs the
+  // terminal to see our /tmp, so "auto" only uses it in a local Kitty.
+  bool kittyUsesFileTransfer() {
+    static const bool useFile = [] {
+      if (configKittyTransfer == "file")
+        return true;
+      if (configKittyTransfer != "auto")
+        return false;
+      bool remote = getenv("SSH_CONNECTION") || getenv("SSH_TTY");
+      const char* term = getenv("TERM");
+      bool kitty = getenv("KITTY_WINDOW_ID") || (term && strstr(term, "kitty"));
+      return kitty && !remote;
+    }();
+    return useFile;
+  }
+
+  // Returns the terminal-side image ID for key, transmitting b64Data (a=t,
+  // no placement) the first time it is seen.
+  uint32_t uploadKittyImage(const std::string& key, const std::string& b64Data) {
+    auto it = kittyImageIds.find(key);
+    if (it != kittyImageIds.end()) {
+      auto pos = std::find(kittyUploadOrder.begin(), kittyUploadOrder.end(), key);
+      if (pos != kittyUploadOrder.end()) {
+        kittyUploadOrder.erase(pos);
+        kittyUploadOrder.push_back(key);
+      }
+      return it->second;
+    }
+
+    // IDs are global to the terminal window; start somewhere pid-specific so
+    // two instances in one window don't overwrite each other's images.
+    if (nextKittyImageId == 0)
+      nextKittyImageId = ((uint32_t)getpid() & 0xFFFF) << 12 | 1;
+    uint32_t id = nextKittyImageId++;
+
+    bool sent = false;
+    if (kittyUsesFileTransfer()) {
+      // t=t: the terminal reads the file and then deletes it. The name must
+      // contain "tty-graphics-protocol" for it to agree to that.
+      std::string tmp = kittyTransferPath(id);
+      std::string png = base64_decode(b64Data);
+      std::ofstream out(tmp, std::ios::binary);
+      out.write(png.data(), png.size());
+      out.close();
+      if (out) {
+        std::string pathB64 = base64_encode((const unsigned char*)tmp.data(), tmp.size());
+        std::cout << "\033_Ga=t,f=100,t=t,i=" << id << ",q=2;" << pathB64 << "\033\\";
+        sent = true;
+      }
+    }
+    if (!sent) {
+      const size_t chunk_size = 4096;
+      size_t total = b64Data.length();
+      size_t offset = 0;
+      while (offset < total) {
+        size_t chunkLen = std::min(chunk_size, total - offset);
+        bool isLast = (offset + chunkLen >= total);
+        std::cout << "\033_G";
+        if (offset == 0) {
+          // a=t: transmit only, f=100: PNG, t=d: direct
+          std::cout << "a=t,f=100,t=d,i=" << id << ",q=2,";
+        }
+        std::cout << "m=" << (isLast ? "0" : "1") << ";";
+        std::cout.write(b64Data.data() + offset, chunkLen);
+        std::cout << "\033\\";
+        offset += chunkLen;
+      }
+    }
+
+    kittyImageIds[key] = id;
+    kittyUploadOrder.push_back(key);
+    if (kittyUploadOrder.size() > KITTY_MAX_IMAGES) {
+      const std::string& oldest = kittyUploadOrder.front();
+      uint32_t oldId = kittyImageIds[oldest];
+      std::cout << "\033_Ga=d,d=I,i=" << oldId << ",q=2\033\\";
+      if (kittyUsesFileTransfer()) {
+        std::error_code ec;
+        fs::remove(kittyTransferPath(oldId), ec);
+      }
+      kittyImageIds.erase(oldest);
+      kittyUploadOrder.pop_front();
+    }
+    return id;
+  }
+
+  void sendKittyGraphics(const std::string& key, const std::string& b64Data, int pY, int pX,
+                         int cols, int rows, int offX = 0, int offY = 0, int startRow = 8) {
+    uint32_t id = uploadKittyImage(key, b64Data);
     // Move cursor to start of preview area (1-indexed for terminal)
     // pY+1 is the start of the window, we have startRow lines of header/padding +
     // offY.
     std::cout << "\033[" << (pY + startRow + offY) << ";" << (pX + 3 + offX) << "H";
-    const size_t chunk_size = 4096;
-    size_t total = b64Data.length();
-    size_t offset = 0;
-    while (offset < total) {
-      size_t chunkLen = std::min(chunk_size, total - offset);
-      bool isLast = (offset + chunkLen >= total);
-      std::cout << "\033_G";
-      if (offset == 0) {
-        // a=T: transmit and display, f=100: PNG, t=d: direct
-        // c, r: scale image to fit these columns and rows
-        std::cout << "a=T,f=100,t=d,q=2,c=" << cols << ",r=" << rows << ",";
-      }
-      std::cout << "m=" << (isLast ? "0" : "1") << ";";
-      std::cout << b64Data.substr(offset, chunkLen);
-      std::cout << "\033\\";
-      offset += chunkLen;
-    }
+    // a=p: place an uploaded image. p=1 makes a redraw replace the existing
+    // placement instead of stacking a second one. c, r: scale to this box.
+    std::cout << "\033_Ga=p,i=" << id << ",p=1,q=2,c=" << cols << ",r=" << rows << "\033\\";
     std::cout << std::flush;
   }
 
@@ -2491,27 +2955,71 @@ public:
       if (offY < 0)
         offY = 0;
 
-      sendKittyGraphics(cachedBase64, pY, pX, cols, rows, offX, offY, imgStartRow);
+      sendKittyGraphics(cachedImageKey, cachedBase64, pY, pX, cols, rows, offX, offY, imgStartRow);
       lastWasDirectRender = true;
     }
   }
 
+  // The entries of a directory preview, from line down. The listing comes
+  // sorted by name with its visible rows resolved (see
+  // buildDirectoryPreview), so drawing only reads it.
+  void drawDirectoryPreview(const FileListing& listing, int line) {
+    int maxSubW = std::max(getmaxx(winPreview) - 8, 5);
+    for (size_t i = 0; i < listing.size() && line < height - 3; ++i) {
+      FileEntry entry = listing[i];
+      std::string subName = entry.name();
+      if ((int)subName.length() > maxSubW)
+        subName = utf8_safe_truncate(subName, std::max(maxSubW - 3, 1));
+
+      std::string ext = entry.extension();
+      std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+      FileStyle s = getFileStyle(entry.name(), ext, entry.is_directory(),
+                                 entry.is_empty_directory());
+      if (entry.is_symlink())
+        s.icon = ICON_LINK;
+
+      wattron(winPreview, COLOR_PAIR(s.pair));
+      mvwprintw(winPreview, line++, 4, "%s %s", s.icon, subName.c_str());
+      wattroff(winPreview, COLOR_PAIR(s.pair));
+    }
+  }
+
   void drawCachedTextPreview() {
     std::lock_guard<std::mutex> lock(previewMutex);
-    if (cachedTextLines.empty())
+    if (!cachedText || cachedText->empty())
       return;
 
     int maxW = getmaxx(winPreview) - 4;
     int startLine = getPreviewContentStartLine();
     int limit = getmaxy(winPreview) - startLine - 2;
-    int lineLimit = std::min((int)cachedTextLines.size(), limit);
+    int lineLimit = std::min((int)cachedText->lines(), limit);
 
     for (int i = 0; i < lineLimit; ++i) {
-      wprintw_ansi(winPreview, startLine + i, 2, cachedTextLines[i], maxW);
+      drawStyledLine(winPreview, startLine + i, 2, *cachedText, i, maxW);
     }
   }
   // ----------------------------
 
+  // Next key for win, or ERR after timeoutMs (-1 = none) or when a worker
+  // signals uiWakeup. Sleeps in poll() instead of letting curses poll.
+  int waitKey(WINDOW* win, int timeoutMs) {
+    wtimeout(win, 0);
+    int ch = wgetch(win);
+    if (ch != ERR) return ch;
+    WaitResult r = waitForInput(STDIN_FILENO, uiWakeup, timeoutMs);
+    if (r == WaitResult::WOKEN) uiWakeup.drain();
+    return r == WaitResult::INPUT ? wgetch(win) : ERR;
+  }
+
+  // Milliseconds until the status toast expires, or -1 if none is shown.
+  int statusTimeoutMs() const {
+    if (statusMessage.empty()) return -1;
+    auto left = STATUS_TOAST_MS - std::chrono::duration_cast<std::chrono::milliseconds>(
+                                      std::chrono::steady_clock::now() - statusTime)
+                                      .count();
+    return left > 0 ? static_cast<int>(left) + 1 : 0;
+  }
+
   void setStatus(const std::string& msg) {
     statusMessage = msg;
     statusTime = std::chrono::steady_clock::now();
@@ -2522,7 +3030,8 @@ public:
       return;
 
     auto now = std::chrono::steady_clock::now();
-    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - statusTime).count() > 1800) {
+    if (std::chrono::duration_cast<std::chrono::milliseconds>(now - statusTime).count() >
+        STATUS_TOAST_MS) {
       statusMessage = "";
       return;
     }
@@ -2665,7 +3174,7 @@ public:
     }
 
     curs_set(0);
-    timeout(50);
+    timeout(0);
     delwin(win);
 
     updateLayout();
@@ -2675,7 +3184,7 @@ public:
   void toggleSelection() {
     if (currentFiles.empty())
       return;
-    fs::path p = currentFiles[selectedIndex].path;
+    fs::path p = currentFiles[selectedIndex].path();
     if (multiSelection.count(p))
       multiSelection.erase(p);
     else
@@ -2685,7 +3194,7 @@ public:
   }
   void selectAll() {
     for (const auto& f : currentFiles)
-      multiSelection.insert(f.path);
+      multiSelection.insert(f.path());
     setStatus("Selected all");
   }
   void clearSelection() {
@@ -2729,27 +3238,8 @@ public:
     return result;
   }
 
-  bool fuzzyMatch(const std::string& str, const std::string& query) {
-    if (query.empty()) return true;
-    size_t queryIdx = 0;
-    for (char c : str) {
-      if (tolower(c) == tolower(query[queryIdx])) {
-        queryIdx++;
-        if (queryIdx == query.length()) {
-          return true;
-        }
-      }
-    }
-    return false;
-  }
-
   void handleSearch() {
-    if (!isCommandAvailable("rg")) {
-      setStatus("Error: ripgrep ('rg') is not installed");
-      return;
-    }
-
-    std::string query = promptInput("Search (ripgrep)");
+    std::string query = promptInput("Search");
     if (query.empty())
       return;
 
@@ -2760,85 +3250,108 @@ public:
     scrollOffset = 0;
     refresh();
 
+    cancelListing();
     cancelSearch();
     fs::path searchPath = currentPath;
 
     long long reqId = searchRequestID;
+    {
+      std::lock_guard<std::mutex> lock(searchResultMutex);
+      pendingSearchResults.clear();
+      pendingSearchRanked = false;
+    }
 
     searchThread = std::thread([this, query, reqId, searchPath]() {
-      std::string cmd = "rg --files-with-matches --smart-case --hidden --glob \"!.git\" " +
-                        escapeShellArg(query) + " " +
-                        escapeShellArg(searchPath.string()) + " 2>/dev/null";
-      FILE* pipe = nullptr;
-      {
-        std::lock_guard<std::mutex> lock(searchMutex);
-        if (reqId != searchRequestID) return;
-        searchPipe = popen(cmd.c_str(), "r");
-        pipe = searchPipe;
-      }
-      if (!pipe) {
-        {
-          std::lock_guard<std::mutex> lock(searchMutex);
-          if (searchPipe == pipe) searchPipe = nullptr;
-        }
-        if (reqId == searchRequestID) {
-          setStatus("Error: Failed to run ripgrep");
+      // Hits go straight into pendingSearchResults with the size and mtime
+      // the scan already has; the UI picks up a snapshot every 50 ms.
+      auto lastUpdate = std::chrono::steady_clock::now();
+      auto onHit = [&](const std::string& dir, const std::string& name, uintmax_t size,
+                       int64_t mtime) {
+        std::lock_guard<std::mutex> lock(searchResultMutex);
+        if (reqId != searchRequestID)
+          return;
+        pendingSearchResults.append(dir, name, 0, size, mtime);
+        auto now = std::chrono::steady_clock::now();
+        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastUpdate).count() > 50) {
+          pendingSearchStatus =
+              "Searching... Found " + std::to_string(pendingSearchResults.size()) + " matches";
+          hasPendingSearchResults = true;
+          searchReady = true;
+          uiWakeup.notify();
+          lastUpdate = now;
         }
+      };
+      std::string error;
+      bool ok = searchContents(searchPath.string(), query, configSearchWorkers, onHit,
+                               [&] { return reqId != searchRequestID; }, error);
+
+      std::lock_guard<std::mutex> lock(searchResultMutex);
+      if (reqId != searchRequestID)
         return;
-      }
+      size_t found = pendingSearchResults.size();
+      if (!ok)
+        pendingSearchStatus = "Error: Invalid search pattern: " + error;
+      else
+        pendingSearchStatus = found == 0 ? ("No matches found for: " + query)
+                                         : ("Search finished. Found " + std::to_string(found) +
+                                            " matches");
+      hasPendingSearchResults = true;
+      searchReady = true;
+      uiWakeup.notify();
+    });
+  }
 
-      std::vector<FileEntry> results;
-      char buffer[4096];
-      auto lastUpdate = std::chrono::steady_clock::now();
+  // Fuzzy jump over the whole file index (file_index_root), best match first.
+  // Results arrive like a search; entries deleted since they were indexed are
+  // dropped by the lstat that fills in their details.
+  void handleJumpToFile() {
+    if (!fileIndex.enabled()) {
+      setStatus("Error: File index is disabled (file_index_root in config.toml)");
+      return;
+    }
+    std::string query = promptInput("Jump to file");
+    if (query.empty())
+      return;
 
-      while (true) {
-        char* res = fgets(buffer, sizeof(buffer), pipe);
-        if (!res || reqId != searchRequestID) break;
-        std::string pathStr(buffer);
-        if (!pathStr.empty() && pathStr.back() == '\n')
-          pathStr.pop_back();
-        if (!pathStr.empty()) {
-          try {
-            fs::path p(pathStr);
-            if (fs::exists(p)) {
-              results.emplace_back(p);
-            }
-          } catch (...) {
-          }
-        }
+    isSearching = true;
+    currentFiles.clear();
+    selectedIndex = 0;
+    scrollOffset = 0;
 
-        auto now = std::chrono::steady_clock::now();
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastUpdate).count() > 50 && !results.empty()) {
-          if (reqId == searchRequestID) {
-            std::lock_guard<std::mutex> lock(searchResultMutex);
-            pendingSearchResults = results;
-            pendingSearchStatus = "Searching... Found " + std::to_string(results.size()) + " matches";
-            hasPendingSearchResults = true;
-            searchReady = true;
-          }
-          lastUpdate = now;
-        }
-      }
+    cancelListing();
+    cancelSearch();
+    long long reqId = searchRequestID;
 
-      {
-        std::lock_guard<std::mutex> lock(searchMutex);
-        if (searchPipe == pipe) {
-          searchPipe = nullptr;
-        } else {
-          pipe = nullptr;
-        }
-      }
-      if (pipe) {
-        pclose(pipe);
+    searchThread = std::thread([this, query, reqId]() {
+      auto start = std::chrono::steady_clock::now();
+      size_t total = 0;
+      std::vector<FileIndex::Hit> hits = fileIndex.query(query, FILE_JUMP_MAX_RESULTS, total);
+      auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+      FileListing results;
+      for (const auto& hit : hits) {
+        if (reqId != searchRequestID)
+          return;
+        struct stat st;
+        if (lstat(hit.path.c_str(), &st) == 0)
+          results.appendPath(hit.path);
       }
 
-      if (reqId == searchRequestID) {
-        std::lock_guard<std::mutex> lock(searchResultMutex);
-        pendingSearchResults = results;
-        pendingSearchStatus = results.empty() ? ("No matches found for: " + query) : ("Search finished. Found " + std::to_string(results.size()) + " matches");
-        hasPendingSearchResults = true;
-        searchReady = true;
-      }
+      std::lock_guard<std::mutex> lock(searchResultMutex);
+      if (reqId != searchRequestID)
+        return;
+      pendingSearchResults = std::move(results);
+      pendingSearchRanked = true;
+      std::string indexed = std::to_string(fileIndex.size()) + " paths" +
+                            (fileIndex.ready() ? "" : ", still indexing");
+      pendingSearchStatus =
+          total == 0 ? ("No matches found for: " + query + " (" + indexed + ")")
+                     : ("Jump: " + std::to_string(total) + " matches in " + std::to_string(ms) +
+                        " ms (" + indexed + ")");
+      hasPendingSearchResults = true;
+      searchReady = true;
+      uiWakeup.notify();
     });
   }
 
@@ -2847,7 +3360,7 @@ public:
       return;
     clipboard.paths.clear();
     if (multiSelection.empty())
-      clipboard.paths.push_back(currentFiles[selectedIndex].path);
+      clipboard.paths.push_back(currentFiles[selectedIndex].path());
     else
       for (const auto& p : multiSelection)
         clipboard.paths.push_back(p);
@@ -2860,7 +3373,7 @@ public:
       return;
     clipboard.paths.clear();
     if (multiSelection.empty())
-      clipboard.paths.push_back(currentFiles[selectedIndex].path);
+      clipboard.paths.push_back(currentFiles[selectedIndex].path());
     else
       for (const auto& p : multiSelection)
         clipboard.paths.push_back(p);
@@ -3027,7 +3540,7 @@ public:
 
     std::string currentFileEscaped = "";
     if (!currentFiles.empty() && selectedIndex < currentFiles.size()) {
-      currentFileEscaped = escapeShellArg(currentFiles[selectedIndex].path.string());
+      currentFileEscaped = escapeShellArg(currentFiles[selectedIndex].path().string());
     }
 
     std::string allSelectedEscaped = "";
@@ -3074,12 +3587,13 @@ public:
         std::string runCmd = "cd " + escapeShellArg(currentPath.string()) + " && (" + finalCmd + ") > /dev/null 2>&1";
         int res = system(runCmd.c_str());
         
-        task->isFinished = true;
         if (res == 0) {
           task->statusMessage = "Success";
         } else {
           task->statusMessage = "Failed (exit code " + std::to_string(res) + ")";
         }
+        task->isFinished = true;
+        uiWakeup.notify();
       });
     } else {
       suspendTerminal();
@@ -3203,7 +3717,7 @@ public:
     }
 
     const auto& file = currentFiles[selectedIndex];
-    std::string newName = promptInput("Rename " + file.name + " to", file.name);
+    std::string newName = promptInput("Rename " + file.name() + " to", file.name());
     if (newName.empty())
       return;
 
@@ -3214,7 +3728,7 @@ public:
     }
 
     try {
-      fs::rename(file.path, target);
+      fs::rename(file.path(), target);
       setStatus("Renamed");
       reloadAll();
     } catch (...) {
@@ -3260,7 +3774,7 @@ public:
       return;
     std::vector<fs::path> targets;
     if (multiSelection.empty())
-      targets.push_back(currentFiles[selectedIndex].path);
+      targets.push_back(currentFiles[selectedIndex].path());
     else
       for (const auto& p : multiSelection)
         targets.push_back(p);
@@ -3284,7 +3798,7 @@ public:
     if (currentFiles.empty())
       return;
     const auto& file = currentFiles[selectedIndex];
-    if (file.is_directory) {
+    if (file.is_directory()) {
       setStatus("Error: Cannot extract a directory!");
       return;
     }
@@ -3323,7 +3837,7 @@ public:
       return false;
     };
 
-    if (!getExtractCommand(file.path, currentPath, extractCmd)) {
+    if (!getExtractCommand(file.path(), currentPath, extractCmd)) {
       setStatus("Error: Unsupported archive format!");
       return;
     }
@@ -3333,16 +3847,16 @@ public:
       return;
     }
 
-    std::string confirm = promptInput("Extract " + file.name + " here? (y/n)");
+    std::string confirm = promptInput("Extract " + file.name() + " here? (y/n)");
     if (confirm == "y" || confirm == "Y") {
-      startExtractTask(extractCmd, file.name, currentPath);
+      startExtractTask(extractCmd, file.name(), currentPath);
     }
   }
 
   void handleCopyPath() {
     if (currentFiles.empty())
       return;
-    std::string path = fs::absolute(currentFiles[selectedIndex].path).string();
+    std::string path = fs::absolute(currentFiles[selectedIndex].path()).string();
     std::string cmd = "echo -n " + escapeShellArg(path) +
                       " | (wl-copy 2>/dev/null || xclip -selection clipboard "
                       "2>/dev/null || pbcopy 2>/dev/null)";
@@ -3375,7 +3889,7 @@ public:
         targets.push_back(p);
       }
     } else {
-      targets.push_back(currentFiles[selectedIndex].path);
+      targets.push_back(currentFiles[selectedIndex].path());
     }
 
     std::string cmd = tool + " -x";
@@ -3454,7 +3968,7 @@ public:
       return;
     std::vector<fs::path> targets;
     if (multiSelection.empty())
-      targets.push_back(currentFiles[selectedIndex].path);
+      targets.push_back(currentFiles[selectedIndex].path());
     else
       for (const auto& p : multiSelection)
         targets.push_back(p);
@@ -3468,60 +3982,14 @@ public:
       return;
 
     if (isTrashMode) {
-      const char* home = std::getenv("HOME");
-      if (home) {
-        for (const auto& p : targets) {
-          fs::path infoFile = fs::path(home) / ".local/share/Trash/info" / (p.filename().string() + ".trashinfo");
-          try {
-            if (fs::exists(infoFile)) {
-              fs::remove(infoFile);
-            }
-          } catch (...) {}
-        }
-      }
+      for (const auto& p : targets)
+        trash.discardInfo(p);
     }
 
     startDeleteTask(targets);
     multiSelection.clear();
   }
 
-  struct TrashInfo {
-    std::string originalPath;
-    std::string deletionDate;
-  };
-
-  TrashInfo getTrashInfo(const fs::path& trashFile) {
-    TrashInfo info;
-    try {
-      fs::path infoDir = trashFile.parent_path().parent_path() / "info";
-      fs::path infoFile = infoDir / (trashFile.filename().string() + ".trashinfo");
-      if (fs::exists(infoFile)) {
-        std::ifstream f(infoFile);
-        std::string line;
-        while (std::getline(f, line)) {
-          if (line.rfind("Path=", 0) == 0) {
-            info.originalPath = line.substr(5);
-          } else if (line.rfind("DeletionDate=", 0) == 0) {
-            info.deletionDate = line.substr(13);
-            size_t tPos = info.deletionDate.find('T');
-            if (tPos != std::string::npos) {
-              info.deletionDate[tPos] = ' ';
-            }
-          }
-        }
-      }
-    } catch (...) {}
-    return info;
-  }
-
-  fs::path getTrashFilesPath() {
-    const char* home = std::getenv("HOME");
-    if (home) {
-      return fs::path(home) / ".local/share/Trash/files";
-    }
-    return "";
-  }
-
   fs::path getMountPoint(const fs::path& path) {
     try {
       fs::path absPath = fs::absolute(path);
@@ -3550,159 +4018,6 @@ public:
     }
   }
 
-  std::vector<fs::path> getAllTrashFilesPaths() {
-    std::vector<fs::path> paths;
-    const char* home = std::getenv("HOME");
-    if (home) {
-      paths.push_back(fs::path(home) / ".local/share/Trash/files");
-    }
-
-    uid_t uid = getuid();
-    std::vector<fs::path> scanDirs;
-    if (home) {
-      std::string user = fs::path(home).filename().string();
-      scanDirs.push_back("/media/" + user);
-      scanDirs.push_back("/run/media/" + user);
-    }
-    scanDirs.push_back("/mnt");
-
-    for (const auto& scanDir : scanDirs) {
-      try {
-        if (fs::exists(scanDir) && fs::is_directory(scanDir)) {
-          for (const auto& entry : fs::directory_iterator(scanDir)) {
-            if (entry.is_directory()) {
-              fs::path localTrash = entry.path() / (".Trash-" + std::to_string(uid));
-              if (fs::exists(localTrash) && fs::is_directory(localTrash)) {
-                paths.push_back(localTrash / "files");
-              }
-            }
-          }
-        }
-      } catch (...) {}
-    }
-    return paths;
-  }
-
-  bool moveToTrash(const fs::path& path) {
-    if (isCommandAvailable("gio")) {
-      std::string cmd = "gio trash " + escapeShellArg(path.string()) + " > /dev/null 2>&1";
-      if (std::system(cmd.c_str()) == 0) {
-        return true;
-      }
-    }
-
-    try {
-      fs::path absPath = fs::absolute(path);
-      fs::path mountPoint = getMountPoint(absPath);
-
-      const char* home = std::getenv("HOME");
-      if (!home) return false;
-      fs::path homePath(home);
-
-      struct stat st_mount, st_home;
-      if (stat(mountPoint.c_str(), &st_mount) != 0 || stat(homePath.c_str(), &st_home) != 0) {
-        return false;
-      }
-
-      bool samePartition = (st_mount.st_dev == st_home.st_dev);
-      fs::path trashDir;
-
-      if (samePartition) {
-        trashDir = homePath / ".local/share/Trash";
-      } else {
-        uid_t uid = getuid();
-        fs::path localTrash = mountPoint / (".Trash-" + std::to_string(uid));
-        if (!fs::exists(localTrash)) {
-          try {
-            fs::create_directories(localTrash);
-            fs::permissions(localTrash, fs::perms::owner_all, fs::perm_options::replace);
-          } catch (...) {
-            return false;
-          }
-        }
-        trashDir = localTrash;
-      }
-
-      fs::path trashFiles = trashDir / "files";
-      fs::path trashInfo = trashDir / "info";
-
-      fs::create_directories(trashFiles);
-      fs::create_directories(trashInfo);
-
-      std::string filename = absPath.filename().string();
-      fs::path destFile = trashFiles / filename;
-
-      int counter = 1;
-      while (fs::exists(destFile)) {
-        destFile = trashFiles / (filename + "_" + std::to_string(counter));
-        counter++;
-      }
-
-      try {
-        fs::rename(absPath, destFile);
-      } catch (const std::filesystem::filesystem_error&) {
-        fs::copy(absPath, destFile, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
-        fs::remove_all(absPath);
-      }
-
-      fs::path destInfo = trashInfo / (destFile.filename().string() + ".trashinfo");
-      std::ofstream out(destInfo);
-      if (out.is_open()) {
-        out << "[Trash Info]\n";
-        out << "Path=" << absPath.string() << "\n";
-
-        std::time_t now = std::time(nullptr);
-        char buf[100];
-        std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
-        out << "DeletionDate=" << buf << "\n";
-        out.close();
-      }
-      return true;
-    } catch (...) {
-      return false;
-    }
-  }
-
-  fs::path findTrashedFile(const fs::path& origPath) {
-    try {
-      fs::path absPath = fs::absolute(origPath);
-      const char* home = std::getenv("HOME");
-      std::vector<fs::path> searchDirs;
-      if (home) {
-        searchDirs.push_back(fs::path(home) / ".local/share/Trash");
-      }
-      uid_t uid = getuid();
-      fs::path mountPoint = getMountPoint(absPath);
-      fs::path localTrash = mountPoint / (".Trash-" + std::to_string(uid));
-      if (fs::exists(localTrash)) {
-        searchDirs.push_back(localTrash);
-      }
-
-      for (const auto& trashDir : searchDirs) {
-        fs::path infoDir = trashDir / "info";
-        fs::path filesDir = trashDir / "files";
-        if (fs::exists(infoDir)) {
-          for (const auto& entry : fs::directory_iterator(infoDir)) {
-            if (entry.path().extension() == ".trashinfo") {
-              std::ifstream f(entry.path());
-              std::string line;
-              while (std::getline(f, line)) {
-                if (line.rfind("Path=", 0) == 0) {
-                  std::string p = line.substr(5);
-                  if (p == absPath.string()) {
-                    std::string base = entry.path().stem().string();
-                    return filesDir / base;
-                  }
-                }
-              }
-            }
-          }
-        }
-      }
-    } catch (...) {}
-    return "";
-  }
-
   void handleUndoTrash() {
     if (lastTrashedFiles.empty()) {
       setStatus("Nothing to undo");
@@ -3711,35 +4026,8 @@ public:
 
     int successCount = 0;
     for (const auto& p : lastTrashedFiles) {
-      TrashInfo ti = getTrashInfo(p);
-      if (ti.originalPath.empty()) continue;
-      try {
-        fs::path dest(ti.originalPath);
-        if (dest.has_parent_path()) {
-          fs::create_directories(dest.parent_path());
-        }
-        if (fs::exists(dest)) {
-          std::string newName = dest.filename().string() + "_restored";
-          dest = dest.parent_path() / newName;
-          int count = 1;
-          while (fs::exists(dest)) {
-            dest = dest.parent_path() / (newName + "_" + std::to_string(count));
-            count++;
-          }
-        }
-        try {
-          fs::rename(p, dest);
-        } catch (...) {
-          fs::copy(p, dest, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
-          fs::remove_all(p);
-        }
-
-        fs::path infoFile = p.parent_path().parent_path() / "info" / (p.filename().string() + ".trashinfo");
-        if (fs::exists(infoFile)) {
-          fs::remove(infoFile);
-        }
+      if (trash.restore(p))
         successCount++;
-      } catch (...) {}
     }
 
     if (successCount > 0) {
@@ -3756,7 +4044,7 @@ public:
       return;
     std::vector<fs::path> targets;
     if (multiSelection.empty())
-      targets.push_back(currentFiles[selectedIndex].path);
+      targets.push_back(currentFiles[selectedIndex].path());
     else
       for (const auto& p : multiSelection)
         targets.push_back(p);
@@ -3776,7 +4064,7 @@ public:
       return;
     std::vector<fs::path> targets;
     if (multiSelection.empty())
-      targets.push_back(currentFiles[selectedIndex].path);
+      targets.push_back(currentFiles[selectedIndex].path());
     else
       for (const auto& p : multiSelection)
         targets.push_back(p);
@@ -3789,39 +4077,8 @@ public:
 
     int successCount = 0;
     for (const auto& p : targets) {
-      TrashInfo ti = getTrashInfo(p);
-      if (ti.originalPath.empty()) {
-        continue;
-      }
-      try {
-        fs::path dest(ti.originalPath);
-        if (dest.has_parent_path()) {
-          fs::create_directories(dest.parent_path());
-        }
-
-        if (fs::exists(dest)) {
-          std::string newName = dest.filename().string() + "_restored";
-          dest = dest.parent_path() / newName;
-          int count = 1;
-          while (fs::exists(dest)) {
-            dest = dest.parent_path() / (newName + "_" + std::to_string(count));
-            count++;
-          }
-        }
-
-        try {
-          fs::rename(p, dest);
-        } catch (const std::filesystem::filesystem_error&) {
-          fs::copy(p, dest, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
-          fs::remove_all(p);
-        }
-
-        fs::path infoFile = p.parent_path().parent_path() / "info" / (p.filename().string() + ".trashinfo");
-        if (fs::exists(infoFile)) {
-          fs::remove(infoFile);
-        }
+      if (trash.restore(p))
         successCount++;
-      } catch (...) {}
     }
 
     if (successCount == (int)targets.size()) {
@@ -3840,8 +4097,7 @@ public:
       return;
 
     std::vector<fs::path> targets;
-    std::vector<fs::path> trashDirs = getAllTrashFilesPaths();
-    for (const auto& filesDir : trashDirs) {
+    for (const auto& filesDir : trash.filesDirs()) {
       try {
         fs::path trashDir = filesDir.parent_path();
         fs::path trashFiles = trashDir / "files";
@@ -3883,7 +4139,7 @@ public:
       scrollOffset = 0;
       setStatus("Exited Trash");
     } else {
-      fs::path trashPath = getTrashFilesPath();
+      fs::path trashPath = trash.homeFilesDir();
       if (trashPath.empty()) {
         setStatus("Error: Trash not available");
         return;
@@ -3907,9 +4163,9 @@ public:
   }
 
   void reloadAll() {
+    previewDrawn = false;
     loadDirectory(currentPath, currentFiles);
     loadParent();
-    tabs[activeTabIndex].currentFiles = currentFiles;
     if (isDualPaneMode) {
       size_t inactiveIdx = (activeTabIndex == leftTabIndex) ? rightTabIndex : leftTabIndex;
       if (inactiveIdx < tabs.size()) {
@@ -3918,6 +4174,131 @@ public:
     }
     updateInotifyWatches();
   }
+  // Applies the batch collected by inotifyWorker in place: each changed name
+  // is re-statted once and inserted, updated or removed in the listings that
+  // show its directory, keeping their sort order. Only a queue overflow (or a
+  // watched directory vanishing) falls back to reloadAll().
+  void applyFsEvents() {
+    previewDrawn = false;
+    std::vector<FsEvent> events;
+    bool overflowed = false;
+    {
+      std::lock_guard<std::mutex> lock(inotifyMutex);
+      events.swap(pendingFsEvents);
+      overflowed = fsEventsOverflowed;
+      fsEventsOverflowed = false;
+    }
+    if (overflowed)
+      listingCache.clear();
+    for (const auto& ev : events)
+      listingCache.invalidate(ev.dir);
+    if (overflowed || isTrashMode || isStreamingListing) {
+      reloadAll();
+      return;
+    }
+
+    std::map<std::pair<fs::path, std::string>, uint32_t> merged;
+    for (const auto& ev : events) {
+      merged[{ev.dir, ev.name}] |= ev.mask;
+    }
+
+    // Names that left or changed, by directory, each statted once.
+    struct Batch {
+      std::vector<std::string> gone;
+      std::vector<std::string> present;
+    };
+    std::map<fs::path, Batch> batches;
+    fs::path parentPath = currentPath.parent_path();
+    bool hasParent = currentPath.has_parent_path() && currentPath != parentPath;
+    for (const auto& [key, mask] : merged) {
+      const auto& [dir, name] = key;
+      if (name.empty()) {
+        if ((mask & (IN_DELETE_SELF | IN_MOVE_SELF)) &&
+            (dir == currentPath || (hasParent && dir == parentPath))) {
+          reloadAll();
+          return;
+        }
+        continue;
+      }
+      if (!showHidden && name[0] == '.')
+        continue;
+      bool gone = (mask & (IN_DELETE | IN_MOVED_FROM)) &&
+                  !(mask & (IN_CREATE | IN_MOVED_TO | IN_MODIFY | IN_ATTRIB));
+      struct stat st;
+      if (!gone && lstat((dir / name).c_str(), &st) != 0)
+        gone = true;
+      Batch& b = batches[dir];
+      (gone ? b.gone : b.present).push_back(name);
+    }
+
+    size_t inactiveIdx = tabs.size();
+    if (isDualPaneMode) {
+      inactiveIdx = (activeTabIndex == leftTabIndex) ? rightTabIndex : leftTabIndex;
+    }
+
+    fs::path selectedPath;
+    if (!isSearching && selectedIndex < currentFiles.size()) {
+      selectedPath = currentFiles[selectedIndex].path();
+    }
+
+    bool currentChanged = false;
+    bool parentChanged = false;
+    const Batch* currentBatch = nullptr;
+    for (const auto& [dir, batch] : batches) {
+      if (dir == currentPath && !isSearching) {
+        currentChanged |= applyFsChanges(currentFiles, dir, batch.gone, batch.present, false);
+        currentBatch = &batch;
+      }
+      if (!isDualPaneMode && hasParent && dir == parentPath) {
+        parentChanged |= applyFsChanges(parentFiles, dir, batch.gone, batch.present, true);
+      }
+      if (inactiveIdx < tabs.size() && tabs[inactiveIdx].currentPath == dir &&
+          !tabs[inactiveIdx].currentFiles.empty()) {
+        applyFsChanges(tabs[inactiveIdx].currentFiles, dir, batch.gone, batch.present, false);
+      }
+    }
+
+    if (currentChanged) {
+      if (!selectedPath.empty()) {
+        size_t idx = currentFiles.indexOf(selectedPath);
+        if (idx != FileListing::npos)
+          selectedIndex = idx;
+      }
+      if (selectedIndex >= currentFiles.size())
+        selectedIndex = currentFiles.empty() ? 0 : currentFiles.size() - 1;
+      std::set<std::string> goneNames(currentBatch->gone.begin(), currentBatch->gone.end());
+      for (auto it = multiSelection.begin(); it != multiSelection.end();) {
+        if (it->parent_path() == currentPath && goneNames.count(it->filename().string()))
+          it = multiSelection.erase(it);
+        else
+          ++it;
+      }
+      queueCv.notify_one();
+    }
+    if (parentChanged) {
+      adjustLeftPane();
+    }
+  }
+
+  // Brings the rows of dir in list up to date with one batch of changes.
+  // Returns true if the listing changed.
+  bool applyFsChanges(FileListing& list, const fs::path& dir, const std::vector<std::string>& gone,
+                      const std::vector<std::string>& present, bool parentOrder) {
+    bool sizes = &list == &currentFiles;
+    return list.applyChanges(
+        dir.string(), gone, present, parentOrder ? SortMode::NAME : sortMode,
+        [&](size_t i, bool added) {
+          if (!sizes) return;
+          if (added) {
+            applyCachedSizes(list, i, i + 1);
+          } else {
+            FileEntry entry = list[i];
+            if (entry.is_directory() && entry.size() == SIZE_CALCULATING)
+              applyCachedSizes(list, i, i + 1);
+          }
+        });
+  }
+
   void toggleHidden() {
     showHidden = !showHidden;
     reloadAll();
@@ -4023,22 +4404,25 @@ public:
 
   void drawParent() {
     if (!winParent) return;
-    werase(winParent);
+    PaneCache& cache = paneCaches[winParent];
+    FrameKey frame;
+    frame.rows = getmaxy(winParent);
+    frame.cols = getmaxx(winParent);
+    frame.flags = parentFiles.empty() ? FRAME_EMPTY : 0;
+    int maxLines = getmaxy(winParent) - 2;
+    if (!cache.valid || cache.frame != frame) {
+      cache.valid = true;
+      cache.frame = frame;
+      cache.rows.assign(maxLines > 0 ? maxLines : 0, RowKey{});
+      werase(winParent);
+    }
     if (parentFiles.empty()) {
       wnoutrefresh(winParent);
       return;
     }
-    wattron(winParent, COLOR_PAIR(6));
-    drawRoundedBox(winParent);
-    wattroff(winParent, COLOR_PAIR(6));
 
-    int maxLines = getmaxy(winParent) - 2;
-    int highlightIdx = -1;
-    for (size_t i = 0; i < parentFiles.size(); ++i)
-      if (parentFiles[i].path == currentPath) {
-        highlightIdx = i;
-        break;
-      }
+    size_t currentIdx = parentFiles.indexOf(currentPath);
+    int highlightIdx = (currentIdx == FileListing::npos) ? -1 : static_cast<int>(currentIdx);
 
     int start = 0;
     if (highlightIdx > maxLines / 2)
@@ -4046,44 +4430,64 @@ public:
     if (start + maxLines > (int)parentFiles.size() && (int)parentFiles.size() > maxLines)
       start = parentFiles.size() - maxLines;
 
-    for (int i = 0; i < maxLines && (start + i) < (int)parentFiles.size(); ++i) {
-      const auto& file = parentFiles[start + i];
-      bool isCurrent = (static_cast<int>(start + i) == highlightIdx);
-      wmove(winParent, i + 1, 1);
-
-      FileStyle style = getFileStyle(file.name, file.extension, file.is_directory, file.is_empty_directory);
-      if (file.is_symlink) {
-        style.icon = ICON_LINK;
+    for (int i = 0; i < maxLines; ++i) {
+      RowKey key;
+      if (start + i < (int)parentFiles.size()) {
+        parentFiles.resolveDetails(start + i);
+        const auto& file = parentFiles[start + i];
+        key.name = file.name();
+        key.marks = (file.is_directory() ? ROW_DIR : 0) | (file.is_symlink() ? ROW_SYMLINK : 0) |
+                    (file.is_empty_directory() ? ROW_EMPTY_DIR : 0) |
+                    (start + i == highlightIdx ? ROW_SELECTED : 0);
       }
-      int finalPair = getFinalPair(style.pair, false, isCurrent);
-
-      std::string display = file.name;
-      if (display.length() > (size_t)getmaxx(winParent) - 8) {
-        int limit = getmaxx(winParent) - 11;
-        if (limit < 1) limit = 1;
-        display = utf8_safe_truncate(display, limit);
+      if (key == cache.rows[i]) continue;
+      clearPaneRow(winParent, i);
+      if (!key.name.empty()) {
+        drawParentRow(i, parentFiles[start + i], key.marks & ROW_SELECTED);
       }
+      cache.rows[i] = std::move(key);
+      for (int j = i + 1; j < maxLines && j < getcury(winParent); ++j)
+        cache.rows[j].marks = ROW_STALE;
+    }
 
-      if (isCurrent) {
-        wattron(winParent, COLOR_PAIR(finalPair) | A_BOLD);
-        for (int j = 0; j < getmaxx(winParent) - 2; ++j)
-          waddch(winParent, ' ');
-        wmove(winParent, i + 1, 1);
+    wattron(winParent, COLOR_PAIR(6));
+    drawRoundedBox(winParent);
+    wattroff(winParent, COLOR_PAIR(6));
+    wnoutrefresh(winParent);
+  }
 
-        wattron(winParent, COLOR_PAIR(6) | A_BOLD);
-        waddstr(winParent, "┃");
-        wattroff(winParent, COLOR_PAIR(6) | A_BOLD);
+  void drawParentRow(int i, const FileEntry& file, bool isCurrent) {
+    FileStyle style = getFileStyle(file.name(), file.extension(), file.is_directory(), file.is_empty_directory());
+    if (file.is_symlink()) {
+      style.icon = ICON_LINK;
+    }
+    int finalPair = getFinalPair(style.pair, false, isCurrent);
 
-        wattron(winParent, COLOR_PAIR(finalPair) | A_BOLD);
-        wprintw(winParent, " %s %s", style.icon, display.c_str());
-        wattroff(winParent, COLOR_PAIR(finalPair) | A_BOLD);
-      } else {
-        wattron(winParent, COLOR_PAIR(finalPair) | A_DIM);
-        wprintw(winParent, "  %s %s", style.icon, display.c_str());
-        wattroff(winParent, COLOR_PAIR(finalPair) | A_DIM);
-      }
+    std::string display = file.name();
+    if (display.length() > (size_t)getmaxx(winParent) - 8) {
+      int limit = getmaxx(winParent) - 11;
+      if (limit < 1) limit = 1;
+      display = utf8_safe_truncate(display, limit);
+    }
+
+    if (isCurrent) {
+      wattron(winParent, COLOR_PAIR(finalPair) | A_BOLD);
+      for (int j = 0; j < getmaxx(winParent) - 2; ++j)
+        waddch(winParent, ' ');
+      wmove(winParent, i + 1, 1);
+
+      wattron(winParent, COLOR_PAIR(6) | A_BOLD);
+      waddstr(winParent, "┃");
+      wattroff(winParent, COLOR_PAIR(6) | A_BOLD);
+
+      wattron(winParent, COLOR_PAIR(finalPair) | A_BOLD);
+      wprintw(winParent, " %s %s", style.icon, display.c_str());
+      wattroff(winParent, COLOR_PAIR(finalPair) | A_BOLD);
+    } else {
+      wattron(winParent, COLOR_PAIR(finalPair) | A_DIM);
+      wprintw(winParent, "  %s %s", style.icon, display.c_str());
+      wattroff(winParent, COLOR_PAIR(finalPair) | A_DIM);
     }
-    wnoutrefresh(winParent);
   }
 
   void drawTabs() {
@@ -4194,7 +4598,7 @@ public:
     tabs[activeTabIndex].isSearching = isSearching;
     tabs[activeTabIndex].isTrashMode = isTrashMode;
     tabs[activeTabIndex].multiSelection = multiSelection;
-    tabs[activeTabIndex].currentFiles = currentFiles;
+    stashActiveListing();
 
     Tab newTab;
     newTab.currentPath = currentPath;
@@ -4244,7 +4648,8 @@ public:
     scrollOffset = tabs[activeTabIndex].scrollOffset;
     isSearching = tabs[activeTabIndex].isSearching;
     isTrashMode = tabs[activeTabIndex].isTrashMode;
-    currentFiles = tabs[activeTabIndex].currentFiles;
+    currentFiles = std::move(tabs[activeTabIndex].currentFiles);
+    tabs[activeTabIndex].currentFiles.clear();
     
     auto savedSelection = tabs[activeTabIndex].multiSelection;
     reloadAll();
@@ -4263,7 +4668,7 @@ public:
     tabs[activeTabIndex].isSearching = isSearching;
     tabs[activeTabIndex].isTrashMode = isTrashMode;
     tabs[activeTabIndex].multiSelection = multiSelection;
-    tabs[activeTabIndex].currentFiles = currentFiles;
+    stashActiveListing();
 
     activeTabIndex = index;
     currentPath = tabs[activeTabIndex].currentPath;
@@ -4271,7 +4676,8 @@ public:
     scrollOffset = tabs[activeTabIndex].scrollOffset;
     isSearching = tabs[activeTabIndex].isSearching;
     isTrashMode = tabs[activeTabIndex].isTrashMode;
-    currentFiles = tabs[activeTabIndex].currentFiles;
+    currentFiles = std::move(tabs[activeTabIndex].currentFiles);
+    tabs[activeTabIndex].currentFiles.clear();
 
     auto savedSelection = tabs[activeTabIndex].multiSelection;
     reloadAll();
@@ -4295,28 +4701,142 @@ public:
     }
   }
 
-  void loadInactiveTabDirectoryIfNeeded(size_t inactiveIdx) {
-    if (inactiveIdx >= tabs.size()) return;
-    if (tabs[inactiveIdx].currentFiles.empty()) {
-      try {
-        std::vector<FileEntry> tempFiles;
-        for (const auto& entry : fs::directory_iterator(tabs[inactiveIdx].currentPath)) {
-          if (!showHidden && entry.path().filename().string().front() == '.')
-            continue;
-          tempFiles.emplace_back(entry);
+  // The active tab's listing lives in currentFiles; a Tab only holds its own
+  // listing while inactive, so switching moves it instead of copying.
+  void stashActiveListing() {
+    if (isStreamingListing) {
+      cancelListing();
+      currentFiles.clear();
+    }
+    tabs[activeTabIndex].currentFiles = std::move(currentFiles);
+    currentFiles.clear();
+  }
+
+  void loadInactiveTabDirectoryIfNeeded(size_t inactiveIdx) {
+    if (inactiveIdx >= tabs.size()) return;
+    if (tabs[inactiveIdx].currentFiles.empty()) {
+      const fs::path& dir = tabs[inactiveIdx].currentPath;
+      FileListing tempFiles;
+      bool nameOrdered = false;
+      if (listingCache.lookup(dir, showHidden, tempFiles, nameOrdered)) {
+        if (!nameOrdered || sortMode != SortMode::NAME)
+          sortList(tempFiles);
+        tabs[inactiveIdx].currentFiles = std::move(tempFiles);
+        return;
+      }
+      try {
+        int64_t mtime = ListingCache::directoryMtime(dir);
+        readDirectoryEntries(dir, showHidden, sortMode != SortMode::NAME, tempFiles);
+        sortList(tempFiles);
+        listingCache.store(dir, showHidden, tempFiles, sortMode == SortMode::NAME, mtime);
+        tabs[inactiveIdx].currentFiles = std::move(tempFiles);
+      } catch (...) {
+        tabs[inactiveIdx].currentFiles.clear();
+      }
+    }
+  }
+
+  // Blanks the inside of row y (0-based, below the top border) before it is
+  // repainted, as werase would.
+  void clearPaneRow(WINDOW* win, int y) {
+    wattrset(win, A_NORMAL);
+    wmove(win, y + 1, 1);
+    for (int j = 0; j < getmaxx(win) - 2; ++j)
+      waddch(win, ' ');
+    wmove(win, y + 1, 1);
+  }
+
+  void drawPane(WINDOW* win, const fs::path& panePath, const FileListing& paneFiles,
+                size_t paneSelectedIndex, size_t& paneScrollOffset,
+                const std::set<fs::path>& paneMultiSelection, bool paneIsSearching,
+                bool paneIsTrashMode, bool hasFocus) {
+    PaneCache& cache = paneCaches[win];
+    FrameKey frame;
+    frame.path = panePath.native();
+    frame.marked = paneMultiSelection.size();
+    frame.rows = getmaxy(win);
+    frame.cols = getmaxx(win);
+    frame.sort = sortMode;
+    frame.flags = (hasFocus ? FRAME_FOCUS : 0) | (paneIsSearching ? FRAME_SEARCHING : 0) |
+                  (paneIsTrashMode ? FRAME_TRASH : 0) | (paneFiles.empty() ? FRAME_EMPTY : 0);
+    int maxLines = getmaxy(win) - 2;
+    if (!cache.valid || cache.frame != frame) {
+      cache.valid = true;
+      cache.frame = frame;
+      cache.rows.assign(maxLines > 0 ? maxLines : 0, RowKey{});
+      drawPaneFrame(win, panePath, paneFiles, paneMultiSelection, paneIsSearching,
+                    paneIsTrashMode, hasFocus);
+    }
+    if (paneFiles.empty()) {
+      wnoutrefresh(win);
+      return;
+    }
+
+    size_t safeSelectedIndex = paneSelectedIndex;
+    if (safeSelectedIndex >= paneFiles.size()) {
+      safeSelectedIndex = paneFiles.size() - 1;
+    }
+
+    if (safeSelectedIndex < paneScrollOffset)
+      paneScrollOffset = safeSelectedIndex;
+    if (safeSelectedIndex >= paneScrollOffset + (size_t)maxLines)
+      paneScrollOffset = safeSelectedIndex - maxLines + 1;
+
+    bool repainted = false;
+    for (int i = 0; i < maxLines; ++i) {
+      size_t idx = paneScrollOffset + i;
+      RowKey key;
+      fs::path filePath;
+      if (idx < paneFiles.size()) {
+        paneFiles.resolveDetails(idx);
+        const auto& file = paneFiles[idx];
+        filePath = file.path();
+        bool inClipboard = false;
+        for (const auto& p : clipboard.paths) {
+          if (p == filePath) {
+            inClipboard = true;
+            break;
+          }
         }
-        sortList(tempFiles);
-        tabs[inactiveIdx].currentFiles = tempFiles;
-      } catch (...) {
-        tabs[inactiveIdx].currentFiles.clear();
-      }
+        key.name = paneIsSearching ? filePath.string() : file.name();
+        key.size = file.size();
+        key.mtime = file.modified_time();
+        if (file.is_symlink()) key.symlinkTarget = file.symlink_target();
+        key.marks = (file.is_directory() ? ROW_DIR : 0) | (file.is_symlink() ? ROW_SYMLINK : 0) |
+                    (file.is_empty_directory() ? ROW_EMPTY_DIR : 0) |
+                    (hasFocus && idx == safeSelectedIndex ? ROW_SELECTED : 0) |
+                    (paneMultiSelection.count(filePath) ? ROW_MULTI : 0) |
+                    (inClipboard ? ROW_CLIPBOARD : 0) | (clipboard.isCut ? ROW_CUT : 0);
+      }
+      if (key == cache.rows[i]) continue;
+      clearPaneRow(win, i);
+      if (idx < paneFiles.size()) {
+        drawPaneRow(win, i, paneFiles[idx], filePath, panePath, paneIsSearching, key.marks);
+      }
+      cache.rows[i] = std::move(key);
+      repainted = true;
+      // Wide characters can wrap a row into the ones below it.
+      for (int j = i + 1; j < maxLines && j < getcury(win); ++j)
+        cache.rows[j].marks = ROW_STALE;
+    }
+
+    if (repainted) {
+      // Redraw the borders at the very end of rendering to ensure they are never broken by text drawing
+      if (hasFocus)
+        wattron(win, COLOR_PAIR(6) | A_BOLD);
+      else
+        wattron(win, COLOR_PAIR(6));
+      drawRoundedBox(win);
+      wattroff(win, A_BOLD);
+      wattroff(win, COLOR_PAIR(6));
     }
+
+    wnoutrefresh(win);
   }
 
-  void drawPane(WINDOW* win, const fs::path& panePath, const std::vector<FileEntry>& paneFiles,
-                size_t paneSelectedIndex, size_t& paneScrollOffset,
-                const std::set<fs::path>& paneMultiSelection, bool paneIsSearching,
-                bool paneIsTrashMode, bool hasFocus) {
+  void drawPaneFrame(WINDOW* win, const fs::path& panePath, const FileListing& paneFiles,
+                     const std::set<fs::path>& paneMultiSelection, bool paneIsSearching,
+                     bool paneIsTrashMode, bool hasFocus) {
     werase(win);
     if (hasFocus)
       wattron(win, COLOR_PAIR(6) | A_BOLD);
@@ -4354,7 +4874,6 @@ public:
       wattron(win, COLOR_PAIR(7) | A_BOLD);
       mvwprintw(win, my / 2, (mx - 15) / 2, "  Searching... ");
       wattroff(win, COLOR_PAIR(7) | A_BOLD);
-      wnoutrefresh(win);
       return;
     }
 
@@ -4365,203 +4884,166 @@ public:
       mvwprintw(win, 0, getmaxx(win) - selStr.length() - 2, "%s", selStr.c_str());
       wattroff(win, COLOR_PAIR(9) | A_BOLD | A_REVERSE);
     }
+  }
 
-    int maxLines = getmaxy(win) - 2;
-    if (paneFiles.empty()) {
-      wnoutrefresh(win);
-      return;
-    }
+  void drawPaneRow(WINDOW* win, int i, const FileEntry& file, const fs::path& filePath,
+                   const fs::path& panePath, bool paneIsSearching, uint16_t marks) {
+    bool isSelected = marks & ROW_SELECTED;
+    bool isMultiSelected = marks & ROW_MULTI;
+    bool inClipboard = marks & ROW_CLIPBOARD;
+    bool isDimmed = inClipboard && clipboard.isCut && !isSelected;
 
-    size_t safeSelectedIndex = paneSelectedIndex;
-    if (safeSelectedIndex >= paneFiles.size()) {
-      safeSelectedIndex = paneFiles.size() - 1;
+    FileStyle style = getFileStyle(file.name(), file.extension(), file.is_directory(), file.is_empty_directory());
+    if (file.is_symlink()) {
+      style.icon = ICON_LINK;
     }
+    int finalPair = getFinalPair(style.pair, isSelected, false);
 
-    if (safeSelectedIndex < paneScrollOffset)
-      paneScrollOffset = safeSelectedIndex;
-    if (safeSelectedIndex >= paneScrollOffset + (size_t)maxLines)
-      paneScrollOffset = safeSelectedIndex - maxLines + 1;
-
-    for (int i = 0; i < maxLines && (paneScrollOffset + i) < paneFiles.size(); ++i) {
-      int idx = paneScrollOffset + i;
-      const auto& file = paneFiles[idx];
+    if (isSelected) {
+      wattron(win, COLOR_PAIR(finalPair) | A_BOLD);
+      for (int j = 0; j < getmaxx(win) - 2; ++j)
+        waddch(win, ' ');
       wmove(win, i + 1, 1);
+    } else if (isMultiSelected) {
+      wattron(win, COLOR_PAIR(9) | A_BOLD);
+    } else {
+      wattron(win, COLOR_PAIR(finalPair));
+    }
+    if (isDimmed) {
+      wattron(win, A_DIM);
+    }
 
-      bool isSelected = (hasFocus && idx == (int)safeSelectedIndex);
-      bool isMultiSelected = paneMultiSelection.count(file.path);
-
-      bool inClipboard = false;
-      for (const auto& p : clipboard.paths) {
-        if (p == file.path) {
-          inClipboard = true;
-          break;
+    std::string dirPart = "";
+    std::string filePart = file.name();
+    if (paneIsSearching) {
+      try {
+        std::string relPath = fs::relative(filePath, panePath).string();
+        size_t lastSlash = relPath.find_last_of("/\\");
+        if (lastSlash != std::string::npos) {
+          dirPart = relPath.substr(0, lastSlash + 1);
+          filePart = relPath.substr(lastSlash + 1);
+        } else {
+          filePart = relPath;
         }
+      } catch (...) {
+        filePart = file.name();
       }
-      bool isDimmed = inClipboard && clipboard.isCut && !isSelected;
-
-      FileStyle style = getFileStyle(file.name, file.extension, file.is_directory, file.is_empty_directory);
-      if (file.is_symlink) {
-        style.icon = ICON_LINK;
-      }
-      int finalPair = getFinalPair(style.pair, isSelected, false);
+    }
 
-      if (isSelected) {
-        wattron(win, COLOR_PAIR(finalPair) | A_BOLD);
-        for (int j = 0; j < getmaxx(win) - 2; ++j)
-          waddch(win, ' ');
-        wmove(win, i + 1, 1);
-      } else if (isMultiSelected) {
-        wattron(win, COLOR_PAIR(9) | A_BOLD);
+    std::string sz;
+    if (sortMode == SortMode::SIZE) {
+      if (file.is_directory() && filePath.string().find("/gvfs/") != std::string::npos) {
+        sz = "DIR";
       } else {
-        wattron(win, COLOR_PAIR(finalPair));
-      }
-      if (isDimmed) {
-        wattron(win, A_DIM);
+        sz = formatSize(file.size());
       }
+    } else {
+      sz = file.modified_time_str();
+    }
 
-      std::string dirPart = "";
-      std::string filePart = file.name;
-      if (paneIsSearching) {
-        try {
-          std::string relPath = fs::relative(file.path, panePath).string();
-          size_t lastSlash = relPath.find_last_of("/\\");
-          if (lastSlash != std::string::npos) {
-            dirPart = relPath.substr(0, lastSlash + 1);
-            filePart = relPath.substr(lastSlash + 1);
-          } else {
-            filePart = relPath;
-          }
-        } catch (...) {
-          filePart = file.name;
-        }
-      }
+    int availWidth = getmaxx(win) - sz.length() - 11;
+    if (availWidth < 10) availWidth = 10;
+
+    std::string fullDisplay = dirPart + filePart;
+    std::string symDisplay = "";
+    if (file.is_symlink()) {
+      symDisplay = " 󰌹 " + file.symlink_target();
+    }
 
-      std::string sz;
-      if (sortMode == SortMode::SIZE) {
-        if (file.is_directory && file.path.string().find("/gvfs/") != std::string::npos) {
-          sz = "DIR";
+    std::string totalDisplay = fullDisplay + symDisplay;
+    size_t totalLen = utf8_length(totalDisplay);
+    if (totalLen > (size_t)availWidth) {
+      size_t fullLen = utf8_length(fullDisplay);
+      if (fullLen >= (size_t)availWidth) {
+        int limit = (int)availWidth - 3;
+        if (limit < 1) limit = 1;
+        fullDisplay = utf8_safe_truncate(fullDisplay, limit);
+        size_t lastSlash = fullDisplay.find_last_of("/\\");
+        if (lastSlash != std::string::npos) {
+          dirPart = fullDisplay.substr(0, lastSlash + 1);
+          filePart = fullDisplay.substr(lastSlash + 1);
         } else {
-          sz = formatSize(file.size);
+          dirPart = "";
+          filePart = fullDisplay;
         }
+        symDisplay = "";
       } else {
-        sz = file.modified_time_str;
-      }
-
-      int availWidth = getmaxx(win) - sz.length() - 11;
-      if (availWidth < 10) availWidth = 10;
-
-      std::string fullDisplay = dirPart + filePart;
-      std::string symDisplay = "";
-      if (file.is_symlink) {
-        symDisplay = " 󰌹 " + file.symlink_target;
-      }
-
-      std::string totalDisplay = fullDisplay + symDisplay;
-      size_t totalLen = utf8_length(totalDisplay);
-      if (totalLen > (size_t)availWidth) {
-        size_t fullLen = utf8_length(fullDisplay);
-        if (fullLen >= (size_t)availWidth) {
-          int limit = (int)availWidth - 3;
+        size_t maxSymLen = availWidth - fullLen;
+        if (maxSymLen >= 7) {
+          std::string symTarget = file.symlink_target();
+          int limit = (int)maxSymLen - 3;
           if (limit < 1) limit = 1;
-          fullDisplay = utf8_safe_truncate(fullDisplay, limit);
-          size_t lastSlash = fullDisplay.find_last_of("/\\");
-          if (lastSlash != std::string::npos) {
-            dirPart = fullDisplay.substr(0, lastSlash + 1);
-            filePart = fullDisplay.substr(lastSlash + 1);
-          } else {
-            dirPart = "";
-            filePart = fullDisplay;
-          }
-          symDisplay = "";
+          symTarget = utf8_safe_truncate(symTarget, limit);
+          symDisplay = " 󰌹 " + symTarget;
         } else {
-          size_t maxSymLen = availWidth - fullLen;
-          if (maxSymLen >= 7) {
-            std::string symTarget = file.symlink_target;
-            int limit = (int)maxSymLen - 3;
-            if (limit < 1) limit = 1;
-            symTarget = utf8_safe_truncate(symTarget, limit);
-            symDisplay = " 󰌹 " + symTarget;
-          } else {
-            symDisplay = "";
-          }
+          symDisplay = "";
         }
       }
+    }
 
-      std::string marker = " ";
-      if (isMultiSelected) {
-        marker = "*";
-      } else if (inClipboard) {
-        marker = clipboard.isCut ? "󰆐" : "󰆏";
-      }
+    std::string marker = " ";
+    if (isMultiSelected) {
+      marker = "*";
+    } else if (inClipboard) {
+      marker = clipboard.isCut ? "󰆐" : "󰆏";
+    }
 
-      if (isSelected) {
-        wattron(win, COLOR_PAIR(6) | A_BOLD);
-        waddstr(win, "┃");
-        wattroff(win, COLOR_PAIR(6) | A_BOLD);
+    if (isSelected) {
+      wattron(win, COLOR_PAIR(6) | A_BOLD);
+      waddstr(win, "┃");
+      wattroff(win, COLOR_PAIR(6) | A_BOLD);
 
-        wattron(win, COLOR_PAIR(finalPair) | A_BOLD);
-        wprintw(win, "%s%s ", marker.c_str(), style.icon);
-      } else {
-        wprintw(win, " %s%s ", marker.c_str(), style.icon);
-      }
+      wattron(win, COLOR_PAIR(finalPair) | A_BOLD);
+      wprintw(win, "%s%s ", marker.c_str(), style.icon);
+    } else {
+      wprintw(win, " %s%s ", marker.c_str(), style.icon);
+    }
 
-      if (paneIsSearching && !dirPart.empty()) {
-        if (isSelected) {
-          wprintw(win, "%s%s", dirPart.c_str(), filePart.c_str());
-        } else {
-          wattron(win, A_DIM);
-          wprintw(win, "%s", dirPart.c_str());
-          wattroff(win, A_DIM);
-          wprintw(win, "%s", filePart.c_str());
-        }
+    if (paneIsSearching && !dirPart.empty()) {
+      if (isSelected) {
+        wprintw(win, "%s%s", dirPart.c_str(), filePart.c_str());
       } else {
+        wattron(win, A_DIM);
+        wprintw(win, "%s", dirPart.c_str());
+        wattroff(win, A_DIM);
         wprintw(win, "%s", filePart.c_str());
       }
+    } else {
+      wprintw(win, "%s", filePart.c_str());
+    }
 
-      if (!symDisplay.empty()) {
-        bool targetDimmed = !isSelected;
-        if (targetDimmed) {
-          wattron(win, A_DIM);
-        }
-        wprintw(win, "%s", symDisplay.c_str());
-        if (targetDimmed) {
-          wattroff(win, A_DIM);
-        }
-      }
-
-      // Explicitly clear the gap between filename/symlink and the date/size string
-      int dateStart = getmaxx(win) - sz.length() - 2;
-      int curY, curX;
-      getyx(win, curY, curX);
-      for (int k = curX; k < dateStart; ++k) {
-        waddch(win, ' ');
-      }
-      wprintw(win, "%s", sz.c_str());
-
-      if (isDimmed) {
+    if (!symDisplay.empty()) {
+      bool targetDimmed = !isSelected;
+      if (targetDimmed) {
         wattron(win, A_DIM);
       }
-      if (isSelected) {
-        wattroff(win, COLOR_PAIR(finalPair) | A_BOLD);
-      } else if (isMultiSelected)
-        wattroff(win, COLOR_PAIR(9) | A_BOLD);
-      else
-        wattroff(win, COLOR_PAIR(finalPair));
-      if (isDimmed) {
+      wprintw(win, "%s", symDisplay.c_str());
+      if (targetDimmed) {
         wattroff(win, A_DIM);
       }
     }
 
-    // Redraw the borders at the very end of rendering to ensure they are never broken by text drawing
-    if (hasFocus)
-      wattron(win, COLOR_PAIR(6) | A_BOLD);
-    else
-      wattron(win, COLOR_PAIR(6));
-    drawRoundedBox(win);
-    wattroff(win, A_BOLD);
-    wattroff(win, COLOR_PAIR(6));
+    // Explicitly clear the gap between filename/symlink and the date/size string
+    int dateStart = getmaxx(win) - sz.length() - 2;
+    int curY, curX;
+    getyx(win, curY, curX);
+    for (int k = curX; k < dateStart; ++k) {
+      waddch(win, ' ');
+    }
+    wprintw(win, "%s", sz.c_str());
 
-    wnoutrefresh(win);
+    if (isDimmed) {
+      wattron(win, A_DIM);
+    }
+    if (isSelected) {
+      wattroff(win, COLOR_PAIR(finalPair) | A_BOLD);
+    } else if (isMultiSelected)
+      wattroff(win, COLOR_PAIR(9) | A_BOLD);
+    else
+      wattroff(win, COLOR_PAIR(finalPair));
+    if (isDimmed) {
+      wattroff(win, A_DIM);
+    }
   }
 
   void drawCurrent() {
@@ -4578,6 +5060,9 @@ public:
       return;
     }
 
+    if (isStreamingListing && visibleWindowEnd() > listingSortedPrefix) {
+      sortVisibleWindow();
+    }
     drawPane(winCurrent, currentPath, currentFiles, selectedIndex, scrollOffset, multiSelection, isSearching, isTrashMode, !focusPinned);
   }
 
@@ -4808,7 +5293,6 @@ public:
 
     WINDOW* devWin = newwin(h, w, startY, startX);
     keypad(devWin, TRUE);
-    wtimeout(devWin, 200);
 
     size_t selectedDeviceIndex = 0;
 
@@ -4909,7 +5393,7 @@ public:
 
       wrefresh(devWin);
 
-      int ch = wgetch(devWin);
+      int ch = waitKey(devWin, -1);
       if (ch == ERR) {
         if (devicesTriggered) {
           devicesTriggered = false;
@@ -5153,7 +5637,7 @@ public:
       return;
     }
     const auto& file = currentFiles[selectedIndex];
-    FileDetails details = getFileDetails(file.path);
+    FileDetails details = getFileDetails(file.path());
 
     int h = details.isSymlink ? 17 : 16;
     int w = 70;
@@ -5190,7 +5674,6 @@ public:
     };
 
     keypad(detWin, TRUE);
-    wtimeout(detWin, 200);
 
     while (true) {
       werase(detWin);
@@ -5249,7 +5732,7 @@ public:
 
       wrefresh(detWin);
 
-      int ch = wgetch(detWin);
+      int ch = waitKey(detWin, -1);
       if (ch != ERR) {
         break;
       }
@@ -5258,105 +5741,202 @@ public:
     delwin(detWin);
   }
 
-  void handleFuzzyFind() {
-    std::string query = promptInput("Fuzzy Find");
-    if (query.empty())
-      return;
-
-    setStatus("Searching...");
-    isSearching = true;
-    currentFiles.clear();
-    selectedIndex = 0;
-    scrollOffset = 0;
-    refresh();
-
-    cancelSearch();
-    fs::path searchPath = currentPath;
+  // The index for root, reused while it is fresh; otherwise a new one is
+  // walked in the background and can be queried right away.
+  std::shared_ptr<PathIndex> fuzzyIndexFor(const fs::path& root) {
+    auto now = std::chrono::steady_clock::now();
+    if (fuzzyIndex && fuzzyIndex->root() == root.string() &&
+        (!fuzzyIndex->complete() || now - fuzzyIndex->builtAt() < FUZZY_INDEX_TTL)) {
+      return fuzzyIndex;
+    }
+    stopFuzzyIndex();
+    fuzzyIndexCancel = false;
+    auto index = std::make_shared<PathIndex>(root.string());
+    fuzzyIndex = index;
+    fuzzyIndexThread = std::thread([this, index]() {
+      index->build([this]() { return fuzzyIndexCancel.load(); });
+    });
+    return index;
+  }
 
-    long long reqId = searchRequestID;
+  void stopFuzzyIndex() {
+    fuzzyIndexCancel = true;
+    if (fuzzyIndexThread.joinable()) {
+      fuzzyIndexThread.join();
+    }
+  }
 
-    searchThread = std::thread([this, query, reqId, searchPath]() {
-      std::string cmd = "find " + escapeShellArg(searchPath.string()) + " -name .git -prune -o -print 2>/dev/null";
-      FILE* pipe = nullptr;
-      {
-        std::lock_guard<std::mutex> lock(searchMutex);
-        if (reqId != searchRequestID) return;
-        searchPipe = popen(cmd.c_str(), "r");
-        pipe = searchPipe;
-      }
-      if (!pipe) {
-        {
-          std::lock_guard<std::mutex> lock(searchMutex);
-          if (searchPipe == pipe) searchPipe = nullptr;
-        }
-        if (reqId == searchRequestID) {
-          setStatus("Error: Failed to run find");
-        }
-        return;
-      }
+  void handleFuzzyFind() {
+    clearDirectRender();
+    fs::path root = currentPath;
+    std::shared_ptr<PathIndex> index = fuzzyIndexFor(root);
+    FuzzyMatcher matcher(index);
 
-      std::vector<FileEntry> results;
-      char buffer[4096];
-      auto lastUpdate = std::chrono::steady_clock::now();
+    int h = height - 4;
+    int w = width - 8;
+    if (h > 30) h = 30;
+    if (w > 110) w = 110;
+    if (h < 8) h = 8;
+    if (w < 30) w = 30;
+
+    WINDOW* findWin = newwin(h, w, (height - h) / 2, (width - w) / 2);
+    if (!findWin) return;
+    keypad(findWin, TRUE);
+
+    int maxRows = h - 6;
+    std::string query;
+    std::vector<FuzzyHit> hits;
+    size_t total = 0;
+    size_t selected = 0;
+    size_t listOffset = 0;
+    uint32_t searchedSize = 0;
+    bool dirty = true;
+    std::vector<uint32_t> positions;
+    fs::path chosen;
 
-      while (true) {
-        char* res = fgets(buffer, sizeof(buffer), pipe);
-        if (!res || reqId != searchRequestID) break;
-        std::string pathStr(buffer);
-        if (!pathStr.empty() && pathStr.back() == '\n')
-          pathStr.pop_back();
-        if (!pathStr.empty()) {
-          try {
-            fs::path p(pathStr);
-            if (p == currentPath) continue;
-            std::string relPath = fs::relative(p, currentPath).string();
-            if (fuzzyMatch(relPath, query)) {
-              if (fs::exists(p)) {
-                results.emplace_back(p);
-              }
-            }
-          } catch (...) {
+    while (true) {
+      uint32_t indexSize = index->size();
+      if (dirty || indexSize != searchedSize) {
+        hits = matcher.search(query, FUZZY_MAX_RESULTS, total);
+        searchedSize = indexSize;
+        if (dirty) {
+          selected = 0;
+          listOffset = 0;
+        }
+        if (selected >= hits.size()) selected = hits.empty() ? 0 : hits.size() - 1;
+        dirty = false;
+      }
+      if (selected < listOffset) listOffset = selected;
+      if (selected >= listOffset + maxRows) listOffset = selected - maxRows + 1;
+
+      werase(findWin);
+      wattron(findWin, COLOR_PAIR(6) | A_BOLD);
+      drawRoundedBox(findWin);
+      wattroff(findWin, COLOR_PAIR(6) | A_BOLD);
+
+      wattron(findWin, COLOR_PAIR(1) | A_BOLD);
+      mvwprintw(findWin, 1, 2, " Fuzzy Find");
+      wattroff(findWin, COLOR_PAIR(1) | A_BOLD);
+      std::string counts = std::to_string(total) + "/" + std::to_string(indexSize) +
+                           (index->complete() ? "" : " (indexing...)");
+      wattron(findWin, A_DIM);
+      mvwprintw(findWin, 1, std::max(14, w - 2 - (int)counts.size()), "%s", counts.c_str());
+      wattroff(findWin, A_DIM);
+
+      std::string shownQuery = utf8_safe_truncate_left(query, w - 8);
+      wattron(findWin, COLOR_PAIR(6) | A_BOLD);
+      mvwprintw(findWin, 2, 2, "❯ ");
+      wattroff(findWin, COLOR_PAIR(6) | A_BOLD);
+      wprintw(findWin, "%s", shownQuery.c_str());
+      int cursorX = getcurx(findWin);
+
+      for (int row = 0; row < maxRows && listOffset + row < hits.size(); ++row) {
+        size_t i = listOffset + row;
+        bool isSel = i == selected;
+        int lineY = 4 + row;
+        std::string rel = matcher.path(hits[i].index);
+        bool isDir = matcher.isDir(hits[i].index);
+        if (isDir) rel += "/";
+        positions.clear();
+        fuzzyScore(rel, query, &positions);
+
+        // Keep the tail of long paths, shifting the match positions with it.
+        std::string text = utf8_safe_truncate_left(rel, w - 8);
+        size_t shift = 0;
+        if (text.size() != rel.size()) shift = rel.size() - (text.size() - 3);
+
+        attr_t base = isSel ? (COLOR_PAIR(6) | A_BOLD) : isDir ? COLOR_PAIR(1) : A_NORMAL;
+        wattron(findWin, base);
+        if (isSel) {
+          for (int j = 1; j < w - 1; ++j) mvwaddch(findWin, lineY, j, ' ');
+        }
+        mvwprintw(findWin, lineY, 2, isSel ? "➜ " : "  ");
+        size_t p = 0, run = 0;
+        while (run < text.size()) {
+          bool hit = false;
+          if (run >= (shift ? 3 : 0)) {
+            size_t orig = run - (shift ? 3 : 0) + shift;
+            while (p < positions.size() && positions[p] < orig) ++p;
+            hit = p < positions.size() && positions[p] == orig;
           }
-        }
-
-        auto now = std::chrono::steady_clock::now();
-        if (std::chrono::duration_cast<std::chrono::milliseconds>(now - lastUpdate).count() > 50 && !results.empty()) {
-          if (reqId == searchRequestID) {
-            std::lock_guard<std::mutex> lock(searchResultMutex);
-            pendingSearchResults = results;
-            pendingSearchStatus = "Fuzzy Find: Searching... Found " + std::to_string(results.size()) + " matches";
-            hasPendingSearchResults = true;
-            searchReady = true;
+          size_t end = run + 1;
+          while (end < text.size() && (text[end] & 0xC0) == 0x80) ++end;
+          if (hit) wattron(findWin, COLOR_PAIR(4) | A_BOLD);
+          waddnstr(findWin, text.data() + run, end - run);
+          if (hit) {
+            wattroff(findWin, COLOR_PAIR(4) | A_BOLD);
+            wattron(findWin, base);
           }
-          lastUpdate = now;
+          run = end;
         }
+        wattroff(findWin, base);
+      }
+      if (hits.empty() && !query.empty() && index->complete()) {
+        wattron(findWin, A_ITALIC | COLOR_PAIR(27));
+        mvwprintw(findWin, h / 2, (w - 16) / 2, "No matches found");
+        wattroff(findWin, A_ITALIC | COLOR_PAIR(27));
       }
 
-      {
-        std::lock_guard<std::mutex> lock(searchMutex);
-        if (searchPipe == pipe) {
-          searchPipe = nullptr;
-        } else {
-          pipe = nullptr;
+      wattron(findWin, A_DIM);
+      mvwprintw(findWin, h - 2, 2, "[Enter] Jump  [Up/Down] Select  [Ctrl-U] Clear  [Esc] Close");
+      wattroff(findWin, A_DIM);
+      wmove(findWin, 2, cursorX);
+      curs_set(1);
+      wrefresh(findWin);
+
+      // Redraw as the index grows while it is still being walked.
+      int ch = waitKey(findWin, index->complete() ? -1 : 50);
+      if (ch == ERR) continue;
+      if (ch == 27) break;
+      if (ch == 10 || ch == KEY_ENTER) {
+        if (selected < hits.size()) {
+          chosen = root / matcher.path(hits[selected].index);
         }
+        break;
       }
-      if (pipe) {
-        pclose(pipe);
+      if (ch == KEY_DOWN || ch == 14) { // Ctrl-N
+        if (selected + 1 < hits.size()) selected++;
+      } else if (ch == KEY_UP || ch == 16) { // Ctrl-P
+        if (selected > 0) selected--;
+      } else if (ch == KEY_NPAGE) {
+        selected = std::min(selected + maxRows, hits.empty() ? 0 : hits.size() - 1);
+      } else if (ch == KEY_PPAGE) {
+        selected = selected > (size_t)maxRows ? selected - maxRows : 0;
+      } else if (ch == KEY_BACKSPACE || ch == 127 || ch == 8) {
+        if (!query.empty()) {
+          // Drop a whole UTF-8 sequence.
+          size_t cut = query.size() - 1;
+          while (cut > 0 && (query[cut] & 0xC0) == 0x80) cut--;
+          query.erase(cut);
+          dirty = true;
+        }
+      } else if (ch == 21) { // Ctrl-U
+        query.clear();
+        dirty = true;
+      } else if (ch >= 32 && ch < 256 && ch != 127) {
+        query += static_cast<char>(ch);
+        dirty = true;
       }
+    }
 
-      if (reqId == searchRequestID) {
-        std::lock_guard<std::mutex> lock(searchResultMutex);
-        pendingSearchResults = results;
-        pendingSearchStatus = results.empty() ? ("No matches found for: " + query) : ("Fuzzy Find finished. Found " + std::to_string(results.size()) + " matches");
-        hasPendingSearchResults = true;
-        searchReady = true;
-      }
-    });
+    curs_set(0);
+    delwin(findWin);
+    updateLayout();
+
+    if (chosen.empty()) return;
+    if (isSearching) {
+      cancelSearch();
+      isSearching = false;
+    }
+    changeDirectory(chosen.parent_path(), true);
+    reloadAll();
+    selectPathWhenLoaded(chosen);
+    setStatus("Found " + chosen.string());
   }
 
   void drawHelpOverlay() {
     clearDirectRender();
-    int h = 27;
+    int h = 28;
     int w = 82;
     if (h > height - 2) h = height - 2;
     if (w > width - 2) w = width - 2;
@@ -5419,7 +5999,7 @@ public:
     int rCol = w / 2 + 1;
     printHelpLine(3, rCol, "P", "Pin Directory");
     printHelpLine(4, rCol, "F5 / Ctrl+R", "Refresh Directory");
-    printHelpLine(5, rCol, "/", "Search (ripgrep)");
+    printHelpLine(5, rCol, "/", "Search contents");
     printHelpLine(6, rCol, "f", "Fuzzy Find");
     printHelpLine(7, rCol, "w", "Show Active Tasks");
     printHelpLine(8, rCol, "i", "Show File Details");
@@ -5439,6 +6019,7 @@ public:
     printHelpLine(22, rCol, "Ctrl+B / H", "Shrink Pane Width");
     printHelpLine(23, rCol, "F4", "Toggle Parent Pane");
     printHelpLine(24, rCol, "F6", "Toggle Bookmarks Pane");
+    printHelpLine(25, rCol, "S", "Hot Path Latencies");
 
     std::string closeMsg = "Press any key to close...";
     if ((int)closeMsg.length() > w - 4) {
@@ -5452,7 +6033,7 @@ public:
 
     timeout(-1);
     getch();
-    timeout(50);
+    timeout(0);
 
     delwin(helpWin);
   }
@@ -5474,7 +6055,6 @@ public:
     if (!taskWin) return;
 
     keypad(taskWin, TRUE);
-    wtimeout(taskWin, 200);
 
     size_t highlightedIndex = 0;
 
@@ -5572,7 +6152,8 @@ public:
 
           std::string metrics = "";
           if (!task->isFinished.load()) {
-            if (task->totalBytes > 0 && task->bytesProcessed.load() >= task->totalBytes) {
+            if (task->totalBytesFinal && task->totalBytes > 0 &&
+                task->bytesProcessed.load() >= task->totalBytes) {
               metrics = "[Finalizing...]";
             } else {
               double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - task->startTime).count();
@@ -5602,7 +6183,9 @@ public:
                         mins = mins % 60;
                         return std::to_string(hours) + "h " + std::to_string(mins) + "m";
                       };
-                      metrics += " ETA: " + formatETA(remainingSeconds);
+                      // Still measuring: the total (and so the ETA) is a lower bound.
+                      metrics += std::string(task->totalBytesFinal ? " ETA: " : " ETA: ~") +
+                                 formatETA(remainingSeconds);
                     }
                   }
                 }
@@ -5676,7 +6259,12 @@ public:
 
       wrefresh(taskWin);
 
-      int ch = wgetch(taskWin);
+      // Progress is redrawn while anything runs; otherwise only keys and
+      // finishing tasks wake the overlay.
+      bool anyRunning = std::any_of(tasksCopy.begin(), tasksCopy.end(), [](const auto& t) {
+        return !t->isFinished.load();
+      });
+      int ch = waitKey(taskWin, anyRunning ? 200 : -1);
       if (ch != ERR) {
         if (ch == 'c' || ch == 'C') {
           std::lock_guard<std::mutex> lock(taskMutex);
@@ -5715,11 +6303,125 @@ public:
       }
     }
 
-    timeout(50);
+    timeout(0);
     delwin(taskWin);
     updateLayout();
   }
 
+  static std::string formatTraceNs(uint64_t ns) {
+    std::stringstream ss;
+    ss << std::fixed << std::setprecision(2);
+    if (ns < 10000) ss << ns / 1e3 << "us";
+    else if (ns < 10000000000ULL) ss << ns / 1e6 << "ms";
+    else ss << ns / 1e9 << "s";
+    return ss.str();
+  }
+
+  // Live latencies of the timed hot paths (see trace.h), refreshed twice a
+  // second while open.
+  void drawStatsOverlay() {
+    clearDirectRender();
+    int h = height - 4;
+    int w = width - 8;
+    if (h < 12) h = 12;
+    if (w < 76) w = 76;
+    if (h > height - 2) h = height - 2;
+    if (w > width - 2) w = width - 2;
+
+    WINDOW* statsWin = newwin(h, w, (height - h) / 2, (width - w) / 2);
+    if (!statsWin) return;
+    keypad(statsWin, TRUE);
+
+    while (true) {
+      werase(statsWin);
+      wattron(statsWin, COLOR_PAIR(6) | A_BOLD);
+      drawRoundedBox(statsWin);
+      wattroff(statsWin, COLOR_PAIR(6) | A_BOLD);
+
+      wattron(statsWin, COLOR_PAIR(1) | A_BOLD);
+      mvwprintw(statsWin, 1, 2, "%s", utf8_safe_truncate("󰓅 Hot Path Latencies", w - 6).c_str());
+      wattroff(statsWin, COLOR_PAIR(1) | A_BOLD);
+
+      wattron(statsWin, COLOR_PAIR(6) | A_DIM);
+      std::string separator = "";
+      for (int k = 0; k < w - 2; ++k) {
+        separator += "─";
+      }
+      mvwprintw(statsWin, 2, 1, "%s", separator.c_str());
+      wattroff(statsWin, COLOR_PAIR(6) | A_DIM);
+
+      int nameW = std::max(12, w - 2 - 4 - 5 * 10);
+      wattron(statsWin, A_BOLD);
+      mvwprintw(statsWin, 3, 2, "%-*s%10s%10s%10s%10s%10s", nameW, "Scope", "Count", "Mean", "p50",
+                "p99", "Max");
+      wattroff(statsWin, A_BOLD);
+
+      std::vector<TraceStats> stats = traceStats();
+      if (stats.empty()) {
+        wattron(statsWin, A_DIM);
+        mvwprintw(statsWin, 5, (w - 22) / 2, "Nothing timed yet");
+        wattroff(statsWin, A_DIM);
+      }
+      for (size_t i = 0; i < stats.size() && (int)i < h - 6; ++i) {
+        const TraceStats& st = stats[i];
+        wattron(statsWin, COLOR_PAIR(1));
+        mvwprintw(statsWin, 4 + i, 2, "%-*s", nameW, utf8_safe_truncate(st.name, nameW - 1).c_str());
+        wattroff(statsWin, COLOR_PAIR(1));
+        mvwprintw(statsWin, 4 + i, 2 + nameW, "%10llu%10s%10s%10s", (unsigned long long)st.count,
+                  formatTraceNs(st.totalNs / st.count).c_str(), formatTraceNs(st.p50Ns).c_str(),
+                  formatTraceNs(st.p99Ns).c_str());
+        wattron(statsWin, st.maxNs > 16000000 ? COLOR_PAIR(8) | A_BOLD : COLOR_PAIR(7));
+        mvwprintw(statsWin, 4 + i, 2 + nameW + 40, "%10s", formatTraceNs(st.maxNs).c_str());
+        wattroff(statsWin, st.maxNs > 16000000 ? COLOR_PAIR(8) | A_BOLD : COLOR_PAIR(7));
+      }
+
+      wattron(statsWin, A_DIM);
+      mvwprintw(statsWin, h - 2, 2, "%s",
+                utf8_safe_truncate("[r] Reset  [Esc/q] Close   percentiles are power-of-two bucket bounds",
+                                   w - 4)
+                    .c_str());
+      wattroff(statsWin, A_DIM);
+      wrefresh(statsWin);
+
+      int ch = waitKey(statsWin, 500);
+      if (ch == 'r' || ch == 'R') {
+        traceReset();
+      } else if (ch == 27 || ch == 'q' || ch == 'Q') {
+        break;
+      }
+    }
+
+    timeout(0);
+    delwin(statsWin);
+    updateLayout();
+  }
+
+  // What the single-pane preview of the selected entry is drawn from.
+  PreviewKey previewKey() {
+    PreviewKey key;
+    key.rows = getmaxy(winPreview);
+    key.cols = getmaxx(winPreview);
+    key.flags = (isTrashMode ? PREVIEW_TRASH : 0) | (showHidden ? PREVIEW_HIDDEN : 0);
+    if (currentFiles.empty() || selectedIndex >= currentFiles.size()) return key;
+    currentFiles.resolveDetails(selectedIndex);
+    const auto& file = currentFiles[selectedIndex];
+    key.path = file.path().string();
+    key.size = file.size();
+    key.mtime = file.modified_time();
+    if (file.is_directory()) {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      auto it = dirSizeCache.find(key.path);
+      if (it != dirSizeCache.end()) {
+        key.dirSize = it->second;
+        key.flags |= PREVIEW_DIR_SIZE;
+      }
+    }
+    std::lock_guard<std::mutex> lock(previewMutex);
+    if (cachedPath == key.path)
+      key.flags |= PREVIEW_READY | (cachedListingPartial ? PREVIEW_PARTIAL : 0);
+    return key;
+  }
+
   void drawPreview() {
     if (!winPreview) return;
     if (isDualPaneMode) {
@@ -5735,22 +6437,30 @@ public:
       return;
     }
 
+    PreviewKey key = previewKey();
+    if (previewDrawn && key == drawnPreview) {
+      wnoutrefresh(winPreview);
+      return;
+    }
+    drawnPreview = std::move(key);
+    previewDrawn = true;
+
     bool samePathAndImage = false;
     if (!currentFiles.empty() && selectedIndex < currentFiles.size()) {
       const auto& nextFile = currentFiles[selectedIndex];
-      std::string extLower = nextFile.extension;
+      std::string extLower = nextFile.extension();
       std::transform(extLower.begin(), extLower.end(), extLower.begin(), ::tolower);
       bool isArchive = (extLower == ".zip" || extLower == ".tar" || extLower == ".gz" || extLower == ".tgz" || 
                         extLower == ".rar" || extLower == ".bz2" || extLower == ".xz" || extLower == ".7z");
       bool isAudio = (extLower == ".mp3" || extLower == ".wav" || extLower == ".flac" || extLower == ".ogg" || 
                       extLower == ".m4a" || extLower == ".aac" || extLower == ".opus" || extLower == ".wma");
-      bool isCode = isCodeFile(nextFile.extension);
+      bool isCode = isCodeFile(nextFile.extension());
       bool isTextPreviewable = isCode || isArchive || isAudio;
       
-      bool isVid = VIDEO_EXTS.count(nextFile.extension);
-      bool isImg = IMAGE_EXTS.count(nextFile.extension);
+      bool isVid = VIDEO_EXTS.count(nextFile.extension());
+      bool isImg = IMAGE_EXTS.count(nextFile.extension());
       
-      if (nextFile.path.string() == cachedPath && !isTextPreviewable && (isVid || isImg)) {
+      if (nextFile.path().string() == cachedPath && !isTextPreviewable && (isVid || isImg)) {
         samePathAndImage = true;
       }
     }
@@ -5771,13 +6481,14 @@ public:
       wnoutrefresh(winPreview);
       return;
     }
+    currentFiles.resolveDetails(selectedIndex);
     const auto& file = currentFiles[selectedIndex];
     int maxW = getmaxx(winPreview) - 4;
     int maxH = getmaxy(winPreview) - 2;
 
     // Header info with better colors
     wattron(winPreview, A_BOLD | COLOR_PAIR(1));
-    std::string dispName = file.name;
+    std::string dispName = file.name();
     int titleMaxW = getmaxx(winPreview) - 8;
     if (titleMaxW < 5) titleMaxW = 5;
     if ((int)dispName.length() > titleMaxW) {
@@ -5790,15 +6501,15 @@ public:
 
     wattron(winPreview, A_DIM);
     std::string previewSizeStr;
-    if (file.is_directory) {
-      if (file.path.string().find("/gvfs/") != std::string::npos) {
+    if (file.is_directory()) {
+      if (file.path().string().find("/gvfs/") != std::string::npos) {
         previewSizeStr = "DIR";
       } else {
         uintmax_t sizeVal = 0;
         bool cached = false;
         {
           std::lock_guard<std::mutex> lock(cacheMutex);
-          auto it = dirSizeCache.find(file.path.string());
+          auto it = dirSizeCache.find(file.path().string());
           if (it != dirSizeCache.end()) {
             sizeVal = it->second;
             cached = true;
@@ -5808,46 +6519,53 @@ public:
           previewSizeStr = formatSize(sizeVal);
         } else {
           previewSizeStr = "Calculating...";
+          uintmax_t indexed = 0;
+          if (file.size() > 0 && file.size() != SIZE_CALCULATING) {
+            previewSizeStr = formatSize(file.size()) + " (calculating...)";
+          } else if (sizeIndex.estimate(file.path(), indexed)) {
+            previewSizeStr = formatSize(indexed) + " (calculating...)";
+          }
           std::lock_guard<std::mutex> qLock(queueMutex);
           bool alreadyQueued = false;
           for (const auto& job : sizeQueue) {
-            if (job.path == file.path) {
+            if (job.path == file.path()) {
               alreadyQueued = true;
               break;
             }
           }
           if (!alreadyQueued) {
-            sizeQueue.push_back({file.path, currentViewId.load()});
+            sizeQueue.push_back({file.path(), currentViewId.load()});
             queueCv.notify_one();
           }
         }
       }
     } else {
-      previewSizeStr = formatSize(file.size);
+      previewSizeStr = formatSize(file.size());
     }
     mvwprintw(winPreview, 2, 2, " Size: %s", previewSizeStr.c_str());
 
     std::string typeStr;
-    if (file.is_symlink) {
+    if (file.is_symlink()) {
       typeStr = "Symlink -> ";
-      if (!file.symlink_target_exists) {
+      if (!file.symlink_target_exists()) {
         typeStr += "[Broken]";
-      } else if (file.is_symlink_directory) {
+      } else if (file.is_symlink_directory()) {
         typeStr += "Directory";
       } else {
-        typeStr += (file.extension.empty() ? "File" : file.extension.c_str());
+        typeStr += (file.extension().empty() ? "File" : file.extension().c_str());
       }
     } else {
-      typeStr = file.is_directory ? "Directory"
-                                  : (file.extension.empty() ? "File" : file.extension.c_str());
+      typeStr = file.is_directory() ? "Directory"
+                                  : (file.extension().empty() ? "File" : file.extension().c_str());
     }
     mvwprintw(winPreview, 3, 2, " Type: %s", typeStr.c_str());
-    mvwprintw(winPreview, 4, 2, " Modified: %s", getFileModifiedTime(file.path).c_str());
+    mvwprintw(winPreview, 4, 2, " Modified: %s", getFileModifiedTime(file.path()).c_str());
     wattroff(winPreview, A_DIM);
 
     int dividerLine = 5;
     if (isTrashMode) {
-      TrashInfo ti = getTrashInfo(file.path);
+      TrashInfo ti;
+      trash.info(file.path(), ti);
       std::string orig = ti.originalPath;
       int maxPathW = getmaxx(winPreview) - 15;
       if (maxPathW < 10) maxPathW = 10;
@@ -5859,9 +6577,9 @@ public:
       mvwprintw(winPreview, 6, 2, " Deleted:  %s", ti.deletionDate.c_str());
       wattroff(winPreview, A_DIM);
       dividerLine = 7;
-    } else if (file.is_symlink) {
+    } else if (file.is_symlink()) {
       wattron(winPreview, A_DIM);
-      mvwprintw(winPreview, 5, 2, " Target: %s", file.symlink_target.c_str());
+      mvwprintw(winPreview, 5, 2, " Target: %s", file.symlink_target().c_str());
       wattroff(winPreview, A_DIM);
       dividerLine = 6;
     }
@@ -5871,11 +6589,11 @@ public:
       mvwaddstr(winPreview, dividerLine, i, "─");
     wattroff(winPreview, COLOR_PAIR(6));
 
-    bool isVid = VIDEO_EXTS.count(file.extension);
-    bool isImg = IMAGE_EXTS.count(file.extension);
-    bool isCode = isCodeFile(file.extension);
+    bool isVid = VIDEO_EXTS.count(file.extension());
+    bool isImg = IMAGE_EXTS.count(file.extension());
+    bool isCode = isCodeFile(file.extension());
 
-    std::string extLower = file.extension;
+    std::string extLower = file.extension();
     std::transform(extLower.begin(), extLower.end(), extLower.begin(), ::tolower);
     bool isArchive = (extLower == ".zip" || extLower == ".tar" || extLower == ".gz" || extLower == ".tgz" || 
                       extLower == ".rar" || extLower == ".bz2" || extLower == ".xz" || extLower == ".7z");
@@ -5884,65 +6602,40 @@ public:
     bool isPdf = (extLower == ".pdf");
     bool isTextPreviewable = isCode || isArchive || isAudio || isPdf;
 
-    bool isDoc = (file.extension == ".doc" || file.extension == ".docx");
-    bool isXls = (file.extension == ".xls" || file.extension == ".xlsx");
-    bool isPpt = (file.extension == ".ppt" || file.extension == ".pptx");
+    bool isDoc = (file.extension() == ".doc" || file.extension() == ".docx");
+    bool isXls = (file.extension() == ".xls" || file.extension() == ".xlsx");
+    bool isPpt = (file.extension() == ".ppt" || file.extension() == ".pptx");
 
     int contentStart = getPreviewContentStartLine();
 
-    if (file.is_directory) {
+    if (file.is_directory()) {
       wattron(winPreview, COLOR_PAIR(1) | A_BOLD);
       mvwprintw(winPreview, contentStart, 2, "󰉖 Content:");
       wattroff(winPreview, COLOR_PAIR(1) | A_BOLD);
-      try {
-        int line = contentStart + 1;
-        for (const auto& entry : fs::directory_iterator(file.path)) {
-          if (!showHidden && entry.path().filename().string().front() == '.')
-            continue;
-          if (line >= height - 3)
-            break;
-          std::string subName = entry.path().filename().string();
-          int maxSubW = getmaxx(winPreview) - 8;
-          if (maxSubW < 5) maxSubW = 5;
-          if ((int)subName.length() > maxSubW) {
-            int limit = maxSubW - 3;
-            if (limit < 1) limit = 1;
-            subName = utf8_safe_truncate(subName, limit);
-          }
-
-          std::string ext = entry.path().extension().string();
-          std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-          
-          bool isSubSym = fs::is_symlink(fs::symlink_status(entry.path()));
-          bool isSubDir = false;
-          if (isSubSym) {
-            try {
-              fs::path resSub = fs::read_symlink(entry.path());
-              if (resSub.is_relative()) {
-                resSub = entry.path().parent_path() / resSub;
-              }
-              isSubDir = fs::is_directory(resSub);
-            } catch (...) {}
-          } else {
-            isSubDir = fs::is_directory(entry);
-          }
-
-          bool isSubDirEmpty = false;
-          if (isSubDir) {
-            try {
-              isSubDirEmpty = (fs::directory_iterator(entry.path()) == fs::directory_iterator());
-            } catch (...) {}
-          }
-          FileStyle s = getFileStyle(entry.path().filename().string(), ext, isSubDir, isSubDirEmpty);
-          if (isSubSym) {
-            s.icon = ICON_LINK;
-          }
-
-          wattron(winPreview, COLOR_PAIR(s.pair));
-          mvwprintw(winPreview, line++, 4, "%s %s", s.icon, subName.c_str());
-          wattroff(winPreview, COLOR_PAIR(s.pair));
-        }
-      } catch (...) {
+      FileListing shared;
+      bool nameOrdered = false;
+      std::shared_ptr<const FileListing> listing;
+      // A visited directory's listing is only drawn as it is; sorting it or
+      // resolving its rows is left to the preview worker.
+      bool hit = listingCache.lookup(file.path(), showHidden, shared, nameOrdered) && nameOrdered;
+      int rows = std::max(height - 3 - (contentStart + 1), 1);
+      for (size_t i = 0; hit && i < std::min((size_t)rows, shared.size()); ++i)
+        hit = shared.detailsResolved(i);
+      if (!hit) {
+        std::lock_guard<std::mutex> lock(previewMutex);
+        if (cachedPath == file.path().string())
+          listing = cachedListing;
+      }
+      if (hit) {
+        drawDirectoryPreview(shared, contentStart + 1);
+      } else if (listing) {
+        drawDirectoryPreview(*listing, contentStart + 1);
+      } else {
+        if (requestedPath != file.path().string())
+          startAsyncPreview(file.path().string(), PreviewType::DIRECTORY, rows, maxW);
+        wattron(winPreview, A_ITALIC | A_DIM);
+        mvwprintw(winPreview, contentStart + 1, 4, "Loading...");
+        wattroff(winPreview, A_ITALIC | A_DIM);
       }
       wnoutrefresh(winPreview);
     } else if (isDoc || isXls || isPpt) {
@@ -5956,22 +6649,22 @@ public:
       wattroff(winPreview, COLOR_PAIR(8));
       wnoutrefresh(winPreview);
     } else if (isVid || isImg || isTextPreviewable) {
-      bool isGvfs = (file.path.string().find("/gvfs/") != std::string::npos);
+      bool isGvfs = (file.path().string().find("/gvfs/") != std::string::npos);
       if ((isVid || isImg) && isGvfs) {
         wattron(winPreview, COLOR_PAIR(8));
         mvwprintw(winPreview, contentStart, 2, " [Media File - No Preview on MTP] ");
         wattroff(winPreview, COLOR_PAIR(8));
         wnoutrefresh(winPreview);
-      } else if ((isVid || isImg) && (!isCommandAvailable("ffmpeg") || !isCommandAvailable("ffprobe"))) {
+      } else if ((isVid || (isImg && !nativeImageFormat(extLower))) && !isCommandAvailable("ffmpeg")) {
         wattron(winPreview, COLOR_PAIR(8));
-        mvwprintw(winPreview, contentStart, 2, " [Media File - Install ffmpeg & ffprobe for preview] ");
+        mvwprintw(winPreview, contentStart, 2, " [Media File - Install ffmpeg for preview] ");
         wattroff(winPreview, COLOR_PAIR(8));
         wnoutrefresh(winPreview);
       } else {
         bool match = false;
         {
           std::lock_guard<std::mutex> lock(previewMutex);
-          if (cachedPath == file.path.string())
+          if (cachedPath == file.path().string())
             match = true;
         }
         if (match) {
@@ -5979,31 +6672,34 @@ public:
             drawCachedTextPreview();
           else
             pendingDirectRenderType = PreviewType::IMAGE;
-        } else if (requestedPath != file.path.string()) {
+        } else if (requestedPath != file.path().string()) {
           wattron(winPreview, A_ITALIC | A_DIM);
           mvwprintw(winPreview, contentStart, 4, "Generating preview...");
           wattroff(winPreview, A_ITALIC | A_DIM);
           PreviewType type = isTextPreviewable ? PreviewType::TEXT : PreviewType::IMAGE;
-          startAsyncPreview(file.path.string(), type, maxH - (contentStart + 1), maxW);
+          startAsyncPreview(file.path().string(), type, maxH - (contentStart + 1), maxW);
         }
       }
     } else {
-      if (is_binary_file(file.path.string())) {
+      // On the UI thread, so read no more than the rows on screen can show.
+      int rows = std::max(height - 3 - contentStart, 0);
+      TextReader reader;
+      bool readable = reader.open(file.path().string(),
+                                  std::max<size_t>(TextReader::BINARY_PROBE,
+                                                   static_cast<size_t>(rows) * std::max(maxW, 1) * 4));
+      if (readable && reader.binary()) {
         wattron(winPreview, COLOR_PAIR(8));
         mvwprintw(winPreview, contentStart, 2, " [Binary File - No Preview] ");
         wattroff(winPreview, COLOR_PAIR(8));
-      } else {
-        std::ifstream f(file.path);
-        if (f.is_open()) {
-          std::string lineStr;
-          int line = contentStart;
-          while (std::getline(f, lineStr) && line < height - 3) {
-            std::replace(lineStr.begin(), lineStr.end(), '\t', ' ');
-            for (size_t i = 0; i < lineStr.length(); i += maxW) {
-              if (line >= height - 3)
-                break;
-              mvwprintw(winPreview, line++, 2, "%s", lineStr.substr(i, maxW).c_str());
-            }
+      } else if (readable) {
+        int line = contentStart;
+        for (size_t l = 0; line < height - 3 && reader.hasLine(l); ++l) {
+          std::string lineStr(reader.line(l));
+          std::replace(lineStr.begin(), lineStr.end(), '\t', ' ');
+          for (size_t i = 0; i < lineStr.length(); i += maxW) {
+            if (line >= height - 3)
+              break;
+            mvwprintw(winPreview, line++, 2, "%s", lineStr.substr(i, maxW).c_str());
           }
         }
       }
@@ -6031,7 +6727,7 @@ public:
         pathsToOpen.push_back(p);
       }
     } else {
-      pathsToOpen.push_back(currentFiles[selectedIndex].path);
+      pathsToOpen.push_back(currentFiles[selectedIndex].path());
     }
 
     if (pathsToOpen.empty())
@@ -6082,9 +6778,9 @@ public:
 
     if (mediaFiles.empty() && codeFiles.empty() && otherFiles.empty()) {
       const auto& file = currentFiles[selectedIndex];
-      if (file.is_directory) {
+      if (file.is_directory()) {
         clearDirectRender();
-        changeDirectory(file.path, true);
+        changeDirectory(file.path(), true);
         selectedIndex = 0;
         scrollOffset = 0;
         isSearching = false;
@@ -6163,13 +6859,8 @@ public:
       changeDirectory(currentPath.parent_path(), true);
       reloadAll();
       selectedIndex = 0;
-      for (size_t i = 0; i < currentFiles.size(); ++i) {
-        if (currentFiles[i].name == oldDirName) {
-          selectedIndex = i;
-          break;
-        }
-      }
-      scrollOffset = (selectedIndex > 10) ? selectedIndex - 10 : 0;
+      scrollOffset = 0;
+      selectPathWhenLoaded(currentPath / oldDirName);
     }
   }
 
@@ -6183,11 +6874,15 @@ public:
       requestID++;
       cachedPath = "";
       requestedPath = "";
-      cachedTextLines.clear();
+      cachedText.reset();
+      cachedListing.reset();
       cachedBase64 = "";
-      sessionImageCache.clear();
-      sessionImageCacheKeys.clear();
+      cachedImageKey = "";
+      previewCache.clear();
+      previewQueue = {};
     }
+    listingCache.clear();
+    invalidateDrawCache();
     reloadAll();
     setStatus("Refreshed");
   }
@@ -6197,9 +6892,12 @@ public:
     bool needsRedraw = true;
 
     while (true) {
+      // Everything below is rechecked after draining, so a worker that
+      // publishes meanwhile just makes the next wait return at once.
+      uiWakeup.drain();
       if (inotifyTriggered) {
         inotifyTriggered = false;
-        reloadAll();
+        applyFsEvents();
         needsRedraw = true;
       }
       if (devicesTriggered) {
@@ -6216,23 +6914,29 @@ public:
             SizeResult res = resultQueue.front();
             resultQueue.pop_front();
             if (res.viewId == currentViewId) {
-              for (auto& f : currentFiles) {
-                if (f.path == res.path) {
-                  f.size = res.size;
-                  updated = true;
-                  break;
-                }
+              size_t idx = currentFiles.indexOf(res.path);
+              if (idx != FileListing::npos) {
+                currentFiles.setSize(idx, res.size);
+                // Sorting by size: move just this row into place.
+                if (sortMode == SortMode::SIZE && !isStreamingListing)
+                  currentFiles.reposition(idx, SortMode::SIZE);
+                // A streamed listing re-sorts its window on the next draw.
+                else if (sortMode == SortMode::SIZE)
+                  listingSortedPrefix = 0;
+                updated = true;
               }
             }
           }
-          if (updated) {
-            if (sortMode == SortMode::SIZE)
-              sortList(currentFiles); // Re-sort if sorting by size
+          if (updated)
             needsRedraw = true;
-          }
         }
       }
 
+      // Merge streamed directory entries
+      if (isStreamingListing && mergeListingChunks()) {
+        needsRedraw = true;
+      }
+
       // Check for async search updates
       {
         std::lock_guard<std::mutex> lock(searchResultMutex);
@@ -6242,22 +6946,18 @@ public:
           // Remember previously selected path to restore cursor position
           fs::path prevSelectedPath;
           if (!currentFiles.empty() && selectedIndex < currentFiles.size()) {
-            prevSelectedPath = currentFiles[selectedIndex].path;
+            prevSelectedPath = currentFiles[selectedIndex].path();
           }
 
           currentFiles = pendingSearchResults;
-          sortList(currentFiles);
+          if (!pendingSearchRanked)
+            sortList(currentFiles);
 
           if (!prevSelectedPath.empty()) {
-            bool found = false;
-            for (size_t idx = 0; idx < currentFiles.size(); ++idx) {
-              if (currentFiles[idx].path == prevSelectedPath) {
-                selectedIndex = idx;
-                found = true;
-                break;
-              }
-            }
-            if (!found) {
+            size_t idx = currentFiles.indexOf(prevSelectedPath);
+            if (idx != FileListing::npos) {
+              selectedIndex = idx;
+            } else {
               if (selectedIndex >= currentFiles.size()) {
                 selectedIndex = currentFiles.empty() ? 0 : currentFiles.size() - 1;
               }
@@ -6290,12 +6990,19 @@ public:
       }
 
       if (needsRedraw) {
+        TRACE_SCOPE("drawFrame");
         if (!currentFiles.empty()) {
           if (selectedIndex >= currentFiles.size())
             selectedIndex = currentFiles.size() - 1;
         } else
           selectedIndex = 0;
 
+        // The panes only repaint what changed (see paneCaches); touching
+        // them still hands ncurses their full contents, restoring whatever
+        // the toast or a closed overlay drew over them.
+        for (WINDOW* w : {winPinned, winParent, winCurrent, winPreview}) {
+          if (w) touchwin(w);
+        }
         drawTabs();
         drawPinned();
         drawParent();
@@ -6402,13 +7109,11 @@ public:
 
       int ch = getch();
       if (ch == 27) {
-        nodelay(stdscr, TRUE);
         int ch1 = getch();
         int ch2 = getch();
         int ch3 = getch();
         int ch4 = getch();
         int ch5 = getch();
-        nodelay(stdscr, FALSE);
 
         if (ch1 == '[' && ch2 == '2' && ch3 == '0' && ch4 == '0' && ch5 == '~') {
           std::string pastedData = "";
@@ -6420,13 +7125,11 @@ public:
               if (c == ERR) break;
             }
             if (c == 27) {
-              nodelay(stdscr, TRUE);
               int e1 = getch();
               int e2 = getch();
               int e3 = getch();
               int e4 = getch();
               int e5 = getch();
-              nodelay(stdscr, FALSE);
               if (e1 == '[' && e2 == '2' && e3 == '0' && e4 == '1' && e5 == '~') {
                 break;
               } else {
@@ -6484,7 +7187,8 @@ public:
         bool statusTimedOut = false;
         if (!statusMessage.empty()) {
           auto now = std::chrono::steady_clock::now();
-          if (std::chrono::duration_cast<std::chrono::milliseconds>(now - statusTime).count() > 1800) {
+          if (std::chrono::duration_cast<std::chrono::milliseconds>(now - statusTime).count() >
+              STATUS_TOAST_MS) {
             statusMessage = "";
             statusTimedOut = true;
           }
@@ -6493,7 +7197,10 @@ public:
           needsRedraw = true;
           imageReady = false;
           searchReady = false;
+          continue;
         }
+        // Idle: sleep until a key, a worker's result or the toast expiring.
+        waitForInput(STDIN_FILENO, uiWakeup, statusTimeoutMs());
         continue;
       }
       needsRedraw = true;
@@ -6850,12 +7557,18 @@ public:
         case 'I':
           drawPermissionsOverlay();
           break;
+        case 'F':
+          handleJumpToFile();
+          break;
         case 'f':
           handleFuzzyFind();
           break;
         case 'w':
           drawTasksOverlay();
           break;
+        case 'S':
+          drawStatsOverlay();
+          break;
         case '?':
           drawHelpOverlay();
           break;
@@ -0,0 +1,491 @@
+#include "fuzzy_finder.h"
+#include "trace.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <queue>
+#include <thread>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// Paths per published segment, and how often a partial one is published
+// while walking so the finder can show early results.
+constexpr size_t SEGMENT_PATHS = 65536;
+constexpr auto PUBLISH_INTERVAL = std::chrono::milliseconds(100);
+// Below this many candidates a query is not worth splitting across threads.
+constexpr size_t MIN_PER_THREAD = 16384;
+// The full DP is used while text length x query length fits this.
+constexpr size_t MAX_DP_CELLS = 32768;
+
+// Scoring constants from fzf.
+constexpr int SCORE_MATCH = 16;
+constexpr int SCORE_GAP_START = -3;
+constexpr int SCORE_GAP_EXTENSION = -1;
+constexpr int BONUS_BOUNDARY = SCORE_MATCH / 2;
+constexpr int BONUS_NON_WORD = SCORE_MATCH / 2;
+constexpr int BONUS_CAMEL123 = BONUS_BOUNDARY + SCORE_GAP_EXTENSION;
+constexpr int BONUS_CONSECUTIVE = -(SCORE_GAP_START + SCORE_GAP_EXTENSION);
+constexpr int BONUS_FIRST_CHAR_MULTIPLIER = 2;
+constexpr int BONUS_BOUNDARY_WHITE = BONUS_BOUNDARY + 2;
+constexpr int BONUS_BOUNDARY_DELIMITER = BONUS_BOUNDARY + 1;
+constexpr int NONE = INT_MIN / 2;
+
+enum CharClass { WHITE, NON_WORD, DELIMITER, LOWER, UPPER, LETTER, NUMBER };
+
+CharClass classOf(unsigned char c) {
+  if (c >= 'a' && c <= 'z') return LOWER;
+  if (c >= 'A' && c <= 'Z') return UPPER;
+  if (c >= '0' && c <= '9') return NUMBER;
+  if (c >= 0x80) return LETTER;
+  if (c == ' ' || c == '\t') return WHITE;
+  if (c == '/') return DELIMITER;
+  return NON_WORD;
+}
+
+int bonusFor(CharClass prev, CharClass cls) {
+  if (cls > DELIMITER) {
+    if (prev == WHITE) return BONUS_BOUNDARY_WHITE;
+    if (prev == DELIMITER) return BONUS_BOUNDARY_DELIMITER;
+    if (prev == NON_WORD) return BONUS_BOUNDARY;
+  }
+  if ((prev == LOWER && cls == UPPER) || (prev != NUMBER && cls == NUMBER)) return BONUS_CAMEL123;
+  if (cls == NON_WORD || cls == DELIMITER) return BONUS_NON_WORD;
+  if (cls == WHITE) return BONUS_BOUNDARY_WHITE;
+  return 0;
+}
+
+char fold(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c; }
+
+bool better(const FuzzyHit& a, const FuzzyHit& b) {
+  if (a.score != b.score) return a.score > b.score;
+  if (a.length != b.length) return a.length < b.length;
+  return a.index < b.index;
+}
+
+struct WorseOnTop {
+  bool operator()(const FuzzyHit& a, const FuzzyHit& b) const { return better(a, b); }
+};
+using HitHeap = std::priority_queue<FuzzyHit, std::vector<FuzzyHit>, WorseOnTop>;
+
+// Greedy fzf v1 for texts too long for the DP: first match forward, then the
+// shortest window ending there, scored left to right.
+int greedyScore(std::string_view text, std::string_view query, bool caseSensitive, size_t start,
+                std::vector<uint32_t>* positions) {
+  auto eq = [&](char t, char q) { return (caseSensitive ? t : fold(t)) == q; };
+  size_t n = text.size(), m = query.size();
+  size_t j = 0, end = 0;
+  for (size_t i = start; i < n; ++i) {
+    if (eq(text[i], query[j]) && ++j == m) {
+      end = i + 1;
+      break;
+    }
+  }
+  size_t begin = end;
+  for (size_t i = end, k = m; i-- > start;) {
+    if (eq(text[i], query[k - 1]) && --k == 0) {
+      begin = i;
+      break;
+    }
+  }
+
+  int score = 0, firstBonus = 0, consecutive = 0;
+  bool inGap = false;
+  CharClass prev = begin > 0 ? classOf(text[begin - 1]) : DELIMITER;
+  j = 0;
+  for (size_t i = begin; i < end; ++i) {
+    CharClass cls = classOf(text[i]);
+    if (j < m && eq(text[i], query[j])) {
+      if (positions) positions->push_back(static_cast<uint32_t>(i));
+      score += SCORE_MATCH;
+      int bonus = bonusFor(prev, cls);
+      if (consecutive == 0) {
+        firstBonus = bonus;
+      } else {
+        if (bonus >= BONUS_BOUNDARY && bonus > firstBonus) firstBonus = bonus;
+        bonus = std::max({bonus, firstBonus, BONUS_CONSECUTIVE});
+      }
+      score += j == 0 ? bonus * BONUS_FIRST_CHAR_MULTIPLIER : bonus;
+      inGap = false;
+      ++consecutive;
+      ++j;
+    } else {
+      score += inGap ? SCORE_GAP_EXTENSION : SCORE_GAP_START;
+      inGap = true;
+      consecutive = 0;
+      firstBonus = 0;
+    }
+    prev = cls;
+  }
+  return score;
+}
+
+} // namespace
+
+uint64_t charMask(std::string_view s) {
+  uint64_t mask = 0;
+  for (unsigned char c : s) {
+    if (c >= 'A' && c <= 'Z') c += 32;
+    if (c >= 'a' && c <= 'z') mask |= 1ull << (c - 'a');
+    else if (c >= '0' && c <= '9') mask |= 1ull << (26 + c - '0');
+    else if (c == '.') mask |= 1ull << 36;
+    else if (c == '_') mask |= 1ull << 37;
+    else if (c == '-') mask |= 1ull << 38;
+    else if (c == '/') mask |= 1ull << 39;
+    else if (c == ' ') mask |= 1ull << 40;
+    else if (c >= 0x80) mask |= 1ull << 41;
+    else mask |= 1ull << 42;
+  }
+  return mask;
+}
+
+// fzf v2: H[j][i] is the best score with query[j] matched at text[i]. A match
+// either extends the run ending at i-1 or follows the best earlier match of
+// query[j-1] across a gap, whose penalty grows with its length.
+int fuzzyScore(std::string_view text, std::string_view query, std::vector<uint32_t>* positions) {
+  size_t n = text.size(), m = query.size();
+  if (m == 0) return 0;
+  bool caseSensitive = std::any_of(query.begin(), query.end(),
+                                   [](char c) { return c >= 'A' && c <= 'Z'; });
+  auto eq = [&](char t, char q) { return (caseSensitive ? t : fold(t)) == q; };
+
+  // Subsequence check. first[q] is the earliest position query[q] can take,
+  // and nothing after the last occurrence of the final query character can
+  // be part of a match, so the DP only covers that window.
+  thread_local std::vector<size_t> first;
+  first.resize(m);
+  size_t j = 0;
+  for (size_t i = 0; i < n && j < m; ++i) {
+    if (eq(text[i], query[j])) first[j++] = i;
+  }
+  if (j < m) return -1;
+  size_t start = first[0];
+  size_t stop = n;
+  while (stop - 1 > first[m - 1] && !eq(text[stop - 1], query[m - 1])) --stop;
+  size_t width = stop - start;
+  // Long gaps can push a real match below zero, which callers read as none.
+  if (width * m > MAX_DP_CELLS)
+    return std::max(0, greedyScore(text, query, caseSensitive, start, positions));
+
+  // Row q is written over [first[q-1] + 1, width - (m - 1 - q)), which covers
+  // every cell the next row reads, so nothing needs clearing.
+  thread_local std::vector<int> bonus, H, C, from;
+  bonus.resize(width);
+  H.resize(width * m);
+  C.resize(width * m);
+  if (positions) from.resize(width * m);
+  CharClass prev = start > 0 ? classOf(text[start - 1]) : DELIMITER;
+  for (size_t i = 0; i < width; ++i) {
+    CharClass cls = classOf(text[start + i]);
+    bonus[i] = bonusFor(prev, cls);
+    prev = cls;
+  }
+
+  for (size_t q = 0; q < m; ++q) {
+    int* row = &H[q * width];
+    int* runs = &C[q * width];
+    const int* up = q > 0 ? &H[(q - 1) * width] : nullptr;
+    const int* upRuns = q > 0 ? &C[(q - 1) * width] : nullptr;
+    size_t upFirst = q > 0 ? first[q - 1] - start : 0;
+    // Between first[q-1] and first[q] nothing matches query[q] (the greedy
+    // scan would have taken it), but the gap from row q-1 starts there.
+    size_t begin = q > 0 ? upFirst + 1 : 0, end = width - (m - 1 - q);
+    int gap = NONE;
+    int gapFrom = -1;
+    for (size_t i = begin; i < end; ++i) {
+      if (q > 0 && i >= upFirst + 2 && up[i - 2] > NONE && up[i - 2] + SCORE_GAP_START > gap) {
+        gap = up[i - 2] + SCORE_GAP_START;
+        gapFrom = static_cast<int>(i - 2);
+      }
+      if (!eq(text[start + i], query[q])) {
+        row[i] = NONE;
+        if (gap > NONE) gap += SCORE_GAP_EXTENSION;
+        continue;
+      }
+      if (q == 0) {
+        row[i] = SCORE_MATCH + bonus[i] * BONUS_FIRST_CHAR_MULTIPLIER;
+        runs[i] = 1;
+        continue;
+      }
+      int best = NONE, run = 1, src = -1;
+      if (gap > NONE) {
+        best = gap + SCORE_MATCH + bonus[i];
+        src = gapFrom;
+      }
+      if (up[i - 1] > NONE) {
+        int c = upRuns[i - 1] + 1;
+        int b = bonus[i];
+        int firstBonus = bonus[i - c + 1];
+        if (b >= BONUS_BOUNDARY && b > firstBonus)
+          c = 1;
+        else
+          b = std::max({b, BONUS_CONSECUTIVE, firstBonus});
+        int s = up[i - 1] + SCORE_MATCH + b;
+        if (s >= best) {
+          best = s;
+          run = c;
+          src = static_cast<int>(i - 1);
+        }
+      }
+      row[i] = best;
+      runs[i] = run;
+      if (positions) from[q * width + i] = src;
+      if (gap > NONE) gap += SCORE_GAP_EXTENSION;
+    }
+  }
+
+  const int* last = &H[(m - 1) * width];
+  size_t bestI = 0;
+  int score = NONE;
+  for (size_t i = first[m - 1] - start; i < width; ++i) {
+    if (last[i] > score) {
+      score = last[i];
+      bestI = i;
+    }
+  }
+  if (positions) {
+    std::vector<uint32_t> pos(m);
+    int i = static_cast<int>(bestI);
+    for (size_t q = m; q-- > 0;) {
+      pos[q] = static_cast<uint32_t>(start + i);
+      i = from[q * width + i];
+    }
+    positions->insert(positions->end(), pos.begin(), pos.end());
+  }
+  return std::max(0, score);
+}
+
+// --- PathIndex -------------------------------------------------------------
+
+std::pair<const PathIndex::Segment*, size_t> PathIndex::Snapshot::locate(uint32_t i) const {
+  size_t s = static_cast<size_t>(std::upper_bound(starts.begin(), starts.end(), i) -
+                                 starts.begin()) - 1;
+  return {segments[s].get(), i - starts[s]};
+}
+
+PathIndex::Snapshot PathIndex::snapshot() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return {segments, starts, total};
+}
+
+uint32_t PathIndex::size() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  return total;
+}
+
+void PathIndex::Segment::add(std::string_view path, bool isDir) {
+  arena += path;
+  offsets.push_back(static_cast<uint32_t>(arena.size()));
+  masks.push_back(charMask(path));
+  dirs.push_back(isDir);
+}
+
+void PathIndex::publish(std::unique_ptr<Segment>& seg) {
+  if (seg->size() == 0) return;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    starts.push_back(total);
+    total += static_cast<uint32_t>(seg->size());
+    segments.push_back(std::shared_ptr<const Segment>(seg.release()));
+  }
+  seg = std::make_unique<Segment>();
+}
+
+void PathIndex::append(std::unique_ptr<Segment> seg) { publish(seg); }
+
+void PathIndex::markComplete() {
+  finishedAt = std::chrono::steady_clock::now();
+  done = true;
+}
+
+void PathIndex::build(const std::function<bool()>& cancelled) {
+  if (walk("", cancelled)) markComplete();
+}
+
+void PathIndex::addSubtree(const std::string& rel, const std::function<bool()>& cancelled,
+                           const std::function<bool(const std::string&)>& skip) {
+  walk(rel, cancelled, skip);
+}
+
+// Breadth first from start (relative, "" for the root), so the shallow paths
+// an empty query lists come first. Returns false if cancelled.
+bool PathIndex::walk(const std::string& start, const std::function<bool()>& cancelled,
+                     const std::function<bool(const std::string&)>& skip) {
+  auto seg = std::make_unique<Segment>();
+  std::string prefix = rootPath == "/" ? "/" : rootPath + "/";
+  std::deque<std::string> pending{start};
+  auto lastPublish = std::chrono::steady_clock::now();
+
+  while (!pending.empty()) {
+    if (cancelled && cancelled()) {
+      publish(seg);
+      return false;
+    }
+    std::string rel = std::move(pending.front());
+    pending.pop_front();
+    std::string full = rel.empty() ? rootPath : prefix + rel;
+    int fd = open(full.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) continue;
+    DIR* dp = fdopendir(fd);
+    if (!dp) {
+      close(fd);
+      continue;
+    }
+    while (struct dirent* e = readdir(dp)) {
+      const char* name = e->d_name;
+      if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) continue;
+      if (strcmp(name, ".git") == 0) continue;
+      bool isDir = e->d_type == DT_DIR;
+      if (e->d_type == DT_UNKNOWN) {
+        struct stat st;
+        isDir = fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(st.st_mode);
+      }
+      std::string child = rel.empty() ? std::string(name) : rel + "/" + name;
+      if (!skip || !skip(child)) seg->add(child, isDir);
+      if (isDir) pending.push_back(std::move(child));
+    }
+    closedir(dp);
+
+    auto now = std::chrono::steady_clock::now();
+    if (seg->size() >= SEGMENT_PATHS || now - lastPublish > PUBLISH_INTERVAL) {
+      publish(seg);
+      lastPublish = now;
+    }
+  }
+  publish(seg);
+  return true;
+}
+
+// --- FuzzyMatcher ----------------------------------------------------------
+
+namespace {
+
+struct Partial {
+  std::vector<uint32_t> matches;
+  HitHeap heap;
+};
+
+void consider(const PathIndex::Segment& seg, size_t local, uint32_t global,
+              const std::string& query, size_t limit, Partial& out) {
+  std::string_view text = seg.path(local);
+  int score = fuzzyScore(text, query);
+  if (score < 0) return;
+  out.matches.push_back(global);
+  out.heap.push({global, score, static_cast<uint32_t>(text.size())});
+  if (out.heap.size() > limit) out.heap.pop();
+}
+
+// Scores global indices [from, to), which are contiguous within segments, so
+// the mask test runs straight down each segment's mask array.
+void scanRange(const PathIndex::Snapshot& snap, uint32_t from, uint32_t to, uint64_t qmask,
+               const std::string& query, size_t limit, Partial& out) {
+  while (from < to) {
+    auto [seg, local] = snap.locate(from);
+    size_t end = std::min(seg->size(), local + (to - from));
+    uint32_t base = from - static_cast<uint32_t>(local);
+    const uint64_t* masks = seg->masks.data();
+    size_t k = local;
+#ifdef __SSE2__
+    // Two masks per step: a lane passes when (query & ~mask) is all zero.
+    __m128i q = _mm_set1_epi64x(static_cast<long long>(qmask));
+    __m128i zero = _mm_setzero_si128();
+    for (; k + 2 <= end; k += 2) {
+      __m128i m = _mm_loadu_si128(reinterpret_cast<const __m128i*>(masks + k));
+      int bits = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_andnot_si128(m, q), zero));
+      if ((bits & 0x00FF) == 0x00FF) consider(*seg, k, base + k, query, limit, out);
+      if ((bits & 0xFF00) == 0xFF00) consider(*seg, k + 1, base + k + 1, query, limit, out);
+    }
+#endif
+    for (; k < end; ++k)
+      if ((masks[k] & qmask) == qmask)
+        consider(*seg, k, base + static_cast<uint32_t>(k), query, limit, out);
+    from = base + static_cast<uint32_t>(end);
+  }
+}
+
+} // namespace
+
+std::vector<FuzzyHit> FuzzyMatcher::search(const std::string& query, size_t limit,
+                                           size_t& total) {
+  TRACE_SCOPE("search.fuzzy");
+  snap = index->snapshot();
+  std::vector<FuzzyHit> hits;
+  if (query.empty()) {
+    levels.clear();
+    total = snap.total;
+    for (uint32_t i = 0; i < snap.total && hits.size() < limit; ++i) {
+      auto [seg, local] = snap.locate(i);
+      hits.push_back({i, 0, static_cast<uint32_t>(seg->path(local).size())});
+    }
+    return hits;
+  }
+
+  // Anything matching query also matched every prefix of it.
+  while (!levels.empty() && query.compare(0, levels.back().query.size(), levels.back().query) != 0)
+    levels.pop_back();
+  const std::vector<uint32_t>* known = levels.empty() ? nullptr : &levels.back().matches;
+  uint32_t rangeStart = levels.empty() ? 0 : levels.back().scanned;
+  size_t listed = known ? known->size() : 0;
+  size_t work = listed + (snap.total - rangeStart);
+  uint64_t qmask = charMask(query);
+
+  // Work item w is known[w] for w < listed, else rangeStart + (w - listed).
+  auto runChunk = [&](size_t a, size_t b, Partial& out) {
+    for (size_t w = a; w < std::min(b, listed); ++w) {
+      uint32_t g = (*known)[w];
+      auto [seg, local] = snap.locate(g);
+      consider(*seg, local, g, query, limit, out);
+    }
+    if (b > listed) {
+      uint32_t from = rangeStart + static_cast<uint32_t>(std::max(a, listed) - listed);
+      uint32_t to = rangeStart + static_cast<uint32_t>(b - listed);
+      scanRange(snap, from, to, qmask, query, limit, out);
+    }
+  };
+
+  size_t threads = std::max<size_t>(1, std::min<size_t>(std::thread::hardware_concurrency(),
+                                                        work / MIN_PER_THREAD));
+  std::vector<Partial> parts(threads);
+  if (threads == 1) {
+    runChunk(0, work, parts[0]);
+  } else {
+    std::vector<std::thread> pool;
+    size_t per = (work + threads - 1) / threads;
+    for (size_t t = 0; t < threads; ++t)
+      pool.emplace_back([&, t] {
+        runChunk(std::min(work, t * per), std::min(work, (t + 1) * per), parts[t]);
+      });
+    for (auto& th : pool)
+      th.join();
+  }
+
+  Level level{query, {}, snap.total};
+  for (Partial& p : parts) {
+    level.matches.insert(level.matches.end(), p.matches.begin(), p.matches.end());
+    for (; !p.heap.empty(); p.heap.pop())
+      hits.push_back(p.heap.top());
+  }
+  std::sort(hits.begin(), hits.end(), better);
+  if (hits.size() > limit) hits.resize(limit);
+  total = level.matches.size();
+  if (!levels.empty() && levels.back().query == query) levels.pop_back();
+  levels.push_back(std::move(level));
+  return hits;
+}
+
+std::string FuzzyMatcher::path(uint32_t i) const {
+  auto [seg, local] = snap.locate(i);
+  return std::string(seg->path(local));
+}
+
+bool FuzzyMatcher::isDir(uint32_t i) const {
+  auto [seg, local] = snap.locate(i);
+  return seg->dirs[local] != 0;
+}
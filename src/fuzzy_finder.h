@@ -0,0 +1,118 @@
+#ifndef FUZZY_FINDER_H
+#define FUZZY_FINDER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Every path under one root (relative to it, .git directories skipped),
+// appended by build() in immutable segments. Queries take a snapshot of the
+// segments, so they can run while the walk is still going.
+class PathIndex {
+public:
+  struct Segment {
+    Segment() { offsets.push_back(0); }
+    void add(std::string_view path, bool isDir);
+
+    std::string arena;
+    std::vector<uint32_t> offsets; // size() + 1 entries into arena
+    std::vector<uint64_t> masks;   // characters present, see charMask()
+    std::vector<uint8_t> dirs;
+    size_t size() const { return masks.size(); }
+    std::string_view path(size_t i) const {
+      return std::string_view(arena.data() + offsets[i], offsets[i + 1] - offsets[i]);
+    }
+  };
+  struct Snapshot {
+    std::vector<std::shared_ptr<const Segment>> segments;
+    std::vector<uint32_t> starts; // global index of each segment's first path
+    uint32_t total = 0;
+    // Segment and local index of global index i.
+    std::pair<const Segment*, size_t> locate(uint32_t i) const;
+  };
+
+  explicit PathIndex(std::string root) : rootPath(std::move(root)) {}
+
+  const std::string& root() const { return rootPath; }
+  // Walks the tree; returns early if cancelled() turns true.
+  void build(const std::function<bool()>& cancelled);
+  // For indexes filled from elsewhere (see FileIndex): publishes seg as is,
+  // walks one subdirectory and adds what it finds (except paths skip() says
+  // are already there), marks the index complete.
+  void append(std::unique_ptr<Segment> seg);
+  void addSubtree(const std::string& rel, const std::function<bool()>& cancelled,
+                  const std::function<bool(const std::string&)>& skip = nullptr);
+  void markComplete();
+  Snapshot snapshot() const;
+  uint32_t size() const;
+  bool complete() const { return done; }
+  std::chrono::steady_clock::time_point builtAt() const { return finishedAt; }
+
+private:
+  void publish(std::unique_ptr<Segment>& seg);
+  bool walk(const std::string& start, const std::function<bool()>& cancelled,
+            const std::function<bool(const std::string&)>& skip = nullptr);
+
+  std::string rootPath;
+  mutable std::mutex mutex;
+  std::vector<std::shared_ptr<const Segment>> segments;
+  std::vector<uint32_t> starts;
+  uint32_t total = 0;
+  std::atomic<bool> done{false};
+  std::chrono::steady_clock::time_point finishedAt;
+};
+
+// Bit set of the (case-folded) character classes in s: one bit per letter
+// and digit, a few for common punctuation and one for everything else. A
+// path can only match a query whose mask is a subset of its own.
+uint64_t charMask(std::string_view s);
+
+// fzf-style score of query against text (higher is better), or -1 if query
+// is not a subsequence of it. Matching is case-insensitive unless query has
+// an uppercase letter. Consecutive runs and matches at word, camelCase and
+// path boundaries score extra. positions, if given, receives the matched
+// byte offsets.
+int fuzzyScore(std::string_view text, std::string_view query,
+               std::vector<uint32_t>* positions = nullptr);
+
+struct FuzzyHit {
+  uint32_t index; // into the index's global numbering
+  int score;
+  uint32_t length;
+};
+
+// Ranks a PathIndex against a query that is typed one key at a time. The
+// paths matching each query are remembered, so extending the query only
+// rescores those (plus whatever the walk has added since) and backspacing
+// returns to an earlier result. Large candidate sets are split across all
+// cores, each keeping a bounded heap of its best hits.
+class FuzzyMatcher {
+public:
+  explicit FuzzyMatcher(std::shared_ptr<PathIndex> index) : index(std::move(index)) {}
+
+  // Best `limit` hits for query, best first; total receives the number of
+  // matching paths. An empty query lists the first paths in walk order.
+  std::vector<FuzzyHit> search(const std::string& query, size_t limit, size_t& total);
+  // Path of a hit from the last search().
+  std::string path(uint32_t i) const;
+  bool isDir(uint32_t i) const;
+
+private:
+  struct Level {
+    std::string query;
+    std::vector<uint32_t> matches; // ascending
+    uint32_t scanned;              // index size when computed
+  };
+
+  std::shared_ptr<PathIndex> index;
+  PathIndex::Snapshot snap;
+  std::vector<Level> levels;
+};
+
+#endif // FUZZY_FINDER_H
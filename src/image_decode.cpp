@@ -0,0 +1,569 @@
+#include "image_decode.h"
+#include <algorithm>
+#include <csetjmp>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#ifdef FYZENOR_HAVE_PNG
+#include <png.h>
+#endif
+#ifdef FYZENOR_HAVE_JPEG
+#include <jpeglib.h>
+#endif
+#ifdef FYZENOR_HAVE_WEBP
+#include <webp/decode.h>
+#endif
+
+namespace {
+
+// Refuse absurd headers before allocating for them.
+constexpr uint64_t MAX_PIXELS = 256ull * 1024 * 1024;
+
+// Area-averaging downscaler fed one RGBA input row at a time, so only the
+// output image and one row of accumulators are ever held in memory. The
+// accumulators are 64-bit: one output pixel can cover a whole
+// MAX_PIXELS-sized input.
+class BoxScaler {
+public:
+  BoxScaler(int inW, int inH, int outW, int outH)
+      : inW(inW), inH(inH), outW(outW), outH(outH), colMap(inW), colCount(outW, 0),
+        sums(static_cast<size_t>(outW) * 4, 0), out(static_cast<size_t>(outW) * outH * 4, 0) {
+    for (int x = 0; x < inW; ++x) {
+      colMap[x] = static_cast<int>(static_cast<int64_t>(x) * outW / inW);
+      colCount[colMap[x]]++;
+    }
+  }
+
+  void addRow(const unsigned char* rgba) {
+    int oy = static_cast<int>(static_cast<int64_t>(y) * outH / inH);
+    if (oy != curRow) flush(oy);
+    uint64_t* s = sums.data();
+    for (int x = 0; x < inW; ++x, rgba += 4) {
+      uint64_t* d = s + colMap[x] * 4;
+      d[0] += rgba[0];
+      d[1] += rgba[1];
+      d[2] += rgba[2];
+      d[3] += rgba[3];
+    }
+    rows++;
+    y++;
+  }
+
+  std::vector<unsigned char>& finish() {
+    flush(curRow);
+    return out;
+  }
+
+private:
+  void flush(int next) {
+    if (rows > 0) {
+      unsigned char* o = out.data() + static_cast<size_t>(curRow) * outW * 4;
+      for (int x = 0; x < outW; ++x) {
+        uint64_t div = static_cast<uint64_t>(colCount[x]) * rows;
+        for (int c = 0; c < 4; ++c)
+          o[x * 4 + c] = static_cast<unsigned char>((sums[x * 4 + c] + div / 2) / div);
+      }
+      std::fill(sums.begin(), sums.end(), 0);
+    }
+    rows = 0;
+    curRow = next;
+  }
+
+  int inW, inH, outW, outH;
+  std::vector<int> colMap;
+  std::vector<uint32_t> colCount;
+  std::vector<uint64_t> sums;
+  std::vector<unsigned char> out;
+  int y = 0;
+  int curRow = 0;
+  uint32_t rows = 0;
+};
+
+// Pixel size decoded images are shrunk to. Never upscales: the terminal scales
+// the placement to the preview box anyway.
+void shrunkSize(int w, int h, int maxW, int maxH, int& outW, int& outH) {
+  if (w <= maxW && h <= maxH) {
+    outW = w;
+    outH = h;
+    return;
+  }
+  fitWithin(w, h, maxW, maxH, outW, outH);
+}
+
+bool readFile(const std::string& path, std::vector<unsigned char>& data) {
+  std::ifstream file(path, std::ios::binary);
+  if (!file) return false;
+  data.assign(std::istreambuf_iterator<char>(file), {});
+  return true;
+}
+
+// What a decode allocates. The decoders' libpng/libjpeg calls live in their
+// own function and reach this only through a reference, so after an error
+// longjmp the caller still sees its real state and frees it (a local of the
+// frame that called setjmp, changed after it, would be indeterminate).
+struct DecodeBuffers {
+  std::vector<unsigned char> row;
+  std::vector<unsigned char> whole;
+  std::vector<unsigned char*> rows;
+  std::vector<unsigned char> px;
+  std::unique_ptr<BoxScaler> scaler;
+};
+
+#ifdef FYZENOR_HAVE_PNG
+// The setjmp scope of decodePng(); png and info are destroyed by the caller.
+bool readPng(png_structp png, png_infop info, FILE* f, int maxW, int maxH, DecodeBuffers& buf,
+             int& w, int& h, bool& hasAlpha) {
+  if (setjmp(png_jmpbuf(png))) return false;
+  png_init_io(png, f);
+  png_read_info(png, info);
+  int inW = static_cast<int>(png_get_image_width(png, info));
+  int inH = static_cast<int>(png_get_image_height(png, info));
+  int colorType = png_get_color_type(png, info);
+  if (inW <= 0 || inH <= 0 || static_cast<uint64_t>(inW) * inH > MAX_PIXELS) return false;
+  hasAlpha = (colorType & PNG_COLOR_MASK_ALPHA) || png_get_valid(png, info, PNG_INFO_tRNS);
+
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_gray_to_rgb(png);
+  png_set_add_alpha(png, 0xFF, PNG_FILLER_AFTER);
+  int passes = png_set_interlace_handling(png);
+  png_read_update_info(png, info);
+
+  shrunkSize(inW, inH, maxW, maxH, w, h);
+  buf.scaler = std::make_unique<BoxScaler>(inW, inH, w, h);
+  size_t stride = static_cast<size_t>(inW) * 4;
+  if (passes == 1) {
+    buf.row.resize(stride);
+    for (int y = 0; y < inH; ++y) {
+      png_read_row(png, buf.row.data(), nullptr);
+      buf.scaler->addRow(buf.row.data());
+    }
+  } else {
+    // Interlaced rows are only final after the last pass.
+    buf.whole.resize(stride * inH);
+    buf.rows.resize(inH);
+    for (int y = 0; y < inH; ++y)
+      buf.rows[y] = buf.whole.data() + stride * y;
+    png_read_image(png, buf.rows.data());
+    for (int y = 0; y < inH; ++y)
+      buf.scaler->addRow(buf.rows[y]);
+  }
+  return true;
+}
+
+bool decodePng(FILE* f, int maxW, int maxH, std::vector<unsigned char>& rgba, int& w, int& h,
+               bool& hasAlpha) {
+  png_structp png = png_create_read_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  if (!png) return false;
+  png_infop info = png_create_info_struct(png);
+  if (!info) {
+    png_destroy_read_struct(&png, nullptr, nullptr);
+    return false;
+  }
+  DecodeBuffers buf;
+  bool ok = readPng(png, info, f, maxW, maxH, buf, w, h, hasAlpha);
+  png_destroy_read_struct(&png, &info, nullptr);
+  if (!ok) return false;
+  rgba = std::move(buf.scaler->finish());
+  return true;
+}
+
+void appendToVector(png_structp png, png_bytep data, png_size_t len) {
+  auto* out = static_cast<std::vector<unsigned char>*>(png_get_io_ptr(png));
+  out->insert(out->end(), data, data + len);
+}
+
+bool encodePng(const std::vector<unsigned char>& rgba, int w, int h, bool hasAlpha,
+               std::vector<unsigned char>& out) {
+  png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  if (!png) return false;
+  png_infop info = png_create_info_struct(png);
+  if (!info) {
+    png_destroy_write_struct(&png, nullptr);
+    return false;
+  }
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    return false;
+  }
+  out.clear();
+  png_set_write_fn(png, &out, appendToVector, nullptr);
+  // The payload is decoded once by the terminal; favour encode speed.
+  png_set_compression_level(png, 1);
+  png_set_IHDR(png, info, w, h, 8, hasAlpha ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+  png_write_info(png, info);
+  if (!hasAlpha) png_set_filler(png, 0, PNG_FILLER_AFTER);
+  for (int y = 0; y < h; ++y)
+    png_write_row(png, const_cast<png_bytep>(rgba.data() + static_cast<size_t>(y) * w * 4));
+  png_write_end(png, nullptr);
+  png_destroy_write_struct(&png, &info);
+  return true;
+}
+#endif
+
+#ifdef FYZENOR_HAVE_JPEG
+struct JpegError {
+  jpeg_error_mgr mgr;
+  jmp_buf jump;
+};
+
+void onJpegError(j_common_ptr cinfo) { longjmp(reinterpret_cast<JpegError*>(cinfo->err)->jump, 1); }
+
+// The setjmp scope of decodeJpeg(); cinfo is created here and destroyed by
+// the caller.
+bool readJpeg(jpeg_decompress_struct& cinfo, JpegError& err, FILE* f, int maxW, int maxH,
+              DecodeBuffers& buf, int& w, int& h) {
+  if (setjmp(err.jump)) return false;
+  jpeg_create_decompress(&cinfo);
+  jpeg_stdio_src(&cinfo, f);
+  jpeg_read_header(&cinfo, TRUE);
+  if (cinfo.jpeg_color_space == JCS_CMYK || cinfo.jpeg_color_space == JCS_YCCK ||
+      static_cast<uint64_t>(cinfo.image_width) * cinfo.image_height > MAX_PIXELS)
+    return false;
+  cinfo.out_color_space = JCS_RGB;
+
+  // Let the IDCT do most of the shrinking: decode at 1/2, 1/4 or 1/8 size as
+  // long as that still leaves at least the target resolution.
+  int targetW, targetH;
+  shrunkSize(static_cast<int>(cinfo.image_width), static_cast<int>(cinfo.image_height), maxW,
+             maxH, targetW, targetH);
+  unsigned denom = 1;
+  while (denom < 8 && cinfo.image_width / (denom * 2) >= static_cast<unsigned>(targetW) &&
+         cinfo.image_height / (denom * 2) >= static_cast<unsigned>(targetH))
+    denom *= 2;
+  cinfo.scale_num = 1;
+  cinfo.scale_denom = denom;
+  cinfo.dct_method = JDCT_IFAST;
+  jpeg_start_decompress(&cinfo);
+
+  int inW = static_cast<int>(cinfo.output_width);
+  int inH = static_cast<int>(cinfo.output_height);
+  shrunkSize(inW, inH, maxW, maxH, w, h);
+  buf.scaler = std::make_unique<BoxScaler>(inW, inH, w, h);
+  buf.row.resize(static_cast<size_t>(inW) * cinfo.output_components);
+  buf.px.resize(static_cast<size_t>(inW) * 4);
+  while (cinfo.output_scanline < cinfo.output_height) {
+    JSAMPROW rowPtr = buf.row.data();
+    jpeg_read_scanlines(&cinfo, &rowPtr, 1);
+    for (int x = 0; x < inW; ++x) {
+      const unsigned char* s = buf.row.data() + x * cinfo.output_components;
+      unsigned char* d = buf.px.data() + x * 4;
+      d[0] = s[0];
+      d[1] = cinfo.output_components >= 3 ? s[1] : s[0];
+      d[2] = cinfo.output_components >= 3 ? s[2] : s[0];
+      d[3] = 0xFF;
+    }
+    buf.scaler->addRow(buf.px.data());
+  }
+  jpeg_finish_decompress(&cinfo);
+  return true;
+}
+
+bool decodeJpeg(FILE* f, int maxW, int maxH, std::vector<unsigned char>& rgba, int& w, int& h) {
+  jpeg_decompress_struct cinfo;
+  JpegError err;
+  cinfo.err = jpeg_std_error(&err.mgr);
+  err.mgr.error_exit = onJpegError;
+  DecodeBuffers buf;
+  bool ok = readJpeg(cinfo, err, f, maxW, maxH, buf, w, h);
+  jpeg_destroy_decompress(&cinfo);
+  if (!ok) return false;
+  rgba = std::move(buf.scaler->finish());
+  return true;
+}
+#endif
+
+#ifdef FYZENOR_HAVE_WEBP
+bool decodeWebp(const std::vector<unsigned char>& data, int maxW, int maxH,
+                std::vector<unsigned char>& rgba, int& w, int& h, bool& hasAlpha) {
+  WebPBitstreamFeatures features;
+  if (WebPGetFeatures(data.data(), data.size(), &features) != VP8_STATUS_OK) return false;
+  if (static_cast<uint64_t>(features.width) * features.height > MAX_PIXELS) return false;
+  int inW = 0, inH = 0;
+  uint8_t* px = WebPDecodeRGBA(data.data(), data.size(), &inW, &inH);
+  if (!px) return false;
+  hasAlpha = features.has_alpha;
+  shrunkSize(inW, inH, maxW, maxH, w, h);
+  BoxScaler scaler(inW, inH, w, h);
+  for (int y = 0; y < inH; ++y)
+    scaler.addRow(px + static_cast<size_t>(y) * inW * 4);
+  WebPFree(px);
+  rgba = std::move(scaler.finish());
+  return true;
+}
+#endif
+
+// First frame of a GIF (87a/89a), composited onto a transparent canvas.
+bool decodeGif(const std::vector<unsigned char>& d, int maxW, int maxH,
+               std::vector<unsigned char>& rgba, int& w, int& h, bool& hasAlpha) {
+  size_t n = d.size();
+  if (n < 13 || (std::memcmp(d.data(), "GIF87a", 6) != 0 && std::memcmp(d.data(), "GIF89a", 6) != 0))
+    return false;
+  int screenW = d[6] | (d[7] << 8);
+  int screenH = d[8] | (d[9] << 8);
+  size_t pos = 13;
+  const unsigned char* globalTable = nullptr;
+  int globalSize = 0;
+  if (d[10] & 0x80) {
+    globalSize = 1 << ((d[10] & 7) + 1);
+    if (pos + globalSize * 3 > n) return false;
+    globalTable = d.data() + pos;
+    pos += globalSize * 3;
+  }
+  int transparent = -1;
+
+  auto skipBlocks = [&]() {
+    while (pos < n && d[pos] != 0)
+      pos += d[pos] + 1;
+    pos++;
+  };
+
+  while (pos < n) {
+    unsigned char tag = d[pos++];
+    if (tag == 0x3B) return false; // trailer before any image
+    if (tag == 0x21) {
+      if (pos >= n) return false;
+      unsigned char label = d[pos++];
+      if (label == 0xF9 && pos + 5 < n && d[pos] == 4 && (d[pos + 1] & 1))
+        transparent = d[pos + 4];
+      skipBlocks();
+      continue;
+    }
+    if (tag != 0x2C || pos + 9 > n) return false;
+
+    int fx = d[pos] | (d[pos + 1] << 8);
+    int fy = d[pos + 2] | (d[pos + 3] << 8);
+    int fw = d[pos + 4] | (d[pos + 5] << 8);
+    int fh = d[pos + 6] | (d[pos + 7] << 8);
+    unsigned char flags = d[pos + 8];
+    pos += 9;
+    const unsigned char* table = globalTable;
+    int tableSize = globalSize;
+    if (flags & 0x80) {
+      tableSize = 1 << ((flags & 7) + 1);
+      if (pos + tableSize * 3 > n) return false;
+      table = d.data() + pos;
+      pos += tableSize * 3;
+    }
+    bool interlaced = flags & 0x40;
+    if (!table || pos >= n) return false;
+    if (screenW <= 0 || screenH <= 0) {
+      screenW = fw;
+      screenH = fh;
+    }
+    if (screenW <= 0 || screenH <= 0 || static_cast<uint64_t>(screenW) * screenH > MAX_PIXELS)
+      return false;
+
+    // LZW-decode the frame's color indices.
+    int minCode = d[pos++];
+    if (minCode < 2 || minCode > 8) return false;
+    std::vector<unsigned char> indices;
+    indices.reserve(static_cast<size_t>(fw) * fh);
+    const int clearCode = 1 << minCode;
+    const int endCode = clearCode + 1;
+    std::vector<uint16_t> prefix(4096);
+    std::vector<unsigned char> suffix(4096);
+    std::vector<unsigned char> stack(4097);
+    int codeSize = minCode + 1;
+    int nextCode = endCode + 1;
+    int prev = -1;
+    unsigned char first = 0;
+    uint32_t bits = 0;
+    int bitCount = 0;
+    bool done = false;
+    for (int i = 0; i < clearCode; ++i) {
+      prefix[i] = 0xFFFF;
+      suffix[i] = static_cast<unsigned char>(i);
+    }
+    while (!done && pos < n && d[pos] != 0) {
+      size_t blockEnd = pos + 1 + d[pos];
+      if (blockEnd > n) break;
+      for (size_t i = pos + 1; i < blockEnd && !done; ++i) {
+        bits |= static_cast<uint32_t>(d[i]) << bitCount;
+        bitCount += 8;
+        while (bitCount >= codeSize) {
+          int code = bits & ((1 << codeSize) - 1);
+          bits >>= codeSize;
+          bitCount -= codeSize;
+          if (code == clearCode) {
+            codeSize = minCode + 1;
+            nextCode = endCode + 1;
+            prev = -1;
+            continue;
+          }
+          if (code == endCode) {
+            done = true;
+            break;
+          }
+          int sp = 0;
+          int cur = code;
+          if (prev < 0) {
+            if (code >= clearCode) return false;
+            indices.push_back(static_cast<unsigned char>(code));
+            first = static_cast<unsigned char>(code);
+            prev = code;
+            continue;
+          }
+          if (code > nextCode) return false;
+          if (code == nextCode) {
+            stack[sp++] = first;
+            cur = prev;
+          }
+          while (cur >= clearCode) {
+            stack[sp++] = suffix[cur];
+            cur = prefix[cur];
+          }
+          stack[sp++] = static_cast<unsigned char>(cur);
+          first = static_cast<unsigned char>(cur);
+          while (sp > 0)
+            indices.push_back(stack[--sp]);
+          if (nextCode < 4096) {
+            prefix[nextCode] = static_cast<uint16_t>(prev);
+            suffix[nextCode] = first;
+            nextCode++;
+            if (nextCode == (1 << codeSize) && codeSize < 12) codeSize++;
+          }
+          prev = code;
+          if (indices.size() >= static_cast<size_t>(fw) * fh) done = true;
+        }
+      }
+      pos = blockEnd;
+    }
+    indices.resize(static_cast<size_t>(fw) * fh, 0);
+
+    std::vector<int> rowOrder(fh);
+    if (interlaced) {
+      static const int passStart[4] = {0, 4, 2, 1};
+      static const int passStep[4] = {8, 8, 4, 2};
+      int r = 0;
+      for (int pass = 0; pass < 4; ++pass) {
+        for (int y = passStart[pass]; y < fh; y += passStep[pass])
+          rowOrder[r++] = y;
+      }
+    } else {
+      for (int y = 0; y < fh; ++y)
+        rowOrder[y] = y;
+    }
+    std::vector<int> srcRow(fh);
+    for (int r = 0; r < fh; ++r)
+      srcRow[rowOrder[r]] = r;
+
+    hasAlpha = transparent >= 0 || fx > 0 || fy > 0 || fw < screenW || fh < screenH;
+    shrunkSize(screenW, screenH, maxW, maxH, w, h);
+    BoxScaler scaler(screenW, screenH, w, h);
+    std::vector<unsigned char> row(static_cast<size_t>(screenW) * 4);
+    for (int y = 0; y < screenH; ++y) {
+      std::fill(row.begin(), row.end(), 0);
+      int ly = y - fy;
+      if (ly >= 0 && ly < fh) {
+        const unsigned char* src = indices.data() + static_cast<size_t>(srcRow[ly]) * fw;
+        for (int x = 0; x < fw; ++x) {
+          int sx = fx + x;
+          if (sx >= screenW) break;
+          int idx = src[x];
+          if (idx == transparent || idx >= tableSize) continue;
+          unsigned char* p = row.data() + sx * 4;
+          p[0] = table[idx * 3];
+          p[1] = table[idx * 3 + 1];
+          p[2] = table[idx * 3 + 2];
+          p[3] = 0xFF;
+        }
+      }
+      scaler.addRow(row.data());
+    }
+    rgba = std::move(scaler.finish());
+    return true;
+  }
+  return false;
+}
+
+} // namespace
+
+void fitWithin(int w, int h, int maxW, int maxH, int& outW, int& outH) {
+  if (w <= 0 || h <= 0) {
+    outW = outH = 0;
+    return;
+  }
+  // Compare maxW/w against maxH/h without floating point.
+  if (static_cast<int64_t>(maxW) * h <= static_cast<int64_t>(maxH) * w) {
+    outW = maxW;
+    outH = static_cast<int>((static_cast<int64_t>(h) * maxW + w / 2) / w);
+  } else {
+    outH = maxH;
+    outW = static_cast<int>((static_cast<int64_t>(w) * maxH + h / 2) / h);
+  }
+  outW = std::max(1, outW);
+  outH = std::max(1, outH);
+}
+
+bool nativeImageFormat(const std::string& ext) {
+#ifdef FYZENOR_HAVE_PNG
+  if (ext == ".png" || ext == ".gif") return true;
+#ifdef FYZENOR_HAVE_JPEG
+  if (ext == ".jpg" || ext == ".jpeg") return true;
+#endif
+#ifdef FYZENOR_HAVE_WEBP
+  if (ext == ".webp") return true;
+#endif
+#else
+  (void)ext;
+#endif
+  return false;
+}
+
+bool pngDimensions(const unsigned char* data, size_t len, int& w, int& h) {
+  static const unsigned char sig[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+  if (len < 24 || std::memcmp(data, sig, 8) != 0 || std::memcmp(data + 12, "IHDR", 4) != 0)
+    return false;
+  auto be32 = [](const unsigned char* p) {
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | p[3];
+  };
+  w = static_cast<int>(be32(data + 16));
+  h = static_cast<int>(be32(data + 20));
+  return w > 0 && h > 0;
+}
+
+bool decodeImagePreview(const std::string& path, int maxW, int maxH,
+                        std::vector<unsigned char>& png) {
+#ifdef FYZENOR_HAVE_PNG
+  FILE* f = fopen(path.c_str(), "rb");
+  if (!f) return false;
+  unsigned char magic[12] = {0};
+  size_t got = fread(magic, 1, sizeof(magic), f);
+  rewind(f);
+
+  std::vector<unsigned char> rgba;
+  int w = 0, h = 0;
+  bool hasAlpha = false;
+  bool ok = false;
+  if (got >= 8 && png_sig_cmp(magic, 0, 8) == 0) {
+    ok = decodePng(f, maxW, maxH, rgba, w, h, hasAlpha);
+  } else if (got >= 3 && magic[0] == 0xFF && magic[1] == 0xD8 && magic[2] == 0xFF) {
+#ifdef FYZENOR_HAVE_JPEG
+    ok = decodeJpeg(f, maxW, maxH, rgba, w, h);
+#endif
+  } else if (got >= 6 && std::memcmp(magic, "GIF8", 4) == 0) {
+    std::vector<unsigned char> data;
+    ok = readFile(path, data) && decodeGif(data, maxW, maxH, rgba, w, h, hasAlpha);
+  } else if (got >= 12 && std::memcmp(magic, "RIFF", 4) == 0 &&
+             std::memcmp(magic + 8, "WEBP", 4) == 0) {
+#ifdef FYZENOR_HAVE_WEBP
+    std::vector<unsigned char> data;
+    ok = readFile(path, data) && decodeWebp(data, maxW, maxH, rgba, w, h, hasAlpha);
+#endif
+  }
+  fclose(f);
+  return ok && encodePng(rgba, w, h, hasAlpha, png);
+#else
+  // Without libpng there is no encoder for the payload; ffmpeg does it all.
+  (void)path;
+  (void)maxW;
+  (void)maxH;
+  (void)png;
+  return false;
+#endif
+}
@@ -0,0 +1,27 @@
+#ifndef IMAGE_DECODE_H
+#define IMAGE_DECODE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Decodes the image at path (PNG and GIF when built with libpng, plus JPEG and
+// WebP with libjpeg/libwebp), shrinks it to fit maxW x maxH and encodes the
+// result as a PNG ready for a Kitty f=100 payload. The format is
+// detected from the file contents, not the extension. Returns false for
+// anything it cannot handle so the caller can fall back to ffmpeg.
+bool decodeImagePreview(const std::string& path, int maxW, int maxH,
+                        std::vector<unsigned char>& png);
+
+// Whether decodeImagePreview() was built with a decoder for files with this
+// (lowercase, dotted) extension.
+bool nativeImageFormat(const std::string& ext);
+
+// Pixel size stored in a PNG's IHDR chunk.
+bool pngDimensions(const unsigned char* data, size_t len, int& w, int& h);
+
+// Scales w x h (up or down) to the largest size that fits maxW x maxH while
+// keeping the aspect ratio.
+void fitWithin(int w, int h, int maxW, int maxH, int& outW, int& outH);
+
+#endif // IMAGE_DECODE_H
@@ -0,0 +1,68 @@
+#include "listing_cache.h"
+#include <sys/stat.h>
+
+int64_t ListingCache::directoryMtime(const fs::path& dir) {
+  struct stat st;
+  if (stat(dir.c_str(), &st) != 0 || !S_ISDIR(st.st_mode)) return FileListing::MTIME_UNKNOWN;
+#ifdef __linux__
+  return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+  return static_cast<int64_t>(st.st_mtime) * 1000000000LL;
+#endif
+}
+
+std::string ListingCache::makeKey(const fs::path& dir, bool showHidden) {
+  std::string key = dir.native();
+  key += '\0';
+  key += showHidden ? '1' : '0';
+  return key;
+}
+
+bool ListingCache::lookup(const fs::path& dir, bool showHidden, FileListing& out,
+                          bool& nameOrdered) {
+  auto it = index.find(makeKey(dir, showHidden));
+  if (it == index.end()) return false;
+  Node& node = *it->second;
+  if (Clock::now() - node.listedAt > maxAge || directoryMtime(dir) != node.mtime) {
+    lru.erase(it->second);
+    index.erase(it);
+    return false;
+  }
+  lru.splice(lru.begin(), lru, it->second);
+  out = node.listing.share();
+  nameOrdered = node.nameOrdered;
+  return true;
+}
+
+void ListingCache::store(const fs::path& dir, bool showHidden, const FileListing& listing,
+                         bool nameOrdered, int64_t mtime, Clock::time_point listedAt) {
+  // GVFS mounts do not keep directory mtimes up to date.
+  if (capacity == 0 || mtime == FileListing::MTIME_UNKNOWN ||
+      dir.native().find("/gvfs/") != std::string::npos)
+    return;
+  std::string key = makeKey(dir, showHidden);
+  erase(key);
+  lru.push_front({key, listing.share(), mtime, nameOrdered, listedAt});
+  index.emplace(std::move(key), lru.begin());
+  while (index.size() > capacity) {
+    index.erase(lru.back().key);
+    lru.pop_back();
+  }
+}
+
+void ListingCache::erase(const std::string& key) {
+  auto it = index.find(key);
+  if (it == index.end()) return;
+  lru.erase(it->second);
+  index.erase(it);
+}
+
+void ListingCache::invalidate(const fs::path& dir) {
+  erase(makeKey(dir, false));
+  erase(makeKey(dir, true));
+}
+
+void ListingCache::clear() {
+  lru.clear();
+  index.clear();
+}
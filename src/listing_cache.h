@@ -0,0 +1,58 @@
+#ifndef LISTING_CACHE_H
+#define LISTING_CACHE_H
+
+#include "file_entry.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+// Directory listings kept for the views that show a directory again: the
+// current and parent panes, other tabs, dual-pane panes and directory
+// previews. A hit is a FileListing::share() view, so it costs no copy until
+// the view changes its rows or order. An entry is checked against the
+// directory's mtime on lookup, dropped on inotify events for the directory
+// (invalidate()) and expires after maxAge, since editing a file inside a
+// directory leaves the directory's mtime alone. The least recently used
+// entries go past capacity. UI thread only, like the views.
+class ListingCache {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  ListingCache(size_t capacity, Clock::duration maxAge) : capacity(capacity), maxAge(maxAge) {}
+
+  // The directory's mtime in nanoseconds, or FileListing::MTIME_UNKNOWN.
+  // Take it before reading the listing that goes to store().
+  static int64_t directoryMtime(const fs::path& dir);
+
+  // A view of dir as listed with showHidden. nameOrdered tells whether the
+  // view is in folders-first, by-name order.
+  bool lookup(const fs::path& dir, bool showHidden, FileListing& out, bool& nameOrdered);
+  // Keeps a view of listing, read when dir had mtime, at time listedAt.
+  void store(const fs::path& dir, bool showHidden, const FileListing& listing, bool nameOrdered,
+             int64_t mtime, Clock::time_point listedAt = Clock::now());
+  void invalidate(const fs::path& dir);
+  void clear();
+
+  size_t size() const { return index.size(); }
+
+private:
+  struct Node {
+    std::string key;
+    FileListing listing;
+    int64_t mtime;
+    bool nameOrdered;
+    Clock::time_point listedAt;
+  };
+  static std::string makeKey(const fs::path& dir, bool showHidden);
+  void erase(const std::string& key);
+
+  size_t capacity;
+  Clock::duration maxAge;
+  std::list<Node> lru; // most recently used first
+  std::unordered_map<std::string, std::list<Node>::iterator> index;
+};
+
+#endif // LISTING_CACHE_H
@@ -1,4 +1,5 @@
 #include "file_manager.h"
+#include "trace.h"
 #include "utils.h"
 #include <iostream>
 
@@ -6,6 +7,7 @@ const std::string VERSION = "4.2.0";
 
 int main(int argc, char* argv[]) {
   globalStartTime = std::chrono::steady_clock::now();
+  std::string traceFile;
   if (argc > 1) {
     for (int i = 1; i < argc; ++i) {
       std::string arg = argv[i];
@@ -18,12 +20,27 @@ int main(int argc, char* argv[]) {
         std::cout << "Options:" << std::endl;
         std::cout << "  -v, --version         Show version information" << std::endl;
         std::cout << "  -h, --help            Show this help message" << std::endl;
+        std::cout << "  --trace FILE          Write a Chrome trace of the session to FILE on exit"
+                  << std::endl;
         return 0;
+      } else if (arg == "--trace") {
+        if (i + 1 >= argc) {
+          std::cerr << "fyzenor: --trace needs a file" << std::endl;
+          return 2;
+        }
+        traceFile = argv[++i];
       }
     }
   }
   loadConfiguration();
-  FileManager fm;
-  fm.run();
+  if (!traceFile.empty()) traceStart(traceFile);
+  {
+    FileManager fm;
+    fm.run();
+  }
+  if (!traceFile.empty() && !traceStop()) {
+    std::cerr << "fyzenor: could not write " << traceFile << std::endl;
+    return 1;
+  }
   return 0;
 }
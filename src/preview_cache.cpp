@@ -0,0 +1,64 @@
+#include "preview_cache.h"
+#include <sys/stat.h>
+
+std::string PreviewCache::makeKey(const std::string& path, int kind, int boxH, int boxW) {
+  struct stat st;
+  long long mtime = 0, size = 0;
+  if (stat(path.c_str(), &st) == 0) {
+#ifdef __linux__
+    mtime = static_cast<long long>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+    mtime = static_cast<long long>(st.st_mtime) * 1000000000LL;
+#endif
+    size = static_cast<long long>(st.st_size);
+  }
+  std::string key = path;
+  key += '\0';
+  key += std::to_string(kind) + ':' + std::to_string(mtime) + ':' + std::to_string(size) + ':' +
+         std::to_string(boxW) + 'x' + std::to_string(boxH);
+  return key;
+}
+
+size_t PreviewCache::footprint(const std::string& key, const PreviewData& data) {
+  // Node, map slot and string headers are charged a flat amount.
+  size_t n = sizeof(Node) + 64 + key.size() + data.b64.size();
+  if (data.text) n += data.text->bytes();
+  if (data.listing) n += data.listing->memoryUsage();
+  return n;
+}
+
+const PreviewData* PreviewCache::get(const std::string& key) {
+  auto it = index.find(key);
+  if (it == index.end()) return nullptr;
+  lru.splice(lru.begin(), lru, it->second);
+  return &it->second->data;
+}
+
+void PreviewCache::put(const std::string& key, PreviewData data) {
+  auto it = index.find(key);
+  if (it != index.end()) {
+    used -= it->second->bytes;
+    lru.erase(it->second);
+    index.erase(it);
+  }
+  size_t bytes = footprint(key, data);
+  if (bytes > budget) return;
+  evictTo(budget - bytes);
+  lru.push_front({key, std::move(data), bytes});
+  index[key] = lru.begin();
+  used += bytes;
+}
+
+void PreviewCache::evictTo(size_t limit) {
+  while (used > limit && !lru.empty()) {
+    used -= lru.back().bytes;
+    index.erase(lru.back().key);
+    lru.pop_back();
+  }
+}
+
+void PreviewCache::clear() {
+  lru.clear();
+  index.clear();
+  used = 0;
+}
@@ -0,0 +1,63 @@
+#ifndef PREVIEW_CACHE_H
+#define PREVIEW_CACHE_H
+
+#include "file_entry.h"
+#include "styled_text.h"
+#include <chrono>
+#include <cstddef>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+// A generated preview: a Kitty PNG payload with its placement size, the
+// parsed lines of a text, archive, media-info or PDF preview, or a
+// directory's listing (shared with whatever is drawing them).
+struct PreviewData {
+  std::string b64;
+  int w = 0, h = 0;
+  std::shared_ptr<const StyledText> text;
+  std::shared_ptr<const FileListing> listing;
+  // Directory listings: when they were read and the directory mtime before.
+  std::chrono::steady_clock::time_point listedAt;
+  int64_t listedMtime = 0;
+};
+
+// Least-recently-used preview cache bounded by the approximate bytes it
+// holds. Lookups and evictions are O(1). Not synchronised; the owner locks.
+class PreviewCache {
+public:
+  explicit PreviewCache(size_t budgetBytes) : budget(budgetBytes) {}
+
+  // Key for path previewed into a box of the given size. It includes the
+  // file's mtime and size, so an edited file misses instead of showing stale
+  // output. kind separates image and text previews of the same file.
+  static std::string makeKey(const std::string& path, int kind, int boxH, int boxW);
+
+  // Marks the entry most recently used. The pointer is valid until the next
+  // put() or clear().
+  const PreviewData* get(const std::string& key);
+  bool contains(const std::string& key) const { return index.count(key) > 0; }
+  // Entries larger than the whole budget are not stored.
+  void put(const std::string& key, PreviewData data);
+  void clear();
+
+  size_t bytes() const { return used; }
+  size_t size() const { return index.size(); }
+
+private:
+  struct Node {
+    std::string key;
+    PreviewData data;
+    size_t bytes;
+  };
+  static size_t footprint(const std::string& key, const PreviewData& data);
+  void evictTo(size_t limit);
+
+  size_t budget;
+  size_t used = 0;
+  std::list<Node> lru; // most recently used first
+  std::unordered_map<std::string, std::list<Node>::iterator> index;
+};
+
+#endif // PREVIEW_CACHE_H
@@ -0,0 +1,198 @@
+#include "preview_render.h"
+#include "archive_list.h"
+#include "dir_loader.h"
+#include "listing_cache.h"
+#include "subprocess.h"
+#include "syntax_highlight.h"
+#include "text_reader.h"
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+
+namespace {
+
+// Appends cmd's output lines; killed as soon as superseded() holds.
+// Returns whether it printed anything.
+bool appendCommandOutput(const std::string& cmd, const std::function<bool()>& superseded,
+                         std::vector<std::string>& lines) {
+  bool gotOutput = false;
+  runShellLines(
+      cmd,
+      [&](const std::string& line) {
+        lines.push_back(line);
+        gotOutput = true;
+        return true;
+      },
+      superseded);
+  return gotOutput;
+}
+
+void appendArchiveListing(const ArchiveListing& listing, std::vector<std::string>& lines) {
+  if (listing.entries.empty()) {
+    lines.push_back("(Empty archive)");
+    return;
+  }
+  for (const ArchiveEntry& entry : listing.entries) {
+    char size[16];
+    snprintf(size, sizeof(size), "%10s", entry.isDir ? "" : formatSize(entry.size).c_str());
+    if (entry.isDir)
+      lines.push_back(std::string(size) + "  \033[1;34m" + entry.name + "\033[0m");
+    else
+      lines.push_back(std::string(size) + "  " + entry.name);
+  }
+  if (listing.total > listing.entries.size())
+    lines.push_back("\033[2m... " + std::to_string(listing.total - listing.entries.size()) +
+                    " more of " + std::to_string(listing.total) + " entries\033[0m");
+  else if (listing.more)
+    lines.push_back("\033[2m...\033[0m");
+}
+
+} // namespace
+
+bool buildTextPreview(const std::string& path, int previewHeight, int previewWidth,
+                      const std::function<bool()>& superseded, StyledText& out) {
+  std::vector<std::string> lines;
+  std::string ext = fs::path(path).extension().string();
+  for (auto& c : ext) c = tolower(c);
+
+  bool isArchive = (ext == ".zip" || ext == ".tar" || ext == ".gz" || ext == ".tgz" || 
+                    ext == ".rar" || ext == ".bz2" || ext == ".xz" || ext == ".7z");
+  
+  bool isAudio = (ext == ".mp3" || ext == ".wav" || ext == ".flac" || ext == ".ogg" || 
+                  ext == ".m4a" || ext == ".aac" || ext == ".opus" || ext == ".wma");
+
+  ArchiveListing listing;
+  if (isArchive && ext != ".7z" && ext != ".rar" &&
+      listArchive(path, std::max(previewHeight, 1), listing, superseded)) {
+    lines.push_back("\033[1;36mArchive Contents:\033[0m");
+    lines.push_back("--------------------------------");
+    appendArchiveListing(listing, lines);
+  } else if (isArchive) {
+    std::string archiveCmd;
+    if (ext == ".zip") {
+      archiveCmd = "unzip -l \"" + path + "\" 2>/dev/null | head -n 40";
+    } else if (ext == ".7z") {
+      archiveCmd = "7z l \"" + path + "\" 2>/dev/null | head -n 40";
+    } else if (ext == ".rar") {
+      archiveCmd = "unrar l \"" + path + "\" 2>/dev/null | head -n 40";
+    } else if (ext == ".tar") {
+      archiveCmd = "tar -tf \"" + path + "\" 2>/dev/null | head -n 40";
+    } else if (ext == ".gz" || ext == ".tgz") {
+      archiveCmd = "tar -ztf \"" + path + "\" 2>/dev/null | head -n 40";
+    } else if (ext == ".bz2") {
+      archiveCmd = "tar -jtf \"" + path + "\" 2>/dev/null | head -n 40";
+    } else if (ext == ".xz") {
+      archiveCmd = "tar -Jtf \"" + path + "\" 2>/dev/null | head -n 40";
+    }
+
+    lines.push_back("\033[1;36mArchive Contents:\033[0m");
+    lines.push_back("--------------------------------");
+    if (!archiveCmd.empty()) {
+      if (!appendCommandOutput(archiveCmd, superseded, lines))
+        lines.push_back("(No list tool available or empty archive)");
+    }
+  } else if (isAudio) {
+    std::string mediaCmd;
+    if (isCommandAvailable("mediainfo")) {
+      mediaCmd = "mediainfo \"" + path + "\" 2>/dev/null | head -n 40";
+    } else if (isCommandAvailable("ffprobe")) {
+      mediaCmd = "ffprobe -v error -show_format -show_streams \"" + path + "\" 2>/dev/null | grep -E \"codec_name|duration|bit_rate|width|height|sample_rate|channels|title|artist\" | head -n 40";
+    }
+
+    lines.push_back("\033[1;35mMedia Info Metadata:\033[0m");
+    lines.push_back("--------------------------------");
+    if (!mediaCmd.empty()) {
+      if (!appendCommandOutput(mediaCmd, superseded, lines))
+        lines.push_back("(Failed to read stream metadata)");
+    } else {
+      lines.push_back("(Install 'mediainfo' or 'ffmpeg' for full metadata previews)");
+    }
+  } else if (ext == ".pdf") {
+    if (isCommandAvailable("pdftotext")) {
+      std::string pdfCmd = "pdftotext -layout -l 3 \"" + path + "\" - 2>/dev/null | head -n 40";
+      lines.push_back("\033[1;32mPDF Document Preview (First 3 Pages):\033[0m");
+      lines.push_back("--------------------------------");
+      if (!appendCommandOutput(pdfCmd, superseded, lines))
+        lines.push_back("(Empty or encrypted PDF document)");
+    } else {
+      lines.push_back(" \033[1;31m[PDF File - No Preview]\033[0m ");
+      lines.push_back(" (Install 'poppler-utils' / 'pdftotext' to view text preview) ");
+    }
+  } else {
+    if (superseded())
+      return false;
+
+    // One bounded read serves the binary check and the text itself.
+    TextReader reader;
+    bool readable = reader.open(path);
+    if (readable && reader.binary()) {
+      lines.push_back("\033[1;31m[Binary File]\033[0m");
+    } else {
+      bool gotOutput = false;
+      std::string cmd;
+      if (configCodeHighlighter == "bat") {
+        if (isCommandAvailable("bat")) {
+          cmd = "bat --color=always --style=plain --paging=never "
+                "--wrap=character --line-range=:" +
+                std::to_string(previewHeight * 2) + " \"" + path + "\" 2>/dev/null";
+        } else if (isCommandAvailable("batcat")) {
+          cmd = "batcat --color=always --style=plain --paging=never "
+                "--wrap=character --line-range=:" +
+                std::to_string(previewHeight * 2) + " \"" + path + "\" 2>/dev/null";
+        }
+      }
+
+      if (!cmd.empty())
+        gotOutput = appendCommandOutput(cmd, superseded, lines);
+
+      if (superseded())
+        return false;
+
+      if (!gotOutput && readable) {
+        lines.clear();
+        size_t rows = std::max(previewHeight, 0);
+        highlightText(reader.lines(0, rows),
+                      syntaxForFile(fs::path(path).filename().string()), rows,
+                      std::max(previewWidth, 0), out, superseded);
+      }
+    }
+  }
+  for (const std::string& line : lines)
+    out.addLine(line);
+  return !superseded();
+}
+
+bool buildDirectoryPreview(const std::string& path, bool showHidden, int previewHeight,
+                           const std::function<bool()>& superseded,
+                           const std::function<bool(std::shared_ptr<FileListing>)>& publishHead,
+                           PreviewData& out) {
+  int64_t mtime = ListingCache::directoryMtime(path);
+  auto listedAt = std::chrono::steady_clock::now();
+  auto listing = std::make_shared<FileListing>();
+  DirReader reader(path, showHidden, false);
+  bool more = reader.isOpen() && reader.readChunk(*listing, (size_t)std::max(previewHeight, 1));
+  size_t shown = (size_t)std::max(previewHeight, 0);
+  auto sortAndResolve = [shown](FileListing& l) {
+    l.sort(SortMode::NAME);
+    for (size_t i = 0; i < std::min(shown, l.size()); ++i)
+      l.resolveDetails(i);
+  };
+
+  if (more) {
+    // A deep copy: reading goes on appending to listing.
+    auto head = std::make_shared<FileListing>(*listing);
+    sortAndResolve(*head);
+    if (publishHead && !publishHead(std::move(head)))
+      return false;
+  }
+  while (more) {
+    if (superseded())
+      return false;
+    more = reader.readChunk(*listing, 4096);
+  }
+  sortAndResolve(*listing);
+  out.listing = std::move(listing);
+  out.listedMtime = mtime;
+  out.listedAt = listedAt;
+  return !superseded();
+}
@@ -0,0 +1,33 @@
+#ifndef PREVIEW_RENDER_H
+#define PREVIEW_RENDER_H
+
+#include "file_entry.h"
+#include "preview_cache.h"
+#include "styled_text.h"
+#include <functional>
+#include <memory>
+#include <string>
+
+// The text and directory previews the file manager's preview workers
+// generate, kept free of the UI so fyzenor-bench can time the same code.
+// superseded is polled throughout, also to kill external tools early.
+
+// Archive listing, media info, PDF text or highlighted source for path in a
+// box of previewHeight rows and previewWidth columns. Returns false if it was
+// superseded before finishing.
+bool buildTextPreview(const std::string& path, int previewHeight, int previewWidth,
+                      const std::function<bool()>& superseded, StyledText& out);
+
+// Reads the directory at path into out.listing, folders first and by name,
+// with the details of the first previewHeight rows resolved so drawing it
+// only reads. When it does not fit in one read, the first chunk, sorted and
+// resolved the same way, goes to publishHead as soon as it is in, to show
+// until the full listing replaces it; publishHead returns false to give up.
+// The whole directory is read so that stepping into it can reuse the
+// listing. Returns false if superseded first.
+bool buildDirectoryPreview(const std::string& path, bool showHidden, int previewHeight,
+                           const std::function<bool()>& superseded,
+                           const std::function<bool(std::shared_ptr<FileListing>)>& publishHead,
+                           PreviewData& out);
+
+#endif // PREVIEW_RENDER_H
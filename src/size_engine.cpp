@@ -0,0 +1,386 @@
+#include "size_engine.h"
+#include "trace.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <unordered_set>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+struct linux_dirent64 {
+  uint64_t d_ino;
+  int64_t d_off;
+  unsigned short d_reclen;
+  unsigned char d_type;
+  char d_name[];
+};
+#endif
+
+// How often a root still being scanned reports its running total.
+constexpr auto PARTIAL_INTERVAL = std::chrono::milliseconds(120);
+
+bool isDotOrDotDot(const char* n) {
+  return n[0] == '.' && (n[1] == '\0' || (n[1] == '.' && n[2] == '\0'));
+}
+
+struct InodeHash {
+  size_t operator()(const std::pair<uint64_t, uint64_t>& k) const {
+    return std::hash<uint64_t>()(k.first * 0x9E3779B97F4A7C15ULL ^ k.second);
+  }
+};
+
+} // namespace
+
+struct SizeEngine::StatInfo {
+  bool isDir = false;
+  bool isReg = false;
+  uint64_t dev = 0;
+  uint64_t ino = 0;
+  uint64_t nlink = 1;
+  uintmax_t size = 0;
+  int64_t mtime = 0;
+};
+
+struct SizeEngine::Root {
+  fs::path path;
+  int viewId;
+  uint64_t dev;
+  // Roots already in the index keep showing the indexed total instead of a
+  // running count that starts again from zero.
+  bool quiet = false;
+  std::atomic<uintmax_t> total{0};
+  std::atomic<int64_t> outstanding{1};
+  std::atomic<int64_t> lastReport{0};
+  int64_t submittedAt = traceNow();
+  std::mutex inodeMutex;
+  std::unordered_set<std::pair<uint64_t, uint64_t>, InodeHash> seenInodes;
+};
+
+// One directory of a root's tree. pending counts the directory itself plus
+// every child not yet finished; the last one to finish folds the total into
+// the parent.
+struct SizeEngine::Node {
+  std::shared_ptr<Node> parent;
+  std::string dir;
+  bool statted = false;
+  uint64_t dev = 0;
+  uint64_t ino = 0;
+  int64_t mtime = 0;
+  uintmax_t ownBytes = 0;
+  std::vector<std::string> children;
+  bool fromIndex = false;
+  uintmax_t indexedTotal = 0;
+  std::atomic<int64_t> pending{1};
+  std::atomic<uintmax_t> total{0};
+  std::atomic<bool> incomplete{false};
+};
+
+bool SizeEngine::statAt(int dirfd, const char* name, bool follow, StatInfo& out) {
+#ifdef __linux__
+  struct statx stx;
+  if (statx(dirfd, name, (follow ? 0 : AT_SYMLINK_NOFOLLOW) | AT_STATX_DONT_SYNC,
+            STATX_TYPE | STATX_SIZE | STATX_INO | STATX_NLINK | STATX_MTIME, &stx) != 0)
+    return false;
+  out.isDir = S_ISDIR(stx.stx_mode);
+  out.isReg = S_ISREG(stx.stx_mode);
+  out.dev = makedev(stx.stx_dev_major, stx.stx_dev_minor);
+  out.ino = stx.stx_ino;
+  out.nlink = stx.stx_nlink;
+  out.size = stx.stx_size;
+  out.mtime = stx.stx_mtime.tv_sec * 1000000000LL + stx.stx_mtime.tv_nsec;
+#else
+  struct stat st;
+  if (fstatat(dirfd, name, &st, follow ? 0 : AT_SYMLINK_NOFOLLOW) != 0) return false;
+  out.isDir = S_ISDIR(st.st_mode);
+  out.isReg = S_ISREG(st.st_mode);
+  out.dev = st.st_dev;
+  out.ino = st.st_ino;
+  out.nlink = st.st_nlink;
+  out.size = st.st_size;
+  out.mtime = static_cast<int64_t>(st.st_mtime) * 1000000000LL;
+#endif
+  return true;
+}
+
+SizeEngine::SizeEngine(unsigned n, bool cross, SizeIndex* idx, ResultFn result, ValidFn valid)
+    : crossFilesystems(cross), index(idx), onResult(std::move(result)),
+      isCurrent(std::move(valid)) {
+  if (n == 0) n = std::max(1u, std::thread::hardware_concurrency());
+  for (unsigned i = 0; i < n; ++i)
+    workers.push_back(std::make_unique<Worker>());
+  for (size_t i = 0; i < workers.size(); ++i)
+    workers[i]->t = std::thread(&SizeEngine::workerLoop, this, i);
+}
+
+SizeEngine::~SizeEngine() { stop(); }
+
+void SizeEngine::stop() {
+  {
+    std::lock_guard<std::mutex> lock(idleMutex);
+    stopping = true;
+  }
+  idleCv.notify_all();
+  for (auto& w : workers) {
+    if (w->t.joinable()) w->t.join();
+  }
+}
+
+void SizeEngine::submit(const fs::path& rootPath, int viewId) {
+  // A symlinked root is followed (listings mark links to directories as
+  // directories); everything below it is walked without following links.
+  StatInfo st;
+  char* real = nullptr;
+  if (!statAt(AT_FDCWD, rootPath.c_str(), true, st) || !st.isDir ||
+      !(real = realpath(rootPath.c_str(), nullptr))) {
+    onResult(rootPath, 0, viewId, true);
+    return;
+  }
+  std::string scanPath = real;
+  free(real);
+
+  auto root = std::make_shared<Root>();
+  root->path = rootPath;
+  root->viewId = viewId;
+  root->dev = st.dev;
+  SizeIndex::Entry known;
+  root->quiet = index && index->lookup(st.dev, st.ino, known, false);
+
+  auto node = std::make_shared<Node>();
+  node->dir = std::move(scanPath);
+  node->statted = true;
+  node->dev = st.dev;
+  node->ino = st.ino;
+  node->mtime = st.mtime;
+  {
+    std::lock_guard<std::mutex> lock(injectMutex);
+    if (!inFlight.insert({rootPath.string(), viewId}).second) return;
+    inject.push_back({root, node});
+  }
+  {
+    std::lock_guard<std::mutex> lock(idleMutex);
+    queued++;
+  }
+  idleCv.notify_one();
+}
+
+void SizeEngine::push(size_t self, WorkItem item) {
+  {
+    std::lock_guard<std::mutex> lock(workers[self]->m);
+    workers[self]->q.push_back(std::move(item));
+  }
+  {
+    std::lock_guard<std::mutex> lock(idleMutex);
+    queued++;
+  }
+  idleCv.notify_one();
+}
+
+// New roots first (they are cheap to start and keep small siblings snappy),
+// then our own newest item, then the oldest item of another worker.
+bool SizeEngine::nextItem(size_t self, WorkItem& out) {
+  {
+    std::lock_guard<std::mutex> lock(injectMutex);
+    if (!inject.empty()) {
+      out = std::move(inject.front());
+      inject.pop_front();
+      queued--;
+      return true;
+    }
+  }
+  {
+    Worker& w = *workers[self];
+    std::lock_guard<std::mutex> lock(w.m);
+    if (!w.q.empty()) {
+      out = std::move(w.q.back());
+      w.q.pop_back();
+      queued--;
+      return true;
+    }
+  }
+  for (size_t k = 1; k < workers.size(); ++k) {
+    Worker& victim = *workers[(self + k) % workers.size()];
+    std::lock_guard<std::mutex> lock(victim.m);
+    if (!victim.q.empty()) {
+      out = std::move(victim.q.front());
+      victim.q.pop_front();
+      queued--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void SizeEngine::workerLoop(size_t self) {
+  while (true) {
+    WorkItem item;
+    if (!nextItem(self, item)) {
+      std::unique_lock<std::mutex> lock(idleMutex);
+      idleCv.wait(lock, [this] { return queued > 0 || stopping; });
+      if (stopping) return;
+      continue;
+    }
+    if (stopping) return;
+    if (isCurrent(item.root->viewId)) {
+      processDir(self, item);
+    } else {
+      item.node->incomplete = true;
+    }
+    item.root->outstanding--;
+    completeNode(item);
+  }
+}
+
+void SizeEngine::pushChild(size_t self, const WorkItem& parent, std::string dir,
+                           const StatInfo* st) {
+  auto child = std::make_shared<Node>();
+  child->parent = parent.node;
+  child->dir = std::move(dir);
+  if (st) {
+    child->statted = true;
+    child->dev = st->dev;
+    child->ino = st->ino;
+    child->mtime = st->mtime;
+  }
+  parent.node->pending++;
+  parent.root->outstanding++;
+  push(self, {parent.root, std::move(child)});
+}
+
+void SizeEngine::completeNode(const WorkItem& item) {
+  std::shared_ptr<Node> n = item.node;
+  while (n && --n->pending == 0) {
+    uintmax_t total = n->total.load();
+    bool incomplete = n->incomplete;
+    if (index && !incomplete && n->statted && (!n->fromIndex || total != n->indexedTotal)) {
+      SizeIndex::Entry e;
+      e.mtime = n->mtime;
+      e.ownBytes = n->ownBytes;
+      e.totalBytes = total;
+      e.children = std::move(n->children);
+      index->store(n->dev, n->ino, std::move(e));
+    }
+    if (!n->parent) {
+      Root& root = *item.root;
+      {
+        std::lock_guard<std::mutex> lock(injectMutex);
+        inFlight.erase({root.path.string(), root.viewId});
+      }
+      if (!incomplete && isCurrent(root.viewId)) {
+        onResult(root.path, total, root.viewId, true);
+      }
+      TRACE_SPAN("size.root", root.submittedAt);
+      if (index) index->saveIfLarge();
+      break;
+    }
+    n->parent->total += total;
+    if (incomplete) n->parent->incomplete = true;
+    n = n->parent;
+  }
+}
+
+void SizeEngine::processDir(size_t self, const WorkItem& item) {
+  TRACE_SCOPE("size.dir");
+  Root& root = *item.root;
+  Node& node = *item.node;
+
+  if (!node.statted) {
+    StatInfo st;
+    if (!statAt(AT_FDCWD, node.dir.c_str(), false, st) || !st.isDir) return;
+    node.statted = true;
+    node.dev = st.dev;
+    node.ino = st.ino;
+    node.mtime = st.mtime;
+  }
+  if (!crossFilesystems && node.dev != root.dev) {
+    node.statted = false; // not counted, so not indexed either
+    return;
+  }
+
+  std::string prefix = node.dir;
+  if (prefix.empty() || prefix.back() != '/') prefix += '/';
+
+  // Unchanged since it was indexed: reuse its own bytes, visit the
+  // remembered subdirectories.
+  SizeIndex::Entry known;
+  if (index && index->lookup(node.dev, node.ino, known) && !known.dirty &&
+      known.mtime == node.mtime) {
+    node.fromIndex = true;
+    node.indexedTotal = known.totalBytes;
+    node.ownBytes = known.ownBytes;
+    node.children = std::move(known.children);
+    for (const std::string& name : node.children)
+      pushChild(self, item, prefix + name, nullptr);
+  } else {
+    int fd = open(node.dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+    if (fd < 0) return;
+
+    uintmax_t local = 0;
+    auto visit = [&](const char* nm) {
+      if (isDotOrDotDot(nm)) return;
+
+      StatInfo st;
+      if (!statAt(fd, nm, false, st)) return;
+      if (st.isDir) {
+        if (!crossFilesystems && st.dev != root.dev) return;
+        node.children.emplace_back(nm);
+        pushChild(self, item, prefix + nm, &st);
+        return;
+      }
+      if (st.isReg && st.nlink > 1) {
+        std::lock_guard<std::mutex> lock(root.inodeMutex);
+        if (!root.seenInodes.insert({st.dev, st.ino}).second) return;
+      }
+      local += st.size;
+    };
+
+#ifdef __linux__
+    alignas(linux_dirent64) char buf[32 * 1024];
+    while (true) {
+      if (stopping || !isCurrent(root.viewId)) {
+        node.incomplete = true;
+        break;
+      }
+      long n = syscall(SYS_getdents64, fd, buf, sizeof(buf));
+      if (n <= 0) break;
+      for (long pos = 0; pos < n;) {
+        auto* d = reinterpret_cast<linux_dirent64*>(buf + pos);
+        pos += d->d_reclen;
+        visit(d->d_name);
+      }
+    }
+    close(fd);
+#else
+    if (DIR* dp = fdopendir(fd)) {
+      while (struct dirent* d = readdir(dp))
+        visit(d->d_name);
+      closedir(dp);
+    } else {
+      close(fd);
+    }
+#endif
+    node.ownBytes = local;
+  }
+
+  node.total += node.ownBytes;
+  uintmax_t total = (root.total += node.ownBytes);
+
+  // Report the running total at most every PARTIAL_INTERVAL per root.
+  if (root.quiet) return;
+  auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+                 std::chrono::steady_clock::now().time_since_epoch())
+                 .count();
+  int64_t last = root.lastReport.load();
+  if (root.outstanding > 1 && now - last >= PARTIAL_INTERVAL.count() &&
+      root.lastReport.compare_exchange_strong(last, now)) {
+    onResult(root.path, total, root.viewId, false);
+  }
+}
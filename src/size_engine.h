@@ -0,0 +1,87 @@
+#ifndef SIZE_ENGINE_H
+#define SIZE_ENGINE_H
+
+#include "size_index.h"
+#include "utils.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+// Work-stealing recursive directory size scanner. Every submitted root is
+// split into one work item per subdirectory; workers pop their own deque LIFO
+// and steal FIFO from the others, so one huge subtree no longer holds up its
+// siblings. Hard links are counted once per root by (dev, inode), and unless
+// crossFilesystems is set the scan stays on the root's filesystem.
+//
+// With a SizeIndex, a directory whose mtime matches its record is not read:
+// its own bytes come from the index and only its remembered subdirectories are
+// visited. Every completed directory's total is written back to the index.
+class SizeEngine {
+public:
+  // Invoked on worker threads: repeatedly with growing totals while a root is
+  // being scanned (final == false), then once with the finished size.
+  using ResultFn =
+      std::function<void(const fs::path& root, uintmax_t size, int viewId, bool final)>;
+  // Returns false once results for viewId are no longer wanted.
+  using ValidFn = std::function<bool(int viewId)>;
+
+  // index may be null.
+  SizeEngine(unsigned workers, bool crossFilesystems, SizeIndex* index, ResultFn onResult,
+             ValidFn isCurrent);
+  ~SizeEngine();
+
+  SizeEngine(const SizeEngine&) = delete;
+  SizeEngine& operator=(const SizeEngine&) = delete;
+
+  // Queues root unless the same root is already being scanned for viewId.
+  void submit(const fs::path& root, int viewId);
+  void stop();
+
+  unsigned workerCount() const { return static_cast<unsigned>(workers.size()); }
+
+private:
+  struct Root;
+  struct Node;
+  struct StatInfo;
+  struct WorkItem {
+    std::shared_ptr<Root> root;
+    std::shared_ptr<Node> node;
+  };
+  struct Worker {
+    std::mutex m;
+    std::deque<WorkItem> q;
+    std::thread t;
+  };
+
+  static bool statAt(int dirfd, const char* name, bool follow, StatInfo& out);
+  void workerLoop(size_t self);
+  bool nextItem(size_t self, WorkItem& out);
+  void push(size_t self, WorkItem item);
+  void pushChild(size_t self, const WorkItem& parent, std::string dir,
+                 const StatInfo* st);
+  void processDir(size_t self, const WorkItem& item);
+  void completeNode(const WorkItem& item);
+
+  bool crossFilesystems;
+  SizeIndex* index;
+  ResultFn onResult;
+  ValidFn isCurrent;
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::mutex injectMutex;
+  std::deque<WorkItem> inject;
+  std::set<std::pair<std::string, int>> inFlight;
+
+  std::mutex idleMutex;
+  std::condition_variable idleCv;
+  std::atomic<size_t> queued{0};
+  std::atomic<bool> stopping{false};
+};
+
+#endif // SIZE_ENGINE_H
@@ -0,0 +1,324 @@
+#include "size_index.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <mutex>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char INDEX_MAGIC[8] = {'F', 'Y', 'Z', 'S', 'I', 'Z', 'E', '1'};
+constexpr uint32_t INDEX_VERSION = 1;
+constexpr size_t OVERLAY_SAVE_THRESHOLD = 4096;
+// Records not used for this long are dropped on save.
+constexpr uint32_t MAX_RECORD_AGE_SECONDS = 180u * 24 * 3600;
+
+constexpr uint32_t RECORD_DIRTY = 1u << 0;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t recordCount;
+  uint64_t childCount;
+  uint64_t namesSize;
+};
+
+bool statDir(const char* p, uint64_t& dev, uint64_t& ino) {
+  struct stat st;
+  if (stat(p, &st) != 0 || !S_ISDIR(st.st_mode)) return false;
+  dev = st.st_dev;
+  ino = st.st_ino;
+  return true;
+}
+
+} // namespace
+
+struct SizeIndex::Record {
+  uint64_t dev;
+  uint64_t ino;
+  int64_t mtime;
+  uint64_t ownBytes;
+  uint64_t totalBytes;
+  uint32_t firstChild;
+  uint32_t childCount;
+  uint32_t flags;
+  uint32_t lastUsed; // seconds since the epoch; 0 in files from before it was kept
+};
+
+struct SizeIndex::ChildRef {
+  uint32_t off;
+  uint32_t len;
+};
+
+SizeIndex::~SizeIndex() { unmap(); }
+
+void SizeIndex::unmap() {
+  if (map) munmap(map, mapSize);
+  map = nullptr;
+  mapSize = 0;
+  records = nullptr;
+  recordCount = 0;
+  childRefs = nullptr;
+  childCount = 0;
+  names = nullptr;
+  namesSize = 0;
+}
+
+void SizeIndex::open(const std::string& file) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  path = file;
+  mapFile();
+}
+
+void SizeIndex::mapFile() {
+  unmap();
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    close(fd);
+    return;
+  }
+  size_t len = static_cast<size_t>(st.st_size);
+  void* m = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) return;
+
+  const Header* h = static_cast<const Header*>(m);
+  if (h->recordCount > len / sizeof(Record) || h->childCount > len / sizeof(ChildRef) ||
+      h->namesSize > len) {
+    munmap(m, len);
+    return;
+  }
+  size_t need = sizeof(Header) + h->recordCount * sizeof(Record) +
+                h->childCount * sizeof(ChildRef) + h->namesSize;
+  if (std::memcmp(h->magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 ||
+      h->version != INDEX_VERSION || need != len) {
+    munmap(m, len);
+    return;
+  }
+
+  const char* base = static_cast<const char*>(m) + sizeof(Header);
+  const Record* recs = reinterpret_cast<const Record*>(base);
+  const ChildRef* refs = reinterpret_cast<const ChildRef*>(base + h->recordCount * sizeof(Record));
+  for (uint64_t i = 0; i < h->recordCount; ++i) {
+    if (recs[i].firstChild > h->childCount ||
+        recs[i].childCount > h->childCount - recs[i].firstChild) {
+      munmap(m, len);
+      return;
+    }
+  }
+  for (uint64_t i = 0; i < h->childCount; ++i) {
+    if (refs[i].off > h->namesSize || refs[i].len > h->namesSize - refs[i].off) {
+      munmap(m, len);
+      return;
+    }
+  }
+
+  map = m;
+  mapSize = len;
+  records = recs;
+  recordCount = h->recordCount;
+  childRefs = refs;
+  childCount = h->childCount;
+  names = base + recordCount * sizeof(Record) + childCount * sizeof(ChildRef);
+  namesSize = h->namesSize;
+}
+
+const SizeIndex::Record* SizeIndex::findBase(Key k) const {
+  const Record* end = records + recordCount;
+  const Record* it = std::lower_bound(records, end, k, [](const Record& r, const Key& key) {
+    return r.dev != key.dev ? r.dev < key.dev : r.ino < key.ino;
+  });
+  if (it == end || it->dev != k.dev || it->ino != k.ino) return nullptr;
+  return it;
+}
+
+void SizeIndex::copyBase(const Record& r, Entry& out, bool withChildren) const {
+  out.mtime = r.mtime;
+  out.ownBytes = r.ownBytes;
+  out.totalBytes = r.totalBytes;
+  out.dirty = (r.flags & RECORD_DIRTY) != 0;
+  out.children.clear();
+  if (!withChildren) return;
+  out.children.reserve(r.childCount);
+  for (uint32_t i = 0; i < r.childCount; ++i) {
+    const ChildRef& c = childRefs[r.firstChild + i];
+    out.children.emplace_back(names + c.off, c.len);
+  }
+}
+
+bool SizeIndex::lookup(uint64_t dev, uint64_t ino, Entry& out, bool withChildren) const {
+  std::shared_lock<std::shared_mutex> lock(mutex);
+  auto it = overlay.find({dev, ino});
+  if (it != overlay.end()) {
+    out.mtime = it->second.mtime;
+    out.ownBytes = it->second.ownBytes;
+    out.totalBytes = it->second.totalBytes;
+    out.dirty = it->second.dirty;
+    if (withChildren) out.children = it->second.children;
+    else out.children.clear();
+    return true;
+  }
+  if (const Record* r = findBase({dev, ino})) {
+    copyBase(*r, out, withChildren);
+    std::lock_guard<std::mutex> touchLock(touchMutex);
+    touched.insert({dev, ino});
+    return true;
+  }
+  return false;
+}
+
+void SizeIndex::store(uint64_t dev, uint64_t ino, Entry entry) {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  overlay[{dev, ino}] = std::move(entry);
+}
+
+bool SizeIndex::estimate(const fs::path& dir, uintmax_t& total) const {
+  uint64_t dev, ino;
+  if (!statDir(dir.c_str(), dev, ino)) return false;
+  Entry e;
+  if (!lookup(dev, ino, e, false)) return false;
+  total = e.totalBytes;
+  return true;
+}
+
+void SizeIndex::markDirty(const fs::path& dir) {
+  fs::path p = dir;
+  while (true) {
+    uint64_t dev, ino;
+    if (statDir(p.c_str(), dev, ino)) {
+      std::unique_lock<std::shared_mutex> lock(mutex);
+      auto it = overlay.find({dev, ino});
+      if (it != overlay.end()) {
+        it->second.dirty = true;
+      } else if (const Record* r = findBase({dev, ino})) {
+        Entry e;
+        copyBase(*r, e, true);
+        e.dirty = true;
+        overlay.emplace(Key{dev, ino}, std::move(e));
+      }
+    }
+    if (!p.has_parent_path() || p == p.parent_path()) break;
+    p = p.parent_path();
+  }
+}
+
+void SizeIndex::saveIfLarge() {
+  {
+    std::shared_lock<std::shared_mutex> lock(mutex);
+    if (overlay.size() < OVERLAY_SAVE_THRESHOLD) return;
+  }
+  save();
+}
+
+bool SizeIndex::save() {
+  std::unique_lock<std::shared_mutex> lock(mutex);
+  std::lock_guard<std::mutex> touchLock(touchMutex);
+  if (path.empty() || (overlay.empty() && touched.empty())) return true;
+
+  // Merge: overlay records replace mapped ones with the same key. Records
+  // used since the last save are stamped now; the rest keep their stamp and
+  // are dropped once too old or, past maxRecords, least recently used first.
+  // The index only knows inodes, not paths, so records of directories that
+  // are gone (or whose inode was reused) leave this way.
+  struct Merged {
+    Key key;
+    const Record* base;
+    const Entry* entry;
+    uint32_t lastUsed;
+    bool fresh; // used since the last save
+  };
+  uint32_t now = static_cast<uint32_t>(std::time(nullptr));
+  std::vector<Merged> all;
+  all.reserve(recordCount + overlay.size());
+  for (size_t i = 0; i < recordCount; ++i) {
+    const Record& r = records[i];
+    if (overlay.count({r.dev, r.ino})) continue;
+    bool fresh = touched.count({r.dev, r.ino}) > 0;
+    uint32_t used = fresh || r.lastUsed == 0 ? now : r.lastUsed;
+    if (now > used && now - used > MAX_RECORD_AGE_SECONDS) continue;
+    all.push_back({{r.dev, r.ino}, &r, nullptr, used, fresh});
+  }
+  for (const auto& [k, e] : overlay)
+    all.push_back({k, nullptr, &e, now, true});
+  if (all.size() > maxRecords) {
+    std::nth_element(all.begin(), all.begin() + maxRecords, all.end(),
+                     [](const Merged& a, const Merged& b) {
+                       return a.fresh != b.fresh ? a.fresh : a.lastUsed > b.lastUsed;
+                     });
+    all.resize(maxRecords);
+  }
+  std::sort(all.begin(), all.end(), [](const Merged& a, const Merged& b) {
+    return a.key.dev != b.key.dev ? a.key.dev < b.key.dev : a.key.ino < b.key.ino;
+  });
+
+  std::vector<Record> outRecords;
+  std::vector<ChildRef> outChildren;
+  std::string outNames;
+  outRecords.reserve(all.size());
+  for (const Merged& m : all) {
+    Record r{};
+    r.dev = m.key.dev;
+    r.ino = m.key.ino;
+    r.firstChild = static_cast<uint32_t>(outChildren.size());
+    r.lastUsed = m.lastUsed;
+    if (m.base) {
+      r.mtime = m.base->mtime;
+      r.ownBytes = m.base->ownBytes;
+      r.totalBytes = m.base->totalBytes;
+      r.flags = m.base->flags;
+      for (uint32_t i = 0; i < m.base->childCount; ++i) {
+        const ChildRef& c = childRefs[m.base->firstChild + i];
+        outChildren.push_back({static_cast<uint32_t>(outNames.size()), c.len});
+        outNames.append(names + c.off, c.len);
+      }
+      r.childCount = m.base->childCount;
+    } else {
+      r.mtime = m.entry->mtime;
+      r.ownBytes = m.entry->ownBytes;
+      r.totalBytes = m.entry->totalBytes;
+      r.flags = m.entry->dirty ? RECORD_DIRTY : 0;
+      for (const std::string& name : m.entry->children) {
+        outChildren.push_back(
+            {static_cast<uint32_t>(outNames.size()), static_cast<uint32_t>(name.size())});
+        outNames += name;
+      }
+      r.childCount = static_cast<uint32_t>(m.entry->children.size());
+    }
+    outRecords.push_back(r);
+  }
+
+  Header h{};
+  std::memcpy(h.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+  h.version = INDEX_VERSION;
+  h.recordCount = outRecords.size();
+  h.childCount = outChildren.size();
+  h.namesSize = outNames.size();
+
+  // Unique per process: another instance may be saving the same index.
+  std::string tmp = path + ".tmp." + std::to_string(getpid());
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (!f) return false;
+  bool ok = fwrite(&h, sizeof(h), 1, f) == 1 &&
+            fwrite(outRecords.data(), sizeof(Record), outRecords.size(), f) ==
+                outRecords.size() &&
+            fwrite(outChildren.data(), sizeof(ChildRef), outChildren.size(), f) ==
+                outChildren.size() &&
+            fwrite(outNames.data(), 1, outNames.size(), f) == outNames.size();
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+
+  overlay.clear();
+  touched.clear();
+  mapFile();
+  return true;
+}
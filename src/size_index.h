@@ -0,0 +1,101 @@
+#ifndef SIZE_INDEX_H
+#define SIZE_INDEX_H
+
+#include "utils.h"
+#include <cstdint>
+#include <mutex>
+#include <shared_mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Persistent directory size index. One record per directory, keyed by
+// (dev, inode) and stamped with the directory's mtime, holding the bytes of
+// its direct non-directory entries, the recursive total and the names of its
+// subdirectories. The file written by save() is memory-mapped read-only by
+// open(); updates collect in an in-memory overlay until the next save().
+//
+// A record whose mtime still matches lets SizeEngine reuse the directory's own
+// bytes and descend into the remembered subdirectories without reading it, so
+// only directories whose mtime changed (or that were marked dirty) are
+// rescanned.
+//
+// Records carry the time they were last stored or looked up. save() drops
+// those unused for six months and, past capacity(), the least recently used,
+// so records of deleted directories do not pile up.
+class SizeIndex {
+public:
+  struct Entry {
+    int64_t mtime = 0;
+    uintmax_t ownBytes = 0;
+    uintmax_t totalBytes = 0;
+    bool dirty = false;
+    std::vector<std::string> children;
+  };
+
+  SizeIndex() = default;
+  ~SizeIndex();
+
+  SizeIndex(const SizeIndex&) = delete;
+  SizeIndex& operator=(const SizeIndex&) = delete;
+
+  // Maps file if it exists and is valid; an unusable file is ignored and
+  // replaced on the next save().
+  void open(const std::string& file);
+  // Writes base + overlay to the index file and remaps it.
+  bool save();
+  // save() once the overlay has grown past a few thousand records.
+  void saveIfLarge();
+  // Most records save() keeps.
+  size_t capacity() const { return maxRecords; }
+  void setCapacity(size_t n) { maxRecords = n; }
+
+  bool lookup(uint64_t dev, uint64_t ino, Entry& out, bool withChildren = true) const;
+  void store(uint64_t dev, uint64_t ino, Entry entry);
+
+  // Last known recursive size of dir, whether or not it is still current.
+  bool estimate(const fs::path& dir, uintmax_t& total) const;
+  // Marks dir and every ancestor dirty. Their totals stay available to
+  // estimate() but are rescanned on the next size request.
+  void markDirty(const fs::path& dir);
+
+private:
+  struct Key {
+    uint64_t dev;
+    uint64_t ino;
+    bool operator==(const Key& o) const { return dev == o.dev && ino == o.ino; }
+  };
+  struct KeyHash {
+    size_t operator()(const Key& k) const {
+      return std::hash<uint64_t>()(k.dev * 0x9E3779B97F4A7C15ULL ^ k.ino);
+    }
+  };
+  struct Record;
+  struct ChildRef;
+
+  void mapFile();
+  void unmap();
+  const Record* findBase(Key k) const;
+  void copyBase(const Record& r, Entry& out, bool withChildren) const;
+
+  std::string path;
+  mutable std::shared_mutex mutex;
+
+  // Mapped file: header, sorted Record[], ChildRef[], name bytes.
+  void* map = nullptr;
+  size_t mapSize = 0;
+  const Record* records = nullptr;
+  size_t recordCount = 0;
+  const ChildRef* childRefs = nullptr;
+  size_t childCount = 0;
+  const char* names = nullptr;
+  size_t namesSize = 0;
+
+  std::unordered_map<Key, Entry, KeyHash> overlay;
+  // Mapped records looked up since the last save.
+  mutable std::mutex touchMutex;
+  mutable std::unordered_set<Key, KeyHash> touched;
+  size_t maxRecords = 1 << 19;
+};
+
+#endif // SIZE_INDEX_H
@@ -0,0 +1,256 @@
+#include "styled_text.h"
+#include <algorithm>
+#include <cwchar>
+
+namespace {
+
+constexpr uint32_t TAB_STOP = 4;
+constexpr size_t MAX_PARAMS = 32;
+
+// Decodes the UTF-8 sequence at s[i]; returns its length, or 0 if it is
+// malformed or cut off.
+size_t decodeUtf8(std::string_view s, size_t i, uint32_t& cp) {
+  unsigned char c = s[i];
+  size_t len;
+  if (c < 0x80) {
+    cp = c;
+    return 1;
+  } else if ((c & 0xe0) == 0xc0) {
+    cp = c & 0x1f;
+    len = 2;
+  } else if ((c & 0xf0) == 0xe0) {
+    cp = c & 0x0f;
+    len = 3;
+  } else if ((c & 0xf8) == 0xf0) {
+    cp = c & 0x07;
+    len = 4;
+  } else {
+    return 0;
+  }
+  if (i + len > s.size()) return 0;
+  for (size_t k = 1; k < len; ++k) {
+    unsigned char cc = s[i + k];
+    if ((cc & 0xc0) != 0x80) return 0;
+    cp = (cp << 6) | (cc & 0x3f);
+  }
+  return len;
+}
+
+uint32_t columnsOf(uint32_t cp) {
+  if (cp < 0x80) return 1;
+  int w = wcwidth(static_cast<wchar_t>(cp));
+  return w < 0 ? 1 : static_cast<uint32_t>(w);
+}
+
+// xterm-256 index nearest to an RGB colour: the grey ramp for greys, the
+// 6x6x6 cube otherwise.
+int16_t nearest256(int r, int g, int b) {
+  if (r == g && g == b) {
+    if (r < 8) return 16;
+    if (r > 248) return 231;
+    return static_cast<int16_t>(232 + (r - 8) * 24 / 240);
+  }
+  int qr = (r * 5 + 127) / 255;
+  int qg = (g * 5 + 127) / 255;
+  int qb = (b * 5 + 127) / 255;
+  return static_cast<int16_t>(16 + 36 * qr + 6 * qg + qb);
+}
+
+int16_t clampColor(int v) { return static_cast<int16_t>(v < 0 ? 0 : (v > 255 ? 255 : v)); }
+
+struct SgrState {
+  uint8_t style = 0;
+  int16_t fg = -1, bg = -1;
+};
+
+// Applies one parsed SGR parameter list. Extended colours take their
+// arguments from the following parameters.
+void applySgr(SgrState& st, const int* params, size_t n) {
+  for (size_t p = 0; p < n; ++p) {
+    int v = params[p];
+    if (v == 0) {
+      st = SgrState{};
+    } else if (v == 1) {
+      st.style |= StyledText::BOLD;
+    } else if (v == 2) {
+      st.style |= StyledText::DIM;
+    } else if (v == 3) {
+      st.style |= StyledText::ITALIC;
+    } else if (v == 4) {
+      st.style |= StyledText::UNDERLINE;
+    } else if (v == 22) {
+      st.style &= ~(StyledText::BOLD | StyledText::DIM);
+    } else if (v == 23) {
+      st.style &= ~StyledText::ITALIC;
+    } else if (v == 24) {
+      st.style &= ~StyledText::UNDERLINE;
+    } else if (v >= 30 && v <= 37) {
+      st.fg = static_cast<int16_t>(v - 30);
+    } else if (v == 39) {
+      st.fg = -1;
+    } else if (v >= 40 && v <= 47) {
+      st.bg = static_cast<int16_t>(v - 40);
+    } else if (v == 49) {
+      st.bg = -1;
+    } else if (v >= 90 && v <= 97) {
+      st.fg = static_cast<int16_t>(v - 90 + 8);
+    } else if (v >= 100 && v <= 107) {
+      st.bg = static_cast<int16_t>(v - 100 + 8);
+    } else if (v == 38 || v == 48) {
+      int16_t* target = (v == 38) ? &st.fg : &st.bg;
+      if (p + 2 < n && params[p + 1] == 5) {
+        *target = clampColor(params[p + 2]);
+        p += 2;
+      } else if (p + 4 < n && params[p + 1] == 2) {
+        *target = nearest256(clampColor(params[p + 2]), clampColor(params[p + 3]),
+                             clampColor(params[p + 4]));
+        p += 4;
+      }
+    }
+  }
+}
+
+} // namespace
+
+void StyledText::setStyle(int16_t fg, int16_t bg, uint8_t style) {
+  if (fg == curFg && bg == curBg && style == curStyle) return;
+  curFg = fg;
+  curBg = bg;
+  curStyle = style;
+  open = false;
+}
+
+void StyledText::append(const char* data, size_t len, uint32_t cols) {
+  if (column + cols > maxColumns) {
+    column = maxColumns;
+    return;
+  }
+  if (!open) {
+    spans.push_back({static_cast<uint32_t>(buffer.size()), 0, 0, curFg, curBg, curStyle});
+    open = true;
+  }
+  buffer.append(data, len);
+  spans.back().length += static_cast<uint32_t>(len);
+  spans.back().columns += cols;
+  column += cols;
+}
+
+// Appends printable text: tabs expanded, control characters dropped,
+// malformed UTF-8 replaced.
+void StyledText::put(std::string_view s) {
+  size_t i = 0;
+  while (i < s.size() && column < maxColumns) {
+    unsigned char c = s[i];
+    if (c == '\t') {
+      uint32_t pad = TAB_STOP - column % TAB_STOP;
+      append("    ", pad, pad);
+      ++i;
+    } else if (c < 0x20 || c == 0x7f) {
+      ++i;
+    } else if (c < 0x80) {
+      // Runs of plain ASCII go in at once.
+      size_t j = i + 1;
+      while (j < s.size() && static_cast<unsigned char>(s[j]) >= 0x20 &&
+             static_cast<unsigned char>(s[j]) < 0x7f)
+        ++j;
+      size_t n = std::min<size_t>(j - i, maxColumns - column);
+      append(s.data() + i, n, static_cast<uint32_t>(n));
+      i = j;
+    } else {
+      uint32_t cp;
+      size_t len = decodeUtf8(s, i, cp);
+      if (len == 0) {
+        append("?", 1, 1);
+        ++i;
+      } else {
+        append(s.data() + i, len, columnsOf(cp));
+        i += len;
+      }
+    }
+  }
+}
+
+void StyledText::add(std::string_view s, int16_t fg, int16_t bg, uint8_t style) {
+  setStyle(fg, bg, style);
+  put(s);
+}
+
+void StyledText::endLine() {
+  lineStarts.push_back(static_cast<uint32_t>(spans.size()));
+  column = 0;
+  open = false;
+  curFg = curBg = -1;
+  curStyle = 0;
+}
+
+void StyledText::addLine(std::string_view line) {
+  SgrState st;
+  size_t i = 0;
+  while (i < line.size()) {
+    // Text up to the next escape.
+    size_t esc = line.find('\033', i);
+    if (esc == std::string_view::npos) esc = line.size();
+    if (esc > i) {
+      setStyle(st.fg, st.bg, st.style);
+      put(line.substr(i, esc - i));
+    }
+    i = esc;
+    if (i >= line.size()) break;
+    if (i + 1 >= line.size() || line[i + 1] != '[') {
+      ++i;
+      continue;
+    }
+    // CSI: parameters up to the final letter.
+    size_t j = i + 2;
+    int params[MAX_PARAMS];
+    size_t n = 0;
+    int val = 0;
+    bool hasVal = false;
+    while (j < line.size() &&
+           !((line[j] >= 'A' && line[j] <= 'Z') || (line[j] >= 'a' && line[j] <= 'z'))) {
+      char d = line[j];
+      if (d == ';' || d == ':') {
+        if (n < MAX_PARAMS) params[n++] = hasVal ? val : 0;
+        val = 0;
+        hasVal = false;
+      } else if (d >= '0' && d <= '9') {
+        val = val * 10 + (d - '0');
+        if (val > 65535) val = 65535;
+        hasVal = true;
+      }
+      ++j;
+    }
+    if (j >= line.size()) break;
+    if (line[j] == 'm') {
+      if (hasVal && n < MAX_PARAMS) params[n++] = val;
+      if (n == 0) params[n++] = 0;
+      applySgr(st, params, n);
+    }
+    i = j + 1;
+  }
+  endLine();
+}
+
+size_t StyledText::bytes() const {
+  return buffer.capacity() + spans.capacity() * sizeof(Span) +
+         lineStarts.capacity() * sizeof(uint32_t);
+}
+
+size_t StyledText::fit(const Span& s, uint32_t columns) const {
+  std::string_view t = text(s);
+  uint32_t used = 0;
+  size_t i = 0;
+  while (i < t.size()) {
+    uint32_t cp;
+    size_t len = decodeUtf8(t, i, cp);
+    if (len == 0) {
+      len = 1;
+      cp = '?';
+    }
+    uint32_t w = columnsOf(cp);
+    if (used + w > columns) break;
+    used += w;
+    i += len;
+  }
+  return i;
+}
@@ -0,0 +1,73 @@
+#ifndef STYLED_TEXT_H
+#define STYLED_TEXT_H
+
+#include <cstddef>
+#include <climits>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Preview lines with their ANSI SGR escapes parsed out once, on the preview
+// worker: every line becomes a run of spans, each a slice of one shared text
+// buffer in a single style and colour with its width in columns. Tabs are
+// expanded to stops of four, other control characters and non-SGR escapes
+// are dropped and malformed UTF-8 shows as '?'. Drawing is then a
+// waddnstr() per span.
+class StyledText {
+public:
+  enum Style : uint8_t {
+    BOLD = 1 << 0,
+    DIM = 1 << 1,
+    ITALIC = 1 << 2,
+    UNDERLINE = 1 << 3,
+  };
+  struct Span {
+    uint32_t begin;  // into text()
+    uint32_t length; // bytes
+    uint32_t columns;
+    int16_t fg, bg; // 0-255, -1 for the default
+    uint8_t style;  // Style bits
+  };
+
+  StyledText() { lineStarts.push_back(0); }
+
+  // Parses one line and appends it.
+  void addLine(std::string_view line);
+  // Builds a line from already-styled pieces (see syntax_highlight.h):
+  // add() appends text in one style, endLine() finishes the line. Text past
+  // maxColumns is dropped.
+  void add(std::string_view s, int16_t fg, int16_t bg = -1, uint8_t style = 0);
+  void endLine();
+  void setMaxColumns(uint32_t columns) { maxColumns = columns; }
+
+  size_t lines() const { return lineStarts.size() - 1; }
+  bool empty() const { return lines() == 0; }
+  const Span* lineBegin(size_t i) const { return spans.data() + lineStarts[i]; }
+  const Span* lineEnd(size_t i) const { return spans.data() + lineStarts[i + 1]; }
+  std::string_view text(const Span& s) const {
+    return std::string_view(buffer.data() + s.begin, s.length);
+  }
+  size_t bytes() const;
+
+  // Bytes of the longest prefix of span s that fits in columns.
+  size_t fit(const Span& s, uint32_t columns) const;
+
+private:
+  void setStyle(int16_t fg, int16_t bg, uint8_t style);
+  void put(std::string_view s);
+  void append(const char* data, size_t len, uint32_t cols);
+
+  std::string buffer;
+  std::vector<Span> spans;
+  std::vector<uint32_t> lineStarts; // lines() + 1 entries into spans
+  uint32_t maxColumns = UINT32_MAX;
+
+  // The line being built.
+  uint32_t column = 0;
+  bool open = false; // spans.back() is on this line and in the current style
+  int16_t curFg = -1, curBg = -1;
+  uint8_t curStyle = 0;
+};
+
+#endif // STYLED_TEXT_H
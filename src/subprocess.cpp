@@ -0,0 +1,124 @@
+#include "subprocess.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char** environ;
+
+namespace {
+
+// How long a read waits before checking cancelled() again.
+constexpr int POLL_INTERVAL_MS = 50;
+
+pid_t spawnShell(const std::string& cmd, int stdoutFd) {
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attr);
+  posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+  posix_spawn_file_actions_addopen(&actions, STDERR_FILENO, "/dev/null", O_WRONLY, 0);
+  posix_spawn_file_actions_adddup2(&actions, stdoutFd, STDOUT_FILENO);
+
+  // The child must not inherit a blocked SIGPIPE/ignored SIGINT from us, and
+  // gets its own group (pgid = its pid) so killpg() reaches the pipeline.
+  sigset_t defaults;
+  sigemptyset(&defaults);
+  sigaddset(&defaults, SIGPIPE);
+  sigaddset(&defaults, SIGINT);
+  sigset_t none;
+  sigemptyset(&none);
+  posix_spawnattr_setsigdefault(&attr, &defaults);
+  posix_spawnattr_setsigmask(&attr, &none);
+  posix_spawnattr_setpgroup(&attr, 0);
+  posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGDEF |
+                                      POSIX_SPAWN_SETSIGMASK);
+
+  const char* argv[] = {"/bin/sh", "-c", cmd.c_str(), nullptr};
+  pid_t pid = -1;
+  if (posix_spawn(&pid, "/bin/sh", &actions, &attr, const_cast<char* const*>(argv), environ) != 0)
+    pid = -1;
+  posix_spawn_file_actions_destroy(&actions);
+  posix_spawnattr_destroy(&attr);
+  return pid;
+}
+
+int reap(pid_t pid, bool kill) {
+  if (kill) killpg(pid, SIGKILL);
+  int status = 0;
+  while (waitpid(pid, &status, 0) < 0) {
+    if (errno != EINTR) return -1;
+  }
+  if (kill || !WIFEXITED(status)) return -1;
+  return WEXITSTATUS(status);
+}
+
+} // namespace
+
+int runShellLines(const std::string& cmd, const LineFn& onLine, const CancelFn& cancelled,
+                  size_t maxOutputBytes) {
+  int fds[2];
+  if (pipe2(fds, O_CLOEXEC) != 0) return -1;
+  pid_t pid = spawnShell(cmd, fds[1]);
+  close(fds[1]);
+  if (pid < 0) {
+    close(fds[0]);
+    return -1;
+  }
+
+  bool stop = false;
+  // The line read so far, and whether it was cut and the rest is skipped.
+  std::string pending;
+  bool cut = false;
+  size_t total = 0;
+  char buf[4096];
+  while (!stop) {
+    if (cancelled && cancelled()) {
+      stop = true;
+      break;
+    }
+    struct pollfd pfd = {fds[0], POLLIN, 0};
+    int r = poll(&pfd, 1, POLL_INTERVAL_MS);
+    if (r < 0 && errno != EINTR) break;
+    if (r <= 0) continue;
+    ssize_t n = read(fds[0], buf, sizeof(buf));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    total += static_cast<size_t>(n);
+    // Only the bytes just read are scanned for newlines.
+    const char* p = buf;
+    const char* end = buf + n;
+    while (p < end && !stop) {
+      const char* nl = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+      const char* stretch = nl ? nl : end;
+      if (!cut) {
+        pending.append(p, std::min(static_cast<size_t>(stretch - p),
+                                   MAX_LINE_BYTES - pending.size()));
+        if (pending.size() == MAX_LINE_BYTES || nl) {
+          stop = !onLine(pending);
+          pending.clear();
+          cut = !nl;
+        }
+      } else if (nl) {
+        cut = false;
+      }
+      p = nl ? nl + 1 : end;
+    }
+    if (total > maxOutputBytes) stop = true;
+  }
+  if (!stop && !cut && !pending.empty()) onLine(pending);
+  close(fds[0]);
+  return reap(pid, stop);
+}
+
+int runShell(const std::string& cmd, const CancelFn& cancelled) {
+  // Reading the (normally silent) stdout pipe until EOF doubles as a
+  // cancellable wait for the shell to exit.
+  return runShellLines(cmd, [](const std::string&) { return true; }, cancelled, SIZE_MAX);
+}
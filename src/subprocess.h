@@ -0,0 +1,30 @@
+#ifndef SUBPROCESS_H
+#define SUBPROCESS_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// Polled while waiting for the child; returning true kills it.
+using CancelFn = std::function<bool()>;
+// Called for every line of output, without the trailing newline. Returning
+// false stops reading and kills the child.
+using LineFn = std::function<bool(const std::string& line)>;
+
+// Runs cmd through /bin/sh, posix_spawn'ed into a process group of its own so
+// cancelling kills the whole pipeline at once instead of waiting for it to
+// notice a closed pipe. stdin and stderr are /dev/null. Returns the exit
+// status, or -1 if it could not be started, was cancelled or was killed.
+//
+// Lines longer than MAX_LINE_BYTES are cut there and the rest of them
+// dropped. Once the child has written more than maxOutputBytes in all, the
+// reading stops and the child is killed as if cancelled.
+constexpr size_t MAX_LINE_BYTES = 64 * 1024;
+constexpr size_t MAX_OUTPUT_BYTES = 16 * 1024 * 1024;
+int runShellLines(const std::string& cmd, const LineFn& onLine, const CancelFn& cancelled,
+                  size_t maxOutputBytes = MAX_OUTPUT_BYTES);
+
+// Same, discarding output; for commands that write their result to a file.
+int runShell(const std::string& cmd, const CancelFn& cancelled);
+
+#endif // SUBPROCESS_H
@@ -0,0 +1,840 @@
+#include "syntax_highlight.h"
+#include <cctype>
+#include <cstring>
+#include <strings.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace {
+
+enum Flag : uint32_t {
+  CASE_INSENSITIVE = 1 << 0,  // keywords match in any case (stored lowercase)
+  PREPROCESSOR = 1 << 1,      // '#' opening a line starts a directive
+  CALLS = 1 << 2,             // an identifier followed by '(' is a call
+  DOLLAR_VARS = 1 << 3,       // $name, ${...} and $1 are variables
+  DOLLAR_IDENT = 1 << 4,      // '$' is an identifier character
+  DASH_IDENT = 1 << 5,        // '-' is an identifier character
+  TRIPLE_QUOTES = 1 << 6,     // """ and ''' strings, which may span lines
+  MULTILINE_STRINGS = 1 << 7, // every string may span lines (backticks always do)
+  KEY_VALUE = 1 << 8,         // "key = value" / "key: value" lines and [section] headers
+  STRING_KEYS = 1 << 9,       // a string followed by ':' is a key
+  MARKUP = 1 << 10,           // <tag attr="value">
+  MARKDOWN = 1 << 11,
+  DIFF = 1 << 12,
+  NO_ESCAPES = 1 << 13,       // backslash does not escape inside strings
+  ANNOTATIONS = 1 << 14,      // @name decorators, annotations and at-rules
+};
+
+struct LanguageSpec {
+  const char* extensions; // lowercase with the dot, or whole file names
+  const char* lineComments;
+  const char* blockOpen;
+  const char* blockClose;
+  const char* quotes;
+  const char* keywords;
+  const char* types; // builtin types, constants and well-known functions
+  uint32_t flags;
+};
+
+constexpr const char* C_KEYWORDS =
+    "alignas alignof asm auto break case catch class const constexpr consteval constinit "
+    "const_cast continue co_await co_return co_yield decltype default delete do dynamic_cast "
+    "else enum explicit export extern final for friend goto if inline mutable namespace new "
+    "noexcept operator override private protected public register reinterpret_cast requires "
+    "restrict return sizeof static static_assert static_cast struct switch template this "
+    "thread_local throw try typedef typeid typename union using virtual volatile while";
+constexpr const char* C_TYPES =
+    "bool char char8_t char16_t char32_t double float int long short signed unsigned void "
+    "wchar_t size_t ssize_t ptrdiff_t int8_t int16_t int32_t int64_t uint8_t uint16_t "
+    "uint32_t uint64_t intptr_t uintptr_t std string vector true false nullptr NULL";
+
+constexpr const char* JS_KEYWORDS =
+    "async await break case catch class const continue debugger default delete do else "
+    "export extends finally for from function get if import in instanceof let new of return "
+    "set static super switch this throw try typeof var void while with yield as implements "
+    "interface package private protected public type enum declare namespace abstract "
+    "readonly keyof infer is satisfies";
+constexpr const char* JS_TYPES =
+    "true false null undefined NaN Infinity any boolean number string symbol object never "
+    "unknown bigint console window document Promise Array Object String Number Map Set JSON "
+    "Math Error";
+
+constexpr const char* SHELL_KEYWORDS =
+    "if then else elif fi case esac for while until do done in function select return exit "
+    "break continue local export readonly declare typeset unset shift source alias set trap "
+    "eval exec time begin end switch";
+constexpr const char* SHELL_TYPES = "echo printf cd pwd test read true false";
+
+constexpr const char* CSS_TYPES =
+    "none auto inherit initial unset block inline inline-block flex grid absolute relative "
+    "fixed sticky bold normal solid dashed transparent important hidden visible center left "
+    "right top bottom";
+
+const LanguageSpec LANGUAGES[] = {
+    // C, C++
+    {".c .h .cpp .cxx .cc .hpp .hxx .ixx .hh .ino", "//", "/*", "*/", "\"'", C_KEYWORDS,
+     C_TYPES, PREPROCESSOR | CALLS},
+    // C#
+    {".cs .csx", "//", "/*", "*/", "\"'",
+     "abstract as base break case catch checked class const continue default delegate do "
+     "else enum event explicit extern finally fixed for foreach goto if implicit in interface "
+     "internal is lock namespace new operator out override params private protected public "
+     "readonly ref return sealed sizeof stackalloc static struct switch this throw try typeof "
+     "unchecked unsafe using virtual volatile while async await var yield get set init record "
+     "where when",
+     "bool byte char decimal double float int long object sbyte short string uint ulong "
+     "ushort void dynamic true false null",
+     PREPROCESSOR | CALLS},
+    // Java
+    {".java", "//", "/*", "*/", "\"'",
+     "abstract assert break case catch class const continue default do else enum extends "
+     "final finally for goto if implements import instanceof interface native new package "
+     "private protected public return static strictfp super switch synchronized this throw "
+     "throws transient try volatile while var record sealed permits yield",
+     "boolean byte char double float int long short void String Object Integer true false "
+     "null",
+     CALLS | ANNOTATIONS},
+    // Kotlin
+    {".kt .kts", "//", "/*", "*/", "\"'",
+     "as break class continue do else for fun if in interface is object package return super "
+     "this throw try typealias typeof val var when while by catch constructor finally get "
+     "import init set where abstract annotation companion const data enum final infix inline "
+     "inner internal lateinit open operator out override private protected public reified "
+     "sealed suspend tailrec vararg",
+     "Any Boolean Byte Char Double Float Int Long Nothing Short String Unit Array List Map "
+     "Set true false null",
+     CALLS | ANNOTATIONS | TRIPLE_QUOTES},
+    // Scala
+    {".scala .sc", "//", "/*", "*/", "\"'",
+     "abstract case catch class def do else extends final finally for forSome if implicit "
+     "import lazy match new object override package private protected return sealed super "
+     "this throw trait try type val var while with yield given using enum then export",
+     "Any AnyRef Boolean Byte Char Double Float Int Long Nothing Short String Unit Option "
+     "Some None List true false null",
+     CALLS | ANNOTATIONS | TRIPLE_QUOTES},
+    // Go
+    {".go", "//", "/*", "*/", "\"'`",
+     "break case chan const continue default defer else fallthrough for func go goto if "
+     "import interface map package range return select struct switch type var",
+     "bool byte complex64 complex128 error float32 float64 int int8 int16 int32 int64 rune "
+     "string uint uint8 uint16 uint32 uint64 uintptr any true false nil iota append cap close "
+     "copy delete len make new panic print println recover",
+     CALLS},
+    // Rust
+    {".rs", "//", "/*", "*/", "\"",
+     "as async await break const continue crate dyn else enum extern fn for if impl in let "
+     "loop match mod move mut pub ref return self Self static struct super trait type unsafe "
+     "use where while macro_rules",
+     "bool char f32 f64 i8 i16 i32 i64 i128 isize str u8 u16 u32 u64 u128 usize String Vec "
+     "Option Result Box Some None Ok Err true false",
+     CALLS | MULTILINE_STRINGS},
+    // Swift
+    {".swift", "//", "/*", "*/", "\"",
+     "associatedtype class deinit enum extension fileprivate func import init inout internal "
+     "let open operator private protocol public rethrows static struct subscript typealias "
+     "var break case continue default defer do else fallthrough for guard if in repeat return "
+     "switch where while as catch is super self Self throw throws try async await some any",
+     "Int Double Float Bool String Character Array Dictionary Set Optional Void true false "
+     "nil",
+     CALLS | ANNOTATIONS | TRIPLE_QUOTES},
+    // Dart
+    {".dart", "//", "/*", "*/", "\"'",
+     "abstract as assert async await break case catch class const continue covariant default "
+     "deferred do dynamic else enum export extends extension external factory final finally "
+     "for get if implements import in interface is late library mixin new of on operator part "
+     "required rethrow return set show static super switch sync this throw try typedef var "
+     "void while with yield",
+     "int double num bool String List Map Set Future Stream true false null",
+     CALLS | ANNOTATIONS | TRIPLE_QUOTES},
+    // JavaScript, TypeScript
+    {".js .jsx .ts .tsx .mjs .cjs .mjx", "//", "/*", "*/", "\"'`", JS_KEYWORDS, JS_TYPES,
+     CALLS | DOLLAR_IDENT | ANNOTATIONS},
+    // CSS
+    {".css", "", "/*", "*/", "\"'", "", CSS_TYPES, KEY_VALUE | DASH_IDENT | ANNOTATIONS},
+    {".scss .sass .less .styl", "//", "/*", "*/", "\"'", "", CSS_TYPES,
+     KEY_VALUE | DASH_IDENT | ANNOTATIONS | DOLLAR_VARS},
+    // HTML, XML and component files
+    {".html .htm .xhtml .vue .svelte .astro .xml .xsd .xsl .xslt .gpx .svg .plist", "", "<!--",
+     "-->", "\"'", "", "", MARKUP},
+    // Python
+    {".py .pyw .pyi", "#", "", "", "\"'",
+     "and as assert async await break class continue def del elif else except finally for "
+     "from global if import in is lambda nonlocal not or pass raise return try while with "
+     "yield match case",
+     "True False None self cls int float str bool list dict set tuple bytes object type print "
+     "len range isinstance super",
+     CALLS | TRIPLE_QUOTES | ANNOTATIONS},
+    // Ruby
+    {".rb .ru .gemspec .rake gemfile rakefile", "#", "", "", "\"'`",
+     "alias and begin break case class def do else elsif end ensure for if in module next not "
+     "or redo rescue retry return self super then undef unless until when while yield require "
+     "require_relative attr_accessor attr_reader attr_writer private protected public puts "
+     "lambda proc",
+     "true false nil", CALLS},
+    // PHP
+    {".php .phtml", "// #", "/*", "*/", "\"'",
+     "abstract and array as break callable case catch class clone const continue declare "
+     "default do echo else elseif empty enddeclare endfor endforeach endif endswitch endwhile "
+     "extends final finally fn for foreach function global goto if implements include "
+     "include_once instanceof insteadof interface isset list match namespace new or print "
+     "private protected public readonly require require_once return static switch throw trait "
+     "try unset use var while xor yield",
+     "true false null int float bool string void mixed self parent", CALLS | DOLLAR_VARS},
+    // Lua
+    {".lua", "--", "--[[", "]]", "\"'",
+     "and break do else elseif end for function goto if in local not or repeat return then "
+     "until while",
+     "true false nil self", CALLS},
+    // SQL
+    {".sql", "--", "/*", "*/", "'\"",
+     "select from where and or not insert into values update set delete create table drop "
+     "alter add column index view join inner left right outer full on as group by order "
+     "having limit offset union all distinct case when then else end is null like in between "
+     "exists primary key foreign references default constraint unique begin commit rollback "
+     "transaction if returning with asc desc",
+     "int integer bigint smallint varchar char text boolean date time timestamp float double "
+     "decimal numeric serial blob true false",
+     CASE_INSENSITIVE | NO_ESCAPES | CALLS},
+    // Perl
+    {".pl .pm .t", "#", "", "", "\"'`",
+     "my our local sub if elsif else unless while until for foreach do last next redo return "
+     "use require package and or not eq ne lt gt le ge print printf die warn",
+     "", CALLS | DOLLAR_VARS},
+    // Shells
+    {".sh .bash .zsh .ksh .fish .command .bashrc .zshrc .profile .bash_profile", "#", "", "",
+     "\"'`", SHELL_KEYWORDS, SHELL_TYPES, DOLLAR_VARS | MULTILINE_STRINGS},
+    // PowerShell
+    {".ps1 .psm1 .psd1", "#", "<#", "#>", "\"'",
+     "begin break catch class continue data define do dynamicparam else elseif end exit "
+     "filter finally for foreach from function if in param process return switch throw trap "
+     "try until using var while workflow",
+     "true false null", CASE_INSENSITIVE | DOLLAR_VARS | CALLS | MULTILINE_STRINGS},
+    // Batch
+    {".bat .cmd", "rem ::", "", "", "\"",
+     "echo set if else goto call exit for in do not exist defined errorlevel setlocal "
+     "endlocal shift pause",
+     "", CASE_INSENSITIVE | NO_ESCAPES},
+    // VBScript
+    {".vbs .vb .bas", "'", "", "", "\"",
+     "dim set if then else elseif end sub function call for each next to step while wend do "
+     "loop until select case const exit and or not is new class property get let private "
+     "public option explicit",
+     "true false nothing empty null", CASE_INSENSITIVE | NO_ESCAPES | CALLS},
+    // awk
+    {".awk", "#", "", "", "\"",
+     "BEGIN END if else while for do break continue next exit return function getline print "
+     "printf delete in",
+     "", CALLS | DOLLAR_VARS},
+    // R
+    {".r .rmd", "#", "", "", "\"'",
+     "if else repeat while function for in next break return library require",
+     "TRUE FALSE NULL NA Inf NaN", CALLS},
+    // Julia
+    {".jl", "#", "#=", "=#", "\"",
+     "begin while if for try return break continue function macro quote let local global "
+     "const do struct module baremodule using import export end else elseif catch finally "
+     "mutable abstract type primitive where in isa",
+     "true false nothing Int Float64 String Bool Any Vector Array Dict",
+     CALLS | TRIPLE_QUOTES | ANNOTATIONS},
+    // Haskell
+    {".hs .lhs", "--", "{-", "-}", "\"",
+     "case class data default deriving do else foreign if import in infix infixl infixr "
+     "instance let module newtype of then type where qualified as hiding",
+     "True False Nothing Just Int Integer Double Float Bool Char String IO Maybe Either", 0},
+    // Clojure
+    {".clj .cljs .cljc .edn", ";", "", "", "\"",
+     "def defn defn- defmacro let fn if do when when-not cond case loop recur quote var throw "
+     "try catch finally ns require import use and or not",
+     "true false nil", DASH_IDENT},
+    // F#
+    {".fs .fsi .fsx", "//", "(*", "*)", "\"",
+     "abstract and as assert base begin class default delegate do done downcast downto elif "
+     "else end exception extern finally for fun function global if in inherit inline "
+     "interface internal lazy let match member module mutable namespace new not of open or "
+     "override private public rec return static struct then to try type upcast use val void "
+     "when while with yield",
+     "true false null int float string bool unit", CALLS | TRIPLE_QUOTES},
+    // CMake
+    {".cmake cmakelists.txt", "#", "", "", "\"",
+     "if else elseif endif foreach endforeach while endwhile function endfunction macro "
+     "endmacro return set unset option project add_executable add_library "
+     "target_link_libraries target_include_directories target_compile_definitions "
+     "target_compile_options find_package find_path find_library include install message "
+     "cmake_minimum_required list string file add_subdirectory add_custom_command "
+     "add_custom_target",
+     "on off true false", CASE_INSENSITIVE | DOLLAR_VARS | NO_ESCAPES},
+    // Make
+    {".make .mk makefile gnumakefile", "#", "", "", "\"'",
+     "ifeq ifneq ifdef ifndef else endif include define endef export override", "",
+     DOLLAR_VARS | KEY_VALUE | NO_ESCAPES},
+    // Dockerfile
+    {".dockerfile dockerfile containerfile", "#", "", "", "\"'",
+     "from run cmd label expose env add copy entrypoint volume user workdir arg onbuild "
+     "stopsignal healthcheck shell as",
+     "", CASE_INSENSITIVE | DOLLAR_VARS},
+    // Diffs
+    {".diff .patch", "", "", "", "", "", "", DIFF},
+    // JSON
+    {".json .json5 .jsonc .ipynb .geojson .webmanifest", "//", "/*", "*/", "\"'", "",
+     "true false null", STRING_KEYS},
+    // YAML
+    {".yaml .yml", "#", "", "", "\"'", "", "true false null yes no on off",
+     KEY_VALUE | NO_ESCAPES},
+    // TOML, INI and friends
+    {".toml .ini .conf .cfg .prefs .properties .env .gitconfig .gitmodules .editorconfig "
+     ".desktop .service",
+     "# ;", "", "", "\"'", "", "true false", KEY_VALUE | TRIPLE_QUOTES},
+    // Comment-only formats
+    {".gitignore .gitattributes .dockerignore .npmignore", "#", "", "", "", "", "", 0},
+    {".md .markdown .mdx", "", "", "", "", "", "", MARKDOWN},
+};
+
+} // namespace
+
+struct SyntaxLanguage {
+  const LanguageSpec* spec;
+  std::vector<std::string_view> lineComments;
+  std::unordered_set<std::string_view> keywords;
+  std::unordered_set<std::string_view> types;
+  std::string_view blockOpen, blockClose;
+  uint32_t flags;
+};
+
+namespace {
+
+std::vector<std::string_view> words(const char* list) {
+  std::vector<std::string_view> out;
+  std::string_view s(list);
+  size_t i = 0;
+  while (i < s.size()) {
+    size_t j = s.find(' ', i);
+    if (j == std::string_view::npos) j = s.size();
+    if (j > i) out.push_back(s.substr(i, j - i));
+    i = j + 1;
+  }
+  return out;
+}
+
+struct Registry {
+  std::vector<SyntaxLanguage> languages;
+  std::unordered_map<std::string_view, const SyntaxLanguage*> byName;
+
+  Registry() {
+    size_t n = sizeof(LANGUAGES) / sizeof(LANGUAGES[0]);
+    languages.resize(n);
+    for (size_t i = 0; i < n; ++i) {
+      const LanguageSpec& spec = LANGUAGES[i];
+      SyntaxLanguage& lang = languages[i];
+      lang.spec = &spec;
+      lang.flags = spec.flags;
+      lang.lineComments = words(spec.lineComments);
+      lang.blockOpen = spec.blockOpen;
+      lang.blockClose = spec.blockClose;
+      for (std::string_view w : words(spec.keywords))
+        lang.keywords.insert(w);
+      for (std::string_view w : words(spec.types))
+        lang.types.insert(w);
+    }
+    for (size_t i = 0; i < n; ++i) {
+      for (std::string_view ext : words(LANGUAGES[i].extensions))
+        byName.emplace(ext, &languages[i]);
+    }
+  }
+};
+
+const Registry& registry() {
+  static const Registry r;
+  return r;
+}
+
+// What a piece of source is, and how it is drawn (xterm-256 colours).
+enum Token : uint8_t {
+  PLAIN,
+  COMMENT,
+  KEYWORD,
+  TYPE,
+  STRING,
+  NUMBER,
+  PREPROC,
+  CALL,
+  VARIABLE,
+  KEY,
+  HEADING,
+  TAG,
+  ATTR,
+  ADDED,
+  REMOVED,
+  HUNK,
+};
+
+struct Paint {
+  int16_t fg;
+  uint8_t style;
+};
+
+constexpr Paint PALETTE[] = {
+    {-1, 0},                     // PLAIN
+    {245, StyledText::ITALIC},   // COMMENT
+    {204, 0},                    // KEYWORD
+    {81, 0},                     // TYPE
+    {186, 0},                    // STRING
+    {141, 0},                    // NUMBER
+    {176, 0},                    // PREPROC
+    {149, 0},                    // CALL
+    {215, 0},                    // VARIABLE
+    {81, 0},                     // KEY
+    {81, StyledText::BOLD},      // HEADING
+    {204, 0},                    // TAG
+    {149, 0},                    // ATTR
+    {114, 0},                    // ADDED
+    {203, 0},                    // REMOVED
+    {75, StyledText::BOLD},      // HUNK
+};
+
+struct LexState {
+  enum Mode : uint8_t { CODE, BLOCK_COMMENT, STRING, FENCE } mode = CODE;
+  char quote = 0;
+  bool triple = false;
+  bool inTag = false;
+};
+
+bool isIdentStart(char c) { return std::isalpha(static_cast<unsigned char>(c)) || c == '_'; }
+
+class Lexer {
+public:
+  Lexer(const SyntaxLanguage* lang, StyledText& out) : lang(lang), out(out) {}
+
+  void line(std::string_view s) {
+    text = s;
+    if (!lang) {
+      emit(0, s.size(), PLAIN);
+    } else if (lang->flags & DIFF) {
+      diffLine();
+    } else if (lang->flags & MARKDOWN) {
+      markdownLine();
+    } else {
+      codeLine();
+    }
+    out.endLine();
+  }
+
+private:
+  bool has(uint32_t flag) const { return (lang->flags & flag) != 0; }
+
+  void emit(size_t a, size_t b, Token t) {
+    if (b > a) out.add(text.substr(a, b - a), PALETTE[t].fg, -1, PALETTE[t].style);
+  }
+
+  bool startsWith(size_t i, std::string_view w) const {
+    return !w.empty() && text.size() - i >= w.size() && text.compare(i, w.size(), w) == 0;
+  }
+
+  bool isIdentChar(char c) const {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' ||
+           (c == '$' && has(DOLLAR_IDENT)) || (c == '-' && has(DASH_IDENT));
+  }
+
+  size_t skipSpaces(size_t i) const {
+    while (i < text.size() && (text[i] == ' ' || text[i] == '\t')) ++i;
+    return i;
+  }
+
+  // A line comment opener at i; alphabetic ones (rem) must be whole words.
+  bool lineCommentAt(size_t i) const {
+    for (std::string_view w : lang->lineComments) {
+      bool word = isIdentStart(w[0]);
+      if (word ? (text.size() - i >= w.size() &&
+                  strncasecmp(text.data() + i, w.data(), w.size()) == 0 &&
+                  (i + w.size() == text.size() || !isIdentChar(text[i + w.size()])))
+               : startsWith(i, w))
+        return true;
+    }
+    return false;
+  }
+
+  // Past the closing quote of a string whose body starts at i, or npos if
+  // the line ends first.
+  size_t stringEnd(size_t i) const {
+    bool escapes = !has(NO_ESCAPES) || st.quote == '`';
+    while (i < text.size()) {
+      char c = text[i];
+      if (c == '\\' && escapes) {
+        i += 2;
+        continue;
+      }
+      if (c == st.quote) {
+        if (!st.triple) return i + 1;
+        if (i + 2 < text.size() && text[i + 1] == c && text[i + 2] == c) return i + 3;
+      }
+      ++i;
+    }
+    return std::string_view::npos;
+  }
+
+  // Emits the string body from i; leaves STRING mode if it closes on this
+  // line or cannot span lines. Returns where it ended.
+  size_t continueString(size_t start, size_t i) {
+    size_t end = stringEnd(i);
+    if (end == std::string_view::npos) {
+      emit(start, text.size(), STRING);
+      if (!(st.triple || st.quote == '`' || has(MULTILINE_STRINGS))) st.mode = LexState::CODE;
+      return text.size();
+    }
+    Token t = STRING;
+    if (has(STRING_KEYS)) {
+      size_t j = skipSpaces(end);
+      if (j < text.size() && text[j] == ':') t = KEY;
+    }
+    emit(start, end, t);
+    st.mode = LexState::CODE;
+    return end;
+  }
+
+  bool keywordIn(const std::unordered_set<std::string_view>& set, std::string_view w) const {
+    if (!has(CASE_INSENSITIVE)) return set.count(w) > 0;
+    char buf[64];
+    if (w.size() > sizeof(buf)) return false;
+    for (size_t k = 0; k < w.size(); ++k)
+      buf[k] = static_cast<char>(std::tolower(static_cast<unsigned char>(w[k])));
+    return set.count(std::string_view(buf, w.size())) > 0;
+  }
+
+  void codeLine() {
+    size_t n = text.size();
+    size_t i = 0;
+    size_t first = skipSpaces(0);
+    while (i < n) {
+      if (st.mode == LexState::BLOCK_COMMENT) {
+        size_t close = text.find(lang->blockClose, i);
+        if (close == std::string_view::npos) {
+          emit(i, n, COMMENT);
+          return;
+        }
+        emit(i, close + lang->blockClose.size(), COMMENT);
+        i = close + lang->blockClose.size();
+        st.mode = LexState::CODE;
+        continue;
+      }
+      if (st.mode == LexState::STRING) {
+        i = continueString(i, i);
+        continue;
+      }
+
+      char c = text[i];
+      if (c == ' ' || c == '\t') {
+        size_t j = skipSpaces(i);
+        emit(i, j, PLAIN);
+        i = j;
+        continue;
+      }
+      if (!lang->blockOpen.empty() && startsWith(i, lang->blockOpen)) {
+        emit(i, i + lang->blockOpen.size(), COMMENT);
+        i += lang->blockOpen.size();
+        st.mode = LexState::BLOCK_COMMENT;
+        continue;
+      }
+      if (has(MARKUP)) {
+        i = markup(i);
+        continue;
+      }
+      if (lineCommentAt(i)) {
+        emit(i, n, COMMENT);
+        return;
+      }
+      if (i == first && c == '#' && has(PREPROCESSOR)) {
+        size_t end = text.find("//", i);
+        size_t block = text.find("/*", i);
+        if (block < end) end = block;
+        if (end == std::string_view::npos) end = n;
+        emit(i, end, PREPROC);
+        i = end;
+        continue;
+      }
+      if (i == first && has(KEY_VALUE)) {
+        size_t j = keyValue(i);
+        if (j != i) {
+          i = j;
+          continue;
+        }
+      }
+      if (c != '\0' && std::strchr(lang->spec->quotes, c)) {
+        size_t start = i;
+        st.quote = c;
+        st.triple = false;
+        if (has(TRIPLE_QUOTES) && i + 2 < n && text[i + 1] == c && text[i + 2] == c) {
+          st.triple = true;
+          i += 3;
+        } else {
+          ++i;
+        }
+        st.mode = LexState::STRING;
+        i = continueString(start, i);
+        continue;
+      }
+      if (std::isdigit(static_cast<unsigned char>(c)) ||
+          (c == '.' && i + 1 < n && std::isdigit(static_cast<unsigned char>(text[i + 1])))) {
+        size_t j = i + 1;
+        while (j < n && (std::isalnum(static_cast<unsigned char>(text[j])) || text[j] == '_' ||
+                         text[j] == '.' || text[j] == '\'' || text[j] == '%'))
+          ++j;
+        emit(i, j, NUMBER);
+        i = j;
+        continue;
+      }
+      if (c == '$' && has(DOLLAR_VARS)) {
+        i = variable(i);
+        continue;
+      }
+      if (c == '@' && has(ANNOTATIONS) && i + 1 < n && isIdentStart(text[i + 1])) {
+        size_t j = i + 1;
+        while (j < n && (isIdentChar(text[j]) || text[j] == '-' || text[j] == '.')) ++j;
+        emit(i, j, PREPROC);
+        i = j;
+        continue;
+      }
+      if (isIdentStart(c) || (c == '$' && has(DOLLAR_IDENT))) {
+        size_t j = i + 1;
+        while (j < n && isIdentChar(text[j])) ++j;
+        std::string_view w = text.substr(i, j - i);
+        Token t = PLAIN;
+        if (keywordIn(lang->keywords, w)) {
+          t = KEYWORD;
+        } else if (keywordIn(lang->types, w)) {
+          t = TYPE;
+        } else if (has(CALLS)) {
+          size_t k = skipSpaces(j);
+          if (k < n && text[k] == '(') t = CALL;
+        }
+        emit(i, j, t);
+        i = j;
+        continue;
+      }
+      // Punctuation and anything else, up to the next thing worth a look.
+      size_t j = i + 1;
+      while (j < n && static_cast<unsigned char>(text[j]) >= 0x80) ++j;
+      emit(i, j, PLAIN);
+      i = j;
+    }
+  }
+
+  // $name, ${...}, $(...) openers and $1, $@ and friends.
+  size_t variable(size_t i) {
+    size_t n = text.size();
+    size_t j = i + 1;
+    if (j < n && text[j] == '{') {
+      size_t close = text.find('}', j);
+      j = close == std::string_view::npos ? n : close + 1;
+    } else if (j < n && (isIdentStart(text[j]))) {
+      while (j < n && (std::isalnum(static_cast<unsigned char>(text[j])) || text[j] == '_')) ++j;
+    } else if (j < n && std::strchr("0123456789@*#?$!-", text[j])) {
+      ++j;
+    }
+    emit(i, j, VARIABLE);
+    return j;
+  }
+
+  // "key = value", "key: value" and "[section]" at the start of a line.
+  size_t keyValue(size_t i) {
+    size_t n = text.size();
+    if (text[i] == '[' && !(lang->flags & DASH_IDENT)) {
+      size_t close = text.find(']', i);
+      if (close != std::string_view::npos) {
+        emit(i, close + 1, HEADING);
+        return close + 1;
+      }
+      return i;
+    }
+    size_t k = i;
+    if (text[k] == '-' && k + 1 < n && text[k + 1] == ' ') {
+      // A YAML list item.
+      emit(k, k + 1, KEYWORD);
+      size_t j = skipSpaces(k + 1);
+      emit(k + 1, j, PLAIN);
+      k = j;
+      i = j;
+    }
+    while (k < n && text[k] != '=' && text[k] != ':' && text[k] != ' ' && text[k] != '\t' &&
+           !std::strchr(lang->spec->quotes, text[k]))
+      ++k;
+    size_t keyEnd = k;
+    k = skipSpaces(k);
+    if (keyEnd == i || k >= n) return i;
+    bool isKey = text[k] == '=' || (text[k] == ':' && (k + 1 == n || text[k + 1] == ' ' ||
+                                                        text[k + 1] == '\t' || text[k + 1] == '='));
+    if (!isKey) return i;
+    emit(i, keyEnd, KEY);
+    return keyEnd;
+  }
+
+  size_t markup(size_t i) {
+    size_t n = text.size();
+    char c = text[i];
+    if (st.inTag) {
+      if (c == '>' || (c == '/' && i + 1 < n && text[i + 1] == '>') ||
+          (c == '?' && i + 1 < n && text[i + 1] == '>')) {
+        size_t j = c == '>' ? i + 1 : i + 2;
+        emit(i, j, TAG);
+        st.inTag = false;
+        return j;
+      }
+      if (c == '"' || c == '\'') {
+        st.quote = c;
+        st.triple = false;
+        st.mode = LexState::STRING;
+        return continueString(i, i + 1);
+      }
+      if (isIdentStart(c) || c == ':' || c == '@' || c == '#' || c == '.') {
+        size_t j = i + 1;
+        while (j < n && (std::isalnum(static_cast<unsigned char>(text[j])) || text[j] == '-' ||
+                         text[j] == '_' || text[j] == ':' || text[j] == '.'))
+          ++j;
+        emit(i, j, ATTR);
+        return j;
+      }
+      emit(i, i + 1, PLAIN);
+      return i + 1;
+    }
+    if (c == '<' && i + 1 < n &&
+        (isIdentStart(text[i + 1]) || std::strchr("/!?", text[i + 1]))) {
+      size_t j = i + 1;
+      if (std::strchr("/!?", text[j])) ++j;
+      while (j < n && (std::isalnum(static_cast<unsigned char>(text[j])) || text[j] == '-' ||
+                       text[j] == '_' || text[j] == ':' || text[j] == '.'))
+        ++j;
+      emit(i, j, TAG);
+      st.inTag = true;
+      return j;
+    }
+    if (c == '&') {
+      size_t semi = text.find(';', i);
+      if (semi != std::string_view::npos && semi - i <= 10) {
+        emit(i, semi + 1, NUMBER);
+        return semi + 1;
+      }
+    }
+    size_t j = i + 1;
+    while (j < n && text[j] != '<' && text[j] != '&') ++j;
+    emit(i, j, PLAIN);
+    return j;
+  }
+
+  void diffLine() {
+    Token t = PLAIN;
+    if (startsWith(0, "+++") || startsWith(0, "---") || startsWith(0, "diff ") ||
+        startsWith(0, "index "))
+      t = HEADING;
+    else if (startsWith(0, "@@"))
+      t = HUNK;
+    else if (startsWith(0, "+"))
+      t = ADDED;
+    else if (startsWith(0, "-"))
+      t = REMOVED;
+    emit(0, text.size(), t);
+  }
+
+  void markdownLine() {
+    size_t n = text.size();
+    size_t first = skipSpaces(0);
+    bool fence = startsWith(first, "```") || startsWith(first, "~~~");
+    if (st.mode == LexState::FENCE) {
+      emit(0, n, fence ? PREPROC : STRING);
+      if (fence) st.mode = LexState::CODE;
+      return;
+    }
+    if (fence) {
+      emit(0, n, PREPROC);
+      st.mode = LexState::FENCE;
+      return;
+    }
+    if (first < n && text[first] == '#') {
+      emit(0, n, HEADING);
+      return;
+    }
+    if (first < n && text[first] == '>') {
+      emit(0, n, COMMENT);
+      return;
+    }
+    size_t i = 0;
+    emit(0, first, PLAIN);
+    i = first;
+    if (i + 1 < n && std::strchr("-*+", text[i]) && text[i + 1] == ' ') {
+      emit(i, i + 1, KEYWORD);
+      ++i;
+    } else {
+      size_t j = i;
+      while (j < n && std::isdigit(static_cast<unsigned char>(text[j]))) ++j;
+      if (j > i && j + 1 < n && text[j] == '.' && text[j + 1] == ' ') {
+        emit(i, j + 1, KEYWORD);
+        i = j + 1;
+      }
+    }
+    while (i < n) {
+      char c = text[i];
+      if (c == '`') {
+        size_t close = text.find('`', i + 1);
+        size_t end = close == std::string_view::npos ? n : close + 1;
+        emit(i, end, STRING);
+        i = end;
+      } else if (c == '[') {
+        size_t close = text.find(']', i + 1);
+        if (close != std::string_view::npos && close + 1 < n && text[close + 1] == '(') {
+          size_t paren = text.find(')', close + 1);
+          size_t end = paren == std::string_view::npos ? n : paren + 1;
+          emit(i, close + 1, TYPE);
+          emit(close + 1, end, COMMENT);
+          i = end;
+        } else {
+          emit(i, i + 1, PLAIN);
+          ++i;
+        }
+      } else {
+        size_t j = i + 1;
+        while (j < n && text[j] != '`' && text[j] != '[') ++j;
+        emit(i, j, PLAIN);
+        i = j;
+      }
+    }
+  }
+
+  const SyntaxLanguage* lang;
+  StyledText& out;
+  LexState st;
+  std::string_view text;
+};
+
+} // namespace
+
+const SyntaxLanguage* syntaxForFile(std::string_view fileName) {
+  std::string lower(fileName);
+  for (char& c : lower)
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  const auto& byName = registry().byName;
+  auto it = byName.find(lower);
+  if (it != byName.end()) return it->second;
+  size_t dot = lower.rfind('.');
+  if (dot == std::string::npos) return nullptr;
+  it = byName.find(std::string_view(lower).substr(dot));
+  return it == byName.end() ? nullptr : it->second;
+}
+
+bool highlightText(std::string_view text, const SyntaxLanguage* lang, size_t maxLines,
+                   uint32_t maxColumns, StyledText& out,
+                   const std::function<bool()>& cancelled) {
+  out.setMaxColumns(maxColumns);
+  Lexer lexer(lang, out);
+  size_t pos = 0;
+  bool stopped = false;
+  for (size_t count = 0; count < maxLines && pos < text.size(); ++count) {
+    if (cancelled && (count & 63) == 63 && cancelled()) {
+      stopped = true;
+      break;
+    }
+    const void* nl = std::memchr(text.data() + pos, '\n', text.size() - pos);
+    size_t end = nl ? static_cast<const char*>(nl) - text.data() : text.size();
+    lexer.line(text.substr(pos, end - pos));
+    pos = end + 1;
+  }
+  out.setMaxColumns(UINT32_MAX);
+  return !stopped;
+}
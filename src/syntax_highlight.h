@@ -0,0 +1,29 @@
+#ifndef SYNTAX_HIGHLIGHT_H
+#define SYNTAX_HIGHLIGHT_H
+
+#include "styled_text.h"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+
+// Built-in highlighting for code previews, in place of running bat. Each
+// language is a row in a table (comment and string delimiters, keyword and
+// type lists, a few behaviour flags) driving one small lexer; its state
+// (open block comment, string, markup tag, code fence) carries from line to
+// line.
+struct SyntaxLanguage;
+
+// Language for a file name (by extension, or names like Makefile), or
+// nullptr for plain text.
+const SyntaxLanguage* syntaxForFile(std::string_view fileName);
+
+// Highlights the first maxLines lines of text (usually a TextReader slice)
+// into out, each clipped to maxColumns; lang may be nullptr. Returns false if
+// cancelled() turned true first.
+bool highlightText(std::string_view text, const SyntaxLanguage* lang, size_t maxLines,
+                   uint32_t maxColumns, StyledText& out,
+                   const std::function<bool()>& cancelled = nullptr);
+
+#endif // SYNTAX_HIGHLIGHT_H
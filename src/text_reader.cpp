@@ -0,0 +1,141 @@
+#include "text_reader.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/vfs.h>
+#else
+#include <sys/mount.h>
+#include <sys/param.h>
+#endif
+
+namespace {
+
+// Windows up to this size are read rather than mapped.
+constexpr size_t PREAD_LIMIT = 64 * 1024;
+
+bool onNetworkFs(int fd) {
+#ifdef __linux__
+  struct statfs sfs;
+  if (fstatfs(fd, &sfs) != 0) return false;
+  switch (static_cast<unsigned long>(sfs.f_type)) {
+  case 0x6969:     // NFS
+  case 0x517b:     // SMB
+  case 0xff534d42: // CIFS
+  case 0xfe534d42: // SMB2
+  case 0x65735546: // FUSE (sshfs, rclone, ...)
+  case 0x01021997: // 9P
+  case 0x00c36400: // Ceph
+  case 0x47504653: // GPFS
+    return true;
+  default:
+    return false;
+  }
+#else
+  struct statfs sfs;
+  if (fstatfs(fd, &sfs) != 0) return false;
+  return (sfs.f_flags & MNT_LOCAL) == 0;
+#endif
+}
+
+} // namespace
+
+TextReader::~TextReader() {
+  if (mapped) munmap(const_cast<char*>(base), size);
+}
+
+bool TextReader::open(const std::string& path, size_t maxBytes) {
+  if (mapped) munmap(const_cast<char*>(base), size);
+  base = nullptr;
+  size = fileSize = 0;
+  mapped = false;
+  buffer.clear();
+  checkpoints.assign(1, 0);
+  indexedLine = indexedPos = 0;
+
+  int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+    close(fd);
+    return false;
+  }
+  fileSize = static_cast<size_t>(st.st_size);
+  size_t window = std::min(fileSize, maxBytes);
+
+  if (window > PREAD_LIMIT && !onNetworkFs(fd)) {
+    void* map = mmap(nullptr, window, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map != MAP_FAILED) {
+      madvise(map, window, MADV_SEQUENTIAL);
+      base = static_cast<const char*>(map);
+      size = window;
+      mapped = true;
+      close(fd);
+      return true;
+    }
+  }
+
+  buffer.resize(window);
+  size_t got = 0;
+  while (got < window) {
+    ssize_t n = pread(fd, &buffer[got], window - got, static_cast<off_t>(got));
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) break;
+    got += static_cast<size_t>(n);
+  }
+  close(fd);
+  buffer.resize(got);
+  base = buffer.data();
+  size = got;
+  return true;
+}
+
+bool TextReader::binary() const {
+  return std::memchr(base, '\0', std::min(size, BINARY_PROBE)) != nullptr;
+}
+
+// Start of the line after the one containing pos, or NPOS.
+size_t TextReader::nextLine(size_t pos) const {
+  const void* nl = std::memchr(base + pos, '\n', size - pos);
+  if (!nl) return NPOS;
+  size_t next = static_cast<const char*>(nl) - base + 1;
+  return next < size ? next : NPOS;
+}
+
+size_t TextReader::lineStart(size_t i) {
+  if (size == 0) return NPOS;
+  if (i <= indexedLine) {
+    size_t pos = checkpoints[i / INDEX_STRIDE];
+    for (size_t k = i / INDEX_STRIDE * INDEX_STRIDE; k < i; ++k)
+      pos = nextLine(pos);
+    return pos;
+  }
+  while (indexedLine < i) {
+    size_t next = nextLine(indexedPos);
+    if (next == NPOS) return NPOS;
+    indexedPos = next;
+    if (++indexedLine % INDEX_STRIDE == 0) checkpoints.push_back(indexedPos);
+  }
+  return indexedPos;
+}
+
+std::string_view TextReader::line(size_t i) {
+  size_t begin = lineStart(i);
+  if (begin == NPOS) return {};
+  const void* nl = std::memchr(base + begin, '\n', size - begin);
+  size_t end = nl ? static_cast<size_t>(static_cast<const char*>(nl) - base) : size;
+  if (end > begin && base[end - 1] == '\r') --end;
+  return std::string_view(base + begin, end - begin);
+}
+
+std::string_view TextReader::lines(size_t first, size_t count) {
+  size_t begin = lineStart(first);
+  if (begin == NPOS) return {};
+  size_t end = lineStart(first + count);
+  if (end == NPOS) end = size;
+  return std::string_view(base + begin, end - begin);
+}
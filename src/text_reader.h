@@ -0,0 +1,60 @@
+#ifndef TEXT_READER_H
+#define TEXT_READER_H
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Read-only view of the start of a file for text previews. At most maxBytes
+// are ever looked at: the window is mapped with mmap, or read with a single
+// pread when it is small or the file lives on a network filesystem (where a
+// mapping can fault on a stalled server). Binary detection and line lookups
+// only touch the bytes they need; line starts are found with memchr and
+// remembered every INDEX_STRIDE lines, so line(i) is a short scan from the
+// nearest checkpoint.
+class TextReader {
+public:
+  static constexpr size_t DEFAULT_BYTES = 4 << 20;
+  // Bytes checked for a NUL by binary().
+  static constexpr size_t BINARY_PROBE = 8192;
+
+  TextReader() = default;
+  ~TextReader();
+
+  TextReader(const TextReader&) = delete;
+  TextReader& operator=(const TextReader&) = delete;
+
+  // False if path is not a readable regular file.
+  bool open(const std::string& path, size_t maxBytes = DEFAULT_BYTES);
+
+  std::string_view data() const { return std::string_view(base, size); }
+  // The file goes on past data().
+  bool truncated() const { return fileSize > size; }
+  bool binary() const;
+
+  // Line i without its newline; empty past the end (see hasLine()).
+  std::string_view line(size_t i);
+  bool hasLine(size_t i) { return lineStart(i) != NPOS; }
+  // Lines [first, first + count) as one slice, newlines included.
+  std::string_view lines(size_t first, size_t count);
+
+private:
+  static constexpr size_t INDEX_STRIDE = 64;
+  static constexpr size_t NPOS = static_cast<size_t>(-1);
+
+  size_t lineStart(size_t i);
+  size_t nextLine(size_t pos) const;
+
+  const char* base = nullptr;
+  size_t size = 0;
+  size_t fileSize = 0;
+  bool mapped = false;
+  std::string buffer; // the pread window
+
+  std::vector<size_t> checkpoints; // start of line k * INDEX_STRIDE
+  size_t indexedLine = 0;          // the last line start the index has reached...
+  size_t indexedPos = 0;           // ...and where it is
+};
+
+#endif // TEXT_READER_H
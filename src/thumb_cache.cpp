@@ -0,0 +1,173 @@
+#include "thumb_cache.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr char THUMB_MAGIC[8] = {'F', 'Y', 'Z', 'K', 'T', 'Y', '0', '1'};
+// A pass after this many new thumbnails, and one shortly after startup.
+constexpr unsigned STORES_PER_PASS = 256;
+constexpr auto STARTUP_DELAY = std::chrono::seconds(5);
+// Trim to this share of the cap so every store doesn't trigger deletions.
+constexpr double GC_LOW_WATER = 0.9;
+// Leftovers of killed writers.
+constexpr int64_t STALE_PART_SECONDS = 3600;
+// Don't rewrite atime on every hit; an hour is plenty for LRU order.
+constexpr int64_t ATIME_REFRESH_SECONDS = 3600;
+
+struct Header {
+  char magic[8];
+  uint32_t w;
+  uint32_t h;
+  uint64_t payloadLen;
+};
+
+std::atomic<unsigned> tempSeq{0};
+
+} // namespace
+
+bool loadThumb(const std::string& file, std::string& b64, int& w, int& h) {
+  int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  struct stat st;
+  if (fstat(fd, &st) != 0 || static_cast<size_t>(st.st_size) < sizeof(Header)) {
+    close(fd);
+    return false;
+  }
+  size_t len = static_cast<size_t>(st.st_size);
+  void* m = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+  bool ok = false;
+  if (m != MAP_FAILED) {
+    const Header* hdr = static_cast<const Header*>(m);
+    if (std::memcmp(hdr->magic, THUMB_MAGIC, sizeof(THUMB_MAGIC)) == 0 &&
+        hdr->payloadLen == len - sizeof(Header) && hdr->w > 0 && hdr->h > 0) {
+      b64.assign(static_cast<const char*>(m) + sizeof(Header), hdr->payloadLen);
+      w = static_cast<int>(hdr->w);
+      h = static_cast<int>(hdr->h);
+      ok = true;
+    }
+    munmap(m, len);
+  }
+  // noatime/relatime mounts may not record the hit; the GC relies on it.
+  if (ok && time(nullptr) - st.st_atime > ATIME_REFRESH_SECONDS) {
+    struct timespec times[2] = {{0, UTIME_NOW}, {0, UTIME_OMIT}};
+    futimens(fd, times);
+  }
+  close(fd);
+  return ok;
+}
+
+bool storeThumb(const std::string& file, const std::string& b64, int w, int h) {
+  Header hdr{};
+  std::memcpy(hdr.magic, THUMB_MAGIC, sizeof(THUMB_MAGIC));
+  hdr.w = static_cast<uint32_t>(w);
+  hdr.h = static_cast<uint32_t>(h);
+  hdr.payloadLen = b64.size();
+
+  std::string tmp = file + ".part" + std::to_string(getpid()) + "-" + std::to_string(++tempSeq);
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (!f) return false;
+  bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1 &&
+            fwrite(b64.data(), 1, b64.size(), f) == b64.size();
+  ok = (fclose(f) == 0) && ok;
+  if (!ok || rename(tmp.c_str(), file.c_str()) != 0) {
+    unlink(tmp.c_str());
+    return false;
+  }
+  return true;
+}
+
+ThumbCacheGC::~ThumbCacheGC() { stop(); }
+
+void ThumbCacheGC::start(const std::string& d, uint64_t capBytes) {
+  dir = d;
+  cap = capBytes;
+  if (dir.empty() || cap == 0) return;
+  thread = std::thread(&ThumbCacheGC::loop, this);
+}
+
+void ThumbCacheGC::stop() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  cv.notify_all();
+  if (thread.joinable()) thread.join();
+}
+
+void ThumbCacheGC::noteStore() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (++storesSincePass >= STORES_PER_PASS) {
+    storesSincePass = 0;
+    passRequested = true;
+    cv.notify_one();
+  }
+}
+
+void ThumbCacheGC::loop() {
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait_for(lock, STARTUP_DELAY, [this] { return stopping; });
+  while (!stopping) {
+    lock.unlock();
+    collect();
+    lock.lock();
+    cv.wait(lock, [this] { return stopping || passRequested; });
+    passRequested = false;
+  }
+}
+
+void ThumbCacheGC::collect() {
+  struct Item {
+    time_t atime;
+    uint64_t bytes;
+    std::string path;
+  };
+  std::vector<Item> items;
+  uint64_t total = 0;
+  time_t now = time(nullptr);
+
+  DIR* dp = opendir(dir.c_str());
+  if (!dp) return;
+  int dfd = dirfd(dp);
+  while (struct dirent* e = readdir(dp)) {
+    if (e->d_name[0] == '.') continue;
+    struct stat st;
+    if (fstatat(dfd, e->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 || !S_ISREG(st.st_mode)) continue;
+    std::string name = e->d_name;
+    bool part = name.find(".part") != std::string::npos;
+    bool legacy = name.size() > 4 && name.compare(name.size() - 4, 4, ".png") == 0 && !part;
+    // PNG thumbnails from before the payload format are never read again.
+    if (legacy || (part && now - st.st_mtime > STALE_PART_SECONDS)) {
+      unlinkat(dfd, e->d_name, 0);
+      continue;
+    }
+    if (part) continue;
+    uint64_t bytes = static_cast<uint64_t>(st.st_blocks) * 512;
+    total += bytes;
+    items.push_back({st.st_atime, bytes, std::move(name)});
+  }
+
+  if (total > cap) {
+    std::sort(items.begin(), items.end(),
+              [](const Item& a, const Item& b) { return a.atime < b.atime; });
+    uint64_t target = static_cast<uint64_t>(cap * GC_LOW_WATER);
+    for (const Item& it : items) {
+      if (total <= target) break;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (stopping) break;
+      }
+      if (unlinkat(dfd, it.path.c_str(), 0) == 0) total -= it.bytes;
+    }
+  }
+  closedir(dp);
+}
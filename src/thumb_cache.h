@@ -0,0 +1,50 @@
+#ifndef THUMB_CACHE_H
+#define THUMB_CACHE_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// On-disk thumbnail cache. Each file (named by getCachePath()) holds a small
+// header with the placement size followed by the base64 Kitty payload, so a
+// hit is an mmap and a copy instead of a read, decode and re-encode.
+
+// Loads a thumbnail written by storeThumb(). False if missing or corrupt.
+bool loadThumb(const std::string& file, std::string& b64, int& w, int& h);
+// Writes file atomically (temp name + rename).
+bool storeThumb(const std::string& file, const std::string& b64, int w, int h);
+
+// Keeps the thumbnail directory under a size cap by removing the least
+// recently used files (by atime, which loadThumb() refreshes) on a background
+// thread. A pass runs shortly after start() and again after every few hundred
+// stores.
+class ThumbCacheGC {
+public:
+  ThumbCacheGC() = default;
+  ~ThumbCacheGC();
+
+  ThumbCacheGC(const ThumbCacheGC&) = delete;
+  ThumbCacheGC& operator=(const ThumbCacheGC&) = delete;
+
+  void start(const std::string& dir, uint64_t capBytes);
+  void stop();
+  // Called after each storeThumb().
+  void noteStore();
+
+private:
+  void loop();
+  void collect();
+
+  std::string dir;
+  uint64_t cap = 0;
+  std::thread thread;
+  std::mutex mutex;
+  std::condition_variable cv;
+  bool stopping = false;
+  bool passRequested = false;
+  unsigned storesSincePass = 0;
+};
+
+#endif // THUMB_CACHE_H
@@ -0,0 +1,149 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <mutex>
+#include <unistd.h>
+
+namespace {
+
+struct TraceEvent {
+  const char* name;
+  int64_t startNs;
+  int64_t durNs;
+  int tid;
+};
+
+std::atomic<TraceSite*> sites{nullptr};
+std::atomic<bool> tracing{false};
+std::atomic<int> nextTid{1};
+
+std::mutex eventsMutex;
+std::vector<TraceEvent> events;
+std::string traceFile;
+int64_t traceOrigin = 0;
+
+int threadId() {
+  thread_local int tid = nextTid++;
+  return tid;
+}
+
+int bucketOf(uint64_t ns) {
+  uint64_t us = ns / 1000;
+  int b = 0;
+  while (us > 1 && b < TraceSite::BUCKETS - 1) {
+    us >>= 1;
+    ++b;
+  }
+  return b;
+}
+
+void writeJsonString(FILE* f, const char* s) {
+  fputc('"', f);
+  for (; *s; ++s) {
+    if (*s == '"' || *s == '\\') fputc('\\', f);
+    fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+} // namespace
+
+int64_t traceNow() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+}
+
+TraceSite::TraceSite(const char* name) : name(name) {
+  next = sites.load();
+  while (!sites.compare_exchange_weak(next, this)) {
+  }
+}
+
+void TraceSite::record(int64_t startNs, int64_t endNs) {
+  uint64_t ns = endNs > startNs ? static_cast<uint64_t>(endNs - startNs) : 0;
+  count.fetch_add(1, std::memory_order_relaxed);
+  totalNs.fetch_add(ns, std::memory_order_relaxed);
+  buckets[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+  uint64_t prev = maxNs.load(std::memory_order_relaxed);
+  while (ns > prev && !maxNs.compare_exchange_weak(prev, ns, std::memory_order_relaxed)) {
+  }
+  if (tracing.load(std::memory_order_relaxed)) {
+    std::lock_guard<std::mutex> lock(eventsMutex);
+    if (events.size() < MAX_TRACE_EVENTS)
+      events.push_back({name, startNs, static_cast<int64_t>(ns), threadId()});
+  }
+}
+
+std::vector<TraceStats> traceStats() {
+  std::vector<TraceStats> out;
+  for (TraceSite* s = sites.load(); s; s = s->next) {
+    TraceStats st;
+    st.name = s->name;
+    st.count = s->count.load(std::memory_order_relaxed);
+    if (st.count == 0) continue;
+    st.totalNs = s->totalNs.load(std::memory_order_relaxed);
+    st.maxNs = s->maxNs.load(std::memory_order_relaxed);
+    uint64_t seen = 0;
+    for (int b = 0; b < TraceSite::BUCKETS; ++b) {
+      st.buckets[b] = s->buckets[b].load(std::memory_order_relaxed);
+      seen += st.buckets[b];
+    }
+    // The upper bound of the bucket holding the sample of rank ceil(seen * q).
+    auto percentile = [&](uint64_t num, uint64_t den) {
+      uint64_t rank = (seen * num + den - 1) / den, cumulative = 0;
+      for (int b = 0; b < TraceSite::BUCKETS; ++b) {
+        cumulative += st.buckets[b];
+        if (cumulative >= rank) return std::min<uint64_t>(1000ULL << (b + 1), st.maxNs);
+      }
+      return st.maxNs;
+    };
+    st.p50Ns = percentile(50, 100);
+    st.p90Ns = percentile(90, 100);
+    st.p99Ns = percentile(99, 100);
+    out.push_back(std::move(st));
+  }
+  std::reverse(out.begin(), out.end());
+  return out;
+}
+
+void traceReset() {
+  for (TraceSite* s = sites.load(); s; s = s->next) {
+    s->count = 0;
+    s->totalNs = 0;
+    s->maxNs = 0;
+    for (auto& b : s->buckets)
+      b = 0;
+  }
+}
+
+void traceStart(const std::string& file) {
+  std::lock_guard<std::mutex> lock(eventsMutex);
+  traceFile = file;
+  events.clear();
+  traceOrigin = traceNow();
+  tracing = true;
+}
+
+bool traceStop() {
+  tracing = false;
+  std::lock_guard<std::mutex> lock(eventsMutex);
+  if (traceFile.empty()) return true;
+  FILE* f = fopen(traceFile.c_str(), "w");
+  traceFile.clear();
+  if (!f) return false;
+  fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[", f);
+  int pid = static_cast<int>(getpid());
+  for (size_t i = 0; i < events.size(); ++i) {
+    const TraceEvent& e = events[i];
+    fputs(i ? ",\n{\"name\":" : "\n{\"name\":", f);
+    writeJsonString(f, e.name);
+    fprintf(f, ",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":%d,\"tid\":%d}",
+            (e.startNs - traceOrigin) / 1000.0, e.durNs / 1000.0, pid, e.tid);
+  }
+  fputs("\n]}\n", f);
+  events.clear();
+  events.shrink_to_fit();
+  return fclose(f) == 0;
+}
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Scoped timers for the hot paths. TRACE_SCOPE("name") times the rest of the
+// enclosing block and adds it to the name's site: a count, total, maximum and
+// a histogram of power-of-two microsecond buckets, all relaxed atomics, so a
+// scope costs two clock reads and a handful of adds. The stats overlay and
+// fyzenor-bench read the sites with traceStats().
+//
+// Between traceStart() and traceStop() every timed scope is also kept as a
+// Chrome trace event, and traceStop() writes them as JSON for
+// chrome://tracing or ui.perfetto.dev.
+struct TraceSite {
+  // Bucket b holds times in [2^b, 2^(b+1)) microseconds; bucket 0 also
+  // holds anything shorter.
+  static constexpr int BUCKETS = 32;
+
+  explicit TraceSite(const char* name);
+  void record(int64_t startNs, int64_t endNs);
+
+  const char* name;
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> totalNs{0};
+  std::atomic<uint64_t> maxNs{0};
+  std::atomic<uint64_t> buckets[BUCKETS] = {};
+  TraceSite* next = nullptr;
+};
+
+// Monotonic nanoseconds.
+int64_t traceNow();
+
+class TraceScope {
+public:
+  explicit TraceScope(TraceSite& site) : site(site), start(traceNow()) {}
+  ~TraceScope() { site.record(start, traceNow()); }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+  TraceSite& site;
+  int64_t start;
+};
+
+struct TraceStats {
+  std::string name;
+  uint64_t count = 0;
+  uint64_t totalNs = 0;
+  uint64_t maxNs = 0;
+  // Upper bounds of the buckets holding these percentiles.
+  uint64_t p50Ns = 0;
+  uint64_t p90Ns = 0;
+  uint64_t p99Ns = 0;
+  uint64_t buckets[TraceSite::BUCKETS] = {};
+};
+
+// Every site that has run at least once, in the order they first ran.
+std::vector<TraceStats> traceStats();
+void traceReset();
+
+// Starts keeping events (at most MAX_TRACE_EVENTS) for file.
+void traceStart(const std::string& file);
+// Writes the kept events; false if the file could not be written.
+bool traceStop();
+constexpr size_t MAX_TRACE_EVENTS = 1 << 21;
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name)                                                                     \
+  static TraceSite TRACE_CONCAT(traceSite, __LINE__)(name);                                   \
+  TraceScope TRACE_CONCAT(traceScope, __LINE__)(TRACE_CONCAT(traceSite, __LINE__))
+// Records a span that began at startNs (from traceNow()) and ends now.
+#define TRACE_SPAN(name, startNs)                                                             \
+  do {                                                                                        \
+    static TraceSite traceSite(name);                                                         \
+    traceSite.record(startNs, traceNow());                                                    \
+  } while (0)
+
+#endif // TRACE_H
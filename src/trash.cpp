@@ -0,0 +1,429 @@
+#include "trash.h"
+#include "copy_engine.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// How long info() trusts an index before looking at the info directory's
+// mtime again.
+constexpr auto RECHECK_INTERVAL = std::chrono::seconds(1);
+constexpr size_t INFO_SUFFIX_LEN = 10; // ".trashinfo"
+
+int64_t mtimeOf(const std::string& path) {
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0) return INT64_MIN;
+#ifdef __linux__
+  return static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec;
+#else
+  return static_cast<int64_t>(st.st_mtime) * 1000000000LL;
+#endif
+}
+
+bool isDir(const std::string& path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// A directory of ours that is not a symlink, created if missing.
+bool ensureDir(const std::string& path) {
+  if (mkdir(path.c_str(), 0700) == 0) return true;
+  struct stat st;
+  return errno == EEXIST && lstat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode) &&
+         st.st_uid == getuid();
+}
+
+// Path= values are URI-escaped, '/' aside.
+std::string escapePath(const std::string& path) {
+  static const char HEX[] = "0123456789ABCDEF";
+  std::string out;
+  out.reserve(path.size());
+  for (unsigned char c : path) {
+    if (isalnum(c) || (c && strchr("/-_.~!*'()", c))) {
+      out += static_cast<char>(c);
+    } else {
+      out += '%';
+      out += HEX[c >> 4];
+      out += HEX[c & 15];
+    }
+  }
+  return out;
+}
+
+std::string unescapePath(std::string_view s) {
+  auto hex = [](char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+  };
+  std::string out;
+  out.reserve(s.size());
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '%' && i + 2 < s.size() && hex(s[i + 1]) >= 0 && hex(s[i + 2]) >= 0) {
+      out += static_cast<char>(hex(s[i + 1]) * 16 + hex(s[i + 2]));
+      i += 2;
+    } else {
+      out += s[i];
+    }
+  }
+  return out;
+}
+
+// /proc/self/mounts escapes blanks and backslashes as octal.
+std::string unescapeMount(const std::string& s) {
+  std::string out;
+  for (size_t i = 0; i < s.size(); ++i) {
+    if (s[i] == '\\' && i + 3 < s.size() && isdigit(static_cast<unsigned char>(s[i + 1]))) {
+      out += static_cast<char>(std::strtol(s.substr(i + 1, 3).c_str(), nullptr, 8));
+      i += 3;
+    } else {
+      out += s[i];
+    }
+  }
+  return out;
+}
+
+bool parseInfo(int dirFd, const char* name, TrashInfo& out) {
+  int fd = openat(dirFd, name, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return false;
+  char buf[4 * PATH_MAX];
+  ssize_t n;
+  do {
+    n = read(fd, buf, sizeof(buf));
+  } while (n < 0 && errno == EINTR);
+  close(fd);
+  if (n <= 0) return false;
+
+  std::string_view text(buf, static_cast<size_t>(n));
+  while (!text.empty()) {
+    size_t nl = text.find('\n');
+    std::string_view line = text.substr(0, nl);
+    text = nl == std::string_view::npos ? std::string_view() : text.substr(nl + 1);
+    if (line.rfind("Path=", 0) == 0) {
+      out.originalPath = unescapePath(line.substr(5));
+    } else if (line.rfind("DeletionDate=", 0) == 0) {
+      out.deletionDate = std::string(line.substr(13));
+      size_t t = out.deletionDate.find('T');
+      if (t != std::string::npos) out.deletionDate[t] = ' ';
+    }
+  }
+  return !out.originalPath.empty();
+}
+
+std::string deletionDate() {
+  std::time_t now = std::time(nullptr);
+  struct tm tm;
+  localtime_r(&now, &tm);
+  char buf[32];
+  std::strftime(buf, sizeof(buf), "%Y-%m-%dT%H:%M:%S", &tm);
+  return buf;
+}
+
+// The topmost directory above path that is still on dev.
+std::string mountTop(const std::string& path, dev_t dev) {
+  std::string cur = path;
+  while (cur != "/") {
+    size_t slash = cur.rfind('/');
+    std::string parent = slash == 0 ? "/" : cur.substr(0, slash);
+    struct stat st;
+    if (stat(parent.c_str(), &st) != 0 || st.st_dev != dev) return cur;
+    cur = parent;
+  }
+  return cur;
+}
+
+bool moveEntry(int fromFd, const char* from, int toFd, const char* to) {
+#ifdef __linux__
+  if (renameat2(fromFd, from, toFd, to, RENAME_NOREPLACE) == 0) return true;
+  if (errno != ENOSYS && errno != EINVAL) return false;
+#endif
+  struct stat st;
+  if (fstatat(toFd, to, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+    errno = EEXIST;
+    return false;
+  }
+  return renameat(fromFd, from, toFd, to) == 0;
+}
+
+} // namespace
+
+fs::path Trash::homeRoot() {
+  const char* data = std::getenv("XDG_DATA_HOME");
+  if (data && data[0] == '/') return fs::path(data) / "Trash";
+  const char* home = std::getenv("HOME");
+  return home ? fs::path(home) / ".local/share/Trash" : fs::path();
+}
+
+fs::path Trash::homeFilesDir() {
+  fs::path root = homeRoot();
+  return root.empty() ? root : root / "files";
+}
+
+Trash::Can& Trash::addCan(const fs::path& root) {
+  Can& can = cans[(root / "files").string()];
+  can.root = root;
+  return can;
+}
+
+Trash::Can* Trash::canFor(const fs::path& filesDir) {
+  auto it = cans.find(filesDir.string());
+  if (it != cans.end()) return &it->second;
+  if (filesDir.filename() != "files" || !isDir(filesDir.string())) return nullptr;
+  return &addCan(filesDir.parent_path());
+}
+
+void Trash::scanMounts() {
+  scanned = true;
+  fs::path home = homeRoot();
+  if (!home.empty()) addCan(home);
+  std::string uid = std::to_string(getuid());
+  auto probe = [&](const std::string& top) {
+    std::string own = (top == "/" ? "" : top) + "/.Trash-" + uid;
+    if (isDir(own + "/files")) addCan(own);
+    std::string shared = (top == "/" ? "" : top) + "/.Trash/" + uid;
+    if (isDir(shared + "/files")) addCan(shared);
+  };
+#ifdef __linux__
+  // Only filesystems on block devices: probing network and pseudo
+  // filesystems can stall or wake automounts.
+  std::ifstream mounts("/proc/self/mounts");
+  std::string device, mountPoint, rest;
+  while (mounts >> device >> mountPoint && std::getline(mounts, rest)) {
+    if (device.rfind("/dev/", 0) == 0) probe(unescapeMount(mountPoint));
+  }
+#else
+  const char* homeEnv = std::getenv("HOME");
+  std::vector<std::string> scanDirs = {"/mnt", "/Volumes"};
+  if (homeEnv) {
+    std::string user = fs::path(homeEnv).filename().string();
+    scanDirs.push_back("/media/" + user);
+    scanDirs.push_back("/run/media/" + user);
+  }
+  for (const auto& scanDir : scanDirs) {
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(scanDir, ec))
+      probe(entry.path().string());
+  }
+#endif
+}
+
+void Trash::rescan() {
+  std::lock_guard<std::mutex> lock(mutex);
+  scanned = false;
+}
+
+std::vector<fs::path> Trash::filesDirs() {
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!scanned) scanMounts();
+  std::vector<fs::path> dirs;
+  fs::path home = homeFilesDir();
+  for (const auto& kv : cans) {
+    if (kv.first != home.string() && isDir(kv.first)) dirs.push_back(kv.first);
+  }
+  std::sort(dirs.begin(), dirs.end());
+  if (!home.empty() && isDir(home.string())) dirs.insert(dirs.begin(), home);
+  return dirs;
+}
+
+void Trash::refresh(Can& can) {
+  auto now = std::chrono::steady_clock::now();
+  if (can.infoMtime != INT64_MIN && now - can.checkedAt < RECHECK_INTERVAL) return;
+  can.checkedAt = now;
+  std::string infoDir = (can.root / "info").string();
+  int64_t mtime = mtimeOf(infoDir);
+  if (mtime == can.infoMtime && mtime != INT64_MIN) return;
+  can.infoMtime = mtime;
+
+  DIR* dir = opendir(infoDir.c_str());
+  if (!dir) {
+    can.entries.clear();
+    return;
+  }
+  // Relative Path= values are relative to the filesystem's top directory.
+  std::string top = can.root.parent_path().string();
+  if (can.root.parent_path().filename() == ".Trash") top = can.root.parent_path().parent_path().string();
+  std::unordered_map<std::string, TrashInfo> fresh;
+  fresh.reserve(can.entries.size());
+  while (struct dirent* de = readdir(dir)) {
+    std::string_view n(de->d_name);
+    if (n.size() <= INFO_SUFFIX_LEN || n.substr(n.size() - INFO_SUFFIX_LEN) != ".trashinfo")
+      continue;
+    std::string name(n.substr(0, n.size() - INFO_SUFFIX_LEN));
+    auto it = can.entries.find(name);
+    if (it != can.entries.end()) {
+      fresh.emplace(std::move(name), std::move(it->second));
+      continue;
+    }
+    TrashInfo ti;
+    if (!parseInfo(dirfd(dir), de->d_name, ti)) continue;
+    if (ti.originalPath[0] != '/') ti.originalPath = top + "/" + ti.originalPath;
+    fresh.emplace(std::move(name), std::move(ti));
+  }
+  closedir(dir);
+  can.entries.swap(fresh);
+}
+
+bool Trash::info(const fs::path& trashed, TrashInfo& out) {
+  std::lock_guard<std::mutex> lock(mutex);
+  Can* can = canFor(trashed.parent_path());
+  if (!can) return false;
+  refresh(*can);
+  auto it = can->entries.find(trashed.filename().string());
+  if (it == can->entries.end()) return false;
+  out = it->second;
+  return true;
+}
+
+bool Trash::openTarget(dev_t dev, const fs::path& path, Target& out) {
+  fs::path root;
+  fs::path home = homeRoot();
+  struct stat st;
+  std::error_code ec;
+  if (!home.empty() && (fs::create_directories(home, ec), stat(home.c_str(), &st) == 0) &&
+      st.st_dev == dev) {
+    root = home;
+  } else {
+    root = mountTop(path.string(), dev);
+    root /= ".Trash-" + std::to_string(getuid());
+    if (!ensureDir(root.string())) return false;
+  }
+  if (!ensureDir((root / "files").string()) || !ensureDir((root / "info").string()))
+    return false;
+  out.filesFd = open((root / "files").c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  out.infoFd = open((root / "info").c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+  if (out.filesFd < 0 || out.infoFd < 0) return false;
+  std::lock_guard<std::mutex> lock(mutex);
+  out.can = canFor(root / "files");
+  return out.can != nullptr;
+}
+
+void Trash::trash(const std::vector<fs::path>& paths, std::vector<fs::path>& trashed,
+                  std::vector<fs::path>& failed, const StepFn& step) {
+  std::unordered_map<dev_t, Target> targets;
+  std::string parentDir;
+  int parentFd = -1;
+
+  for (size_t i = 0; i < paths.size(); ++i) {
+    std::string full = fs::absolute(paths[i]).lexically_normal().string();
+    while (full.size() > 1 && full.back() == '/')
+      full.pop_back();
+    size_t slash = full.rfind('/');
+    std::string dir = slash == 0 ? "/" : full.substr(0, slash);
+    std::string name = full.substr(slash + 1);
+
+    if (dir != parentDir) {
+      if (parentFd >= 0) close(parentFd);
+      parentFd = open(dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+      parentDir = dir;
+    }
+
+    bool ok = false;
+    struct stat st;
+    if (parentFd >= 0 && !name.empty() &&
+        fstatat(parentFd, name.c_str(), &st, AT_SYMLINK_NOFOLLOW) == 0) {
+      auto [it, fresh] = targets.try_emplace(st.st_dev);
+      Target& t = it->second;
+      if (fresh && !openTarget(st.st_dev, full, t)) t.can = nullptr;
+
+      std::string date = deletionDate();
+      std::string text = "[Trash Info]\nPath=" + escapePath(full) + "\nDeletionDate=" + date + "\n";
+      // The first free "name", "name_1", ... in both files/ and info/.
+      for (int k = 0; t.can && k < 10000; ++k) {
+        std::string cand = k == 0 ? name : name + "_" + std::to_string(k);
+        std::string infoName = cand + ".trashinfo";
+        int fd = openat(t.infoFd, infoName.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0600);
+        if (fd < 0) {
+          if (errno == EEXIST) continue;
+          break;
+        }
+        bool written = write(fd, text.data(), text.size()) == static_cast<ssize_t>(text.size());
+        close(fd);
+        if (written && moveEntry(parentFd, name.c_str(), t.filesFd, cand.c_str())) {
+          ok = true;
+        } else if (written && errno == EXDEV) {
+          // Same device number yet no rename (bind mounts): copy over.
+          fs::path dest = t.can->root / "files" / cand;
+          try {
+            fs::copy(full, dest, fs::copy_options::recursive | fs::copy_options::copy_symlinks);
+            fs::remove_all(full);
+            ok = true;
+          } catch (...) {
+            std::error_code ec;
+            fs::remove_all(dest, ec);
+          }
+        } else if (written && errno == EEXIST) {
+          unlinkat(t.infoFd, infoName.c_str(), 0);
+          continue;
+        }
+        if (!ok) {
+          unlinkat(t.infoFd, infoName.c_str(), 0);
+          break;
+        }
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          TrashInfo& ti = t.can->entries[cand];
+          ti.originalPath = full;
+          ti.deletionDate = date;
+          ti.deletionDate[10] = ' ';
+        }
+        trashed.push_back(t.can->root / "files" / cand);
+        break;
+      }
+    }
+    if (!ok) failed.push_back(paths[i]);
+    if (step && !step(i + 1)) break;
+  }
+
+  if (parentFd >= 0) close(parentFd);
+  for (auto& kv : targets) {
+    if (kv.second.filesFd >= 0) close(kv.second.filesFd);
+    if (kv.second.infoFd >= 0) close(kv.second.infoFd);
+  }
+}
+
+void Trash::discardInfo(const fs::path& trashed) {
+  fs::path infoFile =
+      trashed.parent_path().parent_path() / "info" / (trashed.filename().string() + ".trashinfo");
+  unlink(infoFile.c_str());
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = cans.find(trashed.parent_path().string());
+  if (it != cans.end()) it->second.entries.erase(trashed.filename().string());
+}
+
+bool Trash::restore(const fs::path& trashed) {
+  TrashInfo ti;
+  if (!info(trashed, ti)) return false;
+  try {
+    fs::path original(ti.originalPath);
+    if (original.has_parent_path()) fs::create_directories(original.parent_path());
+    fs::path dest = original;
+    for (int count = 0;; ++count) {
+      if (count > 0) {
+        std::string suffix = count == 1 ? "_restored" : "_restored_" + std::to_string(count - 1);
+        dest = original.parent_path() / (original.filename().string() + suffix);
+      }
+      RenameResult r = renameNoReplace(trashed.c_str(), dest.c_str());
+      if (r == RenameResult::MOVED) break;
+      if (r == RenameResult::EXISTS) continue;
+      if (r != RenameResult::CROSS_DEVICE) return false;
+      if (fs::exists(fs::symlink_status(dest))) continue;
+      fs::copy(trashed, dest, fs::copy_options::recursive | fs::copy_options::copy_symlinks);
+      fs::remove_all(trashed);
+      break;
+    }
+  } catch (...) {
+    return false;
+  }
+  discardInfo(trashed);
+  return true;
+}
@@ -0,0 +1,85 @@
+#ifndef TRASH_H
+#define TRASH_H
+
+#include "utils.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <sys/types.h>
+
+struct TrashInfo {
+  std::string originalPath;
+  std::string deletionDate; // "YYYY-MM-DD hh:mm:ss"
+};
+
+// Freedesktop trash handled in-process: the home trash
+// ($XDG_DATA_HOME/Trash) and a .Trash-$uid directory at the top of every
+// other filesystem. A file goes to the trash of its own filesystem with one
+// renameat() between directory descriptors that stay open for the whole
+// batch; its .trashinfo is reserved with O_EXCL (which also picks the
+// trashed name) and filled with a single write().
+//
+// The original path and deletion date of every trashed file are kept in an
+// index per trash directory, read the first time it is asked about and only
+// topped up afterwards: when its info directory's mtime changes, the names
+// there are listed again and just the new .trashinfo files are parsed.
+// Thread-safe.
+class Trash {
+public:
+  // Called after each path with its index; returning false stops the
+  // batch (pause waits happen inside the callback).
+  using StepFn = std::function<bool(size_t done)>;
+
+  // Moves paths to the trash. Each trashed file lands in trashed, each
+  // failure in failed.
+  void trash(const std::vector<fs::path>& paths, std::vector<fs::path>& trashed,
+             std::vector<fs::path>& failed, const StepFn& step = nullptr);
+  // Puts a trashed file back at its original path (with a "_restored"
+  // suffix if that is taken) and drops its .trashinfo.
+  bool restore(const fs::path& trashed);
+  // Drops the .trashinfo of a trashed file that is deleted for good.
+  void discardInfo(const fs::path& trashed);
+  // What the index knows about a file in a trash files directory; false
+  // for a file without a readable .trashinfo.
+  bool info(const fs::path& trashed, TrashInfo& out);
+
+  // The home trash files directory ("" without $HOME).
+  fs::path homeFilesDir();
+  // The files directories of every trash that exists, the home one first.
+  // Mounted filesystems are looked at once, and again after rescan().
+  std::vector<fs::path> filesDirs();
+  // The mount table changed.
+  void rescan();
+
+private:
+  struct Can {
+    fs::path root; // holds files/ and info/
+    std::unordered_map<std::string, TrashInfo> entries; // by trashed name
+    int64_t infoMtime = INT64_MIN;
+    std::chrono::steady_clock::time_point checkedAt;
+  };
+  // Where one batch trashes files from one device.
+  struct Target {
+    Can* can = nullptr;
+    int filesFd = -1;
+    int infoFd = -1;
+    bool crossDevice = false; // files must be copied over
+  };
+
+  Can* canFor(const fs::path& filesDir);
+  Can& addCan(const fs::path& root);
+  void refresh(Can& can);
+  bool openTarget(dev_t dev, const fs::path& path, Target& out);
+  fs::path homeRoot();
+  void scanMounts();
+
+  std::mutex mutex;
+  std::unordered_map<std::string, Can> cans; // by files directory
+  bool scanned = false;
+};
+
+#endif // TRASH_H
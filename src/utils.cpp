@@ -1,5 +1,7 @@
 #include "utils.h"
+#include "text_reader.h"
 #include <algorithm>
+#include <array>
 #include <clocale>
 #include <cstdio>
 #include <cstdlib>
@@ -55,11 +57,23 @@ std::set<std::string> ARCHIVE_EXTS = {
 
 bool configShowHidden = false;
 std::string configSortMode = "name";
+std::string configKittyTransfer = "auto";
+std::string configFileIndexRoot = "~";
+std::string configCodeHighlighter = "builtin";
+bool configNaturalSort = true;
 double configParentWidth = 0.18;
 double configCurrentWidth = 0.32;
 bool configHidePreview = false;
 bool configHideParent = false;
 bool configHidePinned = false;
+unsigned configSizeWorkers = 0;
+bool configSizeCrossFilesystems = false;
+unsigned configCopyWorkers = 0;
+unsigned configPreviewPrefetch = 2;
+unsigned configPreviewWorkers = 0;
+unsigned configPreviewCacheMB = 64;
+unsigned configPreviewDiskCacheMB = 512;
+unsigned configSearchWorkers = 0;
 std::chrono::steady_clock::time_point globalStartTime;
 
 std::string g_icon_dir = " ";
@@ -92,9 +106,26 @@ const char* ICON_PIN = g_icon_pin.c_str();
 const char* ICON_ZIP = g_icon_zip.c_str();
 const char* ICON_LINK = g_icon_link.c_str();
 
-const std::string PREVIEW_TEMP = "/tmp/fm_preview_thumb.png";
 const uintmax_t SIZE_CALCULATING = UINTMAX_MAX;
 
+std::string getCacheRoot() {
+  const char* home = getenv("HOME");
+  fs::path cacheDir;
+  if (home) {
+    cacheDir = fs::path(home) / ".cache/fyzenor";
+  } else {
+    cacheDir = fs::temp_directory_path() / "fyzenor";
+  }
+  if (!fs::exists(cacheDir)) {
+    try {
+      fs::create_directories(cacheDir);
+    } catch (...) {
+      return "/tmp";
+    }
+  }
+  return cacheDir.string();
+}
+
 std::string getCacheDir() {
   const char* home = getenv("HOME");
   fs::path cacheDir;
@@ -114,37 +145,29 @@ std::string getCacheDir() {
 }
 
 std::string getCachePath(const fs::path& p, int w, int h) {
-  std::string pStr = p.string();
-  std::string cDir = getCacheDir();
-  if (!cDir.empty() && pStr.rfind(cDir, 0) == 0) {
-    return pStr;
-  }
-
-  if (pStr.find("Trash/files/") != std::string::npos || pStr.find(".Trash-") != std::string::npos) {
-    return "/tmp/fm_preview_thumb.png";
-  }
-
-  uintmax_t mtime = 0;
-  try {
-    mtime = fs::last_write_time(p).time_since_epoch().count();
-  } catch (...) {
-    mtime = 0;
+  // Inode, size and mtime keep re-used names (trash, downloads) from hitting
+  // an older file's thumbnail.
+  struct stat st;
+  if (stat(p.c_str(), &st) != 0)
+    return "";
+  std::string to_hash = p.string() + '\0' + std::to_string((unsigned long long)st.st_ino) + ':' +
+                        std::to_string((long long)st.st_size) + ':' +
+                        std::to_string((long long)st.st_mtime) + ':' +
+#ifdef __linux__
+                        std::to_string((long long)st.st_mtim.tv_nsec) + ':' +
+#endif
+                        std::to_string(w) + 'x' + std::to_string(h);
+
+  // FNV-1a
+  uint64_t hash = 1469598103934665603ULL;
+  for (char c : to_hash) {
+    hash ^= (unsigned char)c;
+    hash *= 1099511628211ULL;
   }
 
-  try {
-    std::string to_hash =
-        p.string() + std::to_string(mtime) + std::to_string(w) + std::to_string(h);
-
-    unsigned long hash = 5381;
-    for (char c : to_hash)
-      hash = ((hash << 5) + hash) + (unsigned char)c;
-
-    char hex[32];
-    snprintf(hex, sizeof(hex), "%lx", hash);
-    return (fs::path(getCacheDir()) / (std::string(hex) + ".png")).string();
-  } catch (...) {
-    return "/tmp/fm_preview_thumb.png";
-  }
+  char hex[32];
+  snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)hash);
+  return (fs::path(getCacheDir()) / (std::string(hex) + ".kitty")).string();
 }
 
 size_t utf8_length(const std::string& str) {
@@ -484,6 +507,31 @@ std::string base64_encode(const unsigned char* bytes, size_t len) {
   return ret;
 }
 
+std::string base64_decode(const std::string& in) {
+  static const std::array<signed char, 256> lookup = [] {
+    std::array<signed char, 256> t;
+    t.fill(-1);
+    for (int i = 0; i < 64; i++)
+      t[(unsigned char)base64_chars[i]] = (signed char)i;
+    return t;
+  }();
+  std::string out;
+  out.reserve(in.size() / 4 * 3);
+  uint32_t acc = 0;
+  int bits = 0;
+  for (unsigned char c : in) {
+    if (lookup[c] < 0)
+      continue; // '=' padding, whitespace
+    acc = (acc << 6) | (uint32_t)lookup[c];
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      out += (char)((acc >> bits) & 0xFF);
+    }
+  }
+  return out;
+}
+
 std::string formatSize(uintmax_t size) {
   if (size == SIZE_CALCULATING)
     return "...";
@@ -518,23 +566,8 @@ std::string getFileModifiedTime(const fs::path& path) {
 }
 
 bool is_binary_file(const std::string& path) {
-  try {
-    if (fs::is_directory(path))
-      return false;
-  } catch (...) {
-    return false;
-  }
-  std::ifstream file(path, std::ios::binary);
-  if (!file)
-    return false;
-  char buffer[512];
-  file.read(buffer, sizeof(buffer));
-  size_t n = file.gcount();
-  for (size_t i = 0; i < n; ++i) {
-    if (buffer[i] == '\0')
-      return true;
-  }
-  return false;
+  TextReader reader;
+  return reader.open(path, TextReader::BINARY_PROBE) && reader.binary();
 }
 
 std::string escapeShellArg(const std::string& str) {
@@ -818,13 +851,26 @@ void loadConfiguration() {
       out << "# Fyzenor Configuration File\n\n"
           << "[general]\n"
           << "show_hidden = false\n"
-          << "sort_mode = \"name\" # \"name\", \"size\", or \"date\"\n\n"
+          << "sort_mode = \"name\" # \"name\", \"size\", or \"date\"\n"
+          << "kitty_transfer = \"auto\" # \"auto\", \"direct\" (over the pty) or \"file\" (temp file)\n"
+          << "file_index_root = \"~\" # tree indexed for jump to file (F), \"\" = off\n"
+          << "code_highlighter = \"builtin\" # \"builtin\" or \"bat\" (bat/batcat when installed)\n"
+          << "natural_sort = true # names ignore case and compare digit runs as numbers\n\n"
           << "[layout]\n"
           << "parent_width = 0.18\n"
           << "current_width = 0.32\n"
           << "hide_preview = false\n"
           << "hide_parent = false\n"
           << "hide_pinned = false\n\n"
+          << "[performance]\n"
+          << "size_workers = 0 # directory size threads, 0 = one per core\n"
+          << "size_cross_filesystems = false\n"
+          << "copy_workers = 0 # parallel file copies per paste, 0 = pick per device\n"
+          << "preview_prefetch = 2 # entries above and below the cursor to preview ahead, 0 = off\n"
+          << "preview_workers = 0 # preview generator threads, 0 = pick from core count\n"
+          << "preview_cache_mb = 64 # memory for generated previews kept this session\n"
+          << "preview_disk_cache_mb = 512 # on-disk thumbnail cache cap, 0 = never clean up\n"
+          << "search_workers = 0 # content search threads, 0 = one per core\n\n"
           << "[icons]\n"
           << "dir = \" \"\n"
           << "video = \" \"\n"
@@ -923,6 +969,14 @@ void loadConfiguration() {
         configShowHidden = (val == "true");
       } else if (key == "sort_mode") {
         configSortMode = parse_string(val);
+      } else if (key == "kitty_transfer") {
+        configKittyTransfer = parse_string(val);
+      } else if (key == "file_index_root") {
+        configFileIndexRoot = parse_string(val);
+      } else if (key == "code_highlighter") {
+        configCodeHighlighter = parse_string(val);
+      } else if (key == "natural_sort") {
+        configNaturalSort = (val == "true");
       }
     } else if (section == "layout") {
       if (key == "parent_width") {
@@ -936,6 +990,24 @@ void loadConfiguration() {
       } else if (key == "hide_pinned") {
         configHidePinned = (val == "true");
       }
+    } else if (section == "performance") {
+      if (key == "size_workers") {
+        try { configSizeWorkers = static_cast<unsigned>(std::stoul(val)); } catch (...) {}
+      } else if (key == "size_cross_filesystems") {
+        configSizeCrossFilesystems = (val == "true");
+      } else if (key == "copy_workers") {
+        try { configCopyWorkers = static_cast<unsigned>(std::stoul(val)); } catch (...) {}
+      } else if (key == "preview_prefetch") {
+        try { configPreviewPrefetch = static_cast<unsigned>(std::stoul(val)); } catch (...) {}
+      } else if (key == "preview_workers") {
+        try { configPreviewWorkers = static_cast<unsigned>(std::stoul(val)); } catch (...) {}
+      } else if (key == "preview_cache_mb") {
+        try { configPreviewCacheMB = static_cast<unsigned>(std::stoul(val)); } catch (...) {}
+      } else if (key == "preview_disk_cache_mb") {
+        try { configPreviewDiskCacheMB = static_cast<unsigned>(std::stoul(val)); } catch (...) {}
+      } else if (key == "search_workers") {
+        try { configSearchWorkers = static_cast<unsigned>(std::stoul(val)); } catch (...) {}
+      }
     } else if (section == "icons") {
       std::string icon_val = parse_string(val);
       if (key == "dir") g_icon_dir = icon_val;
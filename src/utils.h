@@ -25,11 +25,23 @@ extern std::set<std::string> ARCHIVE_EXTS;
 
 extern bool configShowHidden;
 extern std::string configSortMode;
+extern std::string configKittyTransfer;
+extern std::string configFileIndexRoot;
+extern std::string configCodeHighlighter;
+extern bool configNaturalSort;
 extern double configParentWidth;
 extern double configCurrentWidth;
 extern bool configHidePreview;
 extern bool configHideParent;
 extern bool configHidePinned;
+extern unsigned configSizeWorkers;
+extern bool configSizeCrossFilesystems;
+extern unsigned configCopyWorkers;
+extern unsigned configPreviewPrefetch;
+extern unsigned configPreviewWorkers;
+extern unsigned configPreviewCacheMB;
+extern unsigned configPreviewDiskCacheMB;
+extern unsigned configSearchWorkers;
 extern std::chrono::steady_clock::time_point globalStartTime;
 void loadConfiguration();
 
@@ -48,7 +60,6 @@ extern const char* ICON_PIN;
 extern const char* ICON_ZIP;
 extern const char* ICON_LINK;
 
-extern const std::string PREVIEW_TEMP;
 extern const uintmax_t SIZE_CALCULATING;
 
 enum class SortMode {
@@ -57,7 +68,7 @@ enum class SortMode {
   DATE
 };
 
-enum class PreviewType { NONE, IMAGE, TEXT };
+enum class PreviewType { NONE, IMAGE, TEXT, DIRECTORY };
 
 struct Clipboard {
   std::vector<fs::path> paths;
@@ -70,6 +81,7 @@ struct FileStyle {
 };
 
 // Declarations of utility functions
+std::string getCacheRoot();
 std::string getCacheDir();
 std::string getCachePath(const fs::path& p, int w, int h);
 size_t utf8_length(const std::string& str);
@@ -78,6 +90,7 @@ std::string utf8_safe_truncate_left(const std::string& str, size_t max_cols);
 FileStyle getFileStyle(const std::string& name, const std::string& ext, bool isDir, bool isEmptyDir = false);
 int getFinalPair(int base, bool isSelected, bool isSecondary);
 std::string base64_encode(const unsigned char* bytes, size_t len);
+std::string base64_decode(const std::string& in);
 std::string formatSize(uintmax_t size);
 std::string getFileModifiedTime(const fs::path& path);
 bool is_binary_file(const std::string& path);
@@ -0,0 +1,54 @@
+#include "wakeup.h"
+#include <cerrno>
+#include <cstdint>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/eventfd.h>
+#endif
+
+Wakeup::Wakeup() {
+#ifdef __linux__
+  readFd = writeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (readFd >= 0) return;
+#endif
+  int fds[2];
+  if (pipe(fds) != 0) return;
+  for (int fd : fds) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+  }
+  readFd = fds[0];
+  writeFd = fds[1];
+}
+
+Wakeup::~Wakeup() {
+  if (writeFd >= 0 && writeFd != readFd) close(writeFd);
+  if (readFd >= 0) close(readFd);
+}
+
+void Wakeup::notify() {
+  if (writeFd < 0) return;
+  // An eventfd takes an 8-byte counter increment; a pipe takes anything.
+  // EAGAIN means a wakeup is already pending, which is all that matters.
+  uint64_t one = 1;
+  ssize_t n = write(writeFd, &one, writeFd == readFd ? sizeof(one) : 1);
+  (void)n;
+}
+
+void Wakeup::drain() {
+  if (readFd < 0) return;
+  char buf[64];
+  while (read(readFd, buf, sizeof(buf)) > 0) {
+  }
+}
+
+WaitResult waitForInput(int inputFd, const Wakeup& wake, int timeoutMs) {
+  struct pollfd fds[2] = {{inputFd, POLLIN, 0}, {wake.fd(), POLLIN, 0}};
+  int n = poll(fds, 2, timeoutMs);
+  if (n < 0) return errno == EINTR ? WaitResult::INPUT : WaitResult::TIMEOUT;
+  if (n == 0) return WaitResult::TIMEOUT;
+  if (fds[0].revents) return WaitResult::INPUT;
+  return WaitResult::WOKEN;
+}
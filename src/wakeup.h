@@ -0,0 +1,34 @@
+#ifndef WAKEUP_H
+#define WAKEUP_H
+
+// A file descriptor that worker threads make readable to wake a thread
+// sleeping in poll(). An eventfd on Linux, a non-blocking pipe elsewhere.
+// notify() never blocks and is async-signal-safe; repeated notifications
+// before drain() coalesce into one wakeup.
+class Wakeup {
+public:
+  Wakeup();
+  ~Wakeup();
+
+  Wakeup(const Wakeup&) = delete;
+  Wakeup& operator=(const Wakeup&) = delete;
+
+  void notify();
+  // Clears pending notifications. Call before looking at what changed, so a
+  // notify() that races with the look still wakes the next wait.
+  void drain();
+  int fd() const { return readFd; }
+
+private:
+  int readFd = -1;
+  int writeFd = -1;
+};
+
+enum class WaitResult { INPUT, WOKEN, TIMEOUT };
+
+// Sleeps until inputFd is readable, wake is notified or timeoutMs passes
+// (-1 waits indefinitely). A signal (SIGWINCH) counts as input so the
+// caller's getch() sees KEY_RESIZE. Does not drain wake.
+WaitResult waitForInput(int inputFd, const Wakeup& wake, int timeoutMs);
+
+#endif // WAKEUP_H
@@ -0,0 +1,54 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include "utils.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+// Minimal assertions for the ctest executables: a failed CHECK prints where
+// and exits non-zero.
+#define CHECK(cond)                                                                           \
+  do {                                                                                        \
+    if (!(cond)) {                                                                            \
+      std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);           \
+      std::exit(1);                                                                           \
+    }                                                                                         \
+  } while (0)
+
+#define CHECK_EQ(a, b)                                                                        \
+  do {                                                                                        \
+    auto checkA = (a);                                                                        \
+    auto checkB = (b);                                                                        \
+    if (!(checkA == checkB)) {                                                                \
+      std::fprintf(stderr, "%s:%d: CHECK_EQ(%s, %s) failed: %s vs %s\n", __FILE__, __LINE__,  \
+                   #a, #b, std::to_string(checkA).c_str(), std::to_string(checkB).c_str());   \
+      std::exit(1);                                                                           \
+    }                                                                                         \
+  } while (0)
+
+// A fresh directory under the temp directory, removed when it goes out of
+// scope.
+struct TempDir {
+  fs::path path;
+  explicit TempDir(const std::string& tag) {
+    path = fs::temp_directory_path() / ("fyzenor-test-" + tag + "-" + std::to_string(getpid()));
+    fs::remove_all(path);
+    fs::create_directories(path);
+  }
+  ~TempDir() {
+    std::error_code ec;
+    fs::remove_all(path, ec);
+  }
+};
+
+inline void writeTestFile(const fs::path& p, size_t bytes) {
+  FILE* f = std::fopen(p.c_str(), "wb");
+  if (!f) return;
+  std::string data(bytes, 'x');
+  std::fwrite(data.data(), 1, data.size(), f);
+  std::fclose(f);
+}
+
+#endif // CHECK_H
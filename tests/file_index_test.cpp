@@ -0,0 +1,73 @@
+#include "check.h" // first: it includes utils.h
+#include "file_index.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+namespace {
+
+std::vector<std::string> hits(FileIndex& index, const std::string& q, size_t& total) {
+  std::vector<std::string> out;
+  for (const FileIndex::Hit& h : index.query(q, 100, total))
+    out.push_back(h.path);
+  std::sort(out.begin(), out.end());
+  return out;
+}
+
+// Polls until the index answers q with want (the background thread applies
+// inotify events on its own schedule).
+bool waitFor(FileIndex& index, const std::string& q, const std::vector<std::string>& want) {
+  for (int i = 0; i < 500; ++i) {
+    size_t total;
+    if (hits(index, q, total) == want) return true;
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  }
+  return false;
+}
+
+} // namespace
+
+int main() {
+  TempDir tmp("fileindex");
+  fs::path root = tmp.path / "root";
+  fs::path victim = root / "victim";
+  fs::create_directories(victim);
+  writeTestFile(victim / "a", 1);
+  writeTestFile(victim / "b", 1);
+  writeTestFile(root / "other", 1);
+  std::string file = (tmp.path / "files.idx").string();
+  std::string v = victim.string();
+
+  {
+    FileIndex index;
+    index.start(root.string(), file);
+    for (int i = 0; i < 500 && !index.ready(); ++i)
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    CHECK(index.ready());
+    CHECK_EQ(index.size(), (size_t)4);
+    CHECK(waitFor(index, "victim", {v, v + "/a", v + "/b"}));
+
+    // Delete the directory, then recreate it with different contents: the
+    // old children must stay gone and nothing may be listed twice.
+    fs::remove_all(victim);
+    CHECK(waitFor(index, "victim", {}));
+    fs::create_directory(victim);
+    writeTestFile(victim / "a", 1);
+    writeTestFile(victim / "c", 1);
+    CHECK(waitFor(index, "victim", {v, v + "/a", v + "/c"}));
+    index.stop();
+  }
+
+  // What was saved holds every live path exactly once.
+  FileIndex index;
+  index.start(root.string(), file);
+  for (int i = 0; i < 500 && !index.ready(); ++i)
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+  CHECK(index.ready());
+  CHECK_EQ(index.size(), (size_t)4);
+  size_t total = 0;
+  CHECK(hits(index, "victim", total) == std::vector<std::string>({v, v + "/a", v + "/c"}));
+  CHECK_EQ(total, (size_t)3);
+  index.stop();
+  return 0;
+}
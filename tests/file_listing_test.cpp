@@ -0,0 +1,115 @@
+#include "check.h" // first: it includes utils.h
+#include "file_entry.h"
+#include "dir_loader.h"
+#include <random>
+
+namespace {
+
+std::vector<std::string> names(const FileListing& list) {
+  std::vector<std::string> out;
+  for (size_t i = 0; i < list.size(); ++i)
+    out.push_back(list[i].path().filename().string());
+  return out;
+}
+
+} // namespace
+
+int main() {
+  TempDir tmp("listing");
+  std::mt19937 rng(11);
+  for (int i = 0; i < 500; ++i) {
+    if (i % 7 == 0) fs::create_directory(tmp.path / ("dir" + std::to_string(i)));
+    else writeTestFile(tmp.path / ("file" + std::to_string(i)), rng() % 300);
+  }
+
+  for (SortMode mode : {SortMode::NAME, SortMode::SIZE, SortMode::DATE}) {
+    FileListing list;
+    readDirectoryEntries(tmp.path, false, true, list);
+    list.resolveAllStats();
+    list.sort(mode);
+
+    // A batch removing, rewriting and creating names must leave the listing
+    // as a fresh read and sort would.
+    std::vector<std::string> gone, present;
+    for (int i = 0; i < 500; i += 5) {
+      std::string name = (i % 7 == 0 ? "dir" : "file") + std::to_string(i);
+      fs::remove(tmp.path / name);
+      gone.push_back(name);
+    }
+    for (int i = 1; i < 500; i += 9) {
+      if (i % 7 == 0 || i % 5 == 0) continue;
+      std::string name = "file" + std::to_string(i);
+      writeTestFile(tmp.path / name, 1000 + rng() % 300);
+      present.push_back(name);
+    }
+    for (int i = 0; i < 40; ++i) {
+      std::string name = "new" + std::to_string(i) + "_" + std::to_string(static_cast<int>(mode));
+      writeTestFile(tmp.path / name, rng() % 2000);
+      present.push_back(name);
+    }
+    CHECK(list.applyChanges(tmp.path.string(), gone, present, mode));
+
+    FileListing fresh;
+    readDirectoryEntries(tmp.path, false, true, fresh);
+    fresh.resolveAllStats();
+    fresh.sort(mode);
+    CHECK_EQ(list.size(), fresh.size());
+    CHECK(names(list) == names(fresh));
+    CHECK(!list.applyChanges(tmp.path.string(), {"missing"}, {}, mode));
+  }
+
+  // A listing streamed in chunks keeps its sorted window by merging each
+  // chunk into it, and the tracked row is followed.
+  TempDir stream("stream");
+  std::vector<fs::path> chunks;
+  for (int c = 0; c < 6; ++c) {
+    chunks.push_back(stream.path / ("c" + std::to_string(c)));
+    fs::create_directory(chunks.back());
+    for (int i = 0; i < 200; ++i) {
+      fs::path p = chunks.back() / ("f" + std::to_string(rng() % 5000) + "_" + std::to_string(i));
+      if (i % 9 == 0) fs::create_directory(p);
+      else writeTestFile(p, rng() % 3000);
+    }
+  }
+  for (SortMode mode : {SortMode::NAME, SortMode::SIZE, SortMode::DATE}) {
+    const size_t window = 40;
+    FileListing streamed;
+    readDirectoryEntries(chunks[0], false, true, streamed);
+    streamed.partialSort(window, mode);
+    size_t sorted = window, tracked = 17, k = window;
+    std::string trackedPath = streamed[tracked].path().string();
+    for (size_t c = 1; c < chunks.size(); ++c) {
+      FileListing chunk;
+      readDirectoryEntries(chunks[c], false, true, chunk);
+      size_t first = streamed.size();
+      streamed.appendListing(chunk);
+      // The window grows now and then, which needs looking past the prefix.
+      if (c == 3) k = window + 25;
+      sorted = streamed.mergeSortedPrefix(sorted, first, k, mode, tracked);
+      CHECK_EQ(sorted, k);
+      CHECK(streamed[tracked].path().string() == trackedPath);
+
+      FileListing full = streamed;
+      full.sort(mode);
+      std::vector<std::string> got = names(streamed), want = names(full);
+      got.resize(k);
+      want.resize(k);
+      CHECK(got == want);
+    }
+  }
+
+  // Natural order past the cached prefix: odd and long digit runs, leading
+  // zeros and case.
+  TempDir natural("natural");
+  std::vector<std::string> expected = {
+      "a", "A1", "a2", "a007", "a10", "a99", "a100", "a12345678", "a123456789",
+      "a1234567890", "a9999999999", "a10000000000", "abcdefgh1234567",
+      "abcdefgh1234568", "abcdefgh12345670", "b"};
+  for (const std::string& name : expected)
+    writeTestFile(natural.path / name, 0);
+  FileListing sorted;
+  readDirectoryEntries(natural.path, false, true, sorted);
+  sorted.sort(SortMode::NAME);
+  CHECK(names(sorted) == expected);
+  return 0;
+}
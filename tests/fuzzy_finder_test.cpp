@@ -0,0 +1,73 @@
+#include "check.h" // first: it includes utils.h
+#include "fuzzy_finder.h"
+#include <random>
+
+namespace {
+
+char fold(char c) { return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + 32) : c; }
+
+bool isSubsequence(const std::string& text, const std::string& query) {
+  size_t j = 0;
+  for (size_t i = 0; i < text.size() && j < query.size(); ++i)
+    if (fold(text[i]) == query[j]) ++j;
+  return j == query.size();
+}
+
+// A query's positions are increasing and each lands on its character.
+void checkPositions(const std::string& text, const std::string& query,
+                    const std::vector<uint32_t>& positions) {
+  CHECK_EQ(positions.size(), query.size());
+  for (size_t q = 0; q < query.size(); ++q) {
+    CHECK(positions[q] < text.size());
+    CHECK(fold(text[positions[q]]) == query[q]);
+    if (q > 0) CHECK(positions[q] > positions[q - 1]);
+  }
+}
+
+} // namespace
+
+int main() {
+  CHECK_EQ(fuzzyScore("src/main.cpp", ""), 0);
+  CHECK_EQ(fuzzyScore("src/main.cpp", "xyz"), -1);
+  CHECK_EQ(fuzzyScore("abc", "abcd"), -1);
+  CHECK(fuzzyScore("src/main.cpp", "main") > fuzzyScore("src/mxaxixn.cpp", "main"));
+  CHECK(fuzzyScore("src/Main.cpp", "Main") >= 0);
+  CHECK_EQ(fuzzyScore("src/main.cpp", "Main"), -1);
+
+  // A real match whose gap costs more than its matches earn is still one.
+  CHECK_EQ(fuzzyScore("a" + std::string(300, '.') + "b", "ab"), 0);
+
+  // Random texts over a small alphabet, so queries match in many ways and
+  // the windows begin and end all over the text. Each row of the DP is only
+  // written inside its window and never cleared, so scoring the same pairs
+  // after others, in another order, must give the same results.
+  std::mt19937 rng(19);
+  const char alphabet[] = "ab/._Cd";
+  std::vector<std::pair<std::string, std::string>> cases;
+  for (int k = 0; k < 3000; ++k) {
+    std::string text(1 + rng() % 120, ' ');
+    for (char& c : text)
+      c = alphabet[rng() % 7];
+    std::string query(1 + rng() % 6, ' ');
+    for (char& c : query)
+      c = fold(alphabet[rng() % 7]);
+    cases.emplace_back(text, query);
+  }
+  std::vector<int> scores;
+  for (const auto& [text, query] : cases) {
+    std::vector<uint32_t> positions;
+    int score = fuzzyScore(text, query, &positions);
+    CHECK_EQ(score >= 0, isSubsequence(text, query));
+    if (score >= 0) checkPositions(text, query, positions);
+    scores.push_back(score);
+  }
+  for (size_t k = cases.size(); k-- > 0;)
+    CHECK_EQ(fuzzyScore(cases[k].first, cases[k].second), scores[k]);
+
+  // Past the DP's cell budget the greedy fallback takes over.
+  std::string wide = "x" + std::string(40000, '-') + "y/z";
+  std::vector<uint32_t> positions;
+  CHECK(fuzzyScore(wide, "xyz", &positions) >= 0);
+  checkPositions(wide, "xyz", positions);
+  return 0;
+}
@@ -0,0 +1,67 @@
+#include "check.h" // first: it includes utils.h
+#include "preview_render.h"
+#include <random>
+
+namespace {
+
+// Directories first, then by name, with the first rows resolved.
+void checkShown(const FileListing& list, size_t rows) {
+  for (size_t i = 0; i < std::min(rows, list.size()); ++i)
+    CHECK(list.detailsResolved(i));
+  for (size_t i = 1; i < list.size(); ++i) {
+    bool dirA = list[i - 1].is_directory(), dirB = list[i].is_directory();
+    CHECK(dirA >= dirB);
+    if (dirA == dirB)
+      CHECK(FileListing::compareNames(list[i - 1].name(), list[i].name()) < 0);
+  }
+}
+
+} // namespace
+
+int main() {
+  TempDir tmp("preview");
+  std::mt19937 rng(5);
+  std::vector<int> ids(3000);
+  for (int i = 0; i < 3000; ++i)
+    ids[i] = i;
+  std::shuffle(ids.begin(), ids.end(), rng);
+  for (int id : ids)
+    writeTestFile(tmp.path / ("file" + std::to_string(id)), 0);
+  for (int d = 0; d < 5; ++d)
+    fs::create_directory(tmp.path / ("empty" + std::to_string(d)));
+  fs::create_symlink("file7", tmp.path / "afile7");
+
+  const int rows = 20;
+  std::shared_ptr<FileListing> head;
+  PreviewData data;
+  CHECK(buildDirectoryPreview(
+      tmp.path.string(), false, rows, [] { return false; },
+      [&](std::shared_ptr<FileListing> h) {
+        head = std::move(h);
+        return true;
+      },
+      data));
+
+  // A directory larger than one read publishes its first chunk early.
+  CHECK(head);
+  CHECK_EQ(head->size(), (size_t)rows);
+  checkShown(*head, rows);
+
+  const FileListing& list = *data.listing;
+  CHECK_EQ(list.size(), (size_t)3006);
+  checkShown(list, rows);
+  CHECK(list[0].name() == "empty0");
+  CHECK(list[0].is_empty_directory());
+  CHECK(list[5].name() == "afile7");
+  CHECK(list[5].is_symlink());
+  CHECK(list[6].name() == "file0");
+  CHECK(!list.detailsResolved(list.size() - 1));
+
+  // Giving up on the head stops the read.
+  PreviewData dropped;
+  CHECK(!buildDirectoryPreview(
+      tmp.path.string(), false, rows, [] { return false; },
+      [](std::shared_ptr<FileListing>) { return false; }, dropped));
+  CHECK(!dropped.listing);
+  return 0;
+}
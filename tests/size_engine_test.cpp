@@ -0,0 +1,48 @@
+#include "check.h" // first: it includes utils.h
+#include "size_engine.h"
+#include <condition_variable>
+#include <map>
+#include <mutex>
+
+namespace {
+
+// Final sizes of roots, in submission order.
+uintmax_t sizeOf(SizeEngine& engine, std::mutex& m, std::condition_variable& cv,
+                 std::map<std::string, uintmax_t>& results, const fs::path& root) {
+  engine.submit(root, 1);
+  std::unique_lock<std::mutex> lock(m);
+  cv.wait(lock, [&] { return results.count(root.string()) > 0; });
+  return results[root.string()];
+}
+
+} // namespace
+
+int main() {
+  TempDir tmp("size");
+  fs::path real = tmp.path / "real";
+  fs::create_directories(real / "sub");
+  writeTestFile(real / "a", 1000);
+  writeTestFile(real / "sub" / "b", 2000);
+  fs::create_directory_symlink(real, tmp.path / "link");
+  // A link inside the tree is not followed.
+  fs::create_directory_symlink(real / "sub", real / "sublink");
+
+  std::mutex m;
+  std::condition_variable cv;
+  std::map<std::string, uintmax_t> results;
+  SizeEngine engine(2, false, nullptr,
+                    [&](const fs::path& root, uintmax_t size, int, bool final) {
+                      if (!final) return;
+                      std::lock_guard<std::mutex> lock(m);
+                      results[root.string()] = size;
+                      cv.notify_all();
+                    },
+                    [](int) { return true; });
+
+  uintmax_t direct = sizeOf(engine, m, cv, results, real);
+  CHECK(direct >= 3000);
+  // A symlinked directory root is followed and sized like its target.
+  CHECK_EQ(sizeOf(engine, m, cv, results, tmp.path / "link"), direct);
+  CHECK_EQ(sizeOf(engine, m, cv, results, tmp.path / "missing"), (uintmax_t)0);
+  return 0;
+}
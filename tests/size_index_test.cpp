@@ -0,0 +1,69 @@
+#include "check.h" // first: it includes utils.h
+#include "size_index.h"
+#include <sys/stat.h>
+
+namespace {
+
+SizeIndex::Entry entry(uintmax_t total) {
+  SizeIndex::Entry e;
+  e.mtime = 1;
+  e.ownBytes = total;
+  e.totalBytes = total;
+  e.children = {"child"};
+  return e;
+}
+
+bool has(SizeIndex& index, uint64_t ino) {
+  SizeIndex::Entry e;
+  return index.lookup(1, ino, e);
+}
+
+} // namespace
+
+int main() {
+  TempDir tmp("sizeindex");
+  std::string file = (tmp.path / "dirsizes.idx").string();
+
+  {
+    SizeIndex index;
+    index.open(file);
+    for (uint64_t ino = 0; ino < 10; ++ino)
+      index.store(1, ino, entry(ino * 100));
+    CHECK(index.save());
+  }
+
+  // A later session uses three of the records and adds three; with room for
+  // six, the seven untouched ones are compacted away.
+  {
+    SizeIndex index;
+    index.open(file);
+    index.setCapacity(6);
+    for (uint64_t ino = 0; ino < 3; ++ino)
+      CHECK(has(index, ino));
+    for (uint64_t ino = 10; ino < 13; ++ino)
+      index.store(1, ino, entry(ino * 100));
+    CHECK(index.save());
+  }
+
+  {
+    SizeIndex index;
+    index.open(file);
+    for (uint64_t ino : {0, 1, 2, 10, 11, 12})
+      CHECK(has(index, ino));
+    for (uint64_t ino = 3; ino < 10; ++ino)
+      CHECK(!has(index, ino));
+    SizeIndex::Entry e;
+    CHECK(index.lookup(1, 11, e));
+    CHECK_EQ(e.totalBytes, (uintmax_t)1100);
+    CHECK(e.children.size() == 1 && e.children[0] == "child");
+  }
+
+  // No temporary file is left next to the index.
+  size_t files = 0;
+  for (const auto& de : fs::directory_iterator(tmp.path)) {
+    (void)de;
+    ++files;
+  }
+  CHECK_EQ(files, (size_t)1);
+  return 0;
+}
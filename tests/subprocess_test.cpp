@@ -0,0 +1,43 @@
+#include "check.h" // first: it includes utils.h
+#include "subprocess.h"
+#include <vector>
+
+namespace {
+
+std::vector<std::string> run(const std::string& cmd, int& status,
+                             size_t maxOutputBytes = MAX_OUTPUT_BYTES) {
+  std::vector<std::string> lines;
+  status = runShellLines(
+      cmd,
+      [&](const std::string& line) {
+        lines.push_back(line);
+        return true;
+      },
+      nullptr, maxOutputBytes);
+  return lines;
+}
+
+} // namespace
+
+int main() {
+  int status = 0;
+  std::vector<std::string> lines = run("printf 'one\\ntwo\\n\\nlast'", status);
+  CHECK_EQ(status, 0);
+  CHECK_EQ(lines.size(), (size_t)4);
+  CHECK(lines[0] == "one" && lines[1] == "two" && lines[2].empty() && lines[3] == "last");
+
+  // An overlong line is cut and the rest of it dropped, newline or not.
+  lines = run("head -c 200000 /dev/zero | tr '\\0' x; echo; echo next; head -c 70000 /dev/zero",
+              status);
+  CHECK_EQ(status, 0);
+  CHECK_EQ(lines.size(), (size_t)3);
+  CHECK_EQ(lines[0].size(), MAX_LINE_BYTES);
+  CHECK(lines[1] == "next");
+  CHECK_EQ(lines[2].size(), MAX_LINE_BYTES);
+
+  // Too much output in all kills the child.
+  lines = run("yes", status, 1 << 20);
+  CHECK_EQ(status, -1);
+  CHECK(!lines.empty() && lines.size() <= (1 << 19) + 2048);
+  return 0;
+}